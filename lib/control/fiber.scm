@@ -0,0 +1,533 @@
+;;;
+;;; control.fiber - lightweight threads
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Fibers are lightweight threads scheduled cooperatively on a small
+;; number of VM threads (M:N threading).
+;;
+;; A fiber runs under a reset; when it has to wait (fiber-join, channel
+;; operations, fiber I/O, fiber-sleep, fiber-yield), it captures the rest
+;; of its computation with shift and returns to the worker, which picks
+;; up the next runnable fiber.  A parked fiber is just a record and a
+;; captured partial continuation, so it takes a few hundred bytes plus
+;; the frames it is suspended in.
+;;
+;; The runnable fibers are kept in a single queue shared by all workers,
+;; so a fiber may be resumed on a different thread from the one it was
+;; suspended on.  Each worker has its own aio context (gauche.aio) and
+;; timers, and a pipe to be woken up when it's idle.
+;;
+;; Waiting operations are registered *after* the fiber's continuation is
+;; captured and the worker has left the fiber, so another worker can
+;; never resume a fiber that is still running.  See suspend.
+;;
+;; The waiting operations can also be called outside of fibers; they
+;; simply block the calling thread then.
+;;
+;; Limitation: A fiber can't be suspended while Scheme code is called
+;; back from C (e.g. in a procedure passed to a C-implemented sort, or
+;; in the fill procedure of a virtual port), for the C frames can't be
+;; captured.  That is why we provide fiber-read! etc. instead of making
+;; ordinary port I/O yield.
+
+(define-module control.fiber
+  (use gauche.threads)
+  (use gauche.partcont)
+  (use gauche.uvector)
+  (use gauche.aio)
+  (use data.queue)
+  (use data.heap)
+  (export <fiber-scheduler> make-fiber-scheduler fiber-scheduler?
+          fiber-scheduler-shutdown! current-fiber-scheduler run-fibers
+
+          <fiber> fiber? spawn-fiber current-fiber fiber-name
+          fiber-done? fiber-join fiber-yield fiber-sleep
+
+          <channel> make-channel channel? channel-put! channel-get
+          channel-close! channel-closed?
+
+          fiber-read! fiber-write fiber-accept fiber-connect))
+(select-module control.fiber)
+
+;;;
+;;; Scheduler
+;;;
+
+(define-class <fiber-scheduler> ()
+  ((size      :init-keyword :size :init-value 1)
+   ;; the rest of slots are private
+   (run-queue :init-form (make-mtqueue)) ; Queue Fiber, runnable fibers
+   (workers   :init-value '#())         ; #(<worker>)
+   (mutex     :init-form (make-mutex))  ; protects idle, shut-down and
+                                        ;  fiber states
+   (idle      :init-value '())          ; [<worker>] waiting for events
+   (shut-down :init-value #f)))
+
+;; Each worker owns a VM thread.  Only the worker's thread touches ctx
+;; and timers.
+(define-record-type <worker>
+  (%make-worker scheduler thread ctx wake-in wake-out wake-buf timers)
+  worker?
+  (scheduler worker-scheduler)
+  (thread    worker-thread worker-thread-set!)
+  (ctx       worker-ctx)                ; <aio-context>
+  (wake-in   worker-wake-in)            ; pipe to wake up an idle worker
+  (wake-out  worker-wake-out)
+  (wake-buf  worker-wake-buf)
+  (timers    worker-timers))            ; heap of (deadline . waiter)
+
+(define (make-fiber-scheduler :optional (size (sys-available-processors)))
+  (make <fiber-scheduler> :size size))
+
+(define (fiber-scheduler? obj) (is-a? obj <fiber-scheduler>))
+
+(define-method initialize ((s <fiber-scheduler>) initargs)
+  (next-method)
+  (set! (~ s'workers)
+        (list->vector
+         (list-tabulate (~ s'size)
+                        (^_ (receive (in out) (sys-pipe :buffering :none)
+                              (%make-worker s #f (make-aio-context)
+                                            in out (make-u8vector 64)
+                                            (make-binary-heap :key car)))))))
+  (vector-for-each (^w (worker-thread-set!
+                        w (thread-start! (make-thread (cut worker-loop w)))))
+                   (~ s'workers)))
+
+;; Stops the workers.  Fibers that haven't finished are abandoned.
+(define (fiber-scheduler-shutdown! s)
+  (assume-type s <fiber-scheduler>)
+  (when (eq? (current-fiber-scheduler) s)
+    (error "can't shut down the fiber scheduler from its own fiber:" s))
+  (unless (with-locking-mutex (~ s'mutex)
+            (^[] (begin0 (~ s'shut-down) (set! (~ s'shut-down) #t))))
+    (vector-for-each poke! (~ s'workers))
+    (vector-for-each (^w (thread-join! (worker-thread w))
+                         (close-port (worker-wake-in w))
+                         (close-port (worker-wake-out w)))
+                     (~ s'workers))))
+
+(define %current-worker (make-thread-local #f))
+(define %current-fiber (make-thread-local #f))
+
+;; Returns the scheduler the current thread is working for, or #f.
+(define (current-fiber-scheduler)
+  (cond [(tlref %current-worker) => worker-scheduler]
+        [else #f]))
+
+;; Creates a scheduler, runs THUNK as a fiber on it and returns its
+;; result after shutting down the scheduler.
+(define (run-fibers thunk :key (threads (sys-available-processors)))
+  (let1 s (make-fiber-scheduler threads)
+    (unwind-protect (fiber-join (spawn-fiber thunk :scheduler s))
+      (fiber-scheduler-shutdown! s))))
+
+;; Max number of fibers a worker runs before checking I/O and timers.
+(define-constant *batch-size* 64)
+
+(define (worker-loop w)
+  (define s (worker-scheduler w))
+  (define ctx (worker-ctx w))
+  (tlset! %current-worker w)
+  (arm-wakeup! w)
+  (let loop ()
+    (cond [(~ s'shut-down) (aio-context-close ctx)]
+          [else
+           (run-ready! s *batch-size*)
+           (run-timers! w)
+           (cond [(not (queue-empty? (~ s'run-queue)))
+                  ;; Busy fibers shouldn't starve I/O.  The wakeup read
+                  ;; is always pending, so we check if there are others.
+                  (when (> (aio-pending-count ctx) 1) (aio-dispatch ctx 0))
+                  (loop)]
+                 [(worker-wait! w) (loop)]
+                 [else (aio-context-close ctx)])])))
+
+(define (run-ready! s n)
+  (when (> n 0)
+    (and-let1 f (dequeue! (~ s'run-queue) #f)
+      (run-fiber! f)
+      (run-ready! s (- n 1)))))
+
+;; Runs F until it finishes or suspends.  The result of reset is a thunk
+;; to be called after leaving the fiber.
+(define (run-fiber! f)
+  (tlset! %current-fiber f)
+  (let1 after (guard (e [else (^[] (finish! f 'error e))])
+                (reset (let ([k (fiber-cont f)] [v (fiber-value f)])
+                         (fiber-cont-set! f #f)
+                         (fiber-value-set! f #f)
+                         (k v))))
+    (tlset! %current-fiber #f)
+    (after)))
+
+;; Called when no fiber is runnable.  Waits for I/O, timers or a wakeup.
+;; Returns #f if the worker should exit.
+(define (worker-wait! w)
+  (define s (worker-scheduler w))
+  (define (unidle!)
+    (with-locking-mutex (~ s'mutex)
+      (^[] (set! (~ s'idle) (delete! w (~ s'idle))))))
+  (with-locking-mutex (~ s'mutex) (^[] (push! (~ s'idle) w)))
+  ;; Recheck after getting into the idle list, or we may miss a wakeup.
+  (cond [(not (queue-empty? (~ s'run-queue))) (unidle!) #t]
+        [(~ s'shut-down) (unidle!) #f]
+        [else (aio-dispatch (worker-ctx w) (timer-timeout w))
+              (unidle!)
+              #t]))
+
+;; Wakes up one idle worker, if any, to run a fiber just made runnable.
+(define (wake-worker! s)
+  (and-let* ([w (with-locking-mutex (~ s'mutex)
+                  (^[] (and (pair? (~ s'idle)) (pop! (~ s'idle)))))]
+             [ (not (eq? w (tlref %current-worker))) ])
+    (poke! w)))
+
+(define (poke! w)
+  (write-u8 1 (worker-wake-out w)))
+
+(define (arm-wakeup! w)
+  (aio-read (worker-ctx w) (worker-wake-in w) (worker-wake-buf w)
+            :data (^_ (arm-wakeup! w))))
+
+;;;
+;;; Timers
+;;;
+
+(define (now)
+  (receive (sec nsec) (sys-clock-gettime-monotonic)
+    (+ sec (/. nsec 1e9))))
+
+(define (add-timer! w deadline waiter)
+  (binary-heap-push! (worker-timers w) (cons deadline waiter)))
+
+(define (run-timers! w)
+  (let1 timers (worker-timers w)
+    (unless (binary-heap-empty? timers)
+      (let1 t (now)
+        (let loop ()
+          (unless (binary-heap-empty? timers)
+            (let1 e (binary-heap-find-min timers)
+              (when (<= (car e) t)
+                (binary-heap-pop-min! timers)
+                (resume! (cdr e) #f)
+                (loop)))))))))
+
+;; Timeout for aio-dispatch, in microseconds, or #f.
+(define (timer-timeout w)
+  (let1 timers (worker-timers w)
+    (and (not (binary-heap-empty? timers))
+         (max 0 (exact (ceiling (* (- (car (binary-heap-find-min timers))
+                                       (now))
+                                    1e6)))))))
+
+;;;
+;;; Fibers
+;;;
+
+(define-record-type <fiber>
+  (%make-fiber name scheduler cont value state result joiners)
+  fiber?
+  (name      fiber-name)
+  (scheduler fiber-scheduler)
+  (cont      fiber-cont fiber-cont-set!)   ; procedure to resume with value
+  (value     fiber-value fiber-value-set!)
+  (state     fiber-state fiber-state-set!) ; runnable, parked, done or error
+  (result    fiber-result fiber-result-set!) ; list of values, or condition
+  (joiners   fiber-joiners fiber-joiners-set!)) ; waiters of fiber-join
+
+(define-method write-object ((f <fiber>) port)
+  (format port "#<fiber ~s ~a>" (fiber-name f) (fiber-state f)))
+
+;; Runs THUNK in a new fiber.  SCHEDULER defaults to the one running
+;; the current fiber.
+(define (spawn-fiber thunk :key (scheduler (current-fiber-scheduler))
+                                (name #f))
+  (unless scheduler
+    (error "no fiber scheduler is given, and not in a fiber"))
+  (assume-type scheduler <fiber-scheduler>)
+  (when (~ scheduler'shut-down)
+    (error "fiber scheduler has been shut down:" scheduler))
+  (letrec ([f (%make-fiber name scheduler
+                           (^_ (receive vals (thunk)
+                                 (^[] (finish! f 'done vals))))
+                           #f 'runnable #f '())])
+    (enqueue! (~ scheduler'run-queue) f)
+    (wake-worker! scheduler)
+    f))
+
+(define (current-fiber) (tlref %current-fiber))
+
+(define (fiber-done? f)
+  (assume-type f <fiber>)
+  (boolean (memq (fiber-state f) '(done error))))
+
+(define (finish! f state result)
+  (let1 joiners (with-locking-mutex (~ (fiber-scheduler f)'mutex)
+                  (^[] (fiber-result-set! f result)
+                       (fiber-state-set! f state)
+                       (begin0 (fiber-joiners f) (fiber-joiners-set! f '()))))
+    (dolist [j joiners] (resume! j #t))))
+
+;; Waits for F to finish and returns its results.  If F raised an
+;; exception, it is reraised.
+(define (fiber-join f)
+  (assume-type f <fiber>)
+  (unless (fiber-done? f)
+    (suspend (^w (when (with-locking-mutex (~ (fiber-scheduler f)'mutex)
+                         (^[] (or (fiber-done? f)
+                                  (begin (push! (fiber-joiners f) w) #f))))
+                   (resume! w #t)))))
+  (case (fiber-state f)
+    [(done) (apply values (fiber-result f))]
+    [else (raise (fiber-result f))]))
+
+;; Lets other runnable fibers run.
+(define (fiber-yield)
+  (if (current-fiber)
+    (suspend (^w (resume! w #f)))
+    (thread-yield!)))
+
+(define (fiber-sleep seconds)
+  (if (current-fiber)
+    (let1 deadline (+ (now) seconds)
+      (suspend (^w (add-timer! (tlref %current-worker) deadline w))))
+    (sys-nanosleep (exact (round (* seconds 1e9))))))
+
+;;;
+;;; Suspension
+;;;
+
+;; A waiter is either a fiber or a <thread-waiter>, when a waiting
+;; operation is called outside of fibers.
+(define-record-type <thread-waiter>
+  (make-thread-waiter mutex cv value done)
+  thread-waiter?
+  (mutex tw-mutex)
+  (cv    tw-cv)
+  (value tw-value tw-value-set!)
+  (done  tw-done? tw-done-set!))
+
+;; When REGISTER raises an exception for a fiber, the fiber is resumed
+;; with the condition wrapped in this, and suspend re-raises it.
+(define-record-type <register-error>
+  (make-register-error condition)
+  register-error?
+  (condition register-error-condition))
+
+;; Suspends the current fiber or thread until it's resumed, and returns
+;; the value passed to resume!.  REGISTER is called with the waiter,
+;; and it must arrange to call resume! on it eventually.  For a fiber,
+;; REGISTER is called on the worker after leaving the fiber.  If REGISTER
+;; raises an exception, it must not have arranged to call resume!;
+;; the exception is raised from suspend.
+(define (suspend register)
+  (if-let1 f (current-fiber)
+    (let1 v (shift k
+              (fiber-cont-set! f k)
+              (fiber-state-set! f 'parked)
+              (^[] (guard (e [else (resume! f (make-register-error e))])
+                     (register f))))
+      (if (register-error? v)
+        (raise (register-error-condition v))
+        v))
+    (let1 tw (make-thread-waiter (make-mutex) (make-condition-variable) #f #f)
+      (register tw)
+      (let loop ()
+        (mutex-lock! (tw-mutex tw))
+        (if (tw-done? tw)
+          (begin (mutex-unlock! (tw-mutex tw)) (tw-value tw))
+          (begin (mutex-unlock! (tw-mutex tw) (tw-cv tw)) (loop)))))))
+
+;; Makes WAITER runnable, passing VALUE as the result of suspend.
+(define (resume! waiter value)
+  (if (fiber? waiter)
+    (let1 s (fiber-scheduler waiter)
+      (fiber-value-set! waiter value)
+      (fiber-state-set! waiter 'runnable)
+      (enqueue! (~ s'run-queue) waiter)
+      (wake-worker! s))
+    (with-locking-mutex (tw-mutex waiter)
+      (^[] (tw-value-set! waiter value)
+           (tw-done-set! waiter #t)
+           (condition-variable-broadcast! (tw-cv waiter))))))
+
+;;;
+;;; Channels
+;;;
+
+;; A channel with capacity 0 is a rendezvous point; channel-put!
+;; waits until someone takes the value.
+(define-record-type <channel>
+  (%make-channel capacity mutex buffer getters putters closed)
+  channel?
+  (capacity channel-capacity)
+  (mutex    channel-mutex)
+  (buffer   channel-buffer)             ; Queue value
+  (getters  channel-getters)            ; Queue waiter
+  (putters  channel-putters)            ; Queue (waiter . value)
+  (closed   channel-closed? channel-closed-set!))
+
+(define (make-channel :optional (capacity 0))
+  (unless (and (exact-integer? capacity) (>= capacity 0))
+    (error "capacity must be a nonnegative exact integer, but got:" capacity))
+  (%make-channel capacity (make-mutex) (make-queue) (make-queue) (make-queue)
+                 #f))
+
+(define *none* (list 'none))
+
+;; The following two must be called with the channel's mutex locked.
+;; They return *none* or #f instead of waiting.
+(define (%channel-try-get ch)
+  (let ([buf (channel-buffer ch)]
+        [putters (channel-putters ch)])
+    (cond [(not (queue-empty? buf))
+           (begin0 (dequeue! buf)
+             (unless (queue-empty? putters)
+               (let1 p (dequeue! putters)
+                 (enqueue! buf (cdr p))
+                 (resume! (car p) #t))))]
+          [(not (queue-empty? putters))
+           (let1 p (dequeue! putters)
+             (resume! (car p) #t)
+             (cdr p))]
+          [(channel-closed? ch) (eof-object)]
+          [else *none*])))
+
+(define (%channel-try-put ch v)
+  (cond [(channel-closed? ch) 'closed]
+        [(not (queue-empty? (channel-getters ch)))
+         (resume! (dequeue! (channel-getters ch)) v)
+         #t]
+        [(< (queue-length (channel-buffer ch)) (channel-capacity ch))
+         (enqueue! (channel-buffer ch) v)
+         #t]
+        [else #f]))
+
+;; Returns the next value from CH.  Returns an EOF object if CH is
+;; closed and there's no more values.
+(define (channel-get ch)
+  (assume-type ch <channel>)
+  (let1 v (with-locking-mutex (channel-mutex ch) (cut %channel-try-get ch))
+    (if (eq? v *none*)
+      (suspend (^w (let1 v (with-locking-mutex (channel-mutex ch)
+                             (^[] (rlet1 v (%channel-try-get ch)
+                                    (when (eq? v *none*)
+                                      (enqueue! (channel-getters ch) w)))))
+                     (unless (eq? v *none*) (resume! w v)))))
+      v)))
+
+(define (channel-put! ch v)
+  (assume-type ch <channel>)
+  (let1 r (or (with-locking-mutex (channel-mutex ch)
+                (cut %channel-try-put ch v))
+              (suspend (^w (let1 r (with-locking-mutex (channel-mutex ch)
+                                     (^[] (or (%channel-try-put ch v)
+                                              (begin
+                                                (enqueue! (channel-putters ch)
+                                                          (cons w v))
+                                                #f))))
+                             (when r (resume! w r))))))
+    (when (eq? r 'closed)
+      (error "channel is closed:" ch))
+    (undefined)))
+
+;; Closing a channel wakes up the waiting getters with an EOF object.
+;; The waiting putters raise an error.
+(define (channel-close! ch)
+  (assume-type ch <channel>)
+  (with-locking-mutex (channel-mutex ch)
+    (^[] (unless (channel-closed? ch)
+           (channel-closed-set! ch #t)
+           (dolist [w (dequeue-all! (channel-getters ch))]
+             (resume! w (eof-object)))
+           (dolist [p (dequeue-all! (channel-putters ch))]
+             (resume! (car p) 'closed))))))
+
+;;;
+;;; I/O
+;;;
+
+;; TARGET is a socket, a port with a file descriptor, or an fd.  The I/O
+;; is done directly on the fd, bypassing the port buffer.
+
+;; Used when fiber I/O procedures are called outside of fibers.
+(define %thread-aio-context (make-thread-local #f))
+
+(define (thread-aio-context)
+  (or (tlref %thread-aio-context)
+      (rlet1 ctx (make-aio-context)
+        (tlset! %thread-aio-context ctx))))
+
+;; START takes an aio context and a callback, and queues a request.
+;; Returns the result of the request, or raises a <system-error>.
+(define (aio-call what start)
+  (let1 req (if (current-fiber)
+              (suspend (^w (start (worker-ctx (tlref %current-worker))
+                                  (cut resume! w <>))))
+              (let* ([ctx (thread-aio-context)]
+                     [req (start ctx #f)])
+                (until (aio-request-done? req) (aio-wait ctx))
+                req))
+    (let1 e (aio-request-errno req)
+      (unless (zero? e)
+        (raise (condition
+                (<system-error> (errno e)
+                                (message (format "~a failed: ~a"
+                                                 what (sys-strerror e))))))))
+    (aio-request-result req)))
+
+;; Reads into the uvector BUF and returns the number of bytes read,
+;; which may be less than requested.  0 means EOF.
+(define (fiber-read! target buf :optional (start 0) (end -1))
+  (aio-call 'read
+            (^[ctx cb] (aio-read ctx target buf :start start :end end
+                                 :data cb))))
+
+;; Writes all of DATA, a string or a uvector.
+(define (fiber-write target data :optional (start 0) (end -1))
+  (let* ([buf (if (string? data) (string->u8vector data) data)]
+         [end (if (< end 0) (uvector-size buf) end)])
+    (let loop ([pos start])
+      (when (< pos end)
+        (loop (+ pos (aio-call 'write
+                               (^[ctx cb] (aio-write ctx target buf
+                                                     :start pos :end end
+                                                     :data cb)))))))))
+
+;; Returns a connected <socket>.
+(define (fiber-accept sock)
+  (aio-call 'accept (^[ctx cb] (aio-accept ctx sock :data cb))))
+
+;; Returns SOCK.
+(define (fiber-connect sock addr)
+  (aio-call 'connect (^[ctx cb] (aio-connect ctx sock addr :data cb))))
@@ -34,6 +34,13 @@
 ;; This is a provisional implementation; we'll use implicit thread pool
 ;; to avoid thread creation overhead eventually.
 
+;; If a future is created within a job running on a work-stealing pool
+;; (see control.thread-pool), the future is run as a child job on the same
+;; pool, instead of creating a thread.  You can also give a pool explicitly
+;; to make-future.  Calling future-get on such a future in a worker doesn't
+;; block the worker; it runs other jobs while waiting, so fork/join style
+;; recursive computation works without running out of threads.
+
 ;; Guile and Racket uses 'touch' to retrieve the result of a future, but
 ;; that name seems too generic.  We adopt 'future-get'.
 
@@ -52,28 +59,35 @@
 
 (define-module control.future
   (use gauche.threads)
+  (use control.job)
+  (use control.thread-pool)
   (export <future> future? future make-future future-done?
           future-get future-get/timeout))
 (select-module control.future)
 
 (define-class <future> ()
   ;; all slots must be private
-  ((%thread    :init-keyword :thread)))
+  ((%thread    :init-keyword :thread :init-value #f)
+   (%job       :init-keyword :job :init-value #f))) ; if run on a pool
 
 (define-syntax future
   (syntax-rules ()
-    [(_ expr)
-     (make <future>
-       :thread (thread-start! (make-thread (lambda () (values->list expr)))))]))
+    [(_ expr) (make-future (lambda () expr))]))
 
-(define (make-future thunk)
-  (future (thunk)))
+(define (make-future thunk :optional (pool (current-work-stealing-pool)))
+  (if pool
+    (make <future>
+      :job (fork-job! pool (lambda () (values->list (thunk)))))
+    (make <future>
+      :thread (thread-start! (make-thread (lambda () (values->list (thunk))))))))
 
 (define (future? obj) (is-a? obj <future>))
 
 (define (future-done? future)
   (assume-type future <future>)
-  (eq? (thread-state (~ future'%thread)) 'terminated))
+  (if-let1 job (~ future'%job)
+    (boolean (memq (job-status job) '(done error killed)))
+    (eq? (thread-state (~ future'%thread)) 'terminated)))
 
 (define-hybrid-syntax future-get
   (^[fu :optional (timeout #f) (timeout-val #f)]
@@ -86,7 +100,13 @@
 
 (define (future-get/timeout future timeout timeout-thunk)
   (assume-type future <future>)
-  (guard (e [(uncaught-exception? e) (raise (~ e'reason))]
-            [(join-timeout-exception? e) (timeout-thunk)]
-            [else (raise e)])
-    (apply values (thread-join! (~ future'%thread) timeout))))
+  (if-let1 job (~ future'%job)
+    (let* ([unique (list #f)]
+           [r (join-job! job timeout unique)])
+      (if (eq? r unique)
+        (timeout-thunk)
+        (apply values r)))
+    (guard (e [(uncaught-exception? e) (raise (~ e'reason))]
+              [(join-timeout-exception? e) (timeout-thunk)]
+              [else (raise e)])
+      (apply values (thread-join! (~ future'%thread) timeout)))))
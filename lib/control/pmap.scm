@@ -45,6 +45,7 @@
           sequential-mapper
           make-static-mapper
           make-pool-mapper
+          make-stealing-mapper
           make-fully-concurrent-mapper))
 (select-module control.pmap)
 
@@ -62,6 +63,12 @@
 ;;      distribute elements evenly.  Low overhead, good when each task is
 ;;      lightweight and the execution time won't fractuate much.
 ;;
+;;   stealing-mapper - Use work-stealing pool.  The collection is split
+;;      in halves recursively; a worker keeps one half and leaves the
+;;      other for idle workers to steal.  Good when the processing time
+;;      of each element varies a lot, in which case static-mapper leaves
+;;      cores idle.
+;;
 ;;   full-concurrent-mapper - Creates as many threads as the number of
 ;;      elements and run concurrently.  Relatively large overhead per element,
 ;;      but works better if (1) the number of elements are not very large,
@@ -274,6 +281,80 @@
           (run pool)
         (terminate-all! pool :force-timeout 0)))))
 
+;;
+;; stealing mapper
+;;
+
+;; NB: As pool-mapper, you can pass an existing work-stealing pool.
+;; GRAIN is the number of elements that are processed sequentially
+;; without being split further.
+
+(define-class <stealing-mapper> (<mapper>)
+  ((external-pool :init-keyword :external-pool
+                  :init-value #f)
+   (grain :init-keyword :grain
+          :init-value 1)))
+
+(define (make-stealing-mapper :optional (pool #f) (grain 1))
+  (make <stealing-mapper> :external-pool pool :grain (max grain 1)))
+
+(define (%with-stealing-pool mapper run)
+  (if-let1 pool (~ mapper'external-pool)
+    (run pool)
+    (let1 pool (make-work-stealing-pool (sys-available-processors))
+      (unwind-protect
+          (run pool)
+        (terminate-all! pool)))))
+
+;; Calls (leaf start end) on subranges of [0, n) covering it, in parallel.
+;; If STOP? returns true, remaining ranges are skipped.
+(define (%split-and-run pool n grain leaf stop?)
+  (define (rec start end)
+    (cond [(stop?)]
+          [(<= (- end start) grain) (leaf start end)]
+          [else
+           (let* ([mid (quotient (+ start end) 2)]
+                  [right (fork-job! pool (^[] (rec mid end)))])
+             (rec start mid)
+             (join-job! right))]))
+  (join-job! (fork-job! pool (^[] (rec 0 n)))))
+
+(define-method run-map ((mapper <stealing-mapper>) proc coll)
+  (let* ([vec (coerce-to <vector> coll)]
+         [rvec (make-vector (vector-length vec))])
+    (define (leaf start end)
+      (do ([i start (+ i 1)])
+          [(= i end)]
+        (vector-set! rvec i (proc (vector-ref vec i)))))
+    (%with-stealing-pool
+     mapper
+     (^[pool]
+       (%split-and-run pool (vector-length vec) (~ mapper'grain)
+                       leaf (^[] #f))
+       (vector->list rvec)))))
+
+;; Unlike other mappers, this doesn't terminate threads when a solution
+;; is found; the elements not yet processed are just skipped.
+(define-method run-select ((mapper <stealing-mapper>) proc coll)
+  (define vec (coerce-to <vector> coll))
+  (define result (atom #f #f))
+  (define found? #f)                    ; for quick check without lock
+  (define (leaf start end)
+    (let loop ([i start])
+      (when (and (< i end) (not found?))
+        (receive (s? r) (proc (vector-ref vec i))
+          (if s?
+            (begin
+              (atomic-update! result (^[f v] (if f (values f v) (values #t r))))
+              (set! found? #t))
+            (loop (+ i 1)))))))
+  (%with-stealing-pool
+   mapper
+   (^[pool]
+     (%split-and-run pool (vector-length vec) (~ mapper'grain)
+                     leaf (^[] found?))
+     (atom-ref result 1))))
+
 ;;
 ;; fully concurrent mapper
 ;;
@@ -47,7 +47,12 @@
   (export <thread-pool>
           <thread-pool-shut-down>
           make-thread-pool thread-pool-results thread-pool-shut-down?
-          add-job! wait-all terminate-all!))
+          add-job! wait-all terminate-all!
+
+          <work-stealing-pool>
+          make-work-stealing-pool work-stealing-pool?
+          current-work-stealing-pool
+          fork-job! join-job!))
 (select-module control.thread-pool)
 
 ;; - Thread job is queued in job queue.
@@ -100,7 +105,8 @@
     [_ #t]))                            ; no more jobs
 
 ;; Returns job if queued, #f if job queue is full
-(define (add-job! pool thunk :optional (need-result #f) (timeout #f))
+(define-method add-job! ((pool <thread-pool>) thunk
+                         :optional (need-result #f) (timeout #f))
   (when (~ pool'shut-down) (%shut-down pool))
   (let1 job (make-job thunk :cancellable #t)
     (job-acknowledge! job)
@@ -109,6 +115,19 @@
            (%shut-down pool)
            job))))
 
+;; Converts timeout argument to an absolute time, or #f
+(define (%abstime timeout)
+  (cond [(is-a? timeout <time>) timeout]
+        [(real? timeout)
+         (receive (subsec sec) (modf timeout)
+           (add-duration (current-time)
+                         (make-time time-duration
+                                    (round->exact (* subsec 1e9))
+                                    sec)))]
+        [(not timeout) #f]
+        [else (error "timeout must be either a real number, a <time> object, \
+                      or #f, but got:" timeout)]))
+
 ;; Note: The signature has been changed from 0.9.1, in which wait-all
 ;; only takes check-interval optional argument.  It is impossible to detect
 ;; the old usage, since integer is a valid argument as timeout.  However,
@@ -118,18 +137,9 @@
 ;; the same as saying "forever", so all you get is slighly off check-interval.
 ;; Smaller check-interval may be a bit serious, since it may delay response
 ;; in some situation.  But the default 0.5 seconds isn't really bad, I guess.
-(define (wait-all pool :optional (timeout #f) (check-interval #e5e8))
-  (define abstime
-    (cond [(is-a? timeout <time>) timeout]
-          [(real? timeout)
-           (receive (subsec sec) (modf timeout)
-             (add-duration (current-time)
-                           (make-time time-duration
-                                      (round->exact (* subsec 1e9))
-                                      sec)))]
-          [(not timeout) #f]
-          [else (error "timeout must be either a real number, a <time> object, \
-                        or #f, but got:" timeout)]))
+(define-method wait-all ((pool <thread-pool>)
+                         :optional (timeout #f) (check-interval #e5e8))
+  (define abstime (%abstime timeout))
   (let loop ([now (and abstime (current-time))])
     ;; NB: We assume the caller ensures no new jobs are inserted while calling
     ;; wait-all.
@@ -149,7 +159,8 @@
     [(val) (%terminate-all! pool :force-timeout val)]
     [_     (apply %terminate-all! pool args)]))
 
-(define (%terminate-all! pool :key (force-timeout #f) (cancel-queued-jobs #f))
+(define-method %terminate-all! ((pool <thread-pool>)
+                                :key (force-timeout #f) (cancel-queued-jobs #f))
   (define size (~ pool'size))
 
   ;; First, make sure no more jobs are put into the queue.
@@ -171,3 +182,266 @@
       (and-let* ([job (thread-specific t)])
         (job-mark-killed! job "thread pool has shut down"))
       (thread-terminate! t))))
+
+;;;
+;;; Work-stealing pool
+;;;
+
+;; <work-stealing-pool> supports the same operations as <thread-pool>
+;; (add-job!, wait-all, terminate-all!, thread-pool-results and
+;; thread-pool-shut-down?), but each worker owns a <work-deque>.
+;;
+;; - A job added by a worker of the pool goes to the worker's own deque.
+;;   A job added from other threads goes to the shared injection queue.
+;; - A worker looks for a job first in its own deque (the newest one),
+;;   then in the injection queue, then steals from other workers' deques
+;;   (the oldest one).  In divide-and-conquer computation, the oldest job
+;;   tends to be the largest chunk, so a few steals balance the load.
+;; - Pushing and popping the deque don't lock, so workers don't contend
+;;   on a single queue.
+;;
+;; fork-job! and join-job! provide fork/join style parallelism.
+;; When a worker calls join-job!, it runs other jobs until the joined
+;; job finishes instead of blocking, so nested fork/join doesn't run out
+;; of workers.
+
+(define-class <work-stealing-pool> ()
+  ((result-queue :init-form (make-mtqueue)) ; Queue Job
+   ;; the rest of slots are private
+   (pool      :init-value '())          ; [Thread]
+   (size      :init-keyword :size :init-value 2)
+   (deques    :init-value '#())         ; #(<work-deque>), one per worker
+   (injector  :init-form (make-mtqueue)) ; Queue Job, added from outside
+   (mutex     :init-form (make-mutex))  ; to put idle workers to sleep
+   (cv        :init-form (make-condition-variable))
+   (num-idle  :init-value 0)            ; # of sleeping workers
+   (num-joining :init-value 0)          ; # of workers waiting in join-job!
+   (shut-down :init-value #f)))
+
+(define (make-work-stealing-pool :optional (size (sys-available-processors)))
+  (make <work-stealing-pool> :size size))
+
+(define (work-stealing-pool? obj) (is-a? obj <work-stealing-pool>))
+
+(define-method initialize ((pool <work-stealing-pool>) initargs)
+  (next-method)
+  (set! (~ pool'deques)
+        (list->vector (list-tabulate (~ pool'size) make-work-deque)))
+  (set! (~ pool'pool)
+        (list-tabulate (~ pool'size)
+                       (^i (thread-start! (make-thread (cut ws-worker pool i)))))))
+
+;; (pool . index) if the current thread is a worker of a work-stealing pool.
+(define ws-worker-info (make-thread-local #f))
+
+;; Returns the work-stealing pool the current thread is working for,
+;; or #f.
+(define (current-work-stealing-pool)
+  (cond [(tlref ws-worker-info) => car]
+        [else #f]))
+
+(define (ws-worker pool index)
+  (define dq (vector-ref (~ pool'deques) index))
+  (tlset! ws-worker-info (cons pool index))
+  (let loop ()
+    (cond [(ws-find-job pool dq index)
+           => (^[job] (ws-run-job pool job) (loop))]
+          [(ws-sleep pool) (loop)]
+          [else #t])))                  ; shut down
+
+(define (ws-find-job pool dq index)
+  (or (work-deque-pop! dq #f)
+      (dequeue! (~ pool'injector) #f)
+      (ws-steal pool index)))
+
+(define (ws-steal pool index)
+  (let* ([deques (~ pool'deques)]
+         [n (vector-length deques)])
+    (let loop ([k 1])
+      (and (< k n)
+           (or (work-deque-steal! (vector-ref deques (modulo (+ index k) n))
+                                  #f)
+               (loop (+ k 1)))))))
+
+;; A worker may run a job while running another job in join-job!,
+;; so we restore the thread-specific value afterwards.
+(define (ws-run-job pool job)
+  (define self (current-thread))
+  (let1 outer (thread-specific self)
+    (thread-specific-set! self job)
+    (job-run! job)                      ; captures errors
+    (when (job-specific job) (enqueue! (~ pool'result-queue) job))
+    (when (job-waiter-cv job) (ws-notify-joiners pool))
+    (thread-specific-set! self outer)))
+
+(define (ws-work-available? pool)
+  (or (not (queue-empty? (~ pool'injector)))
+      (any (^[dq] (not (work-deque-empty? dq)))
+           (vector->list (~ pool'deques)))))
+
+;; Waking up workers without locking on every push
+;;
+;;   A waiting worker increments num-idle or num-joining and then checks
+;;   if there's something to do; ws-notify and ws-notify-joiners make
+;;   something to do and then check the counters.  Both sides put a full
+;;   memory barrier in between, so at least one of them sees the other's
+;;   change.  Only when a waiter is seen do we take the mutex to signal.
+;;   The waiter keeps the mutex from the check until it waits on the
+;;   condition variable, so the signal can't come in between.
+
+(define %memory-barrier (with-module gauche.threads %memory-barrier))
+
+;; Called when a worker finds no job.  Returns #f if the worker should
+;; exit, #t otherwise.
+(define (ws-sleep pool)
+  (mutex-lock! (~ pool'mutex))
+  (inc! (~ pool'num-idle))
+  (%memory-barrier)
+  (cond [(ws-work-available? pool)
+         (dec! (~ pool'num-idle))
+         (mutex-unlock! (~ pool'mutex))
+         #t]
+        [(~ pool'shut-down)
+         (dec! (~ pool'num-idle))
+         (mutex-unlock! (~ pool'mutex))
+         #f]
+        [else
+         (mutex-unlock! (~ pool'mutex) (~ pool'cv))
+         (mutex-lock! (~ pool'mutex))
+         (dec! (~ pool'num-idle))
+         (mutex-unlock! (~ pool'mutex))
+         #t]))
+
+;; Called after a job is pushed.  If a worker is in join-job!, we wake
+;; up everyone, for the joining worker may return without taking the
+;; new job.
+(define (ws-notify pool)
+  (%memory-barrier)
+  (cond [(> (~ pool'num-joining) 0)
+         (mutex-lock! (~ pool'mutex))
+         (condition-variable-broadcast! (~ pool'cv))
+         (mutex-unlock! (~ pool'mutex))]
+        [(> (~ pool'num-idle) 0)
+         (mutex-lock! (~ pool'mutex))
+         (condition-variable-signal! (~ pool'cv))
+         (mutex-unlock! (~ pool'mutex))]))
+
+;; Called after a job created by fork-job! finishes.
+(define (ws-notify-joiners pool)
+  (%memory-barrier)
+  (when (> (~ pool'num-joining) 0)
+    (mutex-lock! (~ pool'mutex))
+    (condition-variable-broadcast! (~ pool'cv))
+    (mutex-unlock! (~ pool'mutex))))
+
+(define (ws-push! pool job)
+  (let1 w (tlref ws-worker-info)
+    (if (and w (eq? (car w) pool))
+      (work-deque-push! (vector-ref (~ pool'deques) (cdr w)) job)
+      (enqueue! (~ pool'injector) job)))
+  (ws-notify pool)
+  job)
+
+;; The job queues of work-stealing pool are unbounded, so add-job! never
+;; times out.
+(define-method add-job! ((pool <work-stealing-pool>) thunk
+                         :optional (need-result #f) (timeout #f))
+  (when (~ pool'shut-down) (%shut-down pool))
+  (let1 job (make-job thunk :cancellable #t :specific need-result)
+    (job-acknowledge! job)
+    (ws-push! pool job)))
+
+;; Schedules THUNK on POOL and returns a job, which should be passed to
+;; join-job! to retrieve the result.
+(define (fork-job! pool thunk)
+  (assume-type pool <work-stealing-pool>)
+  (when (~ pool'shut-down) (%shut-down pool))
+  (let1 job (make-job thunk :waitable #t)
+    (job-acknowledge! job)
+    (ws-push! pool job)))
+
+;; Waits for JOB to finish and returns its result.  If the job raised
+;; an exception, it is reraised.  Returns TIMEOUT-VAL on timeout.
+(define (join-job! job :optional (timeout #f) (timeout-val #f))
+  (if (ws-await job (%abstime timeout))
+    (case (job-status job)
+      [(done)  (job-result job)]
+      [(error) (raise (job-result job))]
+      [else    (error "job has been killed:" (job-result job))])
+    timeout-val))
+
+(define (ws-job-finished? job)
+  (memq (job-status job) '(done error killed)))
+
+;; Returns true if JOB finishes, #f on timeout.
+(define (ws-await job abstime)
+  (match (tlref ws-worker-info)
+    [(pool . index)
+     ;; We're a worker.  Instead of blocking, run other jobs, likely
+     ;; including JOB itself if no one has stolen it.
+     (let1 dq (vector-ref (~ pool'deques) index)
+       (let loop ()
+         (cond [(ws-job-finished? job) #t]
+               [(and abstime (time>=? (current-time) abstime)) #f]
+               [(ws-find-job pool dq index)
+                => (^[j] (ws-run-job pool j) (loop))]
+               [(ws-join-wait pool job abstime) (loop)]
+               [else (ws-job-finished? job)])))]
+    [_ (job-wait job abstime #f)]))
+
+;; A joining worker waits until JOB finishes or a new job is pushed.
+;; Returns #f on timeout.
+(define (ws-join-wait pool job abstime)
+  (mutex-lock! (~ pool'mutex))
+  (inc! (~ pool'num-joining))
+  (%memory-barrier)
+  (cond [(or (ws-job-finished? job) (ws-work-available? pool))
+         (dec! (~ pool'num-joining))
+         (mutex-unlock! (~ pool'mutex))
+         #t]
+        [else
+         (let1 r (mutex-unlock! (~ pool'mutex) (~ pool'cv) abstime)
+           (mutex-lock! (~ pool'mutex))
+           (dec! (~ pool'num-joining))
+           (mutex-unlock! (~ pool'mutex))
+           r)]))
+
+(define-method wait-all ((pool <work-stealing-pool>)
+                         :optional (timeout #f) (check-interval #e5e8))
+  (define abstime (%abstime timeout))
+  (let loop ([now (and abstime (current-time))])
+    ;; NB: We assume the caller ensures no new jobs are inserted while calling
+    ;; wait-all.
+    (cond [(and (not (ws-work-available? pool))
+                (= (~ pool'num-idle) (~ pool'size)))]
+          [(and abstime (time>=? now abstime)) #f] ;timeout
+          [else (sys-nanosleep check-interval)
+                (loop (and abstime (current-time)))])))
+
+(define-method %terminate-all! ((pool <work-stealing-pool>)
+                                :key (force-timeout #f) (cancel-queued-jobs #f))
+  (define (kill! job)
+    (job-mark-killed! job "thread pool has shut down")
+    (when (job-specific job) (enqueue! (~ pool'result-queue) job)))
+
+  (set! (~ pool'shut-down) #t)
+
+  ;; Jobs in the deques can only be taken by stealing from outside.
+  (when cancel-queued-jobs
+    (for-each kill! (dequeue-all! (~ pool'injector)))
+    (vector-for-each (^[dq] (let loop ()
+                              (and-let1 job (work-deque-steal! dq #f)
+                                (kill! job)
+                                (loop))))
+                     (~ pool'deques)))
+
+  ;; Wake up sleeping workers.  They exit when no jobs remain.
+  (mutex-lock! (~ pool'mutex))
+  (condition-variable-broadcast! (~ pool'cv))
+  (mutex-unlock! (~ pool'mutex))
+
+  (dolist [t (~ pool'pool)]
+    (unless (thread-join! t force-timeout #f)
+      (and-let* ([job (thread-specific t)])
+        (job-mark-killed! job "thread pool has shut down"))
+      (thread-terminate! t))))
@@ -46,7 +46,8 @@
   (use file.util)
   (use data.ulid)
   (use text.tr)
-  (export compile->c compile-link-toplevel))
+  (export compile->c compile-link-toplevel
+          compile-native-toplevel))
 (select-module gauche.cgen.cbe)
 
 ;; Parameters to control compilation
@@ -72,6 +73,21 @@
                                                          #f
                                                          default-hash)))))
 
+;; When we emit code into a unit other than <cbe-unit> (e.g. the one
+;; gauche.cgen.precomp uses), we keep its globals table here.
+(define *unit-globals* (make-hash-table 'eq?))
+
+(define (unit-globals unit)
+  (if (is-a? unit <cbe-unit>)
+    (~ unit'globals)
+    (or (hash-table-get *unit-globals* unit #f)
+        (rlet1 tab (make-hash-table (make-comparator wrapped-identifier?
+                                                     free-identifier=?
+                                                     #f
+                                                     default-hash))
+          (cgen-decl "#include <gauche/precomp.h>")
+          (hash-table-put! *unit-globals* unit tab)))))
+
 ;; Generate unique name for temporary files
 (define name-gen
   (let1 rs (make-random-source)
@@ -113,39 +129,78 @@
                   :init-function #"Scm__Init_~(cgen-safe-name name)")))
 
 (define (compile-toplevel . forms)
-  (let1 benvs (map compile-b forms)
-    (dolist [benv benvs]
-      (scan-globals (cgen-current-unit) benv))
-    (emit-globals (cgen-current-unit))
-    (dolist [benv benvs]
-      (let1 toplevel-cfn (benv->c benv)
-        (cgen-init #"  ~|toplevel-cfn|(NULL, 0, NULL);")))))
-
-;; scan benvs to register globals
+  (emit-benvs (map compile-b forms)))
+
+(define (emit-benvs benvs)
+  (emit-globals (append-map (cut scan-globals (cgen-current-unit) <>) benvs))
+  (dolist [benv benvs]
+    (let1 toplevel-cfn (benv->c benv)
+      (cgen-init #"  ~|toplevel-cfn|(NULL, 0, NULL);"))))
+
+;; Compile a toplevel FORM in module MOD and emit the C code into the
+;; current cgen unit, which need not be <cbe-unit>.  Used by
+;; gauche.cgen.precomp to compile selected procedures into C.
+;; Returns #f without emitting anything if FORM has a construct the C
+;; backend can't handle yet, so that the caller can fall back to VM code.
+(define (compile-native-toplevel form mod)
+  (and-let* ([benv (guard (e [(<error> e) #f]) (compile-b form mod))]
+             [ (native-compilable? benv) ])
+    (emit-benvs (list benv))
+    #t))
+
+;; Closures are created without environment (see CLOSE insn), so an inner
+;; closure can't refer to the registers of outer benvs.  MOV* isn't
+;; supported yet, either.
+(define (native-compilable? benv)
+  (define (self-contained? b)
+    (every (^[bb]
+             (every (^p (or (not (is-a? (car p) <reg>))
+                            (memq (car p) (~ b'registers))))
+                    (~ bb'reg-use)))
+           (~ b'blocks)))
+  (define (supported? b)
+    (every (^[bb] (not (assq 'MOV* (~ bb'insns)))) (~ b'blocks)))
+  (let loop ([b benv])
+    (and (or (eq? b benv) (self-contained? b))
+         (supported? b)
+         (every loop (~ b'children)))))
+
+;; scan benvs to register globals.  Returns a list of newly registered
+;; <cbe-global>s.
 (define (scan-globals unit benv)
-  (dolist [g (hash-table-keys (~ benv'globals))]
-    (or (hash-table-get (~ unit'globals) g #f)
-        (equal? (hash-table-get (~ benv'globals) g) '(def))
-        (let* ([gname (identifier->symbol g)]
-               [cname (symbol-append (gensym "global_") "_"
-                                     (cgen-safe-name (symbol->string gname)))]
-               [lit-module (cgen-literal (~ g'module))]
-               [lit-name (cgen-literal gname)])
-          (hash-table-put! (~ unit'globals) g
-                           (make <cbe-global>
-                             :cname cname
-                             :module-literal lit-module
-                             :symbol-literal lit-name)))))
-  (dolist [b (~ benv'children)] (scan-globals unit b)))
-
-(define (emit-globals unit)
-  ($ hash-table-for-each (~ unit'globals)
-     (^[_ global]
-       (cgen-decl #"static ScmGloc *~(~ global 'cname);")
-       (cgen-init #"  ~(~ global'cname) = Scm_FindBinding("
-                  #"    SCM_MODULE(~(cgen-cexpr (~ global'module-literal))),"
-                  #"    SCM_SYMBOL(~(cgen-cexpr (~ global'symbol-literal))),"
-                  #"    0);"))))
+  (define globals (unit-globals unit))
+  (append
+   (filter-map
+    (^g (and (not (hash-table-get globals g #f))
+             (not (equal? (hash-table-get (~ benv'globals) g) '(def)))
+             (let* ([gname (identifier->symbol g)]
+                    [cname (symbol-append (gensym "global_") "_"
+                                          (cgen-safe-name (symbol->string gname)))]
+                    [lit-module (cgen-literal (~ g'module))]
+                    [lit-name (cgen-literal gname)])
+               (rlet1 global (make <cbe-global>
+                               :cname cname
+                               :module-literal lit-module
+                               :symbol-literal lit-name)
+                 (hash-table-put! globals g global)))))
+    (hash-table-keys (~ benv'globals)))
+   (append-map (cut scan-globals unit <>) (~ benv'children))))
+
+(define (emit-globals globals)
+  (dolist [global globals]
+    (cgen-decl #"static ScmGloc *~(~ global 'cname);")
+    (cgen-init #"  ~(~ global'cname) = Scm_FindBinding("
+               #"    SCM_MODULE(~(cgen-cexpr (~ global'module-literal))),"
+               #"    SCM_SYMBOL(~(cgen-cexpr (~ global'symbol-literal))),"
+               #"    0);")))
+
+;; C expression to get the gloc of a global.  The binding may not exist
+;; at the initialization time; SCM_PC_GLOC looks it up again if so.
+(define (global-gloc id)
+  (let1 gl (assume (hash-table-get (unit-globals (cgen-current-unit)) id #f)
+                   "Unregistered global:" id)
+    #"SCM_PC_GLOC(~(~ gl'cname), ~(cgen-cexpr (~ gl'module-literal)), \
+                  ~(cgen-cexpr (~ gl'symbol-literal)))"))
 
 (define (benv->c benv)                  ;returns benv's entry cfn name
   (for-each benv->c (~ benv'children))
@@ -177,14 +232,8 @@
 (define (insn->c c insn)
   (match insn
     [('MOV rd rs) (cgen-body #"  ~(R rd) = ~(R rs);")]
-    [('LD r id) (let* ([gl (assume
-                            (hash-table-get (~ (cgen-current-unit)'globals) id))]
-                       [cname (~ gl'cname)])
-                  (cgen-body #"  ~(R r) = Scm_GlocGetValue(~cname);"))]
-    [('ST r id) (let* ([gl (assume
-                            (hash-table-get (~ (cgen-current-unit)'globals) id))]
-                       [cname (~ gl'cname)])
-                  (cgen-body #"  Scm_GlocSetValue(~|cname|, ~(R r));"))]
+    [('LD r id) (cgen-body #"  ~(R r) = Scm_GlocGetValue(~(global-gloc id));")]
+    [('ST r id) (cgen-body #"  Scm_GlocSetValue(~(global-gloc id), ~(R r));")]
     [('CLOSE r b) (cgen-body #"  ~(R r) ="
                              #"    Scm_MakeSubr(~(benv-cfn-name b),"
                              #"                 NULL,"
@@ -223,11 +272,12 @@
     [('ASSV r x y) (builtin-2arg c "Scm_Assv" r x y)]
     [('EQ r x y) (builtin-2arg/bool c "SCM_EQ" r x y)]
     [('EQV r x y) (builtin-2arg/bool c "Scm_EqvP" r x y)]
-    [('APPEND r . xs) (cgen-body #"  /* WRITEME: APPEND */")]
+    [('APPEND r . xs) (cgen-body #"  ~(R r) = ~(gen-append c xs);")]
     [('NOT r x) (cgen-body #"  ~(R r) = SCM_MAKE_BOOL(SCM_FALSEP(~(R x)));")]
     [('REVERSE r x) (builtin-1arg c "Scm_Reverse" r x)]
-    [('APPLY r . xs) (cgen-body #"  /* WRITEME: APPLY */")]
-    [('TAIL-APPLY r . xs) (cgen-body #"  /* WRITEME: TAIL-APPLY */")]
+    [((or 'APPLY 'TAIL-APPLY) . _)
+     ;; bbb turns these into CALL to apply, for they need VM.
+     (error "[internal] APPLY insn shouldn't appear in bbb output:" insn)]
     [('IS-A r x y) (builtin-2arg/bool c "SCM_ISA" r x y)]
     [('NULLP r x) (builtin-1arg/bool c "SCM_NULLP" r x)]
     [('PAIRP r x) (builtin-1arg/bool c "SCM_PAIRP" r x)]
@@ -240,26 +290,46 @@
     [('REALP r x) (builtin-1arg/bool c "SCM_REALP" r x)]
     [('IDENTIFIERP r x) (builtin-1arg/bool c "SCM_IDENTIFIERP" r x)]
     [('SETTER r x) (builtin-1arg c "Scm_Setter" r x)]
-    [('VEC r . xs) (cgen-body #"  /* WRITEME: VEC */")]
-    [('LIST->VEC r x) (cgen-body #"  /* WRITEME: LIST->VEC */")]
-    [('APP-VEC r . xs) (cgen-body #"  /* WRITEME: APP-VEC */")]
-    [('VEC-LEN r x) (builtin-1arg c "SCM_VECTOR_SIZE" r x)]
+    [('VEC r . xs)
+     (let1 v (gensym 'v)
+       (cgen-body #"  {"
+                  #"    ScmObj ~v = Scm_MakeVector(~(length xs), SCM_UNDEFINED);")
+       (for-each-with-index
+        (^[i x] (cgen-body #"    SCM_VECTOR_ELEMENT(~v, ~i) = ~(R x);"))
+        xs)
+       (cgen-body #"    ~(R r) = ~v;"
+                  #"  }"))]
+    [('LIST->VEC r x) (cgen-body #"  ~(R r) = Scm_ListToVector(~(R x), 0, -1);")]
+    [('APP-VEC r . xs)
+     (cgen-body #"  ~(R r) = Scm_ListToVector(~(gen-append c xs), 0, -1);")]
+    [('VEC-LEN r x)
+     (cgen-body #"  ~(R r) = SCM_MAKE_INT(SCM_VECTOR_SIZE(SCM_PC_ENSURE_VEC(~(R x))));")]
     [('VEC-REF r x y)
      (let ([n (gensym 'n)]
            [v (gensym 'v)])
-       (cgen-body #"  ScmSmallInt ~n = SCM_PC_GET_INDEX(~(R y));"
-                  #"  ScmVector *~v = SCM_PC_ENSURE_VEC(~(R x)));"
-                  #"  SCM_PC_BOUND_CHECK(SCM_VECTOR_SIZE(~v), ~n);"
-                  #"  ~(R r) = SCM_VECTOR_ELEMENT(~v, ~n);"))]
+       (cgen-body #"  {"
+                  #"    ScmSmallInt ~n = SCM_PC_GET_INDEX(~(R y));"
+                  #"    ScmVector *~v = SCM_PC_ENSURE_VEC(~(R x));"
+                  #"    SCM_PC_BOUND_CHECK(SCM_VECTOR_SIZE(~v), ~n);"
+                  #"    ~(R r) = SCM_VECTOR_ELEMENT(~v, ~n);"
+                  #"  }"))]
     [('VEC-SET r x y z)
      (let ([n (gensym 'n)]
            [v (gensym 'v)])
-       (cgen-body #"  ScmSmallInt ~n = SCM_PC_GET_INDEX(~(R y));"
-                  #"  ScmVector *~v = SCM_PC_ENSURE_VEC(~(R x)));"
-                  #"  SCM_PC_BOUND_CHECK(SCM_VECTOR_SIZE(~v), ~n);"
-                  #"  SCM_VECTOR_ELEMENT(~v, ~n) = ~(R z);"
-                  #"  ~(R r) = SCM_UNDEFINED;"))]
-    [('UVEC-REF r x y z) (cgen-body #"  /* WRITEME: UVEC-REF */")]
+       (cgen-body #"  {"
+                  #"    ScmSmallInt ~n = SCM_PC_GET_INDEX(~(R y));"
+                  #"    ScmVector *~v = SCM_PC_ENSURE_VEC(~(R x));"
+                  #"    SCM_PC_BOUND_CHECK(SCM_VECTOR_SIZE(~v), ~n);"
+                  #"    SCM_VECTOR_ELEMENT(~v, ~n) = ~(R z);"
+                  #"    ~(R r) = SCM_UNDEFINED;"
+                  #"  }"))]
+    [('UVEC-REF r t x y)
+     ;; T is a constant register of uvector type.  Scm_VMUVectorRef
+     ;; validates the type and the range.
+     (cgen-body #"  ~(R r) = Scm_VMUVectorRef(SCM_UVECTOR(~(R x)),"
+                #"                           ~(const-value t),"
+                #"                           SCM_PC_GET_INDEX(~(R y)),"
+                #"                           SCM_UNBOUND);")]
     [('NUMEQ2 r x y) (builtin-2arg/arith c "SCM_PC_NUMEQ2" "SCM_PC_NUMEQI" r x y)]
     [('NUMLT2 r x y) (builtin-2arg/arith c "SCM_PC_NUMLT2" "SCM_PC_NUMLTI" r x y)]
     [('NUMLE2 r x y) (builtin-2arg/arith c "SCM_PC_NUMLE2" "SCM_PC_NUMLEI" r x y)]
@@ -421,6 +491,13 @@
       [(reg . regs) `("Scm_Cons(" ,(R reg) ", " ,@(rec regs) ")")]))
   (string-concatenate (rec regs)))
 
+(define (gen-append c regs)
+  (match regs
+    [() "SCM_NIL"]
+    [(reg) (R reg)]
+    [(reg1 reg2) #"Scm_Append2(~(R reg1), ~(R reg2))"]
+    [_ #"Scm_Append(~(gen-list c regs))"]))
+
 (define (gen-list* c regs)
   (define (rec regs)
     (match regs
@@ -0,0 +1,362 @@
+;;;
+;;; gauche.cgen.precomp-build - Parallel and incremental precompilation
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;;; Precompiling is a whole-program compilation of each source file,
+;;; and it takes a while.  This module runs precompilation of a set of
+;;; source files in multiple child processes, and skips the files whose
+;;; output is known to be up to date.
+;;;
+;;; Each source file depends on the files it includes, requires and
+;;; uses, transitively.  We scan those dependencies by reading the
+;;; source forms (we don't evaluate anything), and compute a key of
+;;; the source from the contents of all of them, the contents of the
+;;; compiler itself, and the command line to compile it.  The keys of
+;;; compiled files are saved in a state file; the next run only
+;;; compiles the files whose keys differ.  Since the key is computed
+;;; from the contents, touching a file or rewriting it with the same
+;;; content doesn't cause recompilation.
+;;;
+;;; The dependency graph is also used for scheduling.  A file isn't
+;;; compiled until the files it depends on within the same set are
+;;; compiled, so that an interface file (*.sci) generated for the latter
+;;; is ready when the former is compiled.
+
+(define-module gauche.cgen.precomp-build
+  (use scheme.list)
+  (use srfi.13)
+  (use file.util)
+  (use gauche.process)
+  (use rfc.sha)
+  (use util.digest)
+  (use util.match)
+  (export cgen-precompile-parallel))
+(select-module gauche.cgen.precomp-build)
+
+;; TRANSIENT
+;;  Up to 0.9.15, load path list is kept in a global variable instead
+;;  of a parameter.  See gauche.cgen.precomp.
+(cond-expand
+ [gauche-0.9.15 (define load-paths (make-parameter *load-path*))]
+ [else])
+
+;; API
+;;  JOBS is a list of (<source> . <output.c>).
+;;
+;;  COMMAND is a procedure that takes a source file name and returns
+;;  a command line (a list of strings) to precompile it.  The command
+;;  line is included in the key, so changing options of precompilation
+;;  causes recompilation.
+;;
+;;  NPROCS is the maximum number of processes to run at a time.  0 means
+;;  the number of available processors.
+;;
+;;  STATE-FILE is the file to keep the keys of compiled sources.  If it
+;;  is #f, everything is compiled, but still in parallel.
+;;
+;;  COMPILER-FILES are the files that make up the compiler, e.g. the
+;;  precomp script.  Their dependencies are also scanned.
+;;
+;;  LOAD-PATHS are the directories to search the used libraries, in
+;;  addition to the current load paths.
+;;
+;;  If TIMING is true, the time spent for each source file is reported
+;;  after compilation.  If DRY-RUN is true, only reports which sources
+;;  would be compiled.
+;;
+;;  Returns #t if all the sources are compiled successfully, #f otherwise.
+;;  When compilation of a source fails, no more processes are started;
+;;  we wait for the running ones and save the state of the successful ones.
+(define (cgen-precompile-parallel jobs
+                                  :key (command #f)
+                                       (nprocs 1)
+                                       (state-file #f)
+                                       (compiler-files '())
+                                       ((:load-paths extra-load-paths) '())
+                                       (timing #f)
+                                       (dry-run #f)
+                                       (port (current-output-port)))
+  (unless (procedure? command)
+    (error "command procedure is required to run precompilation"))
+  (let* ([nprocs (if (<= nprocs 0) (sys-available-processors) nprocs)]
+         [scan (make-dependency-scanner (append extra-load-paths (load-paths))
+                                        (source-modules (map car jobs)))]
+         [compiler-deps (dependency-closure scan (map canonical-path
+                                                      compiler-files))]
+         [compiler-key (files-key (gauche-version) compiler-deps)]
+         [state (read-state state-file)]
+         [jobs (map (^j (make-job (car j) (cdr j) scan compiler-key
+                                  (command (car j))))
+                    jobs)]
+         [stale (remove (cut job-up-to-date? <> state) jobs)])
+    (for-each (cut job-prerequisites-set! <> stale) stale)
+    (cond
+     [dry-run
+      (dolist [j stale] (format port "precomp: would compile ~a\n" (job-src j)))
+      #t]
+     [else
+      (dolist [j jobs]
+        (unless (memq j stale) (touch-output j compiler-deps)))
+      (let1 ok (run-jobs stale nprocs state port)
+        (when state-file (write-state state-file state))
+        (report port jobs stale timing)
+        ok)])))
+
+;;----------------------------------------------------------------
+;; Jobs
+;;
+
+(define-class <job> ()
+  ((src      :init-keyword :src)            ; source file name as given
+   (path     :init-keyword :path)           ; canonical path of src
+   (out      :init-keyword :out)            ; output C file
+   (command  :init-keyword :command)        ; command line to compile
+   (deps     :init-keyword :deps)           ; dependency closure
+   (key      :init-keyword :key)
+   (prereqs  :init-value '())               ; stale jobs to wait for
+   (process  :init-value #f)
+   (start    :init-value #f)
+   (elapsed  :init-value #f)))
+
+(define (make-job src out scan compiler-key command)
+  (let* ([path (canonical-path src)]
+         [deps (dependency-closure scan (list path))])
+    (make <job> :src src :path path :out out :command command :deps deps
+          :key (files-key (write-to-string (list compiler-key command))
+                          deps))))
+
+(define (job-src j) (~ j'src))
+
+(define (job-up-to-date? j state)
+  (and (equal? (hash-table-get state (~ j'path) #f) (~ j'key))
+       (file-exists? (~ j'out))))
+
+(define (job-prerequisites-set! j stale)
+  (set! (~ j'prereqs)
+        (filter (^k (and (not (eq? j k)) (member (~ k'path) (~ j'deps))))
+                stale)))
+
+;; If the output is up to date but older than some of the sources,
+;; e.g. because a file is touched without changing the content, we
+;; touch the output as well so that make won't regenerate it.
+(define (touch-output j compiler-deps)
+  (let1 t (file-mtime (~ j'out))
+    (when (any (^f (> (file-mtime f) t)) (append (~ j'deps) compiler-deps))
+      (touch-file (~ j'out)))))
+
+(define (current-seconds)
+  (receive (sec usec) (sys-gettimeofday)
+    (+ sec (/. usec 1e6))))
+
+(define (run-jobs jobs nprocs state port)
+  (define finished '())
+  (define failed #f)
+  (define (runnable? j)
+    (every (^k (memq k finished)) (~ j'prereqs)))
+  (define (launch! j)
+    (format port "precomp: compiling ~a\n" (job-src j))
+    (flush port)
+    (set! (~ j'start) (current-seconds))
+    (set! (~ j'process) (run-process (~ j'command))))
+  (define (reap! running)
+    (let1 p (process-wait-any)
+      (if-let1 j (find (^j (eq? (~ j'process) p)) running)
+        (let1 status (process-exit-status p)
+          (set! (~ j'elapsed) (- (current-seconds) (~ j'start)))
+          (cond [(and (sys-wait-exited? status)
+                      (zero? (sys-wait-exit-status status)))
+                 (hash-table-put! state (~ j'path) (~ j'key))
+                 (push! finished j)]
+                [else
+                 (format port "precomp: failed to compile ~a\n" (job-src j))
+                 (flush port)
+                 (hash-table-delete! state (~ j'path))
+                 ;; Don't leave a stale output that looks newer than
+                 ;; the source.
+                 (when (file-exists? (~ j'out)) (sys-unlink (~ j'out)))
+                 (set! failed #t)])
+          (delete j running))
+        running)))
+  (let loop ([pending jobs] [running '()])
+    (cond
+     [(and (null? running) (or failed (null? pending))) (not failed)]
+     [(and (not failed) (< (length running) nprocs)
+           (or (find runnable? pending)
+               ;; Circular dependency.  Just start one of them.
+               (and (null? running) (car pending))))
+      => (^j (launch! j) (loop (delete j pending) (cons j running)))]
+     [else (loop pending (reap! running))])))
+
+(define (report port jobs stale timing)
+  (let1 compiled (filter (^j (~ j'elapsed)) stale)
+    (when (and timing (pair? compiled))
+      (format port "precomp: compile time of each file (seconds):\n")
+      (dolist [j (sort compiled > (^j (~ j'elapsed)))]
+        (format port "  ~8,3f  ~a\n" (~ j'elapsed) (job-src j))))
+    (format port "precomp: ~d file(s) compiled, ~d up to date\n"
+            (length compiled) (- (length jobs) (length stale)))))
+
+;;----------------------------------------------------------------
+;; Dependency scanner
+;;
+
+(define (canonical-path file)
+  (sys-normalize-pathname file :absolute #t :canonicalize #t))
+
+;; Returns a hash table mapping the name of a module defined in SRCS
+;; to the source.  Modules in the set take precedence over the ones
+;; in the load paths.
+(define (source-modules srcs)
+  (rlet1 tab (make-hash-table 'eq?)
+    (dolist [src srcs]
+      (match (read-forms src 1)
+        [(('define-module (? symbol? name) . _))
+         (hash-table-put! tab name (canonical-path src))]
+        [_ #f]))))
+
+;; Read toplevel forms of FILE, up to LIMIT forms.  We may not be able
+;; to read the entire file, e.g. if it contains a reader constructor
+;; which isn't defined yet.  In that case we just use what we've read.
+(define (read-forms file :optional (limit #f))
+  (guard (e [else '()])
+    (call-with-input-file file
+      (^p (let loop ([n 0] [r '()])
+            (let1 form (if (and limit (>= n limit))
+                         (eof-object)
+                         (guard (e [else (eof-object)]) (read p)))
+              (if (eof-object? form)
+                (reverse r)
+                (loop (+ n 1) (cons form r)))))))))
+
+;; Collects dependency specs in FORM, which are (module . <name>),
+;; (file . <path>) or (include . <path>).  We walk into every subform
+;; except quoted data, for use and include can appear in define-module,
+;; cond-expand, or even within a definition.
+(define (collect-deps form acc)
+  (define (add kind xs pred acc)
+    (fold (^[x acc] (if (pred x) (acons kind x acc) acc)) acc xs))
+  (match form
+    [('quote . _) acc]
+    [('use (? symbol? m) . _) (acons 'module m acc)]
+    [('extend . ms) (add 'module ms symbol? acc)]
+    [('require (? string? f)) (acons 'file f acc)]
+    [((or 'include 'include-ci) . fs) (add 'include fs string? acc)]
+    [('import . sets)
+     (add 'module (filter-map import-set->module-name sets) symbol? acc)]
+    [(? list?) (fold collect-deps acc form)]
+    [_ acc]))
+
+(define (import-set->module-name set)
+  (match set
+    [(? symbol?) set]
+    [((or 'only 'except 'prefix 'rename) inner . _)
+     (import-set->module-name inner)]
+    [((? (^x (or (symbol? x) (exact-integer? x)))) ...)
+     (string->symbol (string-join (map x->string set) "."))]
+    [_ #f]))
+
+;; Returns a procedure that takes a canonical path of a source and
+;; returns a list of canonical paths of the files it directly depends
+;; on.  Modules and files not found in DIRS, e.g. the ones built into
+;; the runtime, are ignored.
+(define (make-dependency-scanner dirs modules)
+  (define memo (make-hash-table 'string=?))
+  (define (find-file name dirs suffixes)
+    (define (try stem)
+      (any (^s (let1 f (string-append stem s)
+                 (and (file-is-regular? f) (canonical-path f))))
+           suffixes))
+    (if (absolute-path? name)
+      (try name)
+      (any (^d (try (build-path d name))) dirs)))
+  (define (resolve file spec)
+    (match spec
+      [('module . m) (or (hash-table-get modules m #f)
+                         (find-file (module-name->path m) dirs '(".scm")))]
+      [('file . f) (find-file f dirs '(".scm"))]
+      [('include . f) (find-file f (cons (sys-dirname file) dirs)
+                                 '("" ".scm"))]))
+  (^[file]
+    (or (hash-table-get memo file #f)
+        (rlet1 deps ($ delete-duplicates
+                       $ delete file
+                       $ filter-map (cut resolve file <>)
+                       $ reverse $ fold collect-deps '() (read-forms file))
+          (hash-table-put! memo file deps)))))
+
+;; Returns a sorted list of FILES and all the files they depend on.
+(define (dependency-closure scan files)
+  (let1 seen (make-hash-table 'string=?)
+    (let loop ([files files])
+      (dolist [f files]
+        (unless (hash-table-contains? seen f)
+          (hash-table-put! seen f #t)
+          (loop (scan f)))))
+    (sort (hash-table-keys seen))))
+
+;;----------------------------------------------------------------
+;; Keys and state
+;;
+
+(define (digest-string s) (digest-hexify (sha1-digest-string s)))
+
+;; Memoized with the file's mtime, for the same file is used by many jobs.
+(define file-digest
+  (let1 memo (make-hash-table 'equal?)
+    (^[file]
+      (let1 k (cons file (file-mtime file))
+        (or (hash-table-get memo k #f)
+            (rlet1 d (digest-string (file->string file))
+              (hash-table-put! memo k d)))))))
+
+;; We only use the contents, so that the key doesn't change when the
+;; tree is moved.
+(define (files-key prefix files)
+  (digest-string (write-to-string (cons prefix (map file-digest files)))))
+
+;; The state file contains an alist of canonical source path and its key.
+(define (read-state file)
+  (rlet1 tab (make-hash-table 'string=?)
+    (when (and file (file-exists? file))
+      (guard (e [else #f])
+        (dolist [entry (with-input-from-file file read)]
+          (match entry
+            [((? string? path) . (? string? key))
+             (hash-table-put! tab path key)]
+            [_ #f]))))))
+
+(define (write-state file tab)
+  (with-output-to-file file
+    (^[]
+      (print ";; generated automatically by precomp.  DO NOT EDIT")
+      (write (sort (hash-table->alist tab) string<? car))
+      (newline))))
@@ -53,6 +53,7 @@
 (select-module gauche.cgen.precomp)
 
 (autoload gauche.cgen.optimizer optimize-compiled-code)
+(autoload gauche.cgen.cbe compile-native-toplevel)
 
 ;; TRANSIENT
 ;;  Up to 0.9.15, load path list is kept in a global variable instead
@@ -165,6 +166,13 @@
 ;;      enough from the host environment.  You can't load a different version
 ;;      of the same library the host is using just for the precompiled file.
 ;;      This option is mainly for 'include's in the source.
+;;
+;; native-procedures : Experimental.  A list of names of toplevel procedures,
+;;      or #t to mean all toplevel procedures.  The definitions of those
+;;      procedures are compiled into C functions by the C backend
+;;      (gauche.cgen.cbe), instead of VM code.  If a procedure uses
+;;      a feature the C backend doesn't support yet, it is compiled into
+;;      VM code with a warning.
 
 (define (cgen-precompile src . keys)
   (with-tmodule-recording
@@ -174,6 +182,9 @@
 ;; Precompile multiple Scheme sources that are to be linked into
 ;; single DSO.  Need to check dependency.  The name of the first
 ;; source is used to derive DSO name.
+;; If ONLY is a list of sources, only those sources are compiled, as if
+;; the rest of SRCS had been compiled.  The parallel driver uses it to
+;; compile each source of a DSO in a separate process.
 (define (cgen-precompile-multi srcs
                                :key (ext-initializer #f)
                                     ((:strip-prefix prefix) #f)
@@ -185,9 +196,11 @@
                                     (single-sci-file #f)
                                     (load-paths '())
                                     (target-parameters '())
-                                    (extra-optimization #f))
+                                    (extra-optimization #f)
+                                    (native-procedures #f)
+                                    (only #f))
   (define (precomp-1 main src)
-    (let* ([out.c (cgen-scm-path->c-file (strip-prefix src prefix))]
+    (let* ([out.c (cgen-scm-path->c-file src prefix)]
            [initname (cgen-c-file->initfn out.c)])
 
       (%cgen-precompile src
@@ -199,6 +212,7 @@
                         :strip-prefix prefix
                         :macros-to-keep macros-to-keep
                         :extra-optimization extra-optimization
+                        :native-procedures native-procedures
                         :ext-initializer (and (equal? src main)
                                               ext-initializer)
                         :target-parameters target-parameters
@@ -217,8 +231,15 @@
   (match srcs
     [() #f]
     [(main . subs)
-     (clean-output-files srcs prefix)
-     (let* ([srcs (order-files-by-dependency srcs)]
+     (when only
+       (when single-sci-file
+         (error "single-sci-file can't be used with only"))
+       (dolist [s only]
+         (unless (member s srcs)
+           (error "source file isn't in the list:" s))))
+     (clean-output-files (or only srcs) prefix)
+     (let* ([srcs (let1 srcs (order-files-by-dependency srcs)
+                    (if only (filter (cut member <> only) srcs) srcs))]
             [scis ($ with-tmodule-recording <ptmodule>
                      $ map (cut precomp-1 main <>) srcs)])
        (when single-sci-file
@@ -250,7 +271,8 @@
                                ((:load-paths extra-load-paths) '())
                                (macros-to-keep '())
                                ((:target-parameters tparams) '())
-                               (extra-optimization #f))
+                               (extra-optimization #f)
+                               ((:native-procedures natives) #f))
   (define (do-it)
     (parameterize ([omitted-code '()]
                    [omit-debug-source-info no-source]
@@ -282,7 +304,8 @@
                    [vm-eval-situation SCM_VM_COMPILING]
                    [cise-omit-source-line omit-line-directives]
                    [private-macros-to-keep macros-to-keep]
-                   [run-extra-optimization-passes extra-optimization])
+                   [run-extra-optimization-passes extra-optimization]
+                   [native-procedures natives])
       (select-tmodule 'gauche)
       (cond [out.sci
              (make-directory* (sys-dirname out.sci))
@@ -303,10 +326,12 @@
 ;; e.g. "binary/io.scm" -> "binary--io.c"
 ;;      "binary--io.c" -> "Scm_Init_binary__io"
 ;; We expose these so that other tools will use consistent naming.
-(define (cgen-scm-path->c-file path)
+;; If PREFIX is given, it is stripped from PATH first, in the same way
+;; as the strip-prefix argument of cgen-precompile.
+(define (cgen-scm-path->c-file path :optional (prefix #f))
   ($ regexp-replace-all #/[\/\\]/
      ($ path-swap-extension
-        (sys-normalize-pathname path :canonicalize #t)
+        (sys-normalize-pathname (strip-prefix path prefix) :canonicalize #t)
         "c")
      "--"))
 
@@ -376,6 +401,10 @@
 ;; Experimental: Run extra optimization during AOT compilation.
 (define run-extra-optimization-passes (make-parameter #f))
 
+;; Experimental: Names of toplevel procedures to be compiled into C by
+;; the C backend, or #t for all of them.
+(define native-procedures (make-parameter #f))
+
 ;; Compile target parameters.  See 'compile' entry in compile.scm
 (define target-parameters (make-parameter '(:cont-frame-size 7)))
 
@@ -551,6 +580,7 @@
 (define-global-pred =export-if-defined? export-if-defined)
 (define-global-pred =extend?          extend)
 (define-global-pred =provide?         provide)
+(define-global-pred =define?          define)
 (define-global-pred =lambda?          lambda)
 (define-global-pred =include?         include)
 (define-global-pred =begin?           begin)
@@ -616,6 +646,8 @@
        seed]
       [((? =begin?) . forms) (fold compile-toplevel-form seed forms)]
       [((? =include?) . filenames) (compile-includes filenames #f seed)]
+      ;; Procedure definitions to be compiled into C.
+      [(? compile-native-definition) seed]
       ;; Finally, ordinary expressions.
       [else
        (let* ([compiled-code (compile-in-current-tmodule form)]
@@ -633,6 +665,22 @@
                [else (cons (cgen-literal compiled-code) seed)]))]
       )))
 
+;; If FORM defines a procedure listed in native-procedures, compile it
+;; with the C backend and returns #t.  Returns #f if FORM isn't such
+;; a definition or the C backend can't handle it, in which case the caller
+;; compiles it into VM code.
+(define (compile-native-definition form)
+  (and-let* ([natives (native-procedures)]
+             [name (match form
+                     [((? =define?) ((? symbol? name) . _) . _) name]
+                     [((? =define?) (? symbol? name) ((? =lambda?) . _)) name]
+                     [_ #f])]
+             [ (or (eq? natives #t) (memq name natives)) ])
+    (or (compile-native-toplevel form (~ (current-tmodule)'module))
+        (begin
+          (warn "Can't compile ~s into C; generating VM code instead.\n" name)
+          #f))))
+
 ;; check to see the compiled code only contains CONSTU-RET insn.
 (define (toplevel-constu-ret-code? toplevel-code)
   (and (null? (cdr toplevel-code))
@@ -88,7 +88,13 @@
 (define (copy-port src dst :key (unit 4096) (size -1))
   (check-arg input-port? src)
   (check-arg output-port? dst)
-  (cond [(eq? unit 'byte)
+  (cond [(and (or (eq? unit 'byte) (integer? unit))
+              (port-file-number src)
+              (port-file-number dst))
+         ;; Both are connected to fds.  Let the kernel do the job.
+         (port-sendfile src dst
+                        (if (and (fixnum? size) (>= size 0)) size -1))]
+        [(eq? unit 'byte)
          (if (and (integer? size) (not (negative? size)))
            (%do-copy/limit1 (read-byte src) (write-byte data dst) size)
            (%do-copy (read-byte src) (write-byte data dst) (+ count 1)))]
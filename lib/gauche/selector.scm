@@ -1,5 +1,5 @@
 ;;;
-;;; selector - simple event loop by select()
+;;; selector - simple event loop by select() or epoll()
 ;;;
 ;;;   Copyright (c) 2000-2025  Shiro Kawai  <shiro@acm.org>
 ;;;
@@ -32,27 +32,95 @@
 ;;;
 
 
+;; The selector has two backends.  The 'select' backend works wherever
+;; sys-select works.  The 'epoll' backend is available on Linux; it
+;; doesn't have the FD_SETSIZE limit, and its cost per wakeup depends
+;; on the number of ready fds instead of the number of watched fds.
+;; A new selector uses select, unless epoll is requested by the :backend
+;; init keyword.  Epoll isn't the default, for it refuses some kinds of
+;; fds, such as regular files, which select accepts.
+
 (define-module gauche.selector
   (use scheme.list)
-  (export <selector> selector-add! selector-delete! selector-select)
+  (export <selector> selector-add! selector-delete! selector-select
+          selector-add-timer! selector-delete-timer!)
   )
 (select-module gauche.selector)
 
 (define-class <selector> ()
-  ((rfds :init-form #f)
+  ((backend :init-keyword :backend :init-value #f) ; select or epoll
+   ;; select backend
+   (rfds :init-form #f)
    (wfds :init-form #f)
    (xfds :init-form #f)
-   (rhandlers :init-form '())  ; list of (port-or-fd . proc)
+   (rhandlers :init-form '())  ; list of (port-or-fd proc . oneshot?)
    (whandlers :init-form '())  ; ditto
    (xhandlers :init-form '())  ; ditto
+   ;; epoll backend
+   (epoll :init-form #f)       ; <sys-epoll>
+   (fd-handlers :init-form (make-hash-table 'eqv?)) ; fd -> list of handlers
+   (evbuf :init-form #f)       ; s32vector to receive events
+   ;; timers, sorted by deadline
+   (timers :init-form '())
   ))
 
+(define-method initialize ((selector <selector>) initargs)
+  (next-method)
+  (case (~ selector'backend)
+    [(#f) (set! (~ selector'backend) 'select)]
+    [(select epoll) #t]
+    [else (error "selector backend must be either select or epoll, but got:"
+                 (~ selector'backend))])
+  (when (eq? (~ selector'backend) 'epoll)
+    (epoll-init! selector)))
+
+(define (epoll? selector) (eq? (~ selector'backend) 'epoll))
+
+;; Flags are r, w and x, optionally with modifiers oneshot and edge.
+;; Returns a list of canonicalized r/w/x flags, oneshot? and edge?.
+(define (parse-flags flags)
+  (let loop ([flags flags] [rwx '()] [oneshot #f] [edge #f])
+    (if (null? flags)
+      (values (reverse rwx) oneshot edge)
+      (case (car flags)
+        [(oneshot) (loop (cdr flags) rwx #t edge)]
+        [(edge) (loop (cdr flags) rwx oneshot #t)]
+        [else (loop (cdr flags) (cons (canon-flag (car flags)) rwx)
+                    oneshot edge)]))))
+
 (define (canon-flag flag)
   (case flag
     [(r read) 'r]
     [(w write) 'w]
     [(x exception) 'x]
-    [else (errorf "invalid flag ~s, must be r, w, or x" flag)]))
+    [else (errorf "invalid flag ~s, must be r, w, x, oneshot or edge" flag)]))
+
+(define-method selector-add! ((selector <selector>) port-or-fd proc flags)
+  (assume-type proc <procedure>)
+  (assume-type flags <list>)
+  (receive (rwx oneshot edge) (parse-flags flags)
+    (dolist [flag rwx]
+      (if (epoll? selector)
+        (epoll-add! selector port-or-fd proc flag oneshot edge)
+        (select-add! selector port-or-fd proc flag oneshot)))))
+
+(define-method selector-delete! ((selector <selector>) port-or-fd proc flags)
+  (let1 flags (if flags (map canon-flag flags) '(r w x))
+    (if (epoll? selector)
+      (epoll-delete! selector port-or-fd proc flags)
+      (select-delete! selector port-or-fd proc flags))))
+
+(define-method selector-select ((selector <selector>) :optional (timeout #f))
+  (let* ([usec (wait-usec selector (timeout->usec timeout))]
+         [n (if (epoll? selector)
+              (epoll-select selector usec)
+              (select-select selector usec))])
+    (run-timers! selector)
+    n))
+
+;;;
+;;; select backend
+;;;
 
 (define (flag->fd-slot flag)
   (case flag
@@ -62,65 +130,273 @@
   (case flag
     [(r) 'rhandlers] [(w) 'whandlers] [(x) 'xhandlers]))
 
-(define-method selector-add! ((selector <selector>) port-or-fd proc flags)
-  (assume-type proc <procedure>)
-  (assume-type flags <list>)
-  (dolist [flag (map canon-flag flags)]
-    (let* ([slot (flag->fd-slot flag)]
-           [fds (or (slot-ref selector slot)
-                    (rlet1 f (make <sys-fdset>)
-                      (slot-set! selector slot f)))])
-      (set! (sys-fdset-ref fds port-or-fd) #t))
-    (slot-push! selector (flag->handler-slot flag) (cons port-or-fd proc))))
+(define (select-add! selector port-or-fd proc flag oneshot)
+  (let* ([slot (flag->fd-slot flag)]
+         [hslot (flag->handler-slot flag)]
+         [fds (or (slot-ref selector slot)
+                  (rlet1 f (make <sys-fdset>)
+                    (slot-set! selector slot f)))])
+    (set! (sys-fdset-ref fds port-or-fd) #t)
+    ;; replaces the existing handler, if any
+    (slot-set! selector hslot
+               (cons (list* port-or-fd proc oneshot)
+                     (remove (^e (equal? (car e) port-or-fd))
+                             (slot-ref selector hslot))))))
 
-(define-method selector-delete! ((selector <selector>) port-or-fd proc flags)
-  (let1 flags (if flags (map canon-flag flags) '(r w x))
-    (for-each (^[fds handlers]
-                (cond
-                 [port-or-fd
-                  (if-let1 p (assoc port-or-fd (slot-ref selector handlers))
-                    (when (or (not proc) (eq? proc (cdr p)))
-                      (slot-set! selector handlers
-                                 (delete p (slot-ref selector handlers)))
-                      (if-let1 fds (slot-ref selector fds)
-                        (sys-fdset-set! fds port-or-fd #f))))]
-                 [proc
-                  (let loop ([h (slot-ref selector handlers)]
-                             [newh '()])
-                    (cond [(null? h)
-                           (slot-set! selector handlers (reverse newh))]
-                          [(eq? proc (cdar h))
-                           (if-let1 fds (slot-ref selector fds)
-                             (sys-fdset-set! fds (caar h) #f))
-                           (loop (cdr h) newh)]
-                          [else
-                           (loop (cdr h) (cons (car h) newh))]))]
-                 [else
-                  (slot-set! selector fds #f)
-                  (slot-set! selector handlers '())]))
-              (map flag->fd-slot flags)
-              (map flag->handler-slot flags))))
+(define (select-delete! selector port-or-fd proc flags)
+  (for-each (^[fds handlers]
+              (cond
+               [port-or-fd
+                (if-let1 p (assoc port-or-fd (slot-ref selector handlers))
+                  (when (or (not proc) (eq? proc (cadr p)))
+                    (slot-set! selector handlers
+                               (delete p (slot-ref selector handlers)))
+                    (if-let1 fds (slot-ref selector fds)
+                      (sys-fdset-set! fds port-or-fd #f))))]
+               [proc
+                (let loop ([h (slot-ref selector handlers)]
+                           [newh '()])
+                  (cond [(null? h)
+                         (slot-set! selector handlers (reverse newh))]
+                        [(eq? proc (cadar h))
+                         (if-let1 fds (slot-ref selector fds)
+                           (sys-fdset-set! fds (caar h) #f))
+                         (loop (cdr h) newh)]
+                        [else
+                         (loop (cdr h) (cons (car h) newh))]))]
+               [else
+                (slot-set! selector fds #f)
+                (slot-set! selector handlers '())]))
+            (map flag->fd-slot flags)
+            (map flag->handler-slot flags)))
 
-(define-method selector-select ((selector <selector>) :optional (timeout #f))
+(define (select-select selector usec)
 
   (define (pick-handlers fds handlers flag)
     (fold (^[entry tail]
             (let1 fd (car entry)
               (if (sys-fdset-ref fds fd)
-                (cons (list (cdr entry) fd flag) tail)
+                (cons (list* flag entry) tail)
                 tail)))
           '()
           handlers))
 
+  (define (call-handler h)
+    (let ([flag (car h)] [port-or-fd (cadr h)] [proc (caddr h)])
+      (when (cdddr h)                   ;oneshot
+        (select-delete! selector port-or-fd proc (list flag)))
+      (proc port-or-fd flag)))
+
   (receive (nfds rfds wfds xfds)
       (sys-select (slot-ref selector 'rfds)
                   (slot-ref selector 'wfds)
                   (slot-ref selector 'xfds)
-                  timeout)
+                  usec)
     (when (> nfds 0)
-      (for-each (^h (apply (car h) (cdr h)))
+      (for-each call-handler
                 (append
                  (pick-handlers rfds (slot-ref selector 'rhandlers) 'r)
                  (pick-handlers wfds (slot-ref selector 'whandlers) 'w)
                  (pick-handlers xfds (slot-ref selector 'xhandlers) 'x))))
     nfds))
+
+;;;
+;;; epoll backend
+;;;
+
+(define-class <selector-handler> ()
+  ((flag :init-keyword :flag)              ; r, w or x
+   (port-or-fd :init-keyword :port-or-fd)
+   (proc :init-keyword :proc)
+   (oneshot :init-keyword :oneshot)
+   (edge :init-keyword :edge)))
+
+(define (port-or-fd->fd port-or-fd)
+  (if (integer? port-or-fd)
+    port-or-fd
+    (port-file-number port-or-fd)))     ;may be #f if port is closed
+
+(cond-expand
+ [gauche.sys.epoll
+  (define *epoll-buffer-size* 256)      ;# of events per wakeup
+
+  (define (epoll-init! selector)
+    (set! (~ selector'epoll) (sys-epoll-create))
+    (set! (~ selector'evbuf) (make-s32vector (* 2 *epoll-buffer-size*))))
+
+  ;; Event bits that trigger handlers of each flag.  As select(2) does,
+  ;; we treat hangup and error conditions as readable/writable.
+  (define (flag->events flag)
+    (case flag
+      [(r) (logior EPOLLIN EPOLLHUP EPOLLERR)]
+      [(w) (logior EPOLLOUT EPOLLHUP EPOLLERR)]
+      [(x) EPOLLPRI]))
+
+  (define (interest-events handlers)
+    (fold (^[h events]
+            (logior events
+                    (case (~ h'flag)
+                      [(r) EPOLLIN] [(w) EPOLLOUT] [(x) EPOLLPRI])
+                    (if (~ h'edge) EPOLLET 0)))
+          0 handlers))
+
+  (define (errno-error? e errno)
+    (and (<system-error> e) (eqv? (condition-ref e 'errno) errno)))
+
+  ;; Replace the handlers of FD from OLD to NEW, and tell the kernel.
+  ;; The kernel drops a closed fd from the epoll set but our table keeps
+  ;; it, so if the fd number is reused, MOD fails with ENOENT.  We ADD
+  ;; it again in that case.
+  (define (epoll-update! selector fd old new)
+    (let ([ep (~ selector'epoll)]
+          [tab (~ selector'fd-handlers)])
+      (cond [(null? new)
+             (hash-table-delete! tab fd)
+             (unless (null? old)
+               (sys-epoll-ctl ep EPOLL_CTL_DEL fd 0))]
+            [(null? old)
+             (sys-epoll-ctl ep EPOLL_CTL_ADD fd (interest-events new))
+             (hash-table-put! tab fd new)]
+            [else
+             (guard (e [(errno-error? e ENOENT)
+                        (sys-epoll-ctl ep EPOLL_CTL_ADD fd
+                                       (interest-events new))])
+               (sys-epoll-ctl ep EPOLL_CTL_MOD fd (interest-events new)))
+             (hash-table-put! tab fd new)])))
+
+  (define (epoll-add! selector port-or-fd proc flag oneshot edge)
+    (let* ([fd (or (port-or-fd->fd port-or-fd)
+                   (error "port doesn't have a file descriptor:" port-or-fd))]
+           [old (hash-table-get (~ selector'fd-handlers) fd '())])
+      (epoll-update! selector fd old
+                     (cons (make <selector-handler> :flag flag :port-or-fd port-or-fd
+                                 :proc proc :oneshot oneshot :edge edge)
+                           (remove (^h (and (eq? (~ h'flag) flag)
+                                            (equal? (~ h'port-or-fd)
+                                                    port-or-fd)))
+                                   old)))))
+
+  (define (epoll-delete! selector port-or-fd proc flags)
+    (define tab (~ selector'fd-handlers))
+    (define (match? h)
+      (and (memq (~ h'flag) flags)
+           (or (not port-or-fd) (equal? (~ h'port-or-fd) port-or-fd))
+           (or (not proc) (eq? (~ h'proc) proc))))
+    (define (delete-from! fd)
+      (let* ([old (hash-table-get tab fd '())]
+             [new (remove match? old)])
+        (unless (= (length old) (length new))
+          (epoll-update! selector fd old new))))
+    (if-let1 fd (and port-or-fd (port-or-fd->fd port-or-fd))
+      (delete-from! fd)
+      (for-each delete-from! (hash-table-keys tab))))
+
+  ;; Like the select backend, we call all read handlers first, then
+  ;; write handlers, then exception handlers.  A handler may delete
+  ;; other handlers, so we check if each one is still registered.
+  (define (epoll-select selector usec)
+    (let* ([buf (~ selector'evbuf)]
+           [tab (~ selector'fd-handlers)]
+           [n (sys-epoll-wait! (~ selector'epoll) buf (usec->msec usec))]
+           [count 0])
+      (dolist [flag '(r w x)]
+        (let1 mask (flag->events flag)
+          (dotimes [i n]
+            (let ([fd (s32vector-ref buf (* i 2))]
+                  [events (s32vector-ref buf (+ (* i 2) 1))])
+              (when (logtest events mask)
+                (dolist [h (hash-table-get tab fd '())]
+                  (when (and (eq? (~ h'flag) flag)
+                             (memq h (hash-table-get tab fd '())))
+                    (when (~ h'oneshot)
+                      (let1 old (hash-table-get tab fd '())
+                        (epoll-update! selector fd old (delete h old eq?))))
+                    (inc! count)
+                    (call-handler tab fd h flag))))))))
+      count))
+
+  ;; If a handler finds its fd closed, the kernel has already dropped
+  ;; the fd, so we forget its handlers too.
+  (define (call-handler tab fd h flag)
+    (guard (e [(errno-error? e EBADF)
+               (hash-table-delete! tab fd)
+               (raise e)])
+      ((~ h'proc) (~ h'port-or-fd) flag)))
+
+  (define (usec->msec usec)
+    (if usec
+      (min (ceiling->exact (/ usec 1000)) (- (expt 2 31) 1))
+      -1))
+  ]
+ [else
+  (define (epoll-init! selector)
+    (error "epoll selector isn't supported on this platform"))
+  (define epoll-add! epoll-init!)
+  (define epoll-delete! epoll-init!)
+  (define epoll-select epoll-init!)
+  ])
+
+;;;
+;;; Timers
+;;;
+
+(define-class <selector-timer> ()
+  ((deadline :init-keyword :deadline)   ; monotonic time in usec
+   (interval :init-keyword :interval)   ; usec, or #f if not repeating
+   (proc :init-keyword :proc)))
+
+(define-method selector-add-timer! ((selector <selector>) timeout proc
+                                    :optional (repeat? #f))
+  (assume-type proc <procedure>)
+  (let1 usec (timeout->usec timeout)
+    (unless usec (error "timeout required, but got:" timeout))
+    (rlet1 timer (make <selector-timer>
+                   :deadline (+ (now-usec) usec)
+                   :interval (and repeat? (max usec 1))
+                   :proc proc)
+      (schedule-timer! selector timer))))
+
+(define-method selector-delete-timer! ((selector <selector>) timer)
+  (set! (~ selector'timers) (delete timer (~ selector'timers) eq?)))
+
+(define (schedule-timer! selector timer)
+  (set! (~ selector'timers)
+        (merge (~ selector'timers) (list timer)
+               (^[a b] (< (~ a'deadline) (~ b'deadline))))))
+
+(define (now-usec)
+  (receive (sec nsec) (sys-clock-gettime-monotonic)
+    (if sec
+      (+ (* sec 1000000) (quotient nsec 1000))
+      (receive (sec usec) (sys-gettimeofday)
+        (+ (* sec 1000000) usec)))))
+
+;; Returns how long we wait for I/O, considering the pending timers.
+(define (wait-usec selector usec)
+  (if (null? (~ selector'timers))
+    usec
+    (let1 w (max (- (~ (car (~ selector'timers))'deadline) (now-usec)) 0)
+      (if usec (min usec w) w))))
+
+;; A repeating timer is rescheduled before its handler is called, so
+;; that the handler can delete it.  If we're behind the schedule,
+;; we skip the missed ticks.
+(define (run-timers! selector)
+  (let1 now (now-usec)
+    (let loop ()
+      (let1 timers (~ selector'timers)
+        (when (and (pair? timers)
+                   (<= (~ (car timers)'deadline) now))
+          (let1 t (car timers)
+            (set! (~ selector'timers) (cdr timers))
+            (when (~ t'interval)
+              (let1 next (+ (~ t'deadline) (~ t'interval))
+                (set! (~ t'deadline)
+                      (if (<= next now) (+ now (~ t'interval)) next)))
+              (schedule-timer! selector t))
+            ((~ t'proc))
+            (loop)))))))
+
+;; Timeout is given in the same way as sys-select.  Returns #f for no
+;; timeout.
+(define timeout->usec (with-module gauche.internal %timeout->usec))
@@ -0,0 +1,68 @@
+;;;
+;;; bserializer.scm - binary serializer
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; A compact binary serializer.  Encoding and decoding are done in C
+;; (see the data mode in src/serial.c), and the result is streamed to
+;; the port in chunks.  Shared and circular structures are preserved.
+;; Besides the basic data (numbers, characters, strings, symbols, pairs,
+;; vectors and uvectors), it can handle hash tables (except the ones with
+;; general comparators) and instances of Scheme-defined classes, including
+;; records.  Procedures and other opaque objects can't be serialized.
+;;
+;; Each call of write-to-serializer writes one self-contained datum, and
+;; read-from-serializer never reads beyond it, so the port can be shared
+;; with other data.  Flonums and uvectors are written in the native byte
+;; order, so the data isn't portable across machines of different
+;; byte order.
+;;
+;; Keeping the sharing needs a table of all the objects written, which
+;; is the major cost of writing large data.  If the data is known to be
+;; a tree, give :shared #f to skip it; shared substructures are then
+;; written as many times as they appear, like write-simple, and circular
+;; data never terminates.  Symbols and keywords are shared regardless.
+;; The reader doesn't need the option.
+
+(define-module gauche.serializer.bserializer
+  (use gauche.serializer)
+  (export <bserializer>))
+(select-module gauche.serializer.bserializer)
+
+(define-class <bserializer> (<serializer>)
+  ((shared :init-keyword :shared :init-value #t)))
+
+(define-method write-to-serializer ((self <bserializer>) object)
+  ((with-module gauche.internal %fasl-write-data) object (port-of self)
+   (~ self'shared)))
+
+(define-method read-from-serializer ((self <bserializer>))
+  ((with-module gauche.internal %fasl-read-data) (port-of self)))
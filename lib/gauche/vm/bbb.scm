@@ -699,6 +699,13 @@
          (pass5b/de-asm iform 'slot-ref bb benv ctx)]
         [(SLOT-SET)
          (pass5b/de-asm iform 'slot-set! bb benv ctx)]
+        [(APPLY TAIL-APPLY)
+         (pass5b/de-asm iform 'apply bb benv ctx)]
+        ;; Some insns have different names in VM
+        [(LIST-STAR) (emit bb 'LIST* regs)]
+        [(LIST2VEC) (emit bb 'LIST->VEC regs)]
+        ;; uvector type is given as the first arg
+        [(UVEC-REF) (emit bb 'UVEC-REF (cons (make-const bb (cadr opc)) regs))]
         ;; Convert immediate insns to non-immediate ones
         ;; Be careful about the position of the immediate arg
         [(NUMADDI) (emit bb 'NUMADD2 (cons (make-const bb (cadr opc)) regs))]
@@ -706,6 +713,11 @@
         [(NUMMODI) (emit bb 'NUMMOD2 (list (car regs) (make-const bb (cadr opc))))]
         [(NUMREMI) (emit bb 'NUMREM2 (list (car regs) (make-const bb (cadr opc))))]
         [(ASHI) (emit bb 'ASH (list (car regs) (make-const bb (cadr opc))))]
+        ;; Flonum-only insns are generic ones with proven operand types
+        [(FLADD2) (emit bb 'NUMADD2 regs)]
+        [(FLSUB2) (emit bb 'NUMSUB2 regs)]
+        [(FLMUL2) (emit bb 'NUMMUL2 regs)]
+        [(FLDIV2) (emit bb 'NUMDIV2 regs)]
         [else (emit bb mnemonic regs)]))))
 
 ;; If an ASM insn calls back to VM, we need to turn it back to a
@@ -726,9 +738,9 @@
 (define (pass5b/$MEMV iform bb benv ctx)
   (pass5b/builtin-twoargs 'MEMV iform bb benv ctx))
 (define (pass5b/$EQ? iform bb benv ctx)
-  (pass5b/builtin-twoargs 'EQ? iform bb benv ctx))
+  (pass5b/builtin-twoargs 'EQ iform bb benv ctx))
 (define (pass5b/$EQV? iform bb benv ctx)
-  (pass5b/builtin-twoargs 'EQV? iform bb benv ctx))
+  (pass5b/builtin-twoargs 'EQV iform bb benv ctx))
 
 (define (pass5b/builtin-twoargs op iform bb benv ctx)
   (receive (bb regs)
@@ -744,11 +756,11 @@
     (use-reg! bb reg0)
     (let1 receiver (make-reg bb #f)
       (use-reg! bb receiver #t)
-      (push-insn bb `(LIST->VECTOR ,receiver ,reg0))
+      (push-insn bb `(LIST->VEC ,receiver ,reg0))
       (pass5b/return bb ctx receiver))))
 
 (define (pass5b/$VECTOR iform bb benv ctx)
-  (pass5b/builtin-nargs 'VECTOR iform bb benv ctx))
+  (pass5b/builtin-nargs 'VEC iform bb benv ctx))
 (define (pass5b/$LIST iform bb benv ctx)
   (pass5b/builtin-nargs 'LIST iform bb benv ctx))
 (define (pass5b/$LIST* iform bb benv ctx)
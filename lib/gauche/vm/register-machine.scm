@@ -102,7 +102,7 @@
                  (VEC-LEN . ,vector-length)
                  (VEC-REF . ,vector-ref)
                  (VEC-SET . ,vector-set!)
-                 (UVEC-REF . ,uvector-ref)
+                 (UVEC-REF . ,(^[t v k] (uvector-ref v k)))
                  (NUMEQ2 . ,=)
                  (NUMLT2 . ,<)
                  (NUMLE2 . ,<=)
@@ -0,0 +1,295 @@
+;;;
+;;; text.rope - rope strings
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; A rope is an immutable string represented as a balanced binary tree
+;; of strings.  Concatenation and substring take O(log n) time without
+;; copying the characters, so a large text can be built up piece by
+;; piece.  The tree is kept height-balanced as an AVL tree.
+;;
+;; Leaves are ordinary (immutable) strings; substring of a leaf shares
+;; the string body.  When a contiguous string is needed (rope->string,
+;; regexp matching), the rope is flattened once and the result is
+;; cached in the node.
+
+(define-module text.rope
+  (use gauche.record)
+  (use gauche.sequence)
+  (use gauche.uvector)
+  (use gauche.vport)
+  (use text.tree)
+  (export <rope> rope? rope-empty? string->rope rope->string
+          rope-length rope-size rope-depth rope-ref
+          rope-append rope-concatenate rope-substring
+          rope-pieces rope-for-each-piece
+          open-input-rope rope-rxmatch)
+  )
+(select-module text.rope)
+
+(define-record-type (<rope> #f :mixins (<sequence>))
+  %make-rope rope?
+  (left   %left)                ; string for a leaf, rope for a node
+  (right  %right)               ; #f for a leaf
+  (length rope-length)          ; # of characters
+  (size   rope-size)            ; # of octets
+  (height rope-depth)           ; 0 for a leaf
+  (flat   %flat %flat-set!))    ; flattened string or #f
+
+;; Leaves smaller than this (in octets) are merged when concatenated,
+;; so that appending small pieces one by one doesn't make a tree of
+;; tiny leaves.
+(define-constant *merge-size* 256)
+
+(define-inline (%leaf? r) (not (%right r)))
+
+(define (%leaf s)
+  (let1 s (if (string-immutable? s) s (string-copy-immutable s))
+    (%make-rope s #f (string-length s) (string-size s) 0 s)))
+
+(define (%node l r)
+  (%make-rope l r
+              (+ (rope-length l) (rope-length r))
+              (+ (rope-size l) (rope-size r))
+              (+ 1 (max (rope-depth l) (rope-depth r)))
+              #f))
+
+(define %empty (%leaf ""))
+
+(define (rope-empty? r)
+  (assume-type r <rope>)
+  (zero? (rope-size r)))
+
+(define (string->rope s)
+  (assume-type s <string>)
+  (if (equal? s "") %empty (%leaf s)))
+
+(define (->rope x)
+  (cond [(rope? x) x]
+        [(string? x) (string->rope x)]
+        [else (error "string or rope required, but got:" x)]))
+
+;;;
+;;; Concatenation
+;;;
+
+;; Makes a node of L and R, whose heights differ at most by 2.
+(define (%balance l r)
+  (let ([hl (rope-depth l)] [hr (rope-depth r)])
+    (cond [(> hl (+ hr 1))
+           (let ([ll (%left l)] [lr (%right l)])
+             (if (>= (rope-depth ll) (rope-depth lr))
+               (%node ll (%node lr r))
+               (%node (%node ll (%left lr))
+                      (%node (%right lr) r))))]
+          [(> hr (+ hl 1))
+           (let ([rl (%left r)] [rr (%right r)])
+             (if (>= (rope-depth rr) (rope-depth rl))
+               (%node (%node l rl) rr)
+               (%node (%node l (%left rl))
+                      (%node (%right rl) rr))))]
+          [else (%node l r)])))
+
+(define (%small-leaf? r)
+  (and (%leaf? r) (<= (rope-size r) *merge-size*)))
+
+(define (%merge-leaves a b)
+  (if (<= (+ (rope-size a) (rope-size b)) *merge-size*)
+    (%leaf (string-append (%left a) (%left b)))
+    (%node a b)))
+
+;; Joins L and R, whose heights differ at most by 1.
+(define (%join-near l r)
+  (cond [(and (%leaf? l) (%leaf? r)) (%merge-leaves l r)]
+        [(and (%small-leaf? r) (not (%leaf? l)) (%small-leaf? (%right l)))
+         (%balance (%left l) (%merge-leaves (%right l) r))]
+        [(and (%small-leaf? l) (not (%leaf? r)) (%small-leaf? (%left r)))
+         (%balance (%merge-leaves l (%left r)) (%right r))]
+        [else (%node l r)]))
+
+;; AVL join.  Descends the spine of the taller one until the heights
+;; get close, so it takes O(|height difference|) time.
+(define (%join l r)
+  (cond [(zero? (rope-size l)) r]
+        [(zero? (rope-size r)) l]
+        [else
+         (let ([hl (rope-depth l)] [hr (rope-depth r)])
+           (cond [(> hl (+ hr 1)) (%balance (%left l) (%join (%right l) r))]
+                 [(> hr (+ hl 1)) (%balance (%join l (%left r)) (%right r))]
+                 [else (%join-near l r)]))]))
+
+;; Each argument can be a string or a rope.
+(define (rope-append . xs) (rope-concatenate xs))
+
+(define (rope-concatenate xs)
+  (let1 v (list->vector (map ->rope xs))
+    ;; Joining halves keeps the work linear to the number of pieces.
+    (let rec ([lo 0] [hi (vector-length v)])
+      (case (- hi lo)
+        [(0) %empty]
+        [(1) (vector-ref v lo)]
+        [else (let1 mid (quotient (+ lo hi) 2)
+                (%join (rec lo mid) (rec mid hi)))]))))
+
+;;;
+;;; Access
+;;;
+
+(define (rope-ref r k :optional fallback)
+  (assume-type r <rope>)
+  (if (and (exact-integer? k) (<= 0 k) (< k (rope-length r)))
+    (let loop ([r r] [k k])
+      (if (%leaf? r)
+        (string-ref (%left r) k)
+        (let1 n (rope-length (%left r))
+          (if (< k n)
+            (loop (%left r) k)
+            (loop (%right r) (- k n))))))
+    (if (undefined? fallback)
+      (error "index out of range:" k)
+      fallback)))
+
+(define (rope-substring r start :optional (end (rope-length r)))
+  (assume-type r <rope>)
+  (unless (and (exact-integer? start) (exact-integer? end)
+               (<= 0 start end (rope-length r)))
+    (errorf "start/end out of range: ~s ~s" start end))
+  (let rec ([r r] [s start] [e end])
+    (cond [(= s e) %empty]
+          [(and (= s 0) (= e (rope-length r))) r]
+          [(%leaf? r) (%leaf (substring (%left r) s e))]
+          [else
+           (let1 n (rope-length (%left r))
+             (cond [(<= e n) (rec (%left r) s e)]
+                   [(>= s n) (rec (%right r) (- s n) (- e n))]
+                   [else (%join (rec (%left r) s n)
+                                (rec (%right r) 0 (- e n)))]))])))
+
+;; Calls PROC on each leaf string from left to right.
+(define (rope-for-each-piece proc r)
+  (assume-type r <rope>)
+  (let rec ([r r])
+    (if (%leaf? r)
+      (unless (zero? (rope-size r)) (proc (%left r)))
+      (begin (rec (%left r)) (rec (%right r))))))
+
+(define (rope-pieces r)
+  (assume-type r <rope>)
+  (let rec ([r r] [acc '()])
+    (cond [(zero? (rope-size r)) acc]
+          [(%leaf? r) (cons (%left r) acc)]
+          [else (rec (%left r) (rec (%right r) acc))])))
+
+(define (rope->string r)
+  (assume-type r <rope>)
+  (or (%flat r)
+      (rlet1 s (string-copy-immutable
+                (call-with-output-string
+                  (^[out]
+                    (let rec ([r r])
+                      (cond [(%flat r) => (cut write-string <> out)]
+                            [else (rec (%left r)) (rec (%right r))])))))
+        (%flat-set! r s))))
+
+;;;
+;;; Ports and regexp
+;;;
+
+;; Reads the pieces without flattening the rope.
+(define (open-input-rope r)
+  (assume-type r <rope>)
+  (define pieces (rope-pieces r))
+  (define piece #f)                     ; current piece
+  (define pos 0)                        ; char index in the piece
+  (define (filler buf)
+    (cond [(and piece (< pos (string-length piece)))
+           ;; Copy as many characters as surely fit in BUF.
+           (let* ([len (string-length piece)]
+                  [k (min (- len pos)
+                          (if (= len (string-size piece))
+                            (u8vector-length buf)
+                            (max 1 (quotient (u8vector-length buf) 6))))]
+                  [chunk (substring piece pos (+ pos k))])
+             (string->u8vector! buf 0 chunk)
+             (set! pos (+ pos k))
+             (min (string-size chunk) (u8vector-length buf)))]
+          [(null? pieces) (eof-object)]
+          [else (set! piece (pop! pieces))
+                (set! pos 0)
+                (filler buf)]))
+  (make <buffered-input-port> :fill filler))
+
+;; Regexp needs a contiguous string; the rope is flattened (and cached).
+(define (rope-rxmatch rx r)
+  (rxmatch rx (rope->string r)))
+
+(define-method object-apply ((rx <regexp>) (r <rope>))
+  (rope-rxmatch rx r))
+
+;;;
+;;; Other protocols
+;;;
+
+(define-method write-object ((r <rope>) out)
+  (format out "#<rope ~d chars>" (rope-length r)))
+
+(define-method object-equal? ((a <rope>) (b <rope>))
+  (and (= (rope-size a) (rope-size b))
+       (string=? (rope->string a) (rope->string b))))
+
+(define-method x->string ((r <rope>)) (rope->string r))
+
+(define-method write-tree ((r <rope>) out)
+  (rope-for-each-piece (cut write-string <> out) r))
+
+(define-method call-with-iterator ((r <rope>) proc
+                                   :key (start #f) :allow-other-keys)
+  (define pieces (rope-pieces (if start (rope-substring r start) r)))
+  (define piece #f)
+  (define cur #f)
+  ;; Make CUR point to the next character, or PIECE be #f at the end.
+  (define (advance!)
+    (cond [(and piece (string-cursor<? cur (string-cursor-end piece)))]
+          [(null? pieces) (set! piece #f)]
+          [else (set! piece (pop! pieces))
+                (set! cur (string-cursor-start piece))
+                (advance!)]))
+  (advance!)
+  (proc (^[] (not piece))
+        (^[] (rlet1 c (string-ref piece cur)
+               (set! cur (string-cursor-next piece cur))
+               (advance!)))))
+
+(define-method size-of ((r <rope>)) (rope-length r))
+
+(define-method referencer ((r <rope>)) rope-ref)
+
+(define-method subseq ((r <rope>) . args) (apply rope-substring r args))
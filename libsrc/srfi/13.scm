@@ -94,6 +94,8 @@
 (define (%char-pred/pred c/s/p x) (c/s/p x))
 
 (define %hash-string (with-module gauche.internal %hash-string))
+(define %string-scan-char-cursor
+  (with-module gauche.internal %string-scan-char-cursor))
 (define %string-replace-body! (with-module gauche.internal %string-replace-body!))
 ;;;
 ;;; Predicates
@@ -465,13 +467,17 @@
                        (start 0)
                        (end (string-cursor-end s)))
   (assume-type s <string>)
-  (let ([pred (%get-char-pred c/s/p)]
-        [end (string-index->cursor s end)])
-    (let loop ([cur (string-index->cursor s start)])
-      (if (or (string-cursor=? cur end)
-              (pred c/s/p (string-ref s cur)))
-        (values cur end)
-        (loop (string-cursor-next s cur))))))
+  (if (char? c/s/p)
+    (let ([start (string-index->cursor s start)]
+          [end (string-index->cursor s end)])
+      (values (or (%string-scan-char-cursor s c/s/p start end) end) end))
+    (let ([pred (%get-char-pred c/s/p)]
+          [end (string-index->cursor s end)])
+      (let loop ([cur (string-index->cursor s start)])
+        (if (or (string-cursor=? cur end)
+                (pred c/s/p (string-ref s cur)))
+          (values cur end)
+          (loop (string-cursor-next s cur)))))))
 
 (define (%string-index-right s c/s/p
                              :optional
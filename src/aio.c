@@ -0,0 +1,984 @@
+/*
+ * aio.c - asynchronous I/O
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/priv/aioP.h"
+
+/* See aioP.h for the overview. */
+
+#if defined(SCM_AIO_AVAILABLE)
+#include <sys/epoll.h>
+#include <fcntl.h>
+#endif
+
+#if defined(SCM_AIO_URING)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
+
+static void aio_context_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
+static void aio_request_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_AioContextClass, aio_context_print);
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_AioRequestClass, aio_request_print);
+
+static ScmObj sym_io_uring = SCM_UNBOUND;
+static ScmObj sym_epoll = SCM_UNBOUND;
+static ScmObj sym_read = SCM_UNBOUND;
+static ScmObj sym_write = SCM_UNBOUND;
+static ScmObj sym_accept = SCM_UNBOUND;
+static ScmObj sym_connect = SCM_UNBOUND;
+
+static void aio_context_print(ScmObj obj, ScmPort *port,
+                              ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmAioContext *c = SCM_AIO_CONTEXT(obj);
+    if (c->closed) {
+        Scm_Printf(port, "#<aio-context %S (closed)>",
+                   Scm_AioContextBackend(c));
+    } else {
+        Scm_Printf(port, "#<aio-context %S %ld pending>",
+                   Scm_AioContextBackend(c), c->numRequests);
+    }
+}
+
+static void aio_request_print(ScmObj obj, ScmPort *port,
+                              ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmAioRequest *r = SCM_AIO_REQUEST(obj);
+    Scm_Printf(port, "#<aio-request %S %d %s>",
+               Scm_AioRequestOp(r), r->fd,
+               (r->state != SCM_AIO_DONE
+                ? "pending"
+                : (r->error ? "failed" : "done")));
+}
+
+ScmObj Scm_AioRequestOp(ScmAioRequest *req)
+{
+    switch (req->op) {
+    case SCM_AIO_READ:    return sym_read;
+    case SCM_AIO_WRITE:   return sym_write;
+    case SCM_AIO_ACCEPT:  return sym_accept;
+    case SCM_AIO_CONNECT: return sym_connect;
+    default: return SCM_FALSE;  /* can't happen */
+    }
+}
+
+ScmObj Scm_AioContextBackend(ScmAioContext *ctx)
+{
+    return (ctx->backend == SCM_AIO_BACKEND_URING)? sym_io_uring : sym_epoll;
+}
+
+/*==================================================================
+ * Common routines
+ */
+
+/* A context belongs to the thread that uses it first. */
+static void check_owner(ScmAioContext *ctx)
+{
+    ScmAtomicWord vm = (ScmAtomicWord)Scm_VM();
+    ScmAtomicWord owner = 0;
+    if (!Scm_AtomicCompareExchange(&ctx->owner, &owner, vm) && owner != vm) {
+        Scm_Error("aio context is used by another thread: %S", ctx);
+    }
+}
+
+static void check_open(ScmAioContext *ctx)
+{
+    check_owner(ctx);
+    if (ctx->closed) Scm_Error("aio context already closed: %S", ctx);
+}
+
+/* The target may be a socket, a port with fd, or an fd. */
+static int target_fd(ScmObj target)
+{
+    if (SCM_SOCKETP(target)) {
+        if (SOCKET_CLOSED(SCM_SOCKET(target)->fd)) {
+            Scm_Error("socket already closed: %S", target);
+        }
+        return (int)SCM_SOCKET(target)->fd;
+    }
+    return Scm_GetPortFd(target, TRUE);
+}
+
+static ScmAioRequest *make_request(ScmAioContext *ctx, int op,
+                                   ScmObj target, ScmObj data)
+{
+    check_open(ctx);
+    ScmAioRequest *req = SCM_NEW(ScmAioRequest);
+    SCM_SET_CLASS(req, SCM_CLASS_AIO_REQUEST);
+    req->op = op;
+    req->state = SCM_AIO_QUEUED;
+    req->fd = target_fd(target);
+    req->target = target;
+    req->buffer = SCM_FALSE;
+    req->bufptr = NULL;
+    req->bufsize = 0;
+    req->offset = -1;
+    req->data = data;
+    req->result = SCM_FALSE;
+    req->error = 0;
+    req->addrlen = 0;
+    req->prev = req->next = req->fdnext = NULL;
+    return req;
+}
+
+/* Requests are linked to the context while the kernel may touch them. */
+static void link_request(ScmAioContext *ctx, ScmAioRequest *req)
+{
+    req->prev = NULL;
+    req->next = ctx->requests;
+    if (ctx->requests) ctx->requests->prev = req;
+    ctx->requests = req;
+    ctx->numRequests++;
+}
+
+static void unlink_request(ScmAioContext *ctx, ScmAioRequest *req)
+{
+    if (req->prev) req->prev->next = req->next;
+    else ctx->requests = req->next;
+    if (req->next) req->next->prev = req->prev;
+    req->prev = req->next = NULL;
+    ctx->numRequests--;
+}
+
+/* RES is the syscall result, or -errno. */
+static void complete_request(ScmAioContext *ctx, ScmAioRequest *req, long res)
+{
+    unlink_request(ctx, req);
+    req->state = SCM_AIO_DONE;
+    ctx->completed = Scm_Cons(SCM_OBJ(req), ctx->completed);
+    if (res < 0) {
+        req->error = (int)-res;
+        return;
+    }
+    switch (req->op) {
+    case SCM_AIO_READ:
+    case SCM_AIO_WRITE:
+        req->result = Scm_MakeInteger(res);
+        break;
+    case SCM_AIO_ACCEPT:
+        if (SCM_SOCKETP(req->target)) {
+            req->result =
+                Scm_MakeAcceptedSocket(SCM_SOCKET(req->target), (Socket)res,
+                                       (struct sockaddr*)&req->addrbuf,
+                                       req->addrlen);
+        } else {
+            req->result = Scm_MakeInteger(res);
+        }
+        break;
+    case SCM_AIO_CONNECT:
+        if (SCM_SOCKETP(req->target)) {
+            ScmSocket *s = SCM_SOCKET(req->target);
+            s->address = SCM_SOCKADDR(req->buffer);
+            s->status = SCM_SOCKET_STATUS_CONNECTED;
+        }
+        req->result = req->target;
+        break;
+    }
+}
+
+static void set_region(ScmAioRequest *req, ScmUVector *buf,
+                       ScmSize start, ScmSize end, int writable)
+{
+    ScmSize eltsize = Scm_UVectorElementSize(Scm_ClassOf(SCM_OBJ(buf)));
+    ScmSize size = SCM_UVECTOR_SIZE(buf) * eltsize;
+    if (writable) SCM_UVECTOR_CHECK_MUTABLE(buf);
+    if (end < 0 || end > size) end = size;
+    if (start < 0 || start > end) {
+        Scm_Error("start index out of range: %ld", start);
+    }
+    req->buffer = SCM_OBJ(buf);
+    req->bufptr = (char*)SCM_UVECTOR_ELEMENTS(buf) + start;
+    req->bufsize = end - start;
+}
+
+#if defined(SCM_AIO_URING)
+/*==================================================================
+ * io_uring backend
+ *
+ *   We use the raw syscalls instead of liburing.  The rings are
+ *   shared with the kernel; we're the only producer of the submission
+ *   queue and the only consumer of the completion queue.
+ *
+ *   The user_data of a request's SQE is the pointer to the
+ *   ScmAioRequest.  Timeouts use odd user_data, the generation number
+ *   shifted left by one with the LSB set; completions of stale
+ *   timeouts are ignored.  Cancellations use URING_CANCEL_UD, whose
+ *   completions are ignored as well.
+ */
+
+#define URING_CANCEL_UD  ((uint64_t)-1)
+
+typedef struct uring_rec {
+    int fd;
+    unsigned entries;
+    /* submission queue */
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqArray;
+    unsigned sqMask;
+    struct io_uring_sqe *sqes;
+    /* completion queue */
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+    /* mappings */
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;               /* may be the same as sqRing */
+    size_t cqRingSize;
+    size_t sqesSize;
+    /* timeout */
+    u_long timeoutGen;
+    struct __kernel_timespec ts; /* must outlive the submission */
+    int timedOut;
+} uring;
+
+#define RING_AT(ring, off)  ((void*)((char*)(ring) + (off)))
+
+/* Checks the kernel supports all the opcodes we use.  IORING_OP_READ
+   etc. are added in 5.6, with which IORING_REGISTER_PROBE is also
+   available. */
+static int uring_probe(int fd)
+{
+    static const int ops[] = {
+        IORING_OP_READ, IORING_OP_WRITE, IORING_OP_ACCEPT,
+        IORING_OP_CONNECT, IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL
+    };
+    size_t size = sizeof(struct io_uring_probe)
+        + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (probe == NULL) return FALSE;
+    int ok = (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+                      probe, 256) >= 0);
+    for (size_t i = 0; ok && i < sizeof(ops)/sizeof(ops[0]); i++) {
+        if (ops[i] > probe->last_op
+            || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+            ok = FALSE;
+        }
+    }
+    free(probe);
+    return ok;
+}
+
+static void uring_teardown(uring *u)
+{
+    if (u->sqes != MAP_FAILED) munmap(u->sqes, u->sqesSize);
+    if (u->cqRing != MAP_FAILED && u->cqRing != u->sqRing) {
+        munmap(u->cqRing, u->cqRingSize);
+    }
+    if (u->sqRing != MAP_FAILED) munmap(u->sqRing, u->sqRingSize);
+    if (u->fd >= 0) close(u->fd);
+    u->fd = -1;
+}
+
+/* Returns NULL if io_uring isn't usable. */
+static uring *uring_setup(unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return NULL;
+    if (!uring_probe(fd)) {
+        close(fd);
+        return NULL;
+    }
+
+    uring *u = SCM_NEW_ATOMIC(uring);
+    memset(u, 0, sizeof(uring));
+    u->fd = fd;
+    u->entries = p.sq_entries;
+    u->sqRing = u->cqRing = u->sqes = MAP_FAILED;
+    u->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP);
+    if (single) {
+        if (u->cqRingSize > u->sqRingSize) u->sqRingSize = u->cqRingSize;
+        u->cqRingSize = u->sqRingSize;
+    }
+    u->sqRing = mmap(NULL, u->sqRingSize, PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (u->sqRing == MAP_FAILED) goto fail;
+    if (single) {
+        u->cqRing = u->sqRing;
+    } else {
+        u->cqRing = mmap(NULL, u->cqRingSize, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (u->cqRing == MAP_FAILED) goto fail;
+    }
+    u->sqes = mmap(NULL, u->sqesSize, PROT_READ|PROT_WRITE,
+                   MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) goto fail;
+
+    u->sqHead  = RING_AT(u->sqRing, p.sq_off.head);
+    u->sqTail  = RING_AT(u->sqRing, p.sq_off.tail);
+    u->sqArray = RING_AT(u->sqRing, p.sq_off.array);
+    u->sqMask  = *(unsigned*)RING_AT(u->sqRing, p.sq_off.ring_mask);
+    u->cqHead  = RING_AT(u->cqRing, p.cq_off.head);
+    u->cqTail  = RING_AT(u->cqRing, p.cq_off.tail);
+    u->cqMask  = *(unsigned*)RING_AT(u->cqRing, p.cq_off.ring_mask);
+    u->cqes    = RING_AT(u->cqRing, p.cq_off.cqes);
+    return u;
+
+  fail:
+    uring_teardown(u);
+    return NULL;
+}
+
+/* Passes the queued SQEs to the kernel.  If WAIT is true, also waits
+   for at least one completion. */
+static void uring_enter(ScmAioContext *ctx, uring *u, int wait)
+{
+    unsigned n = (unsigned)ctx->numQueued;
+    int r;
+    if (n == 0 && !wait) return;
+    SCM_SYSCALL(r, (int)syscall(__NR_io_uring_enter, u->fd, n,
+                                wait? 1 : 0,
+                                wait? IORING_ENTER_GETEVENTS : 0,
+                                NULL, 0));
+    if (r < 0) {
+        /* EBUSY/EAGAIN means the completion queue is full.  Let the
+           caller reap it and come back. */
+        if (errno == EBUSY || errno == EAGAIN) return;
+        Scm_SysError("io_uring_enter failed");
+    }
+    ctx->numQueued -= r;
+}
+
+static struct io_uring_sqe *uring_get_sqe(ScmAioContext *ctx, uring *u)
+{
+    unsigned tail = *u->sqTail;
+    if (tail - __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE) >= u->entries) {
+        /* The submission queue is full.  Push them to the kernel to
+           make room. */
+        uring_enter(ctx, u, FALSE);
+        if (tail - __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE)
+            >= u->entries) {
+            Scm_Error("aio submission queue is full: %S", ctx);
+        }
+    }
+    unsigned idx = tail & u->sqMask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sqArray[idx] = idx;
+    return sqe;
+}
+
+static void uring_commit_sqe(ScmAioContext *ctx, uring *u)
+{
+    __atomic_store_n(u->sqTail, *u->sqTail + 1, __ATOMIC_RELEASE);
+    ctx->numQueued++;
+}
+
+static void uring_queue(ScmAioContext *ctx, uring *u, ScmAioRequest *req)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ctx, u);
+    sqe->fd = req->fd;
+    sqe->user_data = (uint64_t)(uintptr_t)req;
+    switch (req->op) {
+    case SCM_AIO_READ:
+    case SCM_AIO_WRITE:
+        sqe->opcode = (req->op == SCM_AIO_READ)
+            ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->addr = (uint64_t)(uintptr_t)req->bufptr;
+        sqe->len = (uint32_t)req->bufsize;
+        sqe->off = (uint64_t)req->offset; /* -1 for the current position */
+        break;
+    case SCM_AIO_ACCEPT:
+        req->addrlen = sizeof(req->addrbuf);
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->addr = (uint64_t)(uintptr_t)&req->addrbuf;
+        sqe->addr2 = (uint64_t)(uintptr_t)&req->addrlen;
+        break;
+    case SCM_AIO_CONNECT: {
+        ScmSockAddr *addr = SCM_SOCKADDR(req->buffer);
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->addr = (uint64_t)(uintptr_t)&addr->addr;
+        sqe->off = addr->addrlen;
+        break;
+    }
+    }
+    uring_commit_sqe(ctx, u);
+    req->state = SCM_AIO_INFLIGHT;
+}
+
+/* Moves the completions to ctx->completed.  Returns the number of
+   completed requests. */
+static int uring_reap(ScmAioContext *ctx, uring *u)
+{
+    int count = 0;
+    unsigned head = *u->cqHead;
+    while (head != __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &u->cqes[head & u->cqMask];
+        uint64_t ud = cqe->user_data;
+        long res = cqe->res;
+        /* Consume the entry first, for complete_request may throw. */
+        __atomic_store_n(u->cqHead, ++head, __ATOMIC_RELEASE);
+        if (ud == URING_CANCEL_UD) {
+            continue;
+        } else if (ud & 1) {
+            if ((ud >> 1) == u->timeoutGen) u->timedOut = TRUE;
+        } else {
+            complete_request(ctx, (ScmAioRequest*)(uintptr_t)ud, res);
+            count++;
+        }
+    }
+    return count;
+}
+
+static void uring_wait(ScmAioContext *ctx, uring *u, long timeout_usec)
+{
+    if (uring_reap(ctx, u) > 0 || !SCM_NULLP(ctx->completed)) {
+        timeout_usec = 0;
+    }
+    if (timeout_usec == 0 || (timeout_usec < 0 && ctx->numRequests == 0)) {
+        uring_enter(ctx, u, FALSE);
+        uring_reap(ctx, u);
+        return;
+    }
+    if (timeout_usec > 0) {
+        /* The timeout also completes when any other request completes
+           (off == 1), so that it won't linger in the kernel. */
+        struct io_uring_sqe *sqe = uring_get_sqe(ctx, u);
+        u->timeoutGen++;
+        u->timedOut = FALSE;
+        u->ts.tv_sec = timeout_usec / 1000000;
+        u->ts.tv_nsec = (timeout_usec % 1000000) * 1000;
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)(uintptr_t)&u->ts;
+        sqe->len = 1;
+        sqe->off = 1;
+        sqe->user_data = ((uint64_t)u->timeoutGen << 1) | 1;
+        uring_commit_sqe(ctx, u);
+    }
+    for (;;) {
+        uring_enter(ctx, u, TRUE);
+        if (uring_reap(ctx, u) > 0 || u->timedOut) break;
+    }
+}
+
+/* Called before closing the ring.  The kernel may still be touching
+   the buffers of the in-flight requests, so we cancel all of them and
+   wait until every one of them has completed. */
+static void uring_cancel_all(ScmAioContext *ctx, uring *u)
+{
+    /* Reaping unlinks requests, so we take a snapshot. */
+    ScmObj reqs = SCM_NIL;
+    for (ScmAioRequest *r = ctx->requests; r; r = r->next) {
+        reqs = Scm_Cons(SCM_OBJ(r), reqs);
+    }
+    ScmObj cp;
+    SCM_FOR_EACH(cp, reqs) {
+        ScmAioRequest *r = SCM_AIO_REQUEST(SCM_CAR(cp));
+        while (r->state != SCM_AIO_DONE
+               && *u->sqTail - __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE)
+                  >= u->entries) {
+            /* The submission queue is full.  Push them and make room
+               in the completion queue as well. */
+            uring_enter(ctx, u, ctx->numQueued == 0);
+            uring_reap(ctx, u);
+        }
+        if (r->state == SCM_AIO_DONE) continue;
+        struct io_uring_sqe *sqe = uring_get_sqe(ctx, u);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)(uintptr_t)r;
+        sqe->user_data = URING_CANCEL_UD;
+        uring_commit_sqe(ctx, u);
+    }
+    uring_enter(ctx, u, FALSE);
+    uring_reap(ctx, u);
+    while (ctx->numRequests > 0) {
+        uring_enter(ctx, u, TRUE);
+        uring_reap(ctx, u);
+    }
+}
+
+#endif /*SCM_AIO_URING*/
+
+#if defined(SCM_AIO_AVAILABLE)
+/*==================================================================
+ * epoll backend
+ *
+ *   Each fd with pending requests is registered with EPOLLONESHOT,
+ *   waiting for the union of the conditions its requests need.  Once
+ *   it fires, we carry out at most one request per direction (the
+ *   fd may be blocking, so another read after the first one could
+ *   block) and rearm the fd if there are remaining requests.
+ */
+
+typedef struct epollq_rec {
+    int fd;
+    ScmHashCore waiters;        /* fd -> chain of ScmAioRequest */
+} epollq;
+
+#define EPOLL_EVENTS_MAX  64
+
+static uint32_t op_events(int op)
+{
+    return (op == SCM_AIO_READ || op == SCM_AIO_ACCEPT)? EPOLLIN : EPOLLOUT;
+}
+
+static epollq *epollq_setup(void)
+{
+    int fd = epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0) Scm_SysError("epoll_create1 failed");
+    epollq *e = SCM_NEW(epollq);
+    e->fd = fd;
+    Scm_HashCoreInitSimple(&e->waiters, SCM_HASH_WORD, 0, NULL);
+    return e;
+}
+
+static void epollq_teardown(epollq *e)
+{
+    if (e->fd >= 0) close(e->fd);
+    e->fd = -1;
+}
+
+/* Registers FD to wait for the conditions of requests in CHAIN.
+   Returns -1 and sets errno on failure. */
+static int epollq_arm(epollq *e, int fd, ScmAioRequest *chain)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLONESHOT;
+    for (ScmAioRequest *r = chain; r; r = r->fdnext) {
+        ev.events |= op_events(r->op);
+    }
+    ev.data.fd = fd;
+    int r = epoll_ctl(e->fd, EPOLL_CTL_MOD, fd, &ev);
+    if (r < 0 && errno == ENOENT) r = epoll_ctl(e->fd, EPOLL_CTL_ADD, fd, &ev);
+    return r;
+}
+
+/* Carries out REQ.  Returns FALSE if it would block, unless IMMEDIATE
+   is true.  Sockets are accessed with MSG_DONTWAIT; other fds are only
+   read/written once per readiness, so they won't block either, except
+   writing more than the pipe can take. */
+static int epollq_perform(ScmAioContext *ctx, ScmAioRequest *req,
+                          int immediate)
+{
+    int fd = req->fd;
+    long r = 0;
+    switch (req->op) {
+    case SCM_AIO_READ:
+        if (req->offset >= 0) {
+            r = pread(fd, req->bufptr, req->bufsize, (off_t)req->offset);
+        } else {
+            r = recv(fd, req->bufptr, req->bufsize, MSG_DONTWAIT);
+            if (r < 0 && errno == ENOTSOCK) {
+                r = read(fd, req->bufptr, req->bufsize);
+            }
+        }
+        break;
+    case SCM_AIO_WRITE:
+        if (req->offset >= 0) {
+            r = pwrite(fd, req->bufptr, req->bufsize, (off_t)req->offset);
+        } else {
+            r = send(fd, req->bufptr, req->bufsize, MSG_DONTWAIT);
+            if (r < 0 && errno == ENOTSOCK) {
+                r = write(fd, req->bufptr, req->bufsize);
+            }
+        }
+        break;
+    case SCM_AIO_ACCEPT:
+        req->addrlen = sizeof(req->addrbuf);
+        r = accept(fd, (struct sockaddr*)&req->addrbuf, &req->addrlen);
+        break;
+    case SCM_AIO_CONNECT: {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        r = getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (r == 0 && err != 0) {
+            errno = err;
+            r = -1;
+        }
+        break;
+    }
+    }
+    if (r < 0) {
+        if (!immediate
+            && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return FALSE;
+        }
+        r = -errno;
+    }
+    complete_request(ctx, req, r);
+    return TRUE;
+}
+
+/* Starts connecting without blocking.  Returns TRUE if it's already
+   finished, either succeeded or failed. */
+static int epollq_start_connect(ScmAioContext *ctx, ScmAioRequest *req)
+{
+    ScmSockAddr *addr = SCM_SOCKADDR(req->buffer);
+    int flags = fcntl(req->fd, F_GETFL);
+    if (flags < 0) {
+        complete_request(ctx, req, -errno);
+        return TRUE;
+    }
+    if (!(flags & O_NONBLOCK)) fcntl(req->fd, F_SETFL, flags|O_NONBLOCK);
+    int r = connect(req->fd, &addr->addr, addr->addrlen);
+    int err = errno;
+    if (!(flags & O_NONBLOCK)) fcntl(req->fd, F_SETFL, flags);
+    if (r == 0) {
+        complete_request(ctx, req, 0);
+        return TRUE;
+    }
+    if (err == EINPROGRESS || err == EINTR) return FALSE;
+    complete_request(ctx, req, -err);
+    return TRUE;
+}
+
+static void epollq_queue(ScmAioContext *ctx, epollq *e, ScmAioRequest *req)
+{
+    if (req->op == SCM_AIO_CONNECT && epollq_start_connect(ctx, req)) return;
+
+    ScmDictEntry *de = Scm_HashCoreSearch(&e->waiters, (intptr_t)req->fd,
+                                          SCM_DICT_CREATE);
+    ScmAioRequest *chain = (ScmAioRequest*)de->value;
+    if (chain == NULL) {
+        chain = req;
+    } else {
+        ScmAioRequest *tail = chain;
+        while (tail->fdnext) tail = tail->fdnext;
+        tail->fdnext = req;
+    }
+    if (epollq_arm(e, req->fd, chain) < 0) {
+        int err = errno;
+        /* Take REQ off the chain */
+        if (chain == req) {
+            Scm_HashCoreSearch(&e->waiters, (intptr_t)req->fd,
+                               SCM_DICT_DELETE);
+        } else {
+            ScmAioRequest *p = chain;
+            while (p->fdnext != req) p = p->fdnext;
+            p->fdnext = NULL;
+            (void)SCM_DICT_SET_VALUE(de, SCM_OBJ(chain));
+        }
+        if (err == EPERM) {
+            /* Regular files can't be polled, for they're always ready. */
+            epollq_perform(ctx, req, TRUE);
+        } else {
+            complete_request(ctx, req, -err);
+        }
+        return;
+    }
+    (void)SCM_DICT_SET_VALUE(de, SCM_OBJ(chain));
+    req->state = SCM_AIO_INFLIGHT;
+}
+
+static void epollq_ready(ScmAioContext *ctx, epollq *e, int fd,
+                         uint32_t events)
+{
+    ScmDictEntry *de = Scm_HashCoreSearch(&e->waiters, (intptr_t)fd,
+                                          SCM_DICT_GET);
+    if (de == NULL) return;
+    if (events & (EPOLLERR|EPOLLHUP)) events |= EPOLLIN|EPOLLOUT;
+
+    ScmAioRequest *chain = (ScmAioRequest*)de->value;
+    ScmAioRequest *remaining = NULL, **tailp = &remaining;
+    uint32_t done = 0;          /* directions we've already served */
+    Scm_HashCoreSearch(&e->waiters, (intptr_t)fd, SCM_DICT_DELETE);
+
+    for (ScmAioRequest *r = chain, *next; r; r = next) {
+        uint32_t ev = op_events(r->op);
+        next = r->fdnext;
+        r->fdnext = NULL;
+        if ((events & ev) && !(done & ev)) {
+            done |= ev;
+            if (epollq_perform(ctx, r, FALSE)) continue;
+        }
+        *tailp = r;
+        tailp = &r->fdnext;
+    }
+    if (remaining) {
+        if (epollq_arm(e, fd, remaining) < 0) {
+            int err = errno;
+            for (ScmAioRequest *r = remaining, *next; r; r = next) {
+                next = r->fdnext;
+                r->fdnext = NULL;
+                complete_request(ctx, r, -err);
+            }
+        } else {
+            de = Scm_HashCoreSearch(&e->waiters, (intptr_t)fd,
+                                    SCM_DICT_CREATE);
+            (void)SCM_DICT_SET_VALUE(de, SCM_OBJ(remaining));
+        }
+    }
+}
+
+static void epollq_wait(ScmAioContext *ctx, epollq *e, long timeout_usec)
+{
+    struct epoll_event evs[EPOLL_EVENTS_MAX];
+    int ms, n;
+
+    if (!SCM_NULLP(ctx->completed)) timeout_usec = 0;
+    if (timeout_usec < 0 && ctx->numRequests == 0) return;
+    if (timeout_usec < 0) {
+        ms = -1;
+    } else if (timeout_usec / 1000 >= INT_MAX) {
+        ms = INT_MAX;
+    } else {
+        ms = (int)((timeout_usec + 999) / 1000);
+    }
+    SCM_SYSCALL(n, epoll_wait(e->fd, evs, EPOLL_EVENTS_MAX, ms));
+    if (n < 0) Scm_SysError("epoll_wait failed");
+    for (int i = 0; i < n; i++) {
+        epollq_ready(ctx, e, evs[i].data.fd, evs[i].events);
+    }
+}
+
+#endif /*SCM_AIO_AVAILABLE*/
+
+/*==================================================================
+ * API
+ */
+
+/* The requests in flight of the contexts collected without being closed.
+   The kernel may still write into their buffers after the ring is
+   closed, so we never let them go. */
+static struct {
+    ScmObj requests;
+    ScmInternalMutex mutex;
+} abandoned;
+
+static void release_backend(ScmAioContext *ctx)
+{
+#if defined(SCM_AIO_URING)
+    if (ctx->uring) uring_teardown((uring*)ctx->uring);
+#endif
+#if defined(SCM_AIO_AVAILABLE)
+    if (ctx->epoll) epollq_teardown((epollq*)ctx->epoll);
+#endif
+}
+
+/* The finalizer may run in any thread, so it only releases the kernel
+   resources; it doesn't wait for the requests.  Closing the ring makes
+   the kernel cancel them. */
+static void aio_finalize(ScmObj obj, void *data SCM_UNUSED)
+{
+    ScmAioContext *ctx = SCM_AIO_CONTEXT(obj);
+    if (ctx->closed) return;
+    ctx->closed = TRUE;
+    if (ctx->uring && ctx->requests) {
+        SCM_INTERNAL_MUTEX_LOCK(abandoned.mutex);
+        abandoned.requests = Scm_Cons(SCM_OBJ(ctx->requests),
+                                      abandoned.requests);
+        SCM_INTERNAL_MUTEX_UNLOCK(abandoned.mutex);
+    }
+    release_backend(ctx);
+}
+
+/* BACKEND may be #f (io_uring if available, epoll otherwise),
+   io-uring or epoll. */
+ScmObj Scm_MakeAioContext(int entries, ScmObj backend)
+{
+#if defined(SCM_AIO_AVAILABLE)
+    if (!SCM_FALSEP(backend)
+        && !SCM_EQ(backend, sym_io_uring) && !SCM_EQ(backend, sym_epoll)) {
+        Scm_Error("aio backend must be #f, io-uring or epoll, but got: %S",
+                  backend);
+    }
+    if (entries < 1) entries = 1;
+    if (entries > 32768) entries = 32768;
+
+    ScmAioContext *ctx = SCM_NEW(ScmAioContext);
+    SCM_SET_CLASS(ctx, SCM_CLASS_AIO_CONTEXT);
+    ctx->closed = FALSE;
+    Scm_AtomicStore(&ctx->owner, 0);
+    ctx->requests = NULL;
+    ctx->numRequests = 0;
+    ctx->numQueued = 0;
+    ctx->completed = SCM_NIL;
+    ctx->uring = NULL;
+    ctx->epoll = NULL;
+
+#if defined(SCM_AIO_URING)
+    if (!SCM_EQ(backend, sym_epoll)) ctx->uring = uring_setup(entries);
+#endif
+    if (ctx->uring) {
+        ctx->backend = SCM_AIO_BACKEND_URING;
+    } else if (SCM_EQ(backend, sym_io_uring)) {
+        Scm_Error("io_uring isn't available on this system");
+    } else {
+        ctx->backend = SCM_AIO_BACKEND_EPOLL;
+        ctx->epoll = epollq_setup();
+    }
+    Scm_RegisterFinalizer(SCM_OBJ(ctx), aio_finalize, NULL);
+    return SCM_OBJ(ctx);
+#else  /*!SCM_AIO_AVAILABLE*/
+    (void)entries;
+    (void)backend;
+    Scm_Error("asynchronous I/O isn't supported on this platform");
+    return SCM_UNDEFINED;       /* dummy */
+#endif /*!SCM_AIO_AVAILABLE*/
+}
+
+/* Requests that haven't completed are canceled.  With io_uring, we
+   wait for the kernel to finish with them before unmapping the rings,
+   since it may be writing into their buffers.  The results of the
+   requests completed meanwhile are discarded. */
+void Scm_AioContextClose(ScmAioContext *ctx)
+{
+    check_owner(ctx);
+    if (ctx->closed) return;
+    ctx->closed = TRUE;
+#if defined(SCM_AIO_URING)
+    if (ctx->uring) uring_cancel_all(ctx, (uring*)ctx->uring);
+#endif
+    release_backend(ctx);
+    /* With epoll, the kernel doesn't know the buffers; we can just
+       drop the requests. */
+    while (ctx->requests) {
+        ScmAioRequest *r = ctx->requests;
+        unlink_request(ctx, r);
+        r->state = SCM_AIO_DONE;
+        r->error = ECANCELED;
+    }
+    ctx->numQueued = 0;
+    ctx->completed = SCM_NIL;
+}
+
+static ScmObj queue_request(ScmAioContext *ctx, ScmAioRequest *req)
+{
+    link_request(ctx, req);
+#if defined(SCM_AIO_URING)
+    if (ctx->backend == SCM_AIO_BACKEND_URING) {
+        uring_queue(ctx, (uring*)ctx->uring, req);
+        return SCM_OBJ(req);
+    }
+#endif
+#if defined(SCM_AIO_AVAILABLE)
+    epollq_queue(ctx, (epollq*)ctx->epoll, req);
+#endif
+    return SCM_OBJ(req);
+}
+
+ScmObj Scm_AioRead(ScmAioContext *ctx, ScmObj target, ScmUVector *buf,
+                   ScmSize start, ScmSize end, int64_t offset, ScmObj data)
+{
+    ScmAioRequest *req = make_request(ctx, SCM_AIO_READ, target, data);
+    set_region(req, buf, start, end, TRUE);
+    req->offset = (offset < 0)? -1 : offset;
+    return queue_request(ctx, req);
+}
+
+ScmObj Scm_AioWrite(ScmAioContext *ctx, ScmObj target, ScmUVector *buf,
+                    ScmSize start, ScmSize end, int64_t offset, ScmObj data)
+{
+    ScmAioRequest *req = make_request(ctx, SCM_AIO_WRITE, target, data);
+    set_region(req, buf, start, end, FALSE);
+    req->offset = (offset < 0)? -1 : offset;
+    return queue_request(ctx, req);
+}
+
+ScmObj Scm_AioAccept(ScmAioContext *ctx, ScmObj target, ScmObj data)
+{
+    return queue_request(ctx, make_request(ctx, SCM_AIO_ACCEPT, target, data));
+}
+
+ScmObj Scm_AioConnect(ScmAioContext *ctx, ScmObj target, ScmObj addr,
+                      ScmObj data)
+{
+    if (!Scm_SockAddrP(addr)) {
+        Scm_Error("socket address required, but got: %S", addr);
+    }
+    ScmAioRequest *req = make_request(ctx, SCM_AIO_CONNECT, target, data);
+    req->buffer = addr;
+    return queue_request(ctx, req);
+}
+
+/* Passes the queued requests to the kernel without waiting.  Returns
+   the number of requests passed.  This is only meaningful with
+   io_uring; with epoll, the requests are registered when queued. */
+int Scm_AioSubmit(ScmAioContext *ctx)
+{
+    check_open(ctx);
+    int n = (int)ctx->numQueued;
+#if defined(SCM_AIO_URING)
+    if (ctx->backend == SCM_AIO_BACKEND_URING) {
+        uring_enter(ctx, (uring*)ctx->uring, FALSE);
+    }
+#endif
+    return n - (int)ctx->numQueued;
+}
+
+/* Waits until at least one request completes, or TIMEOUT_USEC passes.
+   Negative timeout means waiting indefinitely, but we return
+   immediately if there's nothing to wait.  Returns a list of
+   completed requests. */
+ScmObj Scm_AioWait(ScmAioContext *ctx, long timeout_usec)
+{
+    check_open(ctx);
+#if defined(SCM_AIO_URING)
+    if (ctx->backend == SCM_AIO_BACKEND_URING) {
+        uring_wait(ctx, (uring*)ctx->uring, timeout_usec);
+    }
+#endif
+#if defined(SCM_AIO_AVAILABLE)
+    if (ctx->backend == SCM_AIO_BACKEND_EPOLL) {
+        epollq_wait(ctx, (epollq*)ctx->epoll, timeout_usec);
+    }
+#endif
+    ScmObj r = Scm_ReverseX(ctx->completed);
+    ctx->completed = SCM_NIL;
+    return r;
+}
+
+/*==================================================================
+ * Initialization
+ */
+
+void Scm__InitAio(void)
+{
+    ScmModule *mod = SCM_FIND_MODULE("gauche.aio", SCM_FIND_MODULE_CREATE);
+    Scm_InitStaticClass(&Scm_AioContextClass, "<aio-context>", mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_AioRequestClass, "<aio-request>", mod, NULL, 0);
+    sym_io_uring = SCM_INTERN("io-uring");
+    sym_epoll    = SCM_INTERN("epoll");
+    sym_read     = SCM_INTERN("read");
+    sym_write    = SCM_INTERN("write");
+    sym_accept   = SCM_INTERN("accept");
+    sym_connect  = SCM_INTERN("connect");
+    abandoned.requests = SCM_NIL;
+    SCM_INTERNAL_MUTEX_INIT(abandoned.mutex);
+}
@@ -0,0 +1,135 @@
+/*
+ * Benchmark of bignum multiplication algorithms.
+ *
+ *  Runs bignum multiplication of various sizes with each algorithm
+ *  (schoolbook, Karatsuba, Toom-3 and NTT) forced, and shows the
+ *  time per multiplication.  The crossover points tell the values for
+ *  KARATSUBA_THRESHOLD etc. in bignum.c.  Also checks that all the
+ *  algorithms agree.
+ *
+ *  Not build by default.  Run 'make bench-bignum' in src directory.
+ *
+ *  Usage: bench-bignum [max-words]
+ */
+
+#include "gauche.h"
+#include "gauche/priv/bignumP.h"
+
+#define NALGOS 4
+#define HUGE_THRESHOLD  (1<<30) /* effectively disables the algorithm */
+
+static const char *algo_names[NALGOS] = {
+    "school", "kara", "toom3", "ntt"
+};
+
+static const int sizes[] = {
+    10, 20, 40, 60, 80, 120, 160, 200, 300, 500,
+    1000, 2000, 3000, 5000, 10000, 20000, 50000, 100000, -1
+};
+
+static int errcount = 0;
+
+/* Select algorithm ALGO for all sizes */
+static void select_algo(int algo)
+{
+    int kara = HUGE_THRESHOLD, toom3 = HUGE_THRESHOLD, ntt = HUGE_THRESHOLD;
+    switch (algo) {
+    case 3: ntt = 1;           /* FALLTHROUGH */
+    case 2: toom3 = 1;         /* FALLTHROUGH */
+    case 1: kara = 2; break;
+    }
+    Scm__BignumMulThresholds(&kara, &toom3, &ntt);
+}
+
+/* Restore the default thresholds */
+static void default_algo(const int saved[3])
+{
+    int kara = saved[0], toom3 = saved[1], ntt = saved[2];
+    Scm__BignumMulThresholds(&kara, &toom3, &ntt);
+}
+
+static u_long xorshift(void)
+{
+    static uint64_t s = 88172645463325252ULL;
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return (u_long)s;
+}
+
+static ScmBignum *random_bignum(int words)
+{
+    ScmBignum *b = Scm_MakeBignumWithSize(words, 0);
+    for (int i=0; i<words; i++) b->values[i] = xorshift();
+    if (b->values[words-1] == 0) b->values[words-1] = 1;
+    return b;
+}
+
+static double now_usec(void)
+{
+    u_long sec, nsec;
+    Scm_ClockGetTimeMonotonic(&sec, &nsec);
+    return sec * 1.0e6 + nsec / 1.0e3;
+}
+
+/* Returns usec per multiplication, and the result in *result. */
+static double bench(ScmBignum *x, ScmBignum *y, ScmObj *result)
+{
+    int count = 0;
+    double start = now_usec(), elapsed;
+    do {
+        *result = Scm_BignumMul(x, y);
+        count++;
+        elapsed = now_usec() - start;
+    } while (elapsed < 200000.0);
+    return elapsed / count;
+}
+
+int main(int argc, char **argv)
+{
+    int maxwords = 20000;
+    int saved[3] = {-1, -1, -1};
+
+    Scm_Init(GAUCHE_SIGNATURE);
+    if (argc > 1) maxwords = atoi(argv[1]);
+
+    /* Get the default thresholds */
+    Scm__BignumMulThresholds(&saved[0], &saved[1], &saved[2]);
+    printf("Default thresholds: karatsuba=%d toom3=%d ntt=%d (words)\n",
+           saved[0], saved[1], saved[2]);
+
+    printf("%8s", "words");
+    for (int a=0; a<NALGOS; a++) printf(" %12s", algo_names[a]);
+    printf(" %12s\n", "default");
+
+    for (int i=0; sizes[i] > 0 && sizes[i] <= maxwords; i++) {
+        ScmBignum *x = random_bignum(sizes[i]);
+        ScmBignum *y = random_bignum(sizes[i]);
+        ScmObj r, r0 = SCM_FALSE;
+
+        printf("%8d", sizes[i]);
+        for (int a=0; a<NALGOS; a++) {
+            if (a == 0 && sizes[i] > 5000) {
+                /* schoolbook takes too long */
+                printf(" %12s", "-");
+                continue;
+            }
+            select_algo(a);
+            printf(" %10.1fus", bench(x, y, &r));
+            if (SCM_FALSEP(r0)) {
+                r0 = r;
+            } else if (!Scm_NumEq(r0, r)) {
+                printf(" ERROR(%s)", algo_names[a]);
+                errcount++;
+            }
+            fflush(stdout);
+        }
+        default_algo(saved);
+        printf(" %10.1fus\n", bench(x, y, &r));
+        if (!Scm_NumEq(r0, r)) {
+            printf("ERROR(default)\n");
+            errcount++;
+        }
+    }
+    return errcount? 1 : 0;
+}
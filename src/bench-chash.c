@@ -0,0 +1,134 @@
+/*
+ * Scaling benchmark of concurrent hash tables.
+ *
+ *  Runs the same mix of lookups and updates on a concurrent hash table
+ *  and on an ordinary hash table guarded by a mutex, with 1, 2, 4, 8
+ *  and 16 threads, and shows the throughput.  All threads share one
+ *  table with fixnum keys.  Also checks the final content of both
+ *  tables agrees.
+ *
+ *  Not build by default.  Run 'make bench-chash' in src directory.
+ *
+ *  Usage: bench-chash [ops-per-thread [update-percent]]
+ */
+
+#include "gauche.h"
+#include "gauche/priv/chashP.h"
+
+#define NKEYS 4096
+
+static const int nthreads[] = { 1, 2, 4, 8, 16, -1 };
+
+static long ops_per_thread = 1000000;
+static int update_percent = 10;
+
+/* The old way: a hash table guarded by a mutex. */
+static ScmHashTable *locked_table;
+static ScmInternalMutex locked_mutex;
+
+static ScmConcurrentHashTable *chash_table;
+
+static ScmObj locked_op(ScmObj key, ScmObj val, int update)
+{
+    ScmObj r;
+    SCM_INTERNAL_MUTEX_LOCK(locked_mutex);
+    if (update) r = Scm_HashTableSet(locked_table, key, val, 0);
+    else        r = Scm_HashTableRef(locked_table, key, SCM_FALSE);
+    SCM_INTERNAL_MUTEX_UNLOCK(locked_mutex);
+    return r;
+}
+
+static ScmObj chash_op(ScmObj key, ScmObj val, int update)
+{
+    if (update) return Scm_ConcurrentHashTableSet(chash_table, key, val, 0);
+    else        return Scm_ConcurrentHashTableRef(chash_table, key, SCM_FALSE);
+}
+
+typedef struct worker_rec {
+    ScmObj (*op)(ScmObj, ScmObj, int);
+    uint64_t seed;
+} worker_data;
+
+/* Thread thunk.  Each thread has its own random sequence. */
+static ScmObj worker(ScmObj *args SCM_UNUSED, int nargs SCM_UNUSED,
+                     void *data)
+{
+    worker_data *w = (worker_data*)data;
+    uint64_t s = w->seed;
+    for (long i = 0; i < ops_per_thread; i++) {
+        s ^= s << 13;
+        s ^= s >> 7;
+        s ^= s << 17;
+        ScmObj key = SCM_MAKE_INT(s % NKEYS);
+        w->op(key, key, (int)((s >> 32) % 100) < update_percent);
+    }
+    return SCM_UNDEFINED;
+}
+
+static double now_usec(void)
+{
+    u_long sec, nsec;
+    Scm_ClockGetTimeMonotonic(&sec, &nsec);
+    return sec * 1.0e6 + nsec / 1.0e3;
+}
+
+/* Runs OP on N threads, and returns million ops per second. */
+static double bench(int n, ScmObj (*op)(ScmObj, ScmObj, int))
+{
+    ScmObj threads[16];
+    for (int i = 0; i < n; i++) {
+        worker_data *w = SCM_NEW(worker_data);
+        w->op = op;
+        w->seed = 88172645463325252ULL + (uint64_t)i * 2654435761ULL;
+        ScmObj thunk = Scm_MakeSubr(worker, w, 0, 0, SCM_FALSE);
+        threads[i] = Scm_MakeThread(SCM_PROCEDURE(thunk), SCM_FALSE);
+    }
+    double start = now_usec();
+    for (int i = 0; i < n; i++) Scm_ThreadStart(SCM_VM(threads[i]), 0);
+    for (int i = 0; i < n; i++) {
+        Scm_ThreadJoin(SCM_VM(threads[i]), SCM_FALSE, SCM_FALSE);
+    }
+    double elapsed = now_usec() - start;
+    return (double)ops_per_thread * n / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    Scm_Init(GAUCHE_SIGNATURE);
+    if (argc > 1) ops_per_thread = atol(argv[1]);
+    if (argc > 2) update_percent = atoi(argv[2]);
+
+    locked_table =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQV, NKEYS));
+    SCM_INTERNAL_MUTEX_INIT(locked_mutex);
+    chash_table =
+        SCM_CONCURRENT_HASH_TABLE(Scm_MakeConcurrentHashTable(SCM_HASH_EQV,
+                                                              NKEYS));
+    for (long k = 0; k < NKEYS; k++) {
+        locked_op(SCM_MAKE_INT(k), SCM_MAKE_INT(k), TRUE);
+        chash_op(SCM_MAKE_INT(k), SCM_MAKE_INT(k), TRUE);
+    }
+
+    printf("%ld ops/thread, %d%% updates, %d keys, %d processors\n",
+           ops_per_thread, update_percent, NKEYS, Scm_AvailableProcessors());
+    printf("%8s %14s %14s %8s\n", "threads", "locked", "concurrent", "ratio");
+    for (int i = 0; nthreads[i] > 0; i++) {
+        double l = bench(nthreads[i], locked_op);
+        double c = bench(nthreads[i], chash_op);
+        printf("%8d %8.2f Mop/s %8.2f Mop/s %7.2fx\n",
+               nthreads[i], l, c, c / l);
+        fflush(stdout);
+    }
+
+    /* Every update stores the key itself, so both must be the same. */
+    int errcount = 0;
+    for (long k = 0; k < NKEYS; k++) {
+        ScmObj key = SCM_MAKE_INT(k);
+        if (!SCM_EQ(locked_op(key, SCM_FALSE, FALSE), key)
+            || !SCM_EQ(chash_op(key, SCM_FALSE, FALSE), key)) {
+            printf("ERROR: key %ld\n", k);
+            errcount++;
+        }
+    }
+    return errcount? 1 : 0;
+}
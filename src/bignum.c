@@ -796,13 +796,596 @@ static ScmBignum *bignum_mul_word(ScmBignum *br, const ScmBignum *bx,
     return br;
 }
 
+/*
+ * Multiplication of large numbers
+ *
+ *   The following routines work on raw word arrays (least significant
+ *   word first) instead of ScmBignums, so that recursive algorithms can
+ *   work on a part of a number without copying.
+ *
+ *   We switch algorithms by the size of the shorter operand:
+ *
+ *     size < karatsuba_threshold          : schoolbook, O(n*m)
+ *     size < toom3_threshold              : Karatsuba, O(n^1.58)
+ *     size < ntt_threshold                : Toom-3, O(n^1.46)
+ *     otherwise                           : NTT, O(n log n)
+ *
+ *   If one operand is much longer than the other, we split the longer
+ *   one into chunks of the size of the shorter one, except for NTT.
+ *
+ *   The thresholds are variables so that bench-bignum can find out
+ *   the crossover points.  See Scm__BignumMulThresholds.
+ */
+
+#define KARATSUBA_THRESHOLD  40
+#define TOOM3_THRESHOLD      160
+#define NTT_THRESHOLD        4000
+
+static int karatsuba_threshold = KARATSUBA_THRESHOLD;
+static int toom3_threshold = TOOM3_THRESHOLD;
+static int ntt_threshold = NTT_THRESHOLD;
+
+#define WORDS_ALLOC(n)  SCM_NEW_ATOMIC_ARRAY(u_long, (n))
+
+static void words_mul(u_long *r, const u_long *x, int xn,
+                      const u_long *y, int yn);
+
+static inline void words_clear(u_long *r, int n)
+{
+    for (int i=0; i<n; i++) r[i] = 0;
+}
+
+static inline int words_trim(const u_long *x, int n)
+{
+    while (n > 0 && x[n-1] == 0) n--;
+    return n;
+}
+
+/* r[0..xn) = x[0..xn) + y[0..yn), xn >= yn.  Returns carry.
+   r can be the same as x. */
+static u_long words_add(u_long *r, const u_long *x, int xn,
+                        const u_long *y, int yn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<yn; i++) {
+        u_long xx = x[i], yy = y[i];
+        UADD(r[i], c, xx, yy);
+    }
+    for (; i<xn; i++) {
+        u_long xx = x[i];
+        UADD(r[i], c, xx, 0);
+    }
+    return c;
+}
+
+/* r[0..xn) = x[0..xn) - y[0..yn), xn >= yn.  Returns borrow.
+   r can be the same as x. */
+static u_long words_sub(u_long *r, const u_long *x, int xn,
+                        const u_long *y, int yn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<yn; i++) {
+        u_long xx = x[i], yy = y[i];
+        USUB(r[i], c, xx, yy);
+    }
+    for (; i<xn; i++) {
+        u_long xx = x[i];
+        USUB(r[i], c, xx, 0);
+    }
+    return c;
+}
+
+/* Compare x[0..n) and y[0..n) as unsigned numbers. */
+static int words_cmp(const u_long *x, const u_long *y, int n)
+{
+    for (int i=n-1; i>=0; i--) {
+        if (x[i] > y[i]) return 1;
+        if (x[i] < y[i]) return -1;
+    }
+    return 0;
+}
+
+/* r[0..n) = -r[0..n) mod 2^(n*WORD_BITS) */
+static void words_negate(u_long *r, int n)
+{
+    u_long c = 1;
+    for (int i=0; i<n; i++) {
+        u_long x = ~r[i];
+        UADD(r[i], c, x, 0);
+    }
+}
+
+/* r[0..n) <<= 1.  Returns the bit shifted out. */
+static u_long words_lshift1(u_long *r, int n)
+{
+    u_long c = 0;
+    for (int i=0; i<n; i++) {
+        u_long x = r[i];
+        r[i] = (x << 1) | c;
+        c = x >> (WORD_BITS-1);
+    }
+    return c;
+}
+
+/* r[0..n) >>= 1, treating r as unsigned. */
+static void words_rshift1(u_long *r, int n)
+{
+    for (int i=0; i<n-1; i++) {
+        r[i] = (r[i] >> 1) | (r[i+1] << (WORD_BITS-1));
+    }
+    if (n > 0) r[n-1] >>= 1;
+}
+
+/* r[0..n) /= 3, knowing that r is a multiple of 3.  We multiply
+   the modular inverse of 3 instead of dividing (Jebelean's exact
+   division), which is also valid if r is negative in two's complement. */
+static void words_divexact3(u_long *r, int n)
+{
+    const u_long inv3 = (SCM_ULONG_MAX/3)*2 + 1;
+    u_long three = 3, c = 0;
+    for (int i=0; i<n; i++) {
+        u_long s = r[i], hi, lo;
+        u_long b = (s < c);
+        s -= c;
+        u_long q = s * inv3;
+        r[i] = q;
+        UMUL(hi, lo, q, three);
+        (void)lo;
+        c = hi + b;
+    }
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn).  Schoolbook method. */
+static void words_mul_basecase(u_long *r, const u_long *x, int xn,
+                               const u_long *y, int yn)
+{
+    words_clear(r, xn);
+    for (int j=0; j<yn; j++) {
+        u_long yy = y[j], carry = 0;
+        for (int i=0; i<xn; i++) {
+            u_long hi, lo, t, c = 0, rr = r[i+j];
+            UMUL(hi, lo, x[i], yy);
+            UADD(t, c, lo, rr);
+            hi += c;
+            c = 0;
+            UADD(r[i+j], c, t, carry);
+            carry = hi + c;
+        }
+        r[j+xn] = carry;
+    }
+}
+
+/* Multiply x[0..xn) and y[0..yn) and store the result to w[0..wn),
+   clearing extra words.  Leading zeros in x and y are skipped.
+   Assumes wn >= trimmed xn + trimmed yn. */
+static void words_mul_trim(u_long *w, int wn,
+                           const u_long *x, int xn, const u_long *y, int yn)
+{
+    xn = words_trim(x, xn);
+    yn = words_trim(y, yn);
+    if (xn == 0 || yn == 0) {
+        words_clear(w, wn);
+    } else {
+        SCM_ASSERT(xn + yn <= wn);
+        words_mul(w, x, xn, y, yn);
+        words_clear(w + xn + yn, wn - xn - yn);
+    }
+}
+
+/* Karatsuba.  Assumes xn >= yn > xn/2. */
+static void words_mul_karatsuba(u_long *r, const u_long *x, int xn,
+                                const u_long *y, int yn)
+{
+    int h = (xn+1)/2;
+    int x1n = xn - h, y1n = yn - h;
+    int rn = xn + yn;
+
+    if (y1n <= 0) {
+        /* y is too short to split.  r = x0*y + x1*y*B^h */
+        u_long *t = WORDS_ALLOC(x1n + yn);
+        words_mul(r, x, h, y, yn);
+        words_clear(r + h + yn, rn - h - yn);
+        words_mul(t, x + h, x1n, y, yn);
+        words_add(r + h, r + h, rn - h, t, x1n + yn);
+        return;
+    }
+
+    /* z0 = x0*y0 in r[0..2h), z2 = x1*y1 in r[2h..rn) */
+    words_mul(r, x, h, y, h);
+    words_mul(r + 2*h, x + h, x1n, y + h, y1n);
+
+    /* z1 = (x0+x1)*(y0+y1) - z0 - z2 */
+    u_long *sx = WORDS_ALLOC(4*h + 4);
+    u_long *sy = sx + h + 1;
+    u_long *z1 = sy + h + 1;
+    sx[h] = words_add(sx, x, h, x + h, x1n);
+    sy[h] = words_add(sy, y, h, y + h, y1n);
+    words_mul_trim(z1, 2*h + 2, sx, h + 1, sy, h + 1);
+    words_sub(z1, z1, 2*h + 2, r, 2*h);
+    words_sub(z1, z1, 2*h + 2, r + 2*h, x1n + y1n);
+
+    int z1n = words_trim(z1, 2*h + 2);
+    SCM_ASSERT(z1n <= rn - h);
+    words_add(r + h, r + h, rn - h, z1, z1n);
+}
+
+/* Toom-3, evaluating at 0, 1, -1, 2 and infinity.  Assumes
+   xn >= yn > 2*k, where k = ceil(xn/3).
+
+   Let x = x2*B^2k + x1*B^k + x0 and y likewise, and the product
+   c4*B^4k + c3*B^3k + c2*B^2k + c1*B^k + c0.  After computing
+   v(t) = x(t)*y(t) at the five points, we interpolate c's as follows:
+
+     c0 = v(0), c4 = v(inf)
+     w3 = (v(2) - v(-1))/3            = c1 + c2 + 3c3 + 5c4
+     w1 = (v(1) - v(-1))/2            = c1 + c3
+     w2 = v(-1) - v(0)                = -c1 + c2 - c3 + c4
+     w3 = (w3 - w2)/2 - 2*v(inf)      = c1 + 2c3
+     c2 = w2 + w1 - v(inf)
+     c3 = w3 - w1
+     c1 = w1 - c3
+
+   w2 can be negative, so the interpolation is done in modular arithmetic
+   on fixed size words; the divisions are all exact. */
+static void words_mul_toom3(u_long *r, const u_long *x, int xn,
+                            const u_long *y, int yn)
+{
+    int k = (xn+2)/3;
+    int x2n = xn - 2*k, y2n = yn - 2*k;
+    int rn = xn + yn;
+    int en = k + 1;             /* size of evaluated operands */
+    int wn = 2*k + 2;           /* size of interpolation buffers */
+
+    const u_long *x0 = x, *x1 = x + k, *x2 = x + 2*k;
+    const u_long *y0 = y, *y1 = y + k, *y2 = y + 2*k;
+
+    u_long *buf = WORDS_ALLOC(6*en + 3*wn);
+    u_long *px1 = buf,       *qx1 = px1 + en; /* x(1), y(1) */
+    u_long *pm1 = qx1 + en,  *qm1 = pm1 + en; /* |x(-1)|, |y(-1)| */
+    u_long *px2 = qm1 + en,  *qx2 = px2 + en; /* x(2), y(2) */
+    u_long *v1  = qx2 + en,  *vm1 = v1 + wn, *v2 = vm1 + wn;
+    int neg = FALSE;
+
+    /* Evaluation.  We use px1/qx1 for x0+x2/y0+y2 temporarily. */
+    px1[k] = words_add(px1, x0, k, x2, x2n);
+    if (words_cmp(px1, x1, k) >= 0 || px1[k]) {
+        pm1[k] = px1[k] - words_sub(pm1, px1, k, x1, k);
+    } else {
+        pm1[k] = 0;
+        words_sub(pm1, x1, k, px1, k);
+        neg = !neg;
+    }
+    px1[k] += words_add(px1, px1, k, x1, k);
+
+    qx1[k] = words_add(qx1, y0, k, y2, y2n);
+    if (words_cmp(qx1, y1, k) >= 0 || qx1[k]) {
+        qm1[k] = qx1[k] - words_sub(qm1, qx1, k, y1, k);
+    } else {
+        qm1[k] = 0;
+        words_sub(qm1, y1, k, qx1, k);
+        neg = !neg;
+    }
+    qx1[k] += words_add(qx1, qx1, k, y1, k);
+
+    /* x(2) = ((x2*2 + x1)*2) + x0 */
+    words_clear(px2, en);
+    for (int i=0; i<x2n; i++) px2[i] = x2[i];
+    words_lshift1(px2, en);
+    words_add(px2, px2, en, x1, k);
+    words_lshift1(px2, en);
+    words_add(px2, px2, en, x0, k);
+
+    words_clear(qx2, en);
+    for (int i=0; i<y2n; i++) qx2[i] = y2[i];
+    words_lshift1(qx2, en);
+    words_add(qx2, qx2, en, y1, k);
+    words_lshift1(qx2, en);
+    words_add(qx2, qx2, en, y0, k);
+
+    /* Pointwise multiplication.  v(0) and v(inf) go directly to r. */
+    words_mul(r, x0, k, y0, k);
+    words_mul(r + 4*k, x2, x2n, y2, y2n);
+    words_clear(r + 2*k, 2*k);
+    words_mul_trim(v1, wn, px1, en, qx1, en);
+    words_mul_trim(vm1, wn, pm1, en, qm1, en);
+    if (neg) words_negate(vm1, wn);
+    words_mul_trim(v2, wn, px2, en, qx2, en);
+
+    const u_long *c0 = r, *c4 = r + 4*k;
+    int c4n = x2n + y2n;
+
+    /* Interpolation */
+    words_sub(v2, v2, wn, vm1, wn);       /* v2 = (v(2) - v(-1))/3 */
+    words_divexact3(v2, wn);
+    words_sub(v1, v1, wn, vm1, wn);       /* v1 = (v(1) - v(-1))/2 */
+    words_rshift1(v1, wn);
+    words_sub(vm1, vm1, wn, c0, 2*k);     /* vm1 = v(-1) - v(0) */
+    words_sub(v2, v2, wn, vm1, wn);       /* v2 = (v2 - vm1)/2 - 2*c4 */
+    words_rshift1(v2, wn);
+    words_sub(v2, v2, wn, c4, c4n);
+    words_sub(v2, v2, wn, c4, c4n);
+    words_add(vm1, vm1, wn, v1, wn);      /* c2 = vm1 + v1 - c4 */
+    words_sub(vm1, vm1, wn, c4, c4n);
+    words_sub(v2, v2, wn, v1, wn);        /* c3 = v2 - v1 */
+    words_sub(v1, v1, wn, v2, wn);        /* c1 = v1 - c3 */
+
+    /* Recomposition */
+    int n;
+    n = words_trim(v1, wn);
+    SCM_ASSERT(n <= rn - k);
+    words_add(r + k, r + k, rn - k, v1, n);
+    n = words_trim(vm1, wn);
+    SCM_ASSERT(n <= rn - 2*k);
+    words_add(r + 2*k, r + 2*k, rn - 2*k, vm1, n);
+    n = words_trim(v2, wn);
+    SCM_ASSERT(n <= rn - 3*k);
+    words_add(r + 3*k, r + 3*k, rn - 3*k, v2, n);
+}
+
+/* Number theoretic transform.
+
+   For very large operands we use convolution by NTT over three primes
+   less than 2^31, and combine the results by the Chinese remainder
+   theorem.  The operands are split into 32-bit digits.  A coefficient of
+   the convolution is less than N*2^64, where N is the transform size,
+   while the product of three primes is about 2^89, so N up to 2^24 (the
+   largest power of two that divides all p-1) is safe.  That covers
+   operands of up to 2^23 digits, that is, 256M bits.  We fall back to
+   Toom-3 beyond that.
+
+   All the arithmetic here is done with uint32_t and uint64_t, independent
+   of the size of u_long. */
+
+#define NTT_MAX_LOG2  24
+
+static const struct ntt_prime {
+    uint32_t p;
+    uint32_t g;                 /* primitive root */
+} ntt_primes[3] = {
+    { 2013265921UL, 31 },       /* 15*2^27+1 */
+    { 469762049UL, 3 },         /* 7*2^26+1 */
+    { 754974721UL, 11 },        /* 45*2^24+1 */
+};
+
+static inline uint32_t ntt_mulmod(uint32_t a, uint32_t b, uint32_t p)
+{
+    return (uint32_t)(((uint64_t)a * b) % p);
+}
+
+static uint32_t ntt_powmod(uint32_t a, uint64_t e, uint32_t p)
+{
+    uint32_t r = 1;
+    while (e > 0) {
+        if (e & 1) r = ntt_mulmod(r, a, p);
+        a = ntt_mulmod(a, a, p);
+        e >>= 1;
+    }
+    return r;
+}
+
+/* Multiplication by a fixed twiddle factor W, using the precomputed
+   WQ = floor(W*2^32/p) (Shoup's method).  Returns a*w mod p. */
+static inline uint32_t ntt_mulmod_shoup(uint32_t a, uint32_t w, uint32_t wq,
+                                        uint32_t p)
+{
+    uint32_t q = (uint32_t)(((uint64_t)a * wq) >> 32);
+    uint32_t r = a*w - q*p;     /* mod 2^32; true value is in [0, 2p) */
+    return (r >= p)? r - p : r;
+}
+
+/* Fill W[0..n/2) with powers of primitive n-th root of unity ROOT, and
+   WQ with their Shoup's quotients. */
+static void ntt_twiddles(uint32_t *w, uint32_t *wq, int n, uint32_t root,
+                         uint32_t p)
+{
+    uint32_t x = 1;
+    for (int j=0; j<n/2; j++) {
+        w[j] = x;
+        wq[j] = (uint32_t)(((uint64_t)x << 32) / p);
+        x = ntt_mulmod(x, root, p);
+    }
+}
+
+/* Forward transform (decimation in frequency).  The result is in
+   bit-reversed order, which is fine since we only multiply pointwise
+   and transform back with ntt_backward. */
+static void ntt_forward(uint32_t *a, int n, const uint32_t *w,
+                        const uint32_t *wq, uint32_t p)
+{
+    for (int len = n/2, stride = 1; len >= 1; len >>= 1, stride <<= 1) {
+        for (int s = 0; s < n; s += 2*len) {
+            for (int j = 0; j < len; j++) {
+                uint32_t u = a[s+j], v = a[s+j+len];
+                uint32_t t = u + v;
+                a[s+j] = (t >= p)? t - p : t;
+                a[s+j+len] = ntt_mulmod_shoup(u + p - v, w[j*stride],
+                                              wq[j*stride], p);
+            }
+        }
+    }
+}
+
+/* Backward transform (decimation in time), taking bit-reversed input.
+   W and WQ must be of the inverse root.  The result isn't scaled. */
+static void ntt_backward(uint32_t *a, int n, const uint32_t *w,
+                         const uint32_t *wq, uint32_t p)
+{
+    for (int len = 1, stride = n/2; len < n; len <<= 1, stride >>= 1) {
+        for (int s = 0; s < n; s += 2*len) {
+            for (int j = 0; j < len; j++) {
+                uint32_t u = a[s+j];
+                uint32_t v = ntt_mulmod_shoup(a[s+j+len], w[j*stride],
+                                              wq[j*stride], p);
+                uint32_t t = u + v;
+                a[s+j] = (t >= p)? t - p : t;
+                a[s+j+len] = (u >= v)? u - v : u + p - v;
+            }
+        }
+    }
+}
+
+/* Split x[0..xn) into 32-bit digits d[0..n), padding with zero.  A digit
+   can exceed the modulus P, so we reduce it. */
+static void ntt_split(uint32_t *d, int n, const u_long *x, int xn,
+                      uint32_t p)
+{
+    int k = 0;
+    for (int i=0; i<xn; i++) {
+        u_long w = x[i];
+        for (int j=0; j<SIZEOF_LONG/4; j++) {
+            d[k++] = (uint32_t)w % p;
+            w = (SIZEOF_LONG > 4)? (w >> 16 >> 16) : 0;
+        }
+    }
+    while (k < n) d[k++] = 0;
+}
+
+/* Cyclic convolution of x and y modulo the IDX-th prime, left in dx. */
+static void ntt_convolve(uint32_t *dx, uint32_t *dy, int n, int lg,
+                         const u_long *x, int xn, const u_long *y, int yn,
+                         int idx)
+{
+    uint32_t p = ntt_primes[idx].p;
+    uint32_t root = ntt_powmod(ntt_primes[idx].g, (p-1) >> lg, p);
+    uint32_t *w = SCM_NEW_ATOMIC_ARRAY(uint32_t, n*2);
+    uint32_t *wq = w + n/2;
+    uint32_t *iw = wq + n/2;
+    uint32_t *iwq = iw + n/2;
+
+    ntt_twiddles(w, wq, n, root, p);
+    ntt_twiddles(iw, iwq, n, ntt_powmod(root, p-2, p), p);
+
+    ntt_split(dx, n, x, xn, p);
+    ntt_forward(dx, n, w, wq, p);
+    if (x == y && xn == yn) {
+        for (int i=0; i<n; i++) dx[i] = ntt_mulmod(dx[i], dx[i], p);
+    } else {
+        ntt_split(dy, n, y, yn, p);
+        ntt_forward(dy, n, w, wq, p);
+        for (int i=0; i<n; i++) dx[i] = ntt_mulmod(dx[i], dy[i], p);
+    }
+    ntt_backward(dx, n, iw, iwq, p);
+
+    uint32_t ninv = ntt_powmod(n, p-2, p);
+    for (int i=0; i<n; i++) dx[i] = ntt_mulmod(dx[i], ninv, p);
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn) by NTT.  Returns FALSE if the operands
+   are too large for NTT. */
+static int words_mul_ntt(u_long *r, const u_long *x, int xn,
+                         const u_long *y, int yn)
+{
+    const int dpw = SIZEOF_LONG/4;      /* 32-bit digits per word */
+    int lg = 0;
+    while ((1L<<lg) < (long)(xn + yn) * dpw) lg++;
+    if (lg > NTT_MAX_LOG2) return FALSE;
+    int n = 1 << lg;
+
+    uint32_t *d = SCM_NEW_ATOMIC_ARRAY(uint32_t, n*4);
+    uint32_t *d0 = d, *d1 = d + n, *d2 = d + 2*n, *tmp = d + 3*n;
+    ntt_convolve(d0, tmp, n, lg, x, xn, y, yn, 0);
+    ntt_convolve(d1, tmp, n, lg, x, xn, y, yn, 1);
+    ntt_convolve(d2, tmp, n, lg, x, xn, y, yn, 2);
+
+    /* Garner's algorithm.  For each coefficient we find
+         v = v0 + v1*p0 + v2*p0*p1
+       and add it to the 96-bit carry accumulator acc[]. */
+    const uint32_t p0 = ntt_primes[0].p, p1 = ntt_primes[1].p,
+        p2 = ntt_primes[2].p;
+    const uint32_t p0inv_p1 = ntt_powmod(p0 % p1, p1-2, p1);
+    const uint32_t p0p1inv_p2 =
+        ntt_powmod(ntt_mulmod(p0 % p2, p1 % p2, p2), p2-2, p2);
+    const uint64_t p0p1 = (uint64_t)p0 * p1;
+    uint32_t acc[3] = {0, 0, 0};
+    int rn = xn + yn, k = 0;
+    u_long word = 0;
+
+    words_clear(r, rn);
+    for (int i=0; i<rn*dpw; i++) {
+        uint32_t v0 = d0[i];
+        uint32_t v1 = ntt_mulmod((d1[i] + p1 - v0 % p1) % p1, p0inv_p1, p1);
+        uint64_t v01 = v0 + (uint64_t)v1 * p0;  /* < p0*p1 < 2^62 */
+        uint32_t t = (uint32_t)((d2[i] + p2 - v01 % p2) % p2);
+        uint32_t v2 = ntt_mulmod(t, p0p1inv_p2, p2);
+
+        /* acc += v01 + v2*p0p1 */
+        uint64_t lo = (uint64_t)v2 * (uint32_t)p0p1;
+        uint64_t hi = (uint64_t)v2 * (uint32_t)(p0p1 >> 32);
+        uint64_t s0 = (uint64_t)acc[0] + (uint32_t)v01 + (uint32_t)lo;
+        uint64_t s1 = (uint64_t)acc[1] + (v01 >> 32) + (lo >> 32)
+            + (uint32_t)hi + (s0 >> 32);
+        uint64_t s2 = (uint64_t)acc[2] + (hi >> 32) + (s1 >> 32);
+
+        /* emit the lowest digit and shift */
+        uint32_t digit = (uint32_t)s0;
+        acc[0] = (uint32_t)s1;
+        acc[1] = (uint32_t)s2;
+        acc[2] = (uint32_t)(s2 >> 32);
+
+        if (dpw == 1) {
+            r[k++] = digit;
+        } else {
+            int sh = (i % dpw) * 32;
+            word |= (u_long)digit << sh;
+            if (i % dpw == dpw - 1) { r[k++] = word; word = 0; }
+        }
+    }
+    return TRUE;
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn).  r must not overlap with x nor y. */
+static void words_mul(u_long *r, const u_long *x, int xn,
+                      const u_long *y, int yn)
+{
+    if (xn < yn) {
+        const u_long *t = x; x = y; y = t;
+        int tn = xn; xn = yn; yn = tn;
+    }
+
+    if (yn < karatsuba_threshold) {
+        words_mul_basecase(r, x, xn, y, yn);
+    } else if (yn >= ntt_threshold && words_mul_ntt(r, x, xn, y, yn)) {
+        return;
+    } else if (xn >= 2*yn) {
+        /* Unbalanced.  Multiply yn-word chunks of x by y. */
+        u_long *t = WORDS_ALLOC(2*yn);
+        words_clear(r, xn + yn);
+        for (int off = 0; off < xn; off += yn) {
+            int cn = min(yn, xn - off);
+            words_mul(t, x + off, cn, y, yn);
+            words_add(r + off, r + off, xn + yn - off, t, cn + yn);
+        }
+    } else if (yn >= toom3_threshold && yn > 2*((xn+2)/3)) {
+        words_mul_toom3(r, x, xn, y, yn);
+    } else {
+        words_mul_karatsuba(r, x, xn, y, yn);
+    }
+}
+
+/* For benchmarking.  Sets the thresholds of multiplication algorithms
+   and returns the previous values.  A negative argument keeps the current
+   value.  Not thread safe; call it before any other threads start. */
+void Scm__BignumMulThresholds(int *kara, int *toom3, int *ntt)
+{
+#define SWAP_THRESHOLD(var, p)                  \
+    do {                                        \
+        int v_ = *(p);                          \
+        *(p) = var;                             \
+        if (v_ >= 0) var = v_;                  \
+    } while (0)
+    SWAP_THRESHOLD(karatsuba_threshold, kara);
+    SWAP_THRESHOLD(toom3_threshold, toom3);
+    SWAP_THRESHOLD(ntt_threshold, ntt);
+#undef SWAP_THRESHOLD
+}
+
 /* returns bx * by.  not normalized */
 static ScmBignum *bignum_mul(const ScmBignum *bx, const ScmBignum *by)
 {
     ScmBignum *br = make_bignum(bx->size + by->size);
-    for (u_int i=0; i<by->size; i++) {
-        bignum_mul_word(br, bx, by->values[i], i);
-    }
+    words_mul(br->values, bx->values, bx->size, by->values, by->size);
     br->sign = bx->sign * by->sign;
     return br;
 }
@@ -985,6 +1568,228 @@ static u_long bignum_sdiv(ScmBignum *dividend, u_long divisor)
     return r1;
 }
 
+/*
+ * Division of large numbers
+ *
+ *   Like multiplication, these work on raw word arrays.  The divisor
+ *   must be normalized, i.e. its most significant bit must be set;
+ *   words_divrem takes care of it.
+ *
+ *   If the quotient is shorter than div_dc_threshold words, we use
+ *   Knuth's algorithm D with full words.  Otherwise we use the recursive
+ *   division of Burnikel and Ziegler (in the form described in Brent &
+ *   Zimmermann, "Modern Computer Arithmetic", Algorithm 1.8), which
+ *   takes about 2K(n) where K(n) is the cost of n-word multiplication.
+ */
+
+#define DIV_DC_THRESHOLD  50
+
+static int div_dc_threshold = DIV_DC_THRESHOLD;
+
+/* Returns [hi, lo] / d, setting the remainder to *r.  Assumes hi < d and
+   d is normalized. */
+static inline u_long udiv_2by1(u_long hi, u_long lo, u_long d, u_long *r)
+{
+#if SIZEOF_LONG == 8 && defined(__SIZEOF_INT128__)
+    unsigned __int128 n = ((unsigned __int128)hi << 64) | lo;
+    *r = (u_long)(n % d);
+    return (u_long)(n / d);
+#elif SIZEOF_LONG == 4
+    uint64_t n = ((uint64_t)hi << 32) | lo;
+    *r = (u_long)(n % d);
+    return (u_long)(n / d);
+#else
+    /* Divide by half words.  See Hacker's Delight, divlu. */
+    u_long dh = HI(d), dl = LO(d);
+    u_long ln1 = HI(lo), ln0 = LO(lo);
+    u_long q1 = hi / dh, rhat = hi % dh;
+    while (q1 >= HALF_WORD || q1*dl > ((rhat << HALF_BITS) | ln1)) {
+        q1--; rhat += dh;
+        if (rhat >= HALF_WORD) break;
+    }
+    u_long n21 = (hi << HALF_BITS) + ln1 - q1*d;
+    u_long q0 = n21 / dh;
+    rhat = n21 % dh;
+    while (q0 >= HALF_WORD || q0*dl > ((rhat << HALF_BITS) | ln0)) {
+        q0--; rhat += dh;
+        if (rhat >= HALF_WORD) break;
+    }
+    *r = (n21 << HALF_BITS) + ln0 - q0*d;
+    return (q1 << HALF_BITS) | q0;
+#endif
+}
+
+/* r[0..n) -= x[0..n) * y.  Returns the word to be subtracted from r[n]. */
+static u_long words_submul_1(u_long *r, const u_long *x, int n, u_long y)
+{
+    u_long carry = 0;
+    for (int i=0; i<n; i++) {
+        u_long hi, lo, t, c = 0;
+        u_long xx = x[i];
+        UMUL(hi, lo, xx, y);
+        UADD(lo, c, lo, carry);
+        hi += c;
+        c = 0;
+        t = r[i];
+        USUB(r[i], c, t, lo);
+        carry = hi + c;
+    }
+    return carry;
+}
+
+/* Decrement q[0..n) by one. */
+static void words_decr(u_long *q, int n)
+{
+    for (int i=0; i<n; i++) {
+        if (q[i]-- != 0) break;
+    }
+}
+
+/* Knuth's algorithm D.  Divides a[0..n+m) by b[0..n), where b is
+   normalized.  The quotient goes to q[0..m] (note that it has m+1 words;
+   the topmost one is 0 or 1).  The remainder is left in a[0..n), and
+   a[n..n+m) becomes 0. */
+static void words_divrem_basecase(u_long *q, u_long *a, int m,
+                                  const u_long *b, int n)
+{
+    if (words_cmp(a + m, b, n) >= 0) {
+        words_sub(a + m, a + m, n, b, n);
+        q[m] = 1;
+    } else {
+        q[m] = 0;
+    }
+
+    u_long b1 = b[n-1], b2 = (n > 1)? b[n-2] : 0;
+    for (int j=m-1; j>=0; j--) {
+        /* Estimate the quotient digit from the top words. */
+        u_long qhat, rhat;
+        u_long a0 = a[j+n], a1 = a[j+n-1], a2 = (n > 1)? a[j+n-2] : 0;
+        if (a0 >= b1) {
+            qhat = SCM_ULONG_MAX;
+            rhat = a1 + b1;
+            if (rhat < b1) goto estimated; /* rhat overflows */
+        } else {
+            qhat = udiv_2by1(a0, a1, b1, &rhat);
+        }
+        for (;;) {
+            u_long hi, lo;
+            UMUL(hi, lo, qhat, b2);
+            if (hi < rhat || (hi == rhat && lo <= a2)) break;
+            qhat--;
+            rhat += b1;
+            if (rhat < b1) break; /* rhat overflows */
+        }
+      estimated:
+        /* Subtract qhat*b from a[j..j+n].  qhat may still be too big
+           by one, in which case we add b back. */
+        if (words_submul_1(a + j, b, n, qhat) > a[j+n]) {
+            qhat--;
+            words_add(a + j, a + j, n, b, n);
+        }
+        a[j+n] = 0;
+        q[j] = qhat;
+    }
+}
+
+/* Recursive division.  Same interface as words_divrem_basecase,
+   except it requires m <= n. */
+static void words_divrem_rec(u_long *q, u_long *a, int m,
+                             const u_long *b, int n)
+{
+    if (m < div_dc_threshold) {
+        words_divrem_basecase(q, a, m, b, n);
+        return;
+    }
+
+    int k = m/2;
+    const u_long *b0 = b, *b1 = b + k;   /* b = b1*B^k + b0 */
+    int b0n = words_trim(b0, k);
+    u_long *t = WORDS_ALLOC(m + 2);
+    u_long neg;
+
+    /* q1 = a[2k..n+m) / b1 into q[k..m].  The remainder r1 is left in
+       a[2k..n+k). */
+    words_divrem_rec(q + k, a + 2*k, m - k, b1, n - k);
+    /* a[k..n+m) -= q1 * b0, adjusting q1 until a becomes nonnegative */
+    int q1n = words_trim(q + k, m - k + 1);
+    if (q1n > 0 && b0n > 0) {
+        words_mul(t, q + k, q1n, b0, b0n);
+        neg = words_sub(a + k, a + k, n + m - k, t, q1n + b0n);
+        while (neg) {
+            words_decr(q + k, m - k + 1);
+            neg = !words_add(a + k, a + k, n + m - k, b, n);
+        }
+    }
+
+    /* q0 = a[k..n+k) / b1 into q0[0..k].  The remainder r0 is left in
+       a[k..n). */
+    u_long *q0 = WORDS_ALLOC(k + 1);
+    words_divrem_rec(q0, a + k, k, b1, n - k);
+    /* a[0..n+m) -= q0 * b0, adjusting q0 until a becomes nonnegative */
+    int q0n = words_trim(q0, k + 1);
+    if (q0n > 0 && b0n > 0) {
+        words_mul(t, q0, q0n, b0, b0n);
+        neg = words_sub(a, a, n + m, t, q0n + b0n);
+        while (neg) {
+            words_decr(q0, k + 1);
+            neg = !words_add(a, a, n + m, b, n);
+        }
+    }
+    words_clear(q, k);
+    words_add(q, q, m + 1, q0, k + 1);
+}
+
+/* Divides a[0..an) by b[0..bn), where an >= bn > 0 and b[bn-1] != 0.
+   The quotient goes to q[0..an-bn+1) and the remainder to r[0..bn). */
+static void words_divrem(u_long *q, u_long *r, const u_long *a, int an,
+                         const u_long *b, int bn)
+{
+    int shift = WORD_BITS - 1 - Scm__HighestBitNumber(b[bn-1]);
+    u_long *nb = WORDS_ALLOC(bn);
+    u_long *na = WORDS_ALLOC(an + 1);
+
+    /* Normalize.  na[an] < nb[bn-1] holds, so the quotient of
+       na / nb fits in an-bn+1 words. */
+    if (shift > 0) {
+        for (int i=bn-1; i>0; i--) {
+            nb[i] = (b[i] << shift) | (b[i-1] >> (WORD_BITS - shift));
+        }
+        nb[0] = b[0] << shift;
+        na[an] = a[an-1] >> (WORD_BITS - shift);
+        for (int i=an-1; i>0; i--) {
+            na[i] = (a[i] << shift) | (a[i-1] >> (WORD_BITS - shift));
+        }
+        na[0] = a[0] << shift;
+    } else {
+        memcpy(nb, b, bn * sizeof(u_long));
+        memcpy(na, a, an * sizeof(u_long));
+        na[an] = 0;
+    }
+
+    /* Take bn-word chunks of quotient, from the top.  Each step divides
+       (bn + chunk) words, whose upper bn words are the remainder of
+       the previous step. */
+    int m = an + 1 - bn;
+    u_long *qt = WORDS_ALLOC(bn + 1);
+    for (int pos = m; pos > 0; ) {
+        int cm = (pos % bn)? (pos % bn) : bn;
+        pos -= cm;
+        words_divrem_rec(qt, na + pos, cm, nb, bn);
+        SCM_ASSERT(qt[cm] == 0);
+        memcpy(q + pos, qt, cm * sizeof(u_long));
+    }
+
+    /* Unnormalize the remainder. */
+    if (shift > 0) {
+        for (int i=0; i<bn-1; i++) {
+            r[i] = (na[i] >> shift) | (na[i+1] << (WORD_BITS - shift));
+        }
+        r[bn-1] = na[bn-1] >> shift;
+    } else {
+        memcpy(r, na, bn * sizeof(u_long));
+    }
+}
+
 /* assuming dividend is normalized. */
 ScmObj Scm_BignumDivSI(const ScmBignum *dividend, long divisor, long *remainder)
 {
@@ -1060,7 +1865,9 @@ ScmObj Scm_BignumDivRem(const ScmBignum *dividend, const ScmBignum *divisor)
     }
 
     ScmBignum *q = make_bignum(dividend->size - divisor->size + 1);
-    ScmBignum *r = bignum_gdiv(dividend, divisor, q);
+    ScmBignum *r = make_bignum(divisor->size);
+    words_divrem(q->values, r->values, dividend->values, dividend->size,
+                 divisor->values, divisor->size);
     q->sign = dividend->sign * divisor->sign;
     r->sign = dividend->sign;
 
@@ -1241,24 +2048,143 @@ int Scm_BignumLogCount(const ScmBignum *b)
  * Printing
  */
 
+/* Small numbers are converted by repeatedly dividing by the largest
+   power of radix that fits in a half word, R = radix^d.
+
+   For larger numbers we divide the number by R^(2^k), where R^(2^k) is
+   about the square root of the number, and convert the quotient and the
+   remainder recursively.  With the subquadratic division it takes
+   O(M(n) log n).  The powers R^(2^k) are cached up to some size, for we
+   tend to print many numbers of similar size.  Multiple threads may
+   compute the same entry simultaneously, but they store the same value,
+   so it's harmless. */
+
+#define TOSTR_DC_THRESHOLD      30 /* words */
+#define RADIX_POWER_CACHE_SIZE  16
+
+static ScmObj radix_powers[SCM_RADIX_MAX-SCM_RADIX_MIN+1][RADIX_POWER_CACHE_SIZE];
+
+/* Returns d, and sets radix^d to *pw */
+static int radix_halfword_digits(int radix, u_long *pw)
+{
+    u_long p = radix;
+    int d = 1;
+    while (p * radix < HALF_WORD) { p *= radix; d++; }
+    *pw = p;
+    return d;
+}
+
+/* Returns R^(2^level) */
+static ScmObj radix_power(int radix, int level)
+{
+    ScmObj p;
+    if (level < RADIX_POWER_CACHE_SIZE) {
+        p = radix_powers[radix-SCM_RADIX_MIN][level];
+        if (p != NULL) return p;
+    }
+    if (level == 0) {
+        u_long pw;
+        (void)radix_halfword_digits(radix, &pw);
+        p = Scm_MakeIntegerU(pw);
+    } else {
+        ScmObj h = radix_power(radix, level-1);
+        p = Scm_Mul(h, h);
+    }
+    if (level < RADIX_POWER_CACHE_SIZE) {
+        radix_powers[radix-SCM_RADIX_MIN][level] = p;
+    }
+    return p;
+}
+
+/* Writes the digits of nonnegative integer x to ds.  If width > 0, the
+   output is padded with zeros to make it width digits.  Otherwise no
+   leading zeros are written (hence nothing for 0). */
+static void bignum_digits_basecase(ScmDString *ds, ScmObj x, int radix,
+                                   int width, const char *tab)
+{
+    char buf[(TOSTR_DC_THRESHOLD+1)*WORD_BITS];
+    u_long pw;
+    int d = radix_halfword_digits(radix, &pw), n = 0;
+    ScmBignum *q;
+
+    if (SCM_BIGNUMP(x)) {
+        q = SCM_BIGNUM(Scm_BignumCopy(SCM_BIGNUM(x)));
+    } else {
+        q = SCM_BIGNUM(Scm_MakeBignumFromSI(SCM_INT_VALUE(x)));
+    }
+    SCM_ASSERT(q->size <= TOSTR_DC_THRESHOLD);
+    while (q->size > 0 && q->values[q->size-1] == 0) q->size--;
+    while (q->size > 0) {
+        u_long rem = bignum_sdiv(q, pw);
+        for (int i=0; i<d; i++) {
+            buf[n++] = tab[rem % radix];
+            rem /= radix;
+        }
+        while (q->size > 0 && q->values[q->size-1] == 0) q->size--;
+    }
+    while (n > 0 && buf[n-1] == '0') n--;
+    for (int i=n; i<width; i++) Scm_DStringPutc(ds, '0');
+    while (n > 0) Scm_DStringPutc(ds, buf[--n]);
+}
+
+/* Writes the digits of nonnegative integer x, which is less than
+   R^(2^(level+1)).  If pad is true, the output is padded with zeros
+   to make it d*2^(level+1) digits; otherwise no leading zeros are
+   written. */
+static void bignum_digits_rec(ScmDString *ds, ScmObj x, int radix,
+                              int level, int pad, const char *tab)
+{
+    if (level < 0 || !SCM_BIGNUMP(x)
+        || SCM_BIGNUM_SIZE(x) < TOSTR_DC_THRESHOLD) {
+        int width = 0;
+        if (pad) {
+            u_long pw;
+            width = radix_halfword_digits(radix, &pw) << (level+1);
+        }
+        bignum_digits_basecase(ds, x, radix, width, tab);
+    } else {
+        ScmObj p = radix_power(radix, level);
+        if (!pad && Scm_NumCmp(x, p) < 0) {
+            /* The leading part is smaller than the chunk; splitting it
+               would make leading zeros. */
+            bignum_digits_rec(ds, x, radix, level-1, FALSE, tab);
+        } else {
+            ScmObj r;
+            ScmObj q = Scm_Quotient(x, p, &r);
+            bignum_digits_rec(ds, q, radix, level-1, pad, tab);
+            bignum_digits_rec(ds, r, radix, level-1, TRUE, tab);
+        }
+    }
+}
+
 ScmObj Scm_BignumToString(const ScmBignum *b, int radix, int use_upper)
 {
     static const char ltab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
     static const char utab[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
     const char *tab = use_upper? utab : ltab;
-    ScmObj h = SCM_NIL, t = SCM_NIL;
     if (radix < SCM_RADIX_MIN || radix > SCM_RADIX_MAX)
         Scm_Error("radix out of range: %d", radix);
-    ScmBignum *q = SCM_BIGNUM(Scm_BignumCopy(b));
-    for (;q->size > 0;) {
-        long rem = bignum_sdiv(q, radix);
-        SCM_ASSERT(rem >= 0 && rem < radix);
-        SCM_APPEND1(h, t, SCM_MAKE_CHAR(tab[rem]));
-        for (; q->values[q->size-1] == 0 && q->size > 0; q->size--)
-            ;
+
+    ScmBignum *x = SCM_BIGNUM(Scm_BignumCopy(b));
+    x->sign = 1;
+
+    /* Find the level such that R^(2^level) <= x < R^(2^(level+1)).
+       We avoid computing the next power if it is obviously too big. */
+    int level = -1;
+    if (x->size >= TOSTR_DC_THRESHOLD) {
+        for (level = 0;; level++) {
+            ScmObj p = radix_power(radix, level);
+            int psize = SCM_BIGNUMP(p)? (int)SCM_BIGNUM_SIZE(p) : 1;
+            if (2*psize - 1 > (int)x->size) break;
+            if (Scm_NumCmp(radix_power(radix, level+1), SCM_OBJ(x)) > 0) break;
+        }
     }
-    if (q->sign < 0) SCM_APPEND1(h, t, SCM_MAKE_CHAR('-'));
-    return Scm_ListToString(Scm_ReverseX(h));
+
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    if (b->sign < 0) Scm_DStringPutc(&ds, '-');
+    bignum_digits_rec(&ds, SCM_OBJ(x), radix, level, FALSE, tab);
+    return Scm_DStringGet(&ds, 0);
 }
 
 void Scm_BignumDump(const ScmBignum *b, ScmPort *out)
@@ -1312,3 +2238,56 @@ ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc, u_long coef, u_long c)
         return rr;
     }
 }
+
+/* Below this number of big digits, Scm_BignumAccMultAddUIArray just
+   repeats Scm_BignumAccMultAddUI. */
+#define DIGITS_DC_THRESHOLD  40
+
+/* Returns the value of cs[0..n).  pows[k] caches coef^(2^k).  If pown
+   isn't NULL, coef^n is set to it. */
+static ScmObj digits_to_integer(const u_long *cs, int n, u_long coef,
+                                ScmObj *pows, ScmObj *pown)
+{
+    if (n < DIGITS_DC_THRESHOLD) {
+        ScmBignum *r = make_bignum(n + 1);
+        for (int i=0; i<n; i++) r = Scm_BignumAccMultAddUI(r, coef, cs[i]);
+        if (pown) {
+            ScmBignum *p = make_bignum(n + 1);
+            p->values[0] = 1;
+            for (int i=0; i<n; i++) p = Scm_BignumAccMultAddUI(p, coef, 0);
+            *pown = Scm_NormalizeBignum(p);
+        }
+        return Scm_NormalizeBignum(r);
+    }
+
+    /* Split cs into the upper n-L digits and the lower L digits, where
+       L = 2^k < n <= 2^(k+1). */
+    int k = 0;
+    while ((2L << k) < n) k++;
+    int l = 1 << k;
+    ScmObj ph = SCM_FALSE, pl = SCM_FALSE;
+    ScmObj hi = digits_to_integer(cs, n - l, coef, pows, pown? &ph : NULL);
+    ScmObj lo = digits_to_integer(cs + n - l, l, coef, pows,
+                                  SCM_FALSEP(pows[k])? &pl : NULL);
+    if (SCM_FALSEP(pows[k])) pows[k] = pl;
+    if (pown) *pown = Scm_Mul(ph, pows[k]);
+    return Scm_Add(Scm_Mul(hi, pows[k]), lo);
+}
+
+/* Calculate acc * coef^n + cs[0] * coef^(n-1) + ... + cs[n-1], where
+   each cs[i] < coef.  This is for reading a long integer, where cs[] are
+   "big digits".  Repeating Scm_BignumAccMultAddUI takes O(n^2); here we
+   combine the big digits by divide and conquer, so that it takes
+   O(M(n) log n).  Returns a bignum, possibly denormalized. */
+ScmBignum *Scm_BignumAccMultAddUIArray(ScmBignum *acc, u_long coef,
+                                       const u_long *cs, int n)
+{
+    ScmObj pows[sizeof(int)*CHAR_BIT], pown;
+    for (size_t i=0; i<sizeof(pows)/sizeof(pows[0]); i++) {
+        pows[i] = SCM_FALSE;
+    }
+    ScmObj v = digits_to_integer(cs, n, coef, pows, &pown);
+    ScmObj r = Scm_Add(Scm_Mul(Scm_NormalizeBignum(acc), pown), v);
+    if (SCM_BIGNUMP(r)) return SCM_BIGNUM(r);
+    return SCM_BIGNUM(Scm_MakeBignumFromSI(SCM_INT_VALUE(r)));
+}
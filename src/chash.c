@@ -0,0 +1,520 @@
+/*
+ * chash.c - concurrent hash table
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/priv/chashP.h"
+
+/* See chashP.h for the design. */
+
+#define NUM_STRIPES           SCM_CONCURRENT_HASH_TABLE_NUM_STRIPES
+#define MIN_CAPACITY          32
+#define ENTRY_SIZE            3
+
+#define ENTRY_HEADER(st, i)   (&(st)->vec[(i)*ENTRY_SIZE])
+#define ENTRY_KEY(st, i)      (&(st)->vec[(i)*ENTRY_SIZE+1])
+#define ENTRY_VALUE(st, i)    (&(st)->vec[(i)*ENTRY_SIZE+2])
+
+#define HEADER_VALID_P(hdr)   ((hdr) & 0x01)
+
+static void chash_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_ConcurrentHashTableClass, chash_print,
+                         NULL, NULL, NULL,
+                         SCM_CLASS_DICTIONARY_CPL);
+
+static ScmConcurrentHashStorage *new_storage(u_long capacity)
+{
+    ScmConcurrentHashStorage *s = SCM_NEW(ScmConcurrentHashStorage);
+    s->capacity = capacity;
+    s->vec = SCM_NEW_ARRAY(ScmAtomicVar, capacity * ENTRY_SIZE);
+    for (u_long i = 0; i < capacity * ENTRY_SIZE; i++) {
+        Scm_AtomicStore(&s->vec[i], 0);
+    }
+    return s;
+}
+
+static inline ScmConcurrentHashStorage *get_storage(ScmConcurrentHashTable *ht)
+{
+    return (ScmConcurrentHashStorage*)Scm_AtomicLoad(&ht->storage);
+}
+
+ScmObj Scm_MakeConcurrentHashTable(ScmHashType type, u_long initSize)
+{
+    ScmConcurrentHashTable *ht = SCM_NEW(ScmConcurrentHashTable);
+    SCM_SET_CLASS(ht, SCM_CLASS_CONCURRENT_HASH_TABLE);
+    if (type == SCM_HASH_WORD
+        || !Scm_HashCoreTypeToProcs(type, &ht->hashfn, &ht->cmpfn)) {
+        Scm_Error("Scm_MakeConcurrentHashTable: unsupported hash type: %d",
+                  type);
+    }
+    ht->type = type;
+
+    /* Keep the load factor under 1/2 for INITSIZE entries. */
+    u_long capacity = MIN_CAPACITY;
+    while (capacity < initSize*2) {
+        capacity <<= 1;
+        SCM_ASSERT(capacity > 0);   /* overflow check */
+    }
+    Scm_AtomicStore(&ht->storage, (ScmAtomicWord)new_storage(capacity));
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        SCM_INTERNAL_MUTEX_INIT(ht->stripes[i].mutex);
+        Scm_AtomicStore(&ht->stripes[i].numEntries, 0);
+        Scm_AtomicStore(&ht->stripes[i].numUsed, 0);
+    }
+    return SCM_OBJ(ht);
+}
+
+/*
+ * Hashing
+ *
+ *   The hash value stored in the entry header has its LSB set.  The
+ *   probing index and the stripe are taken from the mixed bits of it,
+ *   for the hash functions of hash cores (e.g. address hash) leave
+ *   their lower bits poorly distributed.
+ */
+
+static inline u_long chash_hash(ScmConcurrentHashTable *ht, ScmObj key)
+{
+    if (ht->type == SCM_HASH_STRING && !SCM_STRINGP(key)) {
+        Scm_Error("string required, but got %S", key);
+    }
+    return ht->hashfn(NULL, (intptr_t)key) | 1;
+}
+
+static inline u_long chash_mix(u_long h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bUL;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35UL;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline ScmConcurrentHashStripe *chash_stripe(ScmConcurrentHashTable *ht,
+                                                    u_long hashval)
+{
+    return &ht->stripes[(chash_mix(hashval) >> 24) & (NUM_STRIPES-1)];
+}
+
+/* Look for KEY in ST.  Returns the index of the entry that has KEY
+   (which may be a tombstone), or -1 if not found.  If EMPTY isn't NULL,
+   the index of the unused entry that terminated probing is stored in
+   it (-1 if we've gone through the whole storage). */
+static long chash_probe(ScmConcurrentHashTable *ht,
+                        ScmConcurrentHashStorage *st,
+                        ScmObj key, u_long hashval, long *empty)
+{
+    u_long mask = st->capacity - 1;
+    u_long i = chash_mix(hashval) & mask;
+
+    if (empty) *empty = -1;
+    for (u_long n = 0; n < st->capacity; n++, i = (i+1) & mask) {
+        ScmAtomicWord hdr = Scm_AtomicLoad(ENTRY_HEADER(st, i));
+        if (hdr == 0) {
+            if (empty) *empty = (long)i;
+            return -1;
+        }
+        if (hdr != (ScmAtomicWord)hashval) continue;
+        ScmObj k = SCM_OBJ(Scm_AtomicLoad(ENTRY_KEY(st, i)));
+        if (ht->cmpfn(NULL, (intptr_t)key, (intptr_t)k)) return (long)i;
+    }
+    return -1;
+}
+
+static ScmObj chash_get(ScmConcurrentHashTable *ht, ScmObj key)
+{
+    u_long hashval = chash_hash(ht, key);
+    ScmConcurrentHashStorage *st = get_storage(ht);
+    long i = chash_probe(ht, st, key, hashval, NULL);
+    if (i < 0) return SCM_UNBOUND;
+    return SCM_OBJ(Scm_AtomicLoad(ENTRY_VALUE(st, i)));
+}
+
+ScmObj Scm_ConcurrentHashTableRef(ScmConcurrentHashTable *ht,
+                                  ScmObj key, ScmObj fallback)
+{
+    ScmObj v = chash_get(ht, key);
+    return SCM_UNBOUNDP(v)? fallback : v;
+}
+
+/*
+ * Locking
+ */
+
+static void lock_all(ScmConcurrentHashTable *ht)
+{
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        SCM_INTERNAL_MUTEX_LOCK(ht->stripes[i].mutex);
+    }
+}
+
+static void unlock_all(ScmConcurrentHashTable *ht)
+{
+    for (int i = NUM_STRIPES-1; i >= 0; i--) {
+        SCM_INTERNAL_MUTEX_UNLOCK(ht->stripes[i].mutex);
+    }
+}
+
+static ScmSmallInt count_stripes(ScmConcurrentHashTable *ht, int used)
+{
+    ScmSmallInt n = 0;
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        if (used) n += (ScmSmallInt)Scm_AtomicLoad(&ht->stripes[i].numUsed);
+        else      n += (ScmSmallInt)Scm_AtomicLoad(&ht->stripes[i].numEntries);
+    }
+    return n;
+}
+
+static inline int overloaded(ScmConcurrentHashTable *ht,
+                             ScmConcurrentHashStorage *st)
+{
+    return (u_long)count_stripes(ht, TRUE) > st->capacity/4*3;
+}
+
+/* Rebuild the storage.  Must be called without holding any stripe lock.
+   OLD is the storage the caller found overloaded; if someone else has
+   already rebuilt it, we do nothing. */
+static void chash_rebuild(ScmConcurrentHashTable *ht,
+                          ScmConcurrentHashStorage *old)
+{
+    lock_all(ht);
+    ScmConcurrentHashStorage *st = get_storage(ht);
+    if (st != old) {
+        unlock_all(ht);
+        return;
+    }
+
+    /* Keep the load factor under 1/2 after rebuilding.  If the storage
+       is mostly filled with tombstones, we may not need to expand. */
+    u_long live = (u_long)count_stripes(ht, FALSE);
+    u_long capacity = MIN_CAPACITY;
+    while (capacity < (live+1)*2) {
+        capacity <<= 1;
+        SCM_ASSERT(capacity > 0);   /* overflow check */
+    }
+    ScmConcurrentHashStorage *nst = new_storage(capacity);
+    u_long mask = capacity - 1;
+
+    /* Nobody can write to ST while we're holding all the locks, and
+       nobody can see NST until we publish it.  Since hash values are
+       cached in the headers, we don't need to call hashfn or cmpfn
+       here; it can't raise an error. */
+    for (u_long i = 0; i < st->capacity; i++) {
+        ScmAtomicWord hdr = Scm_AtomicLoad(ENTRY_HEADER(st, i));
+        if (!HEADER_VALID_P(hdr)) continue;
+        ScmAtomicWord v = Scm_AtomicLoad(ENTRY_VALUE(st, i));
+        if (SCM_UNBOUNDP(SCM_OBJ(v))) continue;
+        u_long j = chash_mix((u_long)hdr) & mask;
+        while (Scm_AtomicLoad(ENTRY_HEADER(nst, j)) != 0) j = (j+1) & mask;
+        Scm_AtomicStore(ENTRY_KEY(nst, j), Scm_AtomicLoad(ENTRY_KEY(st, i)));
+        Scm_AtomicStore(ENTRY_VALUE(nst, j), v);
+        Scm_AtomicStore(ENTRY_HEADER(nst, j), hdr);
+    }
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        Scm_AtomicStore(&ht->stripes[i].numUsed,
+                        Scm_AtomicLoad(&ht->stripes[i].numEntries));
+    }
+    Scm_AtomicStoreFull(&ht->storage, (ScmAtomicWord)nst);
+    unlock_all(ht);
+}
+
+/*
+ * Modification
+ *
+ *   All the modifying operations go through chash_modify.
+ */
+
+enum {
+    MOD_SET,                    /* set value, honoring SCM_DICT_* flags */
+    MOD_CAS                     /* set value iff the old one is EXPECTED */
+};
+
+enum {
+    MOD_DONE,                   /* done */
+    MOD_DONE_OVERLOADED,        /* done, but the storage should be rebuilt */
+    MOD_FAILED,                 /* condition isn't met; no change */
+    MOD_FULL                    /* no room; rebuild and retry */
+};
+
+/* Returns the index of the first unused entry after the unused entry
+   FROM has been taken by a writer of another stripe, or -1 if there's
+   none.  We don't need to compare keys on the way; an entry of the same
+   hash value can only be placed before the first unused entry, since
+   unused entries never come back while the storage is in use. */
+static long chash_next_unused(ScmConcurrentHashStorage *st, long from)
+{
+    u_long mask = st->capacity - 1;
+    u_long i = ((u_long)from + 1) & mask;
+    for (u_long n = 1; n < st->capacity; n++, i = (i+1) & mask) {
+        if (Scm_AtomicLoad(ENTRY_HEADER(st, i)) == 0) return (long)i;
+    }
+    return -1;
+}
+
+/* Called while holding the stripe lock.  I and EMPTY are the result of
+   chash_probe on ST, which must still be valid.  NEWVAL being SCM_UNBOUND
+   means deletion.  The previous value (or SCM_UNBOUND) is stored in
+   *OLDVAL. */
+static int chash_modify_locked(ScmConcurrentHashTable *ht,
+                               ScmConcurrentHashStorage *st,
+                               ScmConcurrentHashStripe *stripe,
+                               ScmObj key, u_long hashval,
+                               long i, long empty,
+                               int op, int flags,
+                               ScmObj expected, ScmObj newval,
+                               ScmObj *oldval)
+{
+    ScmObj old = (i < 0)? SCM_UNBOUND : SCM_OBJ(Scm_AtomicLoad(ENTRY_VALUE(st, i)));
+    *oldval = old;
+
+    if (op == MOD_CAS) {
+        if (!SCM_EQ(old, expected)) return MOD_FAILED;
+    } else {
+        if ((flags & SCM_DICT_NO_OVERWRITE) && !SCM_UNBOUNDP(old))
+            return MOD_FAILED;
+        if ((flags & SCM_DICT_NO_CREATE) && SCM_UNBOUNDP(old))
+            return MOD_FAILED;
+    }
+
+    if (SCM_UNBOUNDP(newval)) {
+        /* Deletion.  We leave the entry as a tombstone. */
+        if (!SCM_UNBOUNDP(old)) {
+            Scm_AtomicStore(ENTRY_VALUE(st, i), (ScmAtomicWord)SCM_UNBOUND);
+            Scm_AtomicStore(&stripe->numEntries,
+                            Scm_AtomicLoad(&stripe->numEntries) - 1);
+        }
+        return MOD_DONE;
+    }
+
+    if (i >= 0) {
+        Scm_AtomicStore(ENTRY_VALUE(st, i), (ScmAtomicWord)newval);
+        if (SCM_UNBOUNDP(old)) {
+            Scm_AtomicStore(&stripe->numEntries,
+                            Scm_AtomicLoad(&stripe->numEntries) + 1);
+        }
+        return MOD_DONE;
+    }
+
+    /* New entry.  The writers of other stripes may race for the same
+       unused entry. */
+    for (;;) {
+        if (empty < 0) return MOD_FULL;
+        ScmAtomicWord e = 0;
+        if (Scm_AtomicCompareExchange(ENTRY_HEADER(st, empty), &e,
+                                      (ScmAtomicWord)Scm_VM())) {
+            break;
+        }
+        empty = chash_next_unused(st, empty);
+    }
+    Scm_AtomicStore(ENTRY_KEY(st, empty), (ScmAtomicWord)key);
+    Scm_AtomicStore(ENTRY_VALUE(st, empty), (ScmAtomicWord)newval);
+    Scm_AtomicStoreFull(ENTRY_HEADER(st, empty), (ScmAtomicWord)hashval);
+    Scm_AtomicStore(&stripe->numEntries,
+                    Scm_AtomicLoad(&stripe->numEntries) + 1);
+    Scm_AtomicStore(&stripe->numUsed,
+                    Scm_AtomicLoad(&stripe->numUsed) + 1);
+    return overloaded(ht, st)? MOD_DONE_OVERLOADED : MOD_DONE;
+}
+
+static int chash_modify(ScmConcurrentHashTable *ht, ScmObj key,
+                        int op, int flags, ScmObj expected, ScmObj newval,
+                        ScmObj *oldval)
+{
+    u_long hashval = chash_hash(ht, key);
+    ScmConcurrentHashStripe *stripe = chash_stripe(ht, hashval);
+    ScmConcurrentHashStorage *st;
+    long i, empty;
+    int r;
+
+    for (;;) {
+        if (ht->type == SCM_HASH_EQUAL) {
+            /* equal? may call object-equal? method, which can take
+               arbitrary time, raise an error, or even touch this table.
+               So we probe without the lock, then make sure nothing
+               that affects the result has changed after locking.
+               The key of a found entry never changes while the storage
+               is in use.  A new entry of this key can only be added by
+               a writer of this stripe, which bumps numUsed; the counter
+               is only reset when the storage is replaced. */
+            ScmConcurrentHashStorage *st0 = get_storage(ht);
+            ScmAtomicWord used = Scm_AtomicLoad(&stripe->numUsed);
+            i = chash_probe(ht, st0, key, hashval, &empty);
+            SCM_INTERNAL_MUTEX_LOCK(stripe->mutex);
+            st = get_storage(ht);
+            if (st != st0
+                || (i < 0 && Scm_AtomicLoad(&stripe->numUsed) != used)) {
+                SCM_INTERNAL_MUTEX_UNLOCK(stripe->mutex);
+                continue;
+            }
+        } else {
+            SCM_INTERNAL_MUTEX_LOCK(stripe->mutex);
+            st = get_storage(ht);
+            i = chash_probe(ht, st, key, hashval, &empty);
+        }
+        r = chash_modify_locked(ht, st, stripe, key, hashval, i, empty,
+                                op, flags, expected, newval, oldval);
+        SCM_INTERNAL_MUTEX_UNLOCK(stripe->mutex);
+
+        if (r != MOD_FULL) break;
+        chash_rebuild(ht, st);
+    }
+    if (r == MOD_DONE_OVERLOADED) {
+        chash_rebuild(ht, st);
+        r = MOD_DONE;
+    }
+    return r;
+}
+
+ScmObj Scm_ConcurrentHashTableSet(ScmConcurrentHashTable *ht,
+                                  ScmObj key, ScmObj value, int flags)
+{
+    ScmObj oldval;
+    SCM_ASSERT(!SCM_UNBOUNDP(value));
+    chash_modify(ht, key, MOD_SET, flags, SCM_UNBOUND, value, &oldval);
+    return oldval;
+}
+
+ScmObj Scm_ConcurrentHashTableDelete(ScmConcurrentHashTable *ht, ScmObj key)
+{
+    ScmObj oldval;
+    chash_modify(ht, key, MOD_SET, 0, SCM_UNBOUND, SCM_UNBOUND, &oldval);
+    return oldval;
+}
+
+int Scm_ConcurrentHashTableCompareAndSwap(ScmConcurrentHashTable *ht,
+                                          ScmObj key,
+                                          ScmObj expected,
+                                          ScmObj newval)
+{
+    ScmObj oldval;
+    return chash_modify(ht, key, MOD_CAS, 0, expected, newval, &oldval)
+        == MOD_DONE;
+}
+
+void Scm_ConcurrentHashTableClear(ScmConcurrentHashTable *ht)
+{
+    ScmConcurrentHashStorage *nst = new_storage(MIN_CAPACITY);
+    lock_all(ht);
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        Scm_AtomicStore(&ht->stripes[i].numEntries, 0);
+        Scm_AtomicStore(&ht->stripes[i].numUsed, 0);
+    }
+    Scm_AtomicStoreFull(&ht->storage, (ScmAtomicWord)nst);
+    unlock_all(ht);
+}
+
+ScmSmallInt Scm_ConcurrentHashTableNumEntries(ScmConcurrentHashTable *ht)
+{
+    /* The sum may be transiently off while other threads are modifying
+       the table, but it never goes negative. */
+    ScmSmallInt n = count_stripes(ht, FALSE);
+    return (n < 0)? 0 : n;
+}
+
+/*
+ * Iteration
+ *
+ *   We just walk the storage we see at the beginning, without locking.
+ */
+
+enum {
+    COLLECT_KEYS,
+    COLLECT_VALUES,
+    COLLECT_PAIRS
+};
+
+static ScmObj chash_collect(ScmConcurrentHashTable *ht, int what)
+{
+    ScmConcurrentHashStorage *st = get_storage(ht);
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (u_long i = 0; i < st->capacity; i++) {
+        ScmAtomicWord hdr = Scm_AtomicLoad(ENTRY_HEADER(st, i));
+        if (!HEADER_VALID_P(hdr)) continue;
+        ScmObj k = SCM_OBJ(Scm_AtomicLoad(ENTRY_KEY(st, i)));
+        ScmObj v = SCM_OBJ(Scm_AtomicLoad(ENTRY_VALUE(st, i)));
+        if (SCM_UNBOUNDP(v)) continue;
+        switch (what) {
+        case COLLECT_KEYS:   SCM_APPEND1(h, t, k); break;
+        case COLLECT_VALUES: SCM_APPEND1(h, t, v); break;
+        default:             SCM_APPEND1(h, t, Scm_Cons(k, v)); break;
+        }
+    }
+    return h;
+}
+
+ScmObj Scm_ConcurrentHashTableKeys(ScmConcurrentHashTable *ht)
+{
+    return chash_collect(ht, COLLECT_KEYS);
+}
+
+ScmObj Scm_ConcurrentHashTableValues(ScmConcurrentHashTable *ht)
+{
+    return chash_collect(ht, COLLECT_VALUES);
+}
+
+ScmObj Scm_ConcurrentHashTableToAlist(ScmConcurrentHashTable *ht)
+{
+    return chash_collect(ht, COLLECT_PAIRS);
+}
+
+static void chash_print(ScmObj obj, ScmPort *port,
+                        ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmConcurrentHashTable *ht = SCM_CONCURRENT_HASH_TABLE(obj);
+    const char *str = "";
+
+    switch (ht->type) {
+    case SCM_HASH_EQ:      str = "eq"; break;
+    case SCM_HASH_EQV:     str = "eqv"; break;
+    case SCM_HASH_EQUAL:   str = "equal"; break;
+    case SCM_HASH_STRING:  str = "string"; break;
+    default: Scm_Panic("something wrong with a concurrent hash table");
+    }
+
+    Scm_Printf(port, "#<concurrent-hash-table %s[%ld] @%p>", str,
+               Scm_ConcurrentHashTableNumEntries(ht), ht);
+}
+
+/*
+ * initialization
+ */
+
+void Scm__InitConcurrentHashTable(void)
+{
+    ScmModule *mod = Scm_GaucheModule();
+    Scm_InitStaticClass(&Scm_ConcurrentHashTableClass,
+                        "<concurrent-hash-table>", mod, NULL, 0);
+}
@@ -36,6 +36,7 @@
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
 #include "gauche/priv/configP.h"
+#include "gauche/priv/atomicP.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/classP.h"
 #include "gauche/priv/identifierP.h"
@@ -191,9 +192,10 @@ static ScmObj key_generic        = SCM_FALSE;
 static ScmObj key_specializers   = SCM_FALSE;
 static ScmObj key_body           = SCM_FALSE;
 
-/* TRANSIENT: Global flag to disable generic dispatcher.  This is an escape
-   pod to fall back the default mechanism when we find a serious bug in
-   dispatch accelerator.  Can be turned on with a environment variable. */
+/* TRANSIENT: Global flag to disable generic dispatcher and method cache.
+   This is an escape pod to fall back the default mechanism when we find
+   a serious bug in dispatch accelerator.  Can be turned on with
+   a environment variable. */
 static int disable_generic_dispatcher = FALSE;
 
 /* A global lock to serialize class redefinition.  We need it since
@@ -2120,6 +2122,34 @@ static void generic_print(ScmObj obj, ScmPort *port,
 #endif
 }
 
+/* gf->dispatcher holds ScmGenericDispatch (see priv/dispatchP.h), or
+   NULL if neither a dispatcher nor a method cache has been made. */
+static inline ScmGenericDispatch *generic_dispatch(ScmGeneric *gf)
+{
+    return (ScmGenericDispatch*)Scm_AtomicLoad((ScmAtomicVar*)&gf->dispatcher);
+}
+
+/* Must be called while holding gf->lock. */
+static ScmGenericDispatch *ensure_generic_dispatch(ScmGeneric *gf)
+{
+    ScmGenericDispatch *d = (ScmGenericDispatch*)gf->dispatcher;
+    if (d == NULL) {
+        d = SCM_NEW(ScmGenericDispatch);
+        d->dispatcher = NULL;
+        d->cache = NULL;
+        Scm_AtomicStoreFull((ScmAtomicVar*)&gf->dispatcher, (ScmAtomicWord)d);
+    }
+    return d;
+}
+
+/* Must be called while holding gf->lock, after modifying gf->methods
+   or specializers of the methods. */
+static void invalidate_method_cache(ScmGeneric *gf)
+{
+    ScmGenericDispatch *d = (ScmGenericDispatch*)gf->dispatcher;
+    if (d && d->cache) Scm__MethodCacheInvalidate(d->cache);
+}
+
 /*
  * Accessors
  */
@@ -2166,6 +2196,7 @@ static void generic_methods_set(ScmGeneric *gf, ScmObj val)
     (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
     gf->methods = val;
     gf->maxReqargs = reqs;
+    invalidate_method_cache(gf);
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
 }
 
@@ -2251,10 +2282,11 @@ ScmObj Scm_ComputeApplicableMethods(ScmGeneric *gf, ScmObj *argv, int argc,
         }
     }
 
-    if (gf->dispatcher
+    ScmGenericDispatch *gd = generic_dispatch(gf);
+    ScmMethodDispatcher *dis = gd? gd->dispatcher : NULL;
+    if (dis
         && argc <= SCM_DISPATCHER_MAX_NARGS
         && argc >= 1) {
-        ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
         ScmObj p = Scm__MethodDispatcherLookup(dis, typev, argc);
         if (SCM_PAIRP(p)) methods = p;
     }
@@ -2418,6 +2450,51 @@ ScmObj Scm_SortMethods(ScmObj methods, ScmObj *argv, int argc)
     return Scm_ArrayToList(array, len);
 }
 
+/* Returns the list of applicable methods for ARGV, sorted by specificity.
+ * This is what VM needs to call a generic function, and the result is
+ * memoized in the method cache of gf, keyed by the number of arguments and
+ * the classes of arguments.  See dispatch.c for the details.
+ * Only for ordinary calls; for apply-style calls (the last element
+ * of ARGV is a list of rest arguments) VM takes the full path.
+ */
+ScmObj Scm__ComputeSortedMethods(ScmGeneric *gf, ScmObj *argv, int argc)
+{
+    ScmClass *typev[SCM_METHOD_CACHE_MAX_NARGS];
+    int nsel = (argc < gf->maxReqargs)? argc : gf->maxReqargs;
+
+    if (SCM_NULLP(gf->methods)) return SCM_NIL;
+    if (nsel > SCM_METHOD_CACHE_MAX_NARGS || disable_generic_dispatcher) {
+        ScmObj mm = Scm_ComputeApplicableMethods(gf, argv, argc, FALSE);
+        if (SCM_PAIRP(mm) && SCM_PAIRP(SCM_CDR(mm))) {
+            mm = Scm_SortMethods(mm, argv, argc);
+        }
+        return mm;
+    }
+
+    ScmGenericDispatch *gd = generic_dispatch(gf);
+    ScmMethodCache *cache = gd? gd->cache : NULL;
+    if (cache == NULL) {
+        ScmMethodCache *c = Scm__MakeMethodCache();
+        (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
+        gd = ensure_generic_dispatch(gf);
+        if (gd->cache == NULL) gd->cache = c;
+        cache = gd->cache;
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    }
+
+    for (int i=0; i<nsel; i++) typev[i] = Scm_ClassOf(argv[i]);
+    ScmWord gen;
+    ScmObj mm = Scm__MethodCacheLookup(cache, typev, nsel, argc, &gen);
+    if (!SCM_UNBOUNDP(mm)) return mm;
+
+    mm = Scm_ComputeApplicableMethods(gf, argv, argc, FALSE);
+    if (SCM_PAIRP(mm) && SCM_PAIRP(SCM_CDR(mm))) {
+        mm = Scm_SortMethods(mm, argv, argc);
+    }
+    Scm__MethodCacheAdd(cache, typev, nsel, argc, gen, mm);
+    return mm;
+}
+
 
 /* Developer API.  Accessible from Scheme via generic-build-dispatcher!
    If axis is out of range, we do nothing and returns #f.
@@ -2427,7 +2504,8 @@ ScmObj Scm__GenericBuildDispatcher(ScmGeneric *gf, int axis)
     if (!disable_generic_dispatcher
         && axis >= 0 && axis < SCM_DISPATCHER_MAX_NARGS) {
         (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
-        gf->dispatcher = Scm__BuildMethodDispatcher(gf->methods, axis);
+        ensure_generic_dispatch(gf)->dispatcher =
+            Scm__BuildMethodDispatcher(gf->methods, axis);
         (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
         return SCM_TRUE;
     } else {
@@ -2439,15 +2517,18 @@ ScmObj Scm__GenericBuildDispatcher(ScmGeneric *gf, int axis)
 void Scm__GenericInvalidateDispatcher(ScmGeneric *gf)
 {
     (void)SCM_INTERNAL_MUTEX_LOCK(gf->lock);
-    gf->dispatcher = NULL;
+    ScmGenericDispatch *gd = (ScmGenericDispatch*)gf->dispatcher;
+    if (gd) gd->dispatcher = NULL;
+    invalidate_method_cache(gf);
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
 }
 
 /* Developer API */
 ScmObj Scm__GenericDispatcherInfo(ScmGeneric *gf)
 {
-    if (gf->dispatcher) {
-        return Scm__MethodDispatcherInfo(gf->dispatcher);
+    ScmGenericDispatch *gd = generic_dispatch(gf);
+    if (gd && gd->dispatcher) {
+        return Scm__MethodDispatcherInfo(gd->dispatcher);
     } else {
         return SCM_FALSE;
     }
@@ -2456,9 +2537,10 @@ ScmObj Scm__GenericDispatcherInfo(ScmGeneric *gf)
 /* Developer API */
 void Scm__GenericDispatcherDump(ScmGeneric *gf, ScmPort *port)
 {
-    if (gf->dispatcher) {
+    ScmGenericDispatch *gd = generic_dispatch(gf);
+    if (gd && gd->dispatcher) {
         Scm_Printf(port, "%S's dispatcher:\n", gf);
-        Scm__MethodDispatcherDump((ScmMethodDispatcher*)gf->dispatcher, port);
+        Scm__MethodDispatcherDump(gd->dispatcher, port);
     } else {
         Scm_Printf(port, "%S doesn't have a dispatcher.\n", gf);
     }
@@ -2689,6 +2771,11 @@ static void method_specializers_set(ScmMethod *m, ScmObj val)
         m->specializers = NULL;
     else
         m->specializers = class_list_to_array(val, len);
+    if (m->generic) {
+        (void)SCM_INTERNAL_MUTEX_LOCK(m->generic->lock);
+        invalidate_method_cache(m->generic);
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(m->generic->lock);
+    }
 }
 
 /* update-direct-method! method old-class new-class
@@ -2716,9 +2803,10 @@ ScmObj Scm_UpdateDirectMethod(ScmMethod *m, ScmClass *old, ScmClass *newc)
     if (SCM_FALSEP(Scm_Memq(SCM_OBJ(m), newc->directMethods))) {
         newc->directMethods = Scm_Cons(SCM_OBJ(m), newc->directMethods);
     }
-    /* NB: For now, we just invalidate dispatcher.  Redefining class may
-       trigger massive update-direct-method! and it's inefficient to rebuild
-       dispatcher table for every invocation of it.
+    /* NB: For now, we just invalidate dispatcher (and method cache).
+       Redefining class may trigger massive update-direct-method! and
+       it's inefficient to rebuild dispatcher table for every invocation
+       of it.
      */
     Scm__GenericInvalidateDispatcher(m->generic);
     return SCM_OBJ(m);
@@ -2805,11 +2893,13 @@ ScmObj Scm_AddMethod(ScmGeneric *gf, ScmMethod *method)
         gf->common.typeHint = SCM_FALSE;
 #endif /*GAUCHE_API_VERSION >= 98*/
     }
-    if (gf->dispatcher && (method_locked == NULL)) {
-        ScmMethodDispatcher *dis = (ScmMethodDispatcher*)gf->dispatcher;
+    ScmGenericDispatch *gd = (ScmGenericDispatch*)gf->dispatcher;
+    if (gd && gd->dispatcher && (method_locked == NULL)) {
+        ScmMethodDispatcher *dis = gd->dispatcher;
         if (replaced) Scm__MethodDispatcherDelete(dis, replaced);
         Scm__MethodDispatcherAdd(dis, method);
     }
+    if (method_locked == NULL) invalidate_method_cache(gf);
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
 
     if (method_locked != NULL) {
@@ -2860,9 +2950,9 @@ ScmObj Scm_DeleteMethod(ScmGeneric *gf, ScmMethod *method)
             }
         }
     }
-    if (gf->dispatcher) {
-        Scm__MethodDispatcherDelete((ScmMethodDispatcher*)gf->dispatcher,
-                                    method);
+    ScmGenericDispatch *gd = (ScmGenericDispatch*)gf->dispatcher;
+    if (gd && gd->dispatcher) {
+        Scm__MethodDispatcherDelete(gd->dispatcher, method);
     }
     SCM_FOR_EACH(mp, gf->methods) {
         /* sync # of required selector */
@@ -2870,6 +2960,7 @@ ScmObj Scm_DeleteMethod(ScmGeneric *gf, ScmMethod *method)
             gf->maxReqargs = SCM_PROCEDURE_REQUIRED(SCM_CAR(mp));
         }
     }
+    invalidate_method_cache(gf);
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
     return SCM_UNDEFINED;
 }
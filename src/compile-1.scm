@@ -1991,8 +1991,11 @@
                            :allow-archive #t
                            :relative-dot-path #t)
       [(pseudo-path rest open-content)     ;archive hook is in effect
+       (%add-load-dependency! pseudo-path)
        (open-content pseudo-path)]
-      [(found-path rest) (open-input-file found-path :encoding #t)]
+      [(found-path rest)
+       (%add-load-dependency! found-path)
+       (open-input-file found-path :encoding #t)]
       [_ (error "Can't find the file to include: " path)])))
 
 ;; Report including.
@@ -2022,6 +2025,7 @@
        (when (and (eqv? situ SCM_VM_COMPILING)
                   (memq :compile-toplevel wlist)
                   (cenv-toplevel? cenv))
+         (%touch-modules)               ;compile-time effect
          (dolist [e expr] (eval e (cenv-module cenv))))
        (if (or (and (eqv? situ SCM_VM_LOADING)
                     (memq :load-toplevel wlist)
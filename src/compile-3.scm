@@ -70,7 +70,7 @@
         (if (and (label-dic-info label-dic)
                  (< count *max-pass3-repetition*))
           (loop iform. (+ count 1))
-          iform.)))))
+          (pass3/specialize iform.))))))
 
 (define (pass3-dump iform count)
   (format #t "~78,,,'=a\n" #"pass3 #~count ")
@@ -500,3 +500,221 @@
 
 ;; Dispatch table.
 (define *pass3-dispatch-table* (generate-dispatch-table pass3))
+
+;;
+;; Flonum specialization
+;;
+
+;; After inlining settles, we infer the numeric type of local variables
+;; and replace generic arithmetic whose operands are proven to be flonums
+;; with FLADD2 etc., which skip the runtime type dispatch.  Combined with
+;; the flonum register of the VM, a loop doing flonum arithmetic runs
+;; without checking types at every step.
+;;
+;; The type of an expression is one of the following:
+;;
+;;   none   - yields no value (yet); e.g. a jump to the loop head.
+;;            This is also the initial type of tracked lvars.
+;;   fixnum - a fixnum constant.
+;;   flonum - always a flonum.
+;;   #f     - unknown.
+;;
+;; We only track lvars whose values all come from the nodes we can see;
+;; the ones bound by $LET, and the parameters of embedded local
+;; procedures (loops), whose values come from the 'embed' call and
+;; the 'jump' calls.  Other lvars are unknown.  Starting from 'none',
+;; we repeatedly join the types of the value sources until nothing changes.
+;;
+;; Note that we don't specialize fixnum arithmetic.  It can overflow,
+;; and we have no range information to omit the check.  The generic
+;; instructions check fixnums first anyway.
+
+;; Generic arithmetic instructions and their flonum-only counterpart.
+(define-constant *pass3/flonum-insns*
+  `((,NUMADD2  . ,FLADD2)
+    (,NUMSUB2  . ,FLSUB2)
+    (,NUMMUL2  . ,FLMUL2)
+    (,NUMDIV2  . ,FLDIV2)
+    (,NUMIADD2 . ,FLADD2)
+    (,NUMISUB2 . ,FLSUB2)
+    (,NUMIMUL2 . ,FLMUL2)
+    (,NUMIDIV2 . ,FLDIV2)))
+
+(define (pass3/specialize iform)
+  (if (vm-compiler-flag-no-specialize?)
+    iform
+    (let ([types (make-hash-table 'eq?)] ; tracked lvar -> type
+          [sources '()]                  ; ((lvar . iform) ...)
+          [asms '()]                     ; candidate $ASM nodes
+          [ok #t])
+      (define (add-source! lvar init)
+        (when (hash-table-contains? types lvar)
+          (push! sources (cons lvar init))))
+      (define (track! lvars inits)
+        (ifor-each2 (^[lv in]
+                      (hash-table-put! types lv 'none)
+                      (push! sources (cons lv in)))
+                    lvars inits))
+      (define (collect* iforms loops labels)
+        (ifor-each (^[x] (collect x loops labels)) iforms))
+      ;; LOOPS is a list of embedded $LAMBDAs we're in.
+      (define (collect iform loops labels)
+        (case/unquote
+         (iform-tag iform)
+         [($DEFINE) (collect ($define-expr iform) loops labels)]
+         [($LSET)   (add-source! ($lset-lvar iform) ($lset-expr iform))
+                    (collect ($lset-expr iform) loops labels)]
+         [($GSET)   (collect ($gset-expr iform) loops labels)]
+         [($IF)     (collect ($if-test iform) loops labels)
+                    (collect ($if-then iform) loops labels)
+                    (collect ($if-else iform) loops labels)]
+         [($LET)    (track! ($let-lvars iform) ($let-inits iform))
+                    (collect* ($let-inits iform) loops labels)
+                    (collect ($let-body iform) loops labels)]
+         [($RECEIVE)(collect ($receive-expr iform) loops labels)
+                    (collect ($receive-body iform) loops labels)]
+         [($LAMBDA) (collect ($lambda-body iform) '() labels)]
+         [($CLAMBDA) (collect* ($clambda-closures iform) loops labels)]
+         [($LABEL)  (unless (label-seen? labels iform)
+                      (label-push! labels iform)
+                      (collect ($label-body iform) loops labels))]
+         [($SEQ)    (collect* ($seq-body iform) loops labels)]
+         [($CALL)
+          (collect* ($call-args iform) loops labels)
+          (case ($call-flag iform)
+            [(embed)
+             (let1 lam ($call-proc iform)
+               (when (= ($lambda-optarg lam) 0)
+                 (track! ($lambda-lvars lam) ($call-args iform)))
+               (collect ($lambda-body lam) (cons lam loops) labels))]
+            [(jump)
+             (let1 lam ($call-proc ($call-proc iform))
+               (cond [(not (memq lam loops)) (set! ok #f)] ; shouldn't happen
+                     [(= ($lambda-optarg lam) 0)
+                      (ifor-each2 add-source!
+                                  ($lambda-lvars lam) ($call-args iform))]))]
+            [else (collect ($call-proc iform) loops labels)])]
+         [($ASM)    (when (assv (car ($asm-insn iform)) *pass3/flonum-insns*)
+                      (push! asms iform))
+                    (collect* ($asm-args iform) loops labels)]
+         [($CONS $APPEND $MEMV $EQ? $EQV?)
+                    (collect ($*-arg0 iform) loops labels)
+                    (collect ($*-arg1 iform) loops labels)]
+         [($VECTOR $LIST $LIST*) (collect* ($*-args iform) loops labels)]
+         [($LIST->VECTOR) (collect ($*-arg0 iform) loops labels)]
+         [($DYNENV) (collect ($dynenv-key iform) loops labels)
+                    (collect ($dynenv-value iform) loops labels)
+                    (collect ($dynenv-body iform) loops labels)]
+         [else #f]))
+
+      (collect iform '() (make-label-dic #f))
+      (when (and ok (pair? asms))
+        ;; Iterate until the types of tracked lvars are stable.  Since
+        ;; each update only moves an lvar upward in the lattice, this
+        ;; terminates.
+        (let loop ()
+          (let ([memo (make-hash-table 'eq?)]
+                [changed #f])
+            (dolist [s sources]
+              (let* ([old (hash-table-get types (car s))]
+                     [new (pass3/type-join old
+                                           (pass3/type-of (cdr s) types memo))])
+                (unless (eq? old new)
+                  (hash-table-put! types (car s) new)
+                  (set! changed #t))))
+            (when changed (loop))))
+        (let1 memo (make-hash-table 'eq?)
+          (dolist [node asms]
+            (pass3/specialize-asm node types memo))))
+      iform)))
+
+(define (pass3/type-join a b)
+  (cond [(eq? a 'none) b]
+        [(eq? b 'none) a]
+        [(eq? a b) a]
+        [else #f]))
+
+(define (pass3/type-of iform types memo)
+  (case/unquote
+   (iform-tag iform)
+   [($CONST) (let1 v ($const-value iform)
+               (cond [(flonum? v) 'flonum]
+                     [(fixnum? v) 'fixnum]
+                     [else #f]))]
+   [($LREF)  (hash-table-get types ($lref-lvar iform) #f)]
+   [($IF)    (pass3/type-join (pass3/type-of ($if-then iform) types memo)
+                              (pass3/type-of ($if-else iform) types memo))]
+   [($LET)   (pass3/type-of ($let-body iform) types memo)]
+   [($SEQ)   (and (pair? ($seq-body iform))
+                  (pass3/type-of (last ($seq-body iform)) types memo))]
+   [($LABEL) (or (hash-table-get memo iform #f)
+                 (begin
+                   (hash-table-put! memo iform 'none) ; guard against cycles
+                   (rlet1 t (pass3/type-of ($label-body iform) types memo)
+                     (hash-table-put! memo iform t))))]
+   [($CALL)  (case ($call-flag iform)
+               [(embed) (pass3/type-of ($lambda-body ($call-proc iform))
+                                       types memo)]
+               [(jump) 'none]
+               [else #f])]
+   [($ASM)   (pass3/asm-type iform types memo)]
+   [else #f]))
+
+;; Result type of arithmetic $ASM node.
+(define (pass3/asm-type iform types memo)
+  (define (numeric? t) (memq t '(flonum fixnum)))
+  (let1 code (car ($asm-insn iform))
+    (match ($asm-args iform)
+      [(x)
+       (and (eqv? code NEGATE)
+            (let1 tx (pass3/type-of x types memo)
+              (and (memq tx '(none flonum)) tx)))]
+      [(x y)
+       (let ([tx (pass3/type-of x types memo)]
+             [ty (pass3/type-of y types memo)])
+         (cond
+          [(memv code `(,FLADD2 ,FLSUB2 ,FLMUL2 ,FLDIV2))
+           (if (or (eq? tx 'none) (eq? ty 'none)) 'none 'flonum)]
+          [(not (assv code *pass3/flonum-insns*)) #f]
+          [(or (eq? tx 'none) (eq? ty 'none)) 'none]
+          [(not (and (numeric? tx) (numeric? ty))) #f]
+          [(memv code `(,NUMIADD2 ,NUMISUB2 ,NUMIMUL2 ,NUMIDIV2)) 'flonum]
+          [(and (eq? tx 'fixnum) (eq? ty 'fixnum)) #f]
+          [(eqv? code NUMMUL2)
+           ;; (* x 0) is exact 0, so the fixnum side must be a nonzero
+           ;; constant.
+           (and (or (eq? tx ty)
+                    (pass3/nonzero-fixnum-const? (if (eq? tx 'fixnum) x y)))
+                'flonum)]
+          [else 'flonum]))]
+      [_ #f])))
+
+(define (pass3/nonzero-fixnum-const? iform)
+  (and ($const? iform)
+       (fixnum? ($const-value iform))
+       (not (eqv? ($const-value iform) 0))))
+
+;; Rewrite arithmetic $ASM node to the flonum-only instruction if
+;; one operand is a flonum, and the other is a flonum or a fixnum constant
+;; that can be converted to a flonum beforehand.  We leave exact zero
+;; alone, since the generic operation treats it specially; e.g. (* x 0)
+;; is exact 0, and (+ -0.0 0) is -0.0.
+(define (pass3/specialize-asm iform types memo)
+  (define (flonum-arg? arg)
+    (eq? (pass3/type-of arg types memo) 'flonum))
+  (define (convertible-arg? arg)
+    (and ($const? arg)
+         (fixnum? ($const-value arg))
+         (not (eqv? ($const-value arg) 0))))
+  (define (convert arg)
+    (if (flonum-arg? arg) arg ($const (inexact ($const-value arg)))))
+  (and-let* ([p (assv (car ($asm-insn iform)) *pass3/flonum-insns*)]
+             [args ($asm-args iform)]
+             [ (length=? args 2) ]
+             [x (car args)]
+             [y (cadr args)]
+             [ (or (and (flonum-arg? x)
+                        (or (flonum-arg? y) (convertible-arg? y)))
+                   (and (flonum-arg? y) (convertible-arg? x))) ])
+    ($asm-insn-set! iform `(,(cdr p)))
+    ($asm-args-set! iform (list (convert x) (convert y)))))
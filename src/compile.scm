@@ -2266,6 +2266,8 @@
    (return (SCM_VM_COMPILER_FLAG_IS_SET (Scm_VM) SCM_COMPILE_NO_POST_INLINE_OPT)))
  (define-cproc vm-compiler-flag-no-lifting? () ::<boolean>
    (return (SCM_VM_COMPILER_FLAG_IS_SET (Scm_VM) SCM_COMPILE_NO_LIFTING)))
+ (define-cproc vm-compiler-flag-no-specialize? () ::<boolean>
+   (return (SCM_VM_COMPILER_FLAG_IS_SET (Scm_VM) SCM_COMPILE_NO_SPECIALIZE)))
 
  (define-enum SCM_COMPILE_NOINLINE_GLOBALS)
  (define-enum SCM_COMPILE_NOINLINE_LOCALS)
@@ -2277,6 +2279,7 @@
  (define-enum SCM_COMPILE_NOCOMBINE)
  (define-enum SCM_COMPILE_NO_POST_INLINE_OPT)
  (define-enum SCM_COMPILE_NO_LIFTING)
+ (define-enum SCM_COMPILE_NO_SPECIALIZE)
  (define-enum SCM_COMPILE_INCLUDE_VERBOSE)
  (define-enum SCM_COMPILE_NOINLINE_SETTERS)
  (define-enum SCM_COMPILE_NODISSOLVE_APPLY)
@@ -2287,7 +2290,7 @@
  ;; Set/get VM's current module info. (temporary)
  (define-cproc vm-current-module () (return (SCM_OBJ (-> (Scm_VM) module))))
  (define-cproc vm-set-current-module (mod::<module>) ::<void>
-   (set! (-> (Scm_VM) module) mod))
+   (Scm_SelectModule mod))
  )
 
 ;;============================================================
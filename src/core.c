@@ -71,6 +71,7 @@ extern void Scm__InitNumber(void);
 extern void Scm__InitChar(void);
 extern void Scm__InitClass(void);
 extern void Scm__InitMemoTable(void);
+extern void Scm__InitConcurrentHashTable(void);
 extern void Scm__InitList(void);
 extern void Scm__InitExceptions(void);
 extern void Scm__InitPort(void);
@@ -95,8 +96,10 @@ extern void Scm__InitNative(void);
 extern void Scm__InitNet(void);
 extern void Scm__InitNetAddr(void);
 extern void Scm__InitNetDb(void);
+extern void Scm__InitAio(void);
 extern void Scm__InitMutex(void);
 extern void Scm__InitThreads(void);
+extern void Scm__InitWorkDeque(void);
 
 extern void Scm_Init_libalpha(void);
 extern void Scm_Init_libbool(void);
@@ -117,6 +120,7 @@ extern void Scm_Init_libmisc(void);
 extern void Scm_Init_libmod(void);
 extern void Scm_Init_libnative(void);
 extern void Scm_Init_libnet(void);
+extern void Scm_Init_libaio(void);
 extern void Scm_Init_libnum(void);
 extern void Scm_Init_libobj(void);
 extern void Scm_Init_libproc(void);
@@ -137,6 +141,7 @@ extern void Scm_Init_libomega(void);
 extern void Scm__FinishModuleInitialization(void);
 
 static void finalizable(void);
+static void gc_event(GC_EventType e);
 static void init_cond_features(void);
 
 #ifdef GAUCHE_USE_PTHREADS
@@ -184,6 +189,7 @@ void Scm_Init(const char *signature)
     GC_set_oom_fn(oom_handler);
     GC_set_finalize_on_demand(TRUE);
     GC_set_finalizer_notifier(finalizable);
+    GC_set_on_collection_event(gc_event);
 
     /* Newer bdwgc delays spawning marker threads until the client creates
        first thread.  We can take advantage of parallel markers even with
@@ -216,6 +222,7 @@ void Scm_Init(const char *signature)
     CALL_INIT(Scm__InitChar);
     CALL_INIT(Scm__InitClass);
     CALL_INIT(Scm__InitMemoTable);
+    CALL_INIT(Scm__InitConcurrentHashTable);
     CALL_INIT(Scm__InitList);
     CALL_INIT(Scm__InitCollection);
     CALL_INIT(Scm__InitExceptions);
@@ -234,8 +241,10 @@ void Scm_Init(const char *signature)
     CALL_INIT(Scm__InitNet);
     CALL_INIT(Scm__InitNetAddr);
     CALL_INIT(Scm__InitNetDb);
+    CALL_INIT(Scm__InitAio);
     CALL_INIT(Scm__InitMutex);
     CALL_INIT(Scm__InitThreads);
+    CALL_INIT(Scm__InitWorkDeque);
 
     CALL_INIT(Scm_Init_libalpha);
     CALL_INIT(Scm_Init_libbool);
@@ -255,6 +264,7 @@ void Scm_Init(const char *signature)
     CALL_INIT(Scm_Init_libmod);
     CALL_INIT(Scm_Init_libnative);
     CALL_INIT(Scm_Init_libnet);
+    CALL_INIT(Scm_Init_libaio);
     CALL_INIT(Scm_Init_libnum);
     CALL_INIT(Scm_Init_libobj);
     CALL_INIT(Scm_Init_libproc);
@@ -398,6 +408,276 @@ void Scm_GCSentinel(void *obj, const char *name)
     Scm_RegisterFinalizer(SCM_OBJ(obj), gc_sentinel, (void*)name);
 }
 
+/*
+ * GC configuration.
+ *
+ * Parameters are set by -G command-line options of gosh (before GC is
+ * initialized) or gc-configure! (at runtime).  Most of the setters of
+ * bdwgc are unsynchronized, so we call them with the allocation lock.
+ */
+
+static size_t gc_max_heap_size = 0; /* bdwgc doesn't have the getter */
+
+typedef struct {
+    const char *name;
+    size_t value;
+} gc_param;
+
+static void *gc_set_param_locked(void *data)
+{
+    gc_param *p = (gc_param*)data;
+    if (strcmp(p->name, "free-space-divisor") == 0) {
+        GC_set_free_space_divisor((GC_word)p->value);
+    } else if (strcmp(p->name, "full-freq") == 0) {
+        GC_set_full_freq((int)p->value);
+    } else if (strcmp(p->name, "time-limit") == 0) {
+        GC_set_time_limit((unsigned long)p->value);
+    } else if (strcmp(p->name, "max-heap-size") == 0) {
+        GC_set_max_heap_size((GC_word)p->value);
+        gc_max_heap_size = p->value;
+    }
+    return NULL;
+}
+
+/* Returns SCM_GC_PARAM_OK, or SCM_GC_PARAM_UNKNOWN if NAME isn't a
+   known parameter, SCM_GC_PARAM_TOO_LATE if the parameter can't be
+   changed after GC is initialized, or SCM_GC_PARAM_BAD_VALUE.
+   This may be called before Scm_Init, so it shouldn't raise an error. */
+int Scm_GCSetParameter(const char *name, size_t value)
+{
+    if (strcmp(name, "markers") == 0) {
+#if defined(GC_THREADS)
+        if (GC_is_init_called()) return SCM_GC_PARAM_TOO_LATE;
+        GC_set_markers_count((unsigned)value);
+        return SCM_GC_PARAM_OK;
+#else  /*!GC_THREADS*/
+        return (value <= 1)? SCM_GC_PARAM_OK : SCM_GC_PARAM_BAD_VALUE;
+#endif /*!GC_THREADS*/
+    }
+    if (strcmp(name, "incremental") == 0) {
+        /* bdwgc can't turn incremental mode off. */
+        if (value == 0) {
+            return GC_is_incremental_mode()? SCM_GC_PARAM_TOO_LATE
+                : SCM_GC_PARAM_OK;
+        }
+        GC_enable_incremental();
+        return SCM_GC_PARAM_OK;
+    }
+    if (strcmp(name, "free-space-divisor") == 0
+        || strcmp(name, "full-freq") == 0
+        || strcmp(name, "time-limit") == 0
+        || strcmp(name, "max-heap-size") == 0) {
+        if (value == 0 && strcmp(name, "free-space-divisor") == 0) {
+            return SCM_GC_PARAM_BAD_VALUE;
+        }
+        if (value > INT_MAX && strcmp(name, "full-freq") == 0) {
+            return SCM_GC_PARAM_BAD_VALUE;
+        }
+        gc_param p = { name, value };
+        if (GC_is_init_called()) {
+            GC_call_with_alloc_lock(gc_set_param_locked, &p);
+        } else {
+            gc_set_param_locked(&p);
+        }
+        return SCM_GC_PARAM_OK;
+    }
+    return SCM_GC_PARAM_UNKNOWN;
+}
+
+static void *gc_get_params_locked(void *data)
+{
+    size_t *v = (size_t*)data;
+    v[0] = GC_get_free_space_divisor();
+    v[1] = GC_get_full_freq();
+    v[2] = GC_get_time_limit();
+    v[3] = gc_max_heap_size;
+    return NULL;
+}
+
+/* Returns ((:markers N) (:incremental BOOL) ...), like gc-stat. */
+ScmObj Scm_GCParameters(void)
+{
+    size_t v[4];
+    GC_call_with_alloc_lock(gc_get_params_locked, v);
+#if defined(GC_THREADS)
+    int markers = GC_get_parallel() + 1;
+#else
+    int markers = 1;
+#endif
+    return Scm_List(SCM_LIST2(SCM_MAKE_KEYWORD("markers"),
+                              SCM_MAKE_INT(markers)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("incremental"),
+                              SCM_MAKE_BOOL(GC_is_incremental_mode())),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("time-limit"),
+                              Scm_MakeIntegerU(v[2])),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("free-space-divisor"),
+                              Scm_MakeIntegerU(v[0])),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("full-freq"),
+                              Scm_MakeIntegerU(v[1])),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("max-heap-size"),
+                              Scm_MakeIntegerU(v[3])),
+                    NULL);
+}
+
+/*
+ * GC telemetry.
+ *
+ * bdwgc notifies us the progress of each collection.  The callback is
+ * called with the allocation lock held (even with the world stopped),
+ * so it only updates the counters; it must not allocate.
+ *
+ * A pause is the interval the world is stopped.  In incremental mode,
+ * a collection consists of several short pauses.  If the collector
+ * runs without stopping the world (single-threaded runtime), the whole
+ * collection counts as a pause.
+ *
+ * All times are in nanoseconds internally, and shown in microseconds.
+ */
+
+typedef struct gc_telemetry_rec {
+    /* current collection */
+    uint64_t start;
+    uint64_t markStart;
+    uint64_t stopStart;
+    int      paused;            /* world was stopped in this collection */
+
+    u_long   collections;
+    uint64_t totalTime;
+    uint64_t lastTime;
+    uint64_t markTime;
+    uint64_t lastMarkTime;
+
+    u_long   pauses;
+    uint64_t totalPause;
+    uint64_t lastPause;
+    uint64_t maxPause;
+    /* histogram[k] counts pauses in [2^(k-1), 2^k) microseconds;
+       histogram[0] counts pauses shorter than 1us, and the last
+       one counts all longer pauses. */
+    u_long   histogram[SCM_GC_PAUSE_HISTOGRAM_SIZE];
+} gc_telemetry_rec;
+
+static gc_telemetry_rec gc_telemetry;
+
+static uint64_t gc_clock(void)
+{
+    u_long sec, nsec;
+    Scm_ClockGetTimeMonotonic(&sec, &nsec);
+    return (uint64_t)sec * 1000000000 + nsec;
+}
+
+static void gc_record_pause(uint64_t t)
+{
+    uint64_t usec = t / 1000;
+    int k = 0;
+    while (usec > 0 && k < SCM_GC_PAUSE_HISTOGRAM_SIZE-1) {
+        usec >>= 1;
+        k++;
+    }
+    gc_telemetry.histogram[k]++;
+    gc_telemetry.pauses++;
+    gc_telemetry.totalPause += t;
+    gc_telemetry.lastPause = t;
+    if (t > gc_telemetry.maxPause) gc_telemetry.maxPause = t;
+}
+
+static void gc_event(GC_EventType e)
+{
+    uint64_t now = gc_clock();
+    switch (e) {
+    case GC_EVENT_START:
+        gc_telemetry.start = now;
+        gc_telemetry.paused = FALSE;
+        break;
+    case GC_EVENT_MARK_START:
+        gc_telemetry.markStart = now;
+        break;
+    case GC_EVENT_MARK_END:
+        if (gc_telemetry.markStart == 0) break;
+        gc_telemetry.lastMarkTime = now - gc_telemetry.markStart;
+        gc_telemetry.markTime += gc_telemetry.lastMarkTime;
+        gc_telemetry.markStart = 0;
+        break;
+    case GC_EVENT_PRE_STOP_WORLD:
+        gc_telemetry.stopStart = now;
+        break;
+    case GC_EVENT_POST_START_WORLD:
+        if (gc_telemetry.stopStart == 0) break;
+        gc_record_pause(now - gc_telemetry.stopStart);
+        gc_telemetry.stopStart = 0;
+        gc_telemetry.paused = TRUE;
+        break;
+    case GC_EVENT_END:
+        if (gc_telemetry.start == 0) break;
+        gc_telemetry.collections++;
+        gc_telemetry.lastTime = now - gc_telemetry.start;
+        gc_telemetry.totalTime += gc_telemetry.lastTime;
+        if (!gc_telemetry.paused) gc_record_pause(gc_telemetry.lastTime);
+        gc_telemetry.start = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+static void *gc_telemetry_copy(void *data)
+{
+    memcpy(data, &gc_telemetry, sizeof(gc_telemetry));
+    return NULL;
+}
+
+static void *gc_telemetry_clear(void *data SCM_UNUSED)
+{
+    /* Keep the state of the ongoing collection, if any. */
+    uint64_t start = gc_telemetry.start;
+    uint64_t markStart = gc_telemetry.markStart;
+    uint64_t stopStart = gc_telemetry.stopStart;
+    int paused = gc_telemetry.paused;
+    memset(&gc_telemetry, 0, sizeof(gc_telemetry));
+    gc_telemetry.start = start;
+    gc_telemetry.markStart = markStart;
+    gc_telemetry.stopStart = stopStart;
+    gc_telemetry.paused = paused;
+    return NULL;
+}
+
+#define USEC(t)  Scm_MakeIntegerU64((t)/1000)
+
+/* Returns ((:collections N) (:total-time USEC) ...), like gc-stat. */
+ScmObj Scm_GCTelemetry(void)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    gc_telemetry_rec st;
+    GC_call_with_alloc_lock(gc_telemetry_copy, &st);
+
+    ScmObj hist = Scm_MakeVector(SCM_GC_PAUSE_HISTOGRAM_SIZE, SCM_MAKE_INT(0));
+    for (int i=0; i<SCM_GC_PAUSE_HISTOGRAM_SIZE; i++) {
+        SCM_VECTOR_ELEMENT(hist, i) = Scm_MakeIntegerU(st.histogram[i]);
+    }
+
+#define ADD(key, val) \
+    SCM_APPEND1(h, t, SCM_LIST2(SCM_MAKE_KEYWORD(key), val))
+    ADD("collections",    Scm_MakeIntegerU(st.collections));
+    ADD("total-time",     USEC(st.totalTime));
+    ADD("last-time",      USEC(st.lastTime));
+    ADD("mark-time",      USEC(st.markTime));
+    ADD("last-mark-time", USEC(st.lastMarkTime));
+    ADD("pauses",         Scm_MakeIntegerU(st.pauses));
+    ADD("total-pause",    USEC(st.totalPause));
+    ADD("last-pause",     USEC(st.lastPause));
+    ADD("max-pause",      USEC(st.maxPause));
+    ADD("pause-histogram", hist);
+#undef ADD
+    return h;
+}
+
+#undef USEC
+
+void Scm_GCTelemetryReset(void)
+{
+    GC_call_with_alloc_lock(gc_telemetry_clear, NULL);
+}
+
 
 /*=============================================================
  * Finalization.  Scheme finalizers are added as NO_ORDER.
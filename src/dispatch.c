@@ -40,7 +40,8 @@
 /*
  * Method dispatch acceleration
  *
- *  gf->dispatcher may contain a structure that accelerates method dispatch.
+ *  gf->dispatcher points to ScmGenericDispatch (priv/dispatchP.h), whose
+ *  dispatcher field may contain a structure that accelerates method dispatch.
  *  The structure must be treated as opaque from other parts.
  *
  *  In the current implementation, we use special open-addressing hash table.
@@ -408,3 +409,125 @@ void Scm__MethodDispatcherDump(ScmMethodDispatcher *dis, ScmPort *port)
     Scm_Printf(port, "MethodDispatcher axis=%d\n", dis->axis);
     mhash_print((mhash*)dis->methodHash, port);
 }
+
+/*
+ * Method cache
+ *
+ *  Even without the dispatch accelerator, a call site of a generic
+ *  function tends to see the same few combinations of argument classes
+ *  over and over.  For each GF we keep a small table that maps
+ *  (<number-of-args>, <class-of-arg0>, ..., <class-of-argN>) to the
+ *  list of applicable methods already sorted by specificity, so that
+ *  such calls skip both compute-applicable-methods and sort-methods.
+ *  N is min(<number-of-args>, gf->maxReqargs), since classes of the
+ *  arguments beyond that don't affect the method selection.
+ *
+ *  The table is a tiny direct-mapped cache with SCM_METHOD_CACHE_SIZE
+ *  slots, probed at two adjacent slots.  Each slot holds an immutable
+ *  entry; an entry is created afresh and the slot pointer is swapped
+ *  atomically, so readers never lock.  A slot can be overwritten by
+ *  any other entry at any time---losing an entry only costs a slow path.
+ *
+ *  The cache must be invalidated whenever the result of method selection
+ *  can change: a method is added or deleted, or a specializer is modified
+ *  by class redefinition.  Instead of clearing the slots, we increment
+ *  the generation number of the cache, and the entries of older
+ *  generations are ignored.  The caller reads the generation before it
+ *  computes the methods, and gives it back to Scm__MethodCacheAdd,
+ *  so that the result computed from the old method list won't be
+ *  registered as the current one even if invalidation happens
+ *  in the middle.
+ *
+ *  Invalidation is done while holding the GF lock (in class.c).
+ */
+
+#define SCM_METHOD_CACHE_SIZE  8 /* must be power of 2 */
+
+typedef struct mcache_entry_rec {
+    ScmWord gen;
+    int argc;
+    int nsel;
+    ScmObj methods;
+    ScmClass *classes[SCM_METHOD_CACHE_MAX_NARGS];
+} mcache_entry;
+
+struct ScmMethodCacheRec {
+    ScmAtomicVar generation;
+    ScmAtomicVar slots[SCM_METHOD_CACHE_SIZE];
+};
+
+static inline u_long mcachefn(ScmClass **typev, int nsel, int argc)
+{
+    u_long h = argc;
+    for (int i=0; i<nsel; i++) {
+        h = h*31 + (SCM_WORD(typev[i]) >> 3);
+    }
+    return (h * 2654435761UL) >> 16;
+}
+
+static inline int mcache_entry_match(const mcache_entry *e, ScmWord gen,
+                                     ScmClass **typev, int nsel, int argc)
+{
+    if (e == NULL || e->gen != gen || e->argc != argc || e->nsel != nsel) {
+        return FALSE;
+    }
+    for (int i=0; i<nsel; i++) {
+        if (e->classes[i] != typev[i]) return FALSE;
+    }
+    return TRUE;
+}
+
+/* NB: The fields are all zero initially, so that the cache can be
+   published without barrier. */
+ScmMethodCache *Scm__MakeMethodCache(void)
+{
+    return SCM_NEW(ScmMethodCache);
+}
+
+/* Returns the cached method list, or SCM_UNBOUND if not found.
+   The current generation is stored in *gen, to be passed to
+   Scm__MethodCacheAdd. */
+ScmObj Scm__MethodCacheLookup(ScmMethodCache *c, ScmClass **typev,
+                              int nsel, int argc, ScmWord *gen)
+{
+    SCM_ASSERT(nsel <= SCM_METHOD_CACHE_MAX_NARGS);
+    ScmWord g = (ScmWord)Scm_AtomicLoad(&c->generation);
+    u_long j = mcachefn(typev, nsel, argc);
+    *gen = g;
+    for (int i=0; i<2; i++, j++) {
+        mcache_entry *e = (mcache_entry*)
+            Scm_AtomicLoad(&c->slots[j & (SCM_METHOD_CACHE_SIZE-1)]);
+        if (mcache_entry_match(e, g, typev, nsel, argc)) return e->methods;
+    }
+    return SCM_UNBOUND;
+}
+
+void Scm__MethodCacheAdd(ScmMethodCache *c, ScmClass **typev,
+                         int nsel, int argc, ScmWord gen, ScmObj methods)
+{
+    SCM_ASSERT(nsel <= SCM_METHOD_CACHE_MAX_NARGS);
+    u_long j = mcachefn(typev, nsel, argc);
+    u_long k = j & (SCM_METHOD_CACHE_SIZE-1);
+    /* Take the second slot if the first one is occupied by a valid entry
+       and the second one isn't. */
+    mcache_entry *e0 = (mcache_entry*)Scm_AtomicLoad(&c->slots[k]);
+    if (e0 && e0->gen == gen) {
+        u_long k1 = (j+1) & (SCM_METHOD_CACHE_SIZE-1);
+        mcache_entry *e1 = (mcache_entry*)Scm_AtomicLoad(&c->slots[k1]);
+        if (e1 == NULL || e1->gen != gen) k = k1;
+    }
+
+    mcache_entry *e = SCM_NEW(mcache_entry);
+    e->gen = gen;
+    e->argc = argc;
+    e->nsel = nsel;
+    e->methods = methods;
+    for (int i=0; i<nsel; i++) e->classes[i] = typev[i];
+    Scm_AtomicStoreFull(&c->slots[k], (ScmAtomicWord)e);
+}
+
+void Scm__MethodCacheInvalidate(ScmMethodCache *c)
+{
+    ScmWord g = (ScmWord)Scm_AtomicLoad(&c->generation);
+    Scm_AtomicStoreFull(&c->generation, (ScmAtomicWord)(g+1));
+}
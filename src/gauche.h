@@ -1734,6 +1734,20 @@ SCM_EXTERN void Scm_RegisterDL(void *data_start, void *data_end,
                                void *bss_start, void *bss_end);
 SCM_EXTERN void Scm_GCSentinel(void *obj, const char *name);
 
+/* GC configuration and telemetry */
+enum {
+    SCM_GC_PARAM_OK = 0,
+    SCM_GC_PARAM_UNKNOWN = -1,     /* unknown parameter name */
+    SCM_GC_PARAM_TOO_LATE = -2,    /* can't be changed at this point */
+    SCM_GC_PARAM_BAD_VALUE = -3
+};
+#define SCM_GC_PAUSE_HISTOGRAM_SIZE  24
+
+SCM_EXTERN int    Scm_GCSetParameter(const char *name, size_t value);
+SCM_EXTERN ScmObj Scm_GCParameters(void);
+SCM_EXTERN ScmObj Scm_GCTelemetry(void);
+SCM_EXTERN void   Scm_GCTelemetryReset(void);
+
 SCM_EXTERN ScmObj Scm_GetFeatures(void);
 SCM_EXTERN void   Scm_AddFeature(const char *feature, const char *mod);
 SCM_EXTERN void   Scm_DeleteFeature(const char *feature);
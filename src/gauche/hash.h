@@ -63,6 +63,10 @@ typedef u_long ScmHashProc(const ScmHashCore *hc, intptr_t key);
 typedef int    ScmHashCompareProc(const ScmHashCore *hc, intptr_t key,
                                   intptr_t entrykey);
 
+/* The core is an open-addressing table.  BUCKETS points to a record
+   private to hash.c, which holds the buckets and their control bytes;
+   see hash.c for the details.  NUMBUCKETS and NUMBUCKETSLOG2 are kept
+   for information. */
 struct ScmHashCoreRec {
     void **buckets;
     int numBuckets;
@@ -102,7 +106,7 @@ SCM_EXTERN void Scm_HashCoreClear(ScmHashCore *core);
 struct ScmHashIterRec {
     ScmHashCore *core;
     int   bucket;
-    void *next;
+    void *next;                 /* not used; kept for compatibility */
 };
 
 SCM_EXTERN void Scm_HashIterInit(ScmHashIter *iter, ScmHashCore *core);
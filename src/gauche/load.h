@@ -79,6 +79,9 @@ SCM_EXTERN ScmObj Scm_CurrentLoadHistory(void);
 SCM_EXTERN ScmObj Scm_CurrentLoadNext(void);
 SCM_EXTERN ScmObj Scm_CurrentLoadPort(void);
 
+SCM_EXTERN ScmObj Scm_CompileCacheDirectory(void);
+SCM_EXTERN void   Scm_SetCompileCacheDirectory(ScmObj dir);
+
 /*=================================================================
  * Load path management
  */
@@ -254,6 +254,9 @@ SCM_EXTERN ScmObj Scm_SocketBind(ScmSocket *s, ScmSockAddr *addr);
 SCM_EXTERN ScmObj Scm_SocketConnect(ScmSocket *s, ScmSockAddr *addr);
 SCM_EXTERN ScmObj Scm_SocketListen(ScmSocket *s, int backlog);
 SCM_EXTERN ScmObj Scm_SocketAccept(ScmSocket *s);
+SCM_EXTERN ScmObj Scm_MakeAcceptedSocket(ScmSocket *s, Socket newfd,
+                                         struct sockaddr *addr,
+                                         socklen_t addrlen);
 
 SCM_EXTERN ScmObj Scm_GetSockName(int fd);
 SCM_EXTERN ScmObj Scm_GetPeerName(int fd);
@@ -263,6 +266,7 @@ SCM_EXTERN ScmObj Scm_SocketGetPeerName(ScmSocket *s);
 SCM_EXTERN ScmObj Scm_SocketSend(ScmSocket *s, ScmObj msg, int flags);
 SCM_EXTERN ScmObj Scm_SocketSendTo(ScmSocket *s, ScmObj msg, ScmSockAddr *to, int flags);
 SCM_EXTERN ScmObj Scm_SocketSendMsg(ScmSocket *s, ScmObj msg, int flags);
+SCM_EXTERN ScmObj Scm_SocketSendV(ScmSocket *s, ScmObj msgs, int flags);
 SCM_EXTERN ScmObj Scm_SocketRecv(ScmSocket *s, int bytes, int flags);
 SCM_EXTERN ScmObj Scm_SocketRecvX(ScmSocket *s, ScmUVector *buf, int flags);
 SCM_EXTERN ScmObj Scm_SocketRecvFrom(ScmSocket *s, int bytes, int flags);
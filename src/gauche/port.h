@@ -440,6 +440,10 @@ SCM_EXTERN ScmObj Scm_ReadLineUnsafe(ScmPort *port);
 
 SCM_EXTERN ScmObj Scm_OpenFilePort(const char *path, int flags,
                                    int buffering, int perm);
+SCM_EXTERN ScmObj Scm_OpenMmapInputPort(const char *path);
+
+SCM_EXTERN ScmSize Scm_PortWritev(ScmPort *port, ScmObj bufs);
+SCM_EXTERN ScmSize Scm_PortSendfile(ScmPort *src, ScmPort *dst, ScmSize size);
 
 SCM_EXTERN ScmObj Scm_Stdin(void);
 SCM_EXTERN ScmObj Scm_Stdout(void);
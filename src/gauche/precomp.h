@@ -152,7 +152,23 @@ static inline ScmObj SCM_PC_NUMSUBI(ScmObj a, ScmSmallInt b)
     do {                                                \
         if ((n) >= (size))                              \
             Scm_Error("index out of range: %ld", (n));  \
-    } whlie (0)
+    } while (0)
+
+/*
+ * Global variable reference
+ *
+ *   GLOC is a static ScmGloc* looked up at the initialization.  If the
+ *   variable is defined later than the initialization (e.g. a forward
+ *   reference in the same module), it is still NULL; we look it up
+ *   again on the first access.
+ */
+
+#define SCM_PC_GLOC(gloc, mod, sym)                                     \
+    ((gloc) != NULL                                                     \
+     ? (gloc)                                                           \
+     : ((gloc) = Scm_FindBinding(SCM_MODULE(mod), SCM_SYMBOL(sym), 0)) != NULL \
+     ? (gloc)                                                           \
+     : (Scm_Error("unbound variable: %S", sym), NULL))
 
 /*
  * Precompiled code specific API
@@ -0,0 +1,165 @@
+/*
+ * priv/aioP.h - asynchronous I/O
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_PRIV_AIOP_H
+#define GAUCHE_PRIV_AIOP_H
+
+/* Completion-based asynchronous I/O (gauche.aio).
+
+   The client queues requests (read, write, accept and connect) to an
+   <aio-context>, then waits for their completion.  Each request is an
+   <aio-request> object, which carries the result and an arbitrary
+   client data.  A scheduler can keep a continuation or a task in the
+   client data to resume it when the I/O is done, so that many tasks can
+   wait on I/O with a single thread.
+
+   There are two backends.
+
+   - io_uring (Linux 5.6 and later).  Requests are put in the submission
+     queue and the kernel carries out the I/O.  The submission is
+     batched; the queued requests are passed to the kernel all at once
+     when the client waits, or explicitly submits them.
+
+   - epoll.  Used when io_uring isn't available at runtime (old kernels,
+     or the syscalls are blocked by seccomp).  A request waits for
+     the readiness of the fd, then it is carried out by the ordinary
+     syscall.  Regular files are always ready, so the requests on them
+     are carried out on the spot.
+
+   The memory of the buffers is written by the kernel asynchronously
+   with io_uring.  The context keeps all the requests it has accepted
+   until they complete, so that the buffers won't be collected.
+
+   A context isn't thread-safe.  It belongs to the thread that first
+   queues a request, waits or closes it; other threads get an error.
+ */
+
+#include "gauche/net.h"
+#include "gauche/priv/atomicP.h"
+
+#if defined(HAVE_SYS_EPOLL_H)
+#define SCM_AIO_AVAILABLE 1
+#endif
+
+#if defined(SCM_AIO_AVAILABLE) && defined(HAVE_LINUX_IO_URING_H) \
+    && defined(__GNUC__)
+#define SCM_AIO_URING 1
+#endif
+
+enum {
+    SCM_AIO_READ,
+    SCM_AIO_WRITE,
+    SCM_AIO_ACCEPT,
+    SCM_AIO_CONNECT
+};
+
+enum {
+    SCM_AIO_BACKEND_URING,
+    SCM_AIO_BACKEND_EPOLL
+};
+
+enum {
+    SCM_AIO_QUEUED,             /* not passed to the kernel yet */
+    SCM_AIO_INFLIGHT,           /* passed to the kernel / waiting for fd */
+    SCM_AIO_DONE
+};
+
+typedef struct ScmAioRequestRec ScmAioRequest;
+
+struct ScmAioRequestRec {
+    SCM_HEADER;
+    int op;                     /* SCM_AIO_READ etc. */
+    int state;                  /* SCM_AIO_QUEUED etc. */
+    int fd;
+    ScmObj target;              /* port, socket or fd given by the client */
+    ScmObj buffer;              /* uvector for read/write,
+                                   sockaddr for connect */
+    void *bufptr;               /* read/write region in the buffer */
+    size_t bufsize;
+    int64_t offset;             /* file offset, or -1 for the current pos */
+    ScmObj data;                /* client data */
+    ScmObj result;              /* #f until succeeded */
+    int error;                  /* errno if failed, 0 otherwise */
+    struct sockaddr_storage addrbuf; /* peer address for accept */
+    socklen_t addrlen;
+    ScmAioRequest *prev;        /* link in ctx->requests */
+    ScmAioRequest *next;
+    ScmAioRequest *fdnext;      /* epoll: other requests on the same fd */
+};
+
+SCM_CLASS_DECL(Scm_AioRequestClass);
+#define SCM_CLASS_AIO_REQUEST  (&Scm_AioRequestClass)
+#define SCM_AIO_REQUEST(obj)   ((ScmAioRequest*)(obj))
+#define SCM_AIO_REQUEST_P(obj) SCM_XTYPEP(obj, SCM_CLASS_AIO_REQUEST)
+
+typedef struct ScmAioContextRec {
+    SCM_HEADER;
+    int backend;                /* SCM_AIO_BACKEND_* */
+    int closed;
+    ScmAtomicVar owner;         /* ScmVM* that uses this context, or 0 */
+    ScmAioRequest *requests;    /* all requests not yet returned to
+                                   the client, doubly linked */
+    ScmSize numRequests;
+    ScmSize numQueued;          /* requests not passed to the kernel */
+    ScmObj completed;           /* completed requests not yet returned,
+                                   in reverse order */
+    void *uring;                /* backend specific data */
+    void *epoll;
+} ScmAioContext;
+
+SCM_CLASS_DECL(Scm_AioContextClass);
+#define SCM_CLASS_AIO_CONTEXT  (&Scm_AioContextClass)
+#define SCM_AIO_CONTEXT(obj)   ((ScmAioContext*)(obj))
+#define SCM_AIO_CONTEXT_P(obj) SCM_XTYPEP(obj, SCM_CLASS_AIO_CONTEXT)
+
+SCM_EXTERN ScmObj Scm_MakeAioContext(int entries, ScmObj backend);
+SCM_EXTERN void   Scm_AioContextClose(ScmAioContext *ctx);
+SCM_EXTERN ScmObj Scm_AioContextBackend(ScmAioContext *ctx);
+
+SCM_EXTERN ScmObj Scm_AioRead(ScmAioContext *ctx, ScmObj target,
+                              ScmUVector *buf, ScmSize start, ScmSize end,
+                              int64_t offset, ScmObj data);
+SCM_EXTERN ScmObj Scm_AioWrite(ScmAioContext *ctx, ScmObj target,
+                               ScmUVector *buf, ScmSize start, ScmSize end,
+                               int64_t offset, ScmObj data);
+SCM_EXTERN ScmObj Scm_AioAccept(ScmAioContext *ctx, ScmObj target,
+                                ScmObj data);
+SCM_EXTERN ScmObj Scm_AioConnect(ScmAioContext *ctx, ScmObj target,
+                                 ScmObj addr, ScmObj data);
+
+SCM_EXTERN int    Scm_AioSubmit(ScmAioContext *ctx);
+SCM_EXTERN ScmObj Scm_AioWait(ScmAioContext *ctx, long timeout_usec);
+
+SCM_EXTERN ScmObj Scm_AioRequestOp(ScmAioRequest *req);
+
+#endif /*GAUCHE_PRIV_AIOP_H*/
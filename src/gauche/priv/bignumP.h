@@ -83,7 +83,13 @@ SCM_EXTERN ScmObj Scm_BignumAsh(const ScmBignum *bx, int cnt);
 SCM_EXTERN ScmBignum *Scm_MakeBignumWithSize(int size, u_long init);
 SCM_EXTERN ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc,
                                              u_long coef, u_long c);
+SCM_EXTERN ScmBignum *Scm_BignumAccMultAddUIArray(ScmBignum *acc,
+                                                  u_long coef,
+                                                  const u_long *cs, int n);
 
 SCM_EXTERN void   Scm_BignumDump(const ScmBignum *b, ScmPort *out);
 
+/* For benchmarking */
+SCM_EXTERN void   Scm__BignumMulThresholds(int *kara, int *toom3, int *ntt);
+
 #endif /* GAUCHE_PRIV_BIGNUMP_H */
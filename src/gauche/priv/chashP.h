@@ -0,0 +1,168 @@
+/*
+ * priv/chashP.h - concurrent hash table
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_PRIV_CHASHP_H
+#define GAUCHE_PRIV_CHASHP_H
+
+#include "gauche/priv/atomicP.h"
+
+/* Concurrent hash table is a hash table that can be shared among
+   threads without external locking.  Unlike <hash-table>, which
+   requires the user to serialize all the accesses, it is designed for
+   read-mostly workload with occasional concurrent updates.
+
+   - Lookup never takes a lock.
+   - Updates are serialized per 'stripe'.  The stripe is chosen by the
+     hash value of the key, so updates of different keys rarely contend.
+   - Iteration (keys, values, ->alist) takes a snapshot.  It is weakly
+     consistent: An update that happens concurrently may or may not be
+     seen, but each entry is seen at most once with the value it had at
+     some point during the iteration.
+
+   Supported hash types are eq, eqv, equal and string.
+ */
+
+/* The storage is a flat array of open-addressed entries, probed linearly.
+
+            +-------------+
+    Entry > |   header    |
+            +-------------+
+            |     key     |
+            +-------------+
+            |    value    |
+            +-------------+
+
+   The header slot may be:
+
+     0..00   - Unused entry.  Terminates probing.
+     x..x1   - The hash value of the key, with LSB set.  Key is valid.
+     x..00   - Non zero entry with LSBs being 00.  This is a pointer to the
+               <thread> that is filling the entry.  Readers skip it.
+
+   Once the header becomes a hash value, the key of the entry never
+   changes as long as the storage is in use.  Deleting an entry sets
+   its value to SCM_UNBOUND; the entry remains as a tombstone, and
+   the key can be reused for the later insertion of the same key.
+
+  Lookup
+
+   - h = LOAD(storage), then probe from the index given by the hash value.
+       - hdr = LOAD(entry->header)
+       - if hdr == 0, probe failed.
+       - if hdr == hash value and key matches, LOAD(entry->value).
+         If it is SCM_UNBOUND, probe failed; otherwise found.
+       - otherwise, advance to the next entry.
+
+  Update
+
+   - Lock the stripe of the key, then LOAD(storage).
+   - Probe as in lookup.  If the key is found, STORE(entry->value).
+   - Otherwise, CAS(&entry->header, 0, Scm_VM()) on the first unused entry.
+     If it fails, another writer of another stripe has taken the entry;
+     move on to the next unused entry.  If it succeeds, store the key
+     and the value, then STORE(entry->header, hash value).
+
+   Since writers of the same key are serialized by the stripe lock,
+   there's at most one entry for each key in the storage.
+
+   For equal tables, comparing keys may run Scheme code (object-equal?),
+   so we don't do it while holding the lock.  We probe first, then lock
+   the stripe and check that neither the storage nor, if the key wasn't
+   found, the stripe's numUsed has changed; otherwise we unlock and retry.
+
+  Expansion
+
+   When the number of used entries (including tombstones) exceeds 3/4 of
+   the capacity, we lock all the stripes in order, copy the live entries
+   to a new storage, and swap the storage pointer.  Readers that have
+   loaded the old storage keep reading it, which is still consistent
+   at the moment of the swap.
+ */
+
+#define SCM_CONCURRENT_HASH_TABLE_NUM_STRIPES 32
+
+typedef struct ScmConcurrentHashStorageRec {
+    u_long capacity;            /* power of 2.  read only */
+    ScmAtomicVar *vec;          /* [capacity*3] */
+} ScmConcurrentHashStorage;
+
+/* The counters of a stripe are only modified by the thread holding
+   the stripe lock, but read by anyone. */
+typedef struct ScmConcurrentHashStripeRec {
+    ScmInternalMutex mutex;
+    ScmAtomicVar numEntries;    /* # of live entries */
+    ScmAtomicVar numUsed;       /* # of used entries, including tombstones */
+} ScmConcurrentHashStripe;
+
+/* Fields other than storage and stripes are read-only */
+typedef struct ScmConcurrentHashTableRec {
+    SCM_HEADER;
+    ScmHashType type;
+    ScmHashProc *hashfn;
+    ScmHashCompareProc *cmpfn;
+    ScmAtomicVar storage;       /* ScmConcurrentHashStorage* */
+    ScmConcurrentHashStripe stripes[SCM_CONCURRENT_HASH_TABLE_NUM_STRIPES];
+} ScmConcurrentHashTable;
+
+SCM_CLASS_DECL(Scm_ConcurrentHashTableClass);
+#define SCM_CLASS_CONCURRENT_HASH_TABLE   (&Scm_ConcurrentHashTableClass)
+#define SCM_CONCURRENT_HASH_TABLE(obj)    ((ScmConcurrentHashTable*)(obj))
+#define SCM_CONCURRENT_HASH_TABLE_P(obj)  \
+    SCM_ISA(obj, SCM_CLASS_CONCURRENT_HASH_TABLE)
+
+SCM_EXTERN ScmObj Scm_MakeConcurrentHashTable(ScmHashType type,
+                                              u_long initSize);
+
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableRef(ScmConcurrentHashTable *ht,
+                                             ScmObj key, ScmObj fallback);
+/* Set and Delete return the previous value, or SCM_UNBOUND if there
+   wasn't one.  Flags for Set are the same as Scm_HashTableSet. */
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableSet(ScmConcurrentHashTable *ht,
+                                             ScmObj key, ScmObj value,
+                                             int flags);
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableDelete(ScmConcurrentHashTable *ht,
+                                                ScmObj key);
+/* Atomically replaces the value of KEY with NEWVAL iff the current value
+   is EXPECTED.  SCM_UNBOUND as EXPECTED means the key must be absent,
+   and as NEWVAL means deleting the entry.  Returns TRUE on success. */
+SCM_EXTERN int    Scm_ConcurrentHashTableCompareAndSwap(ScmConcurrentHashTable *ht,
+                                                        ScmObj key,
+                                                        ScmObj expected,
+                                                        ScmObj newval);
+SCM_EXTERN void   Scm_ConcurrentHashTableClear(ScmConcurrentHashTable *ht);
+SCM_EXTERN ScmSmallInt Scm_ConcurrentHashTableNumEntries(ScmConcurrentHashTable *ht);
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableKeys(ScmConcurrentHashTable *ht);
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableValues(ScmConcurrentHashTable *ht);
+SCM_EXTERN ScmObj Scm_ConcurrentHashTableToAlist(ScmConcurrentHashTable *ht);
+
+#endif /*GAUCHE_PRIV_CHASHP_H*/
@@ -46,6 +46,10 @@ SCM_EXTERN void   Scm__GenericInvalidateDispatcher(ScmGeneric *gf);
 SCM_EXTERN ScmObj Scm__GenericDispatcherInfo(ScmGeneric *gf);
 SCM_EXTERN void   Scm__GenericDispatcherDump(ScmGeneric *gf, ScmPort *port);
 
+/* Called from VM to find the sorted applicable methods, using cache */
+SCM_EXTERN ScmObj Scm__ComputeSortedMethods(ScmGeneric *gf,
+                                            ScmObj *argv, int argc);
+
 
 /* A proxy type is a class to hold a reference to another class.
    It is used to keep reference to a type in another compound type
@@ -93,6 +93,15 @@ SCM_EXTERN ScmObj Scm_DecodePackedDebugInfo(const uint8_t *codeVector,
                                             ScmSmallInt codeSize,
                                             ScmVector *constVector);
 
+/* FASL - binary serialization of compiled code, used by the compile
+ * cache.  See serial.c.  The data mode is used by the binary serializer.
+ */
+SCM_EXTERN ScmObj Scm_FaslEncode(ScmObj obj);
+SCM_EXTERN ScmObj Scm_FaslRead(ScmPort *port);
+SCM_EXTERN ScmObj Scm_FaslVersion(void);
+SCM_EXTERN void   Scm_FaslWriteData(ScmObj obj, ScmPort *port, int shared);
+SCM_EXTERN ScmObj Scm_FaslReadData(ScmPort *port);
+
 SCM_DECL_END
 
 #endif /* GAUCHE_PRIV_CODEP_H */
@@ -52,4 +52,27 @@ ScmObj Scm__MethodDispatcherLookup(ScmMethodDispatcher *dis,
 ScmObj Scm__MethodDispatcherInfo(const ScmMethodDispatcher *dis);
 void   Scm__MethodDispatcherDump(ScmMethodDispatcher *dis, ScmPort *port);
 
+/* Method cache.  Keeps the sorted list of applicable methods for
+   recently seen tuples of argument classes.  We only cache when
+   the number of classes to look at is equal to or smaller than this. */
+#define SCM_METHOD_CACHE_MAX_NARGS  4
+
+typedef struct ScmMethodCacheRec ScmMethodCache;
+
+ScmMethodCache *Scm__MakeMethodCache(void);
+ScmObj Scm__MethodCacheLookup(ScmMethodCache *c, ScmClass **typev,
+                              int nsel, int argc, ScmWord *gen);
+void   Scm__MethodCacheAdd(ScmMethodCache *c, ScmClass **typev,
+                           int nsel, int argc, ScmWord gen, ScmObj methods);
+void   Scm__MethodCacheInvalidate(ScmMethodCache *c);
+
+/* The dispatcher slot of ScmGeneric points to this record.  It is
+   allocated on demand under gf->lock, and once set it is kept for the
+   life of the generic; only its fields change.  Keeping the method
+   cache here leaves the public layout of ScmGeneric intact. */
+typedef struct ScmGenericDispatchRec {
+    ScmMethodDispatcher *dispatcher; /* NULL unless built explicitly */
+    ScmMethodCache *cache;           /* NULL until first sorted lookup */
+} ScmGenericDispatch;
+
 #endif  /*GAUCHE_PRIV_DISPATCHP_H*/
@@ -42,4 +42,9 @@ SCM_EXTERN ScmObj Scm__MakeWrapperModule(ScmModule *origin, ScmObj prefix);
 
 SCM_EXTERN ScmGloc   *Scm__IdentifierToBoundGloc(ScmIdentifier*);
 
+/* Incremented whenever a module or a binding is created or changed,
+   or the current module is switched.  See module.c. */
+SCM_EXTERN u_long     Scm__ModuleStamp(void);
+SCM_EXTERN void       Scm__TouchModules(void);
+
 #endif /*GAUCHE_PRIV_MODULEP_H*/
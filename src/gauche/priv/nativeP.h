@@ -52,5 +52,6 @@ SCM_EXTERN ScmObj Scm__VMCallNative(ScmVM *vm,
                                     ScmObj rettype);
 
 SCM_EXTERN ScmObj Scm__AllocateCodePage(ScmU8Vector *code);
+SCM_EXTERN void  *Scm__AllocateJitCode(const void *code, size_t size);
 
 #endif /*GAUCHE_PRIV_NATIVEP_H*/
@@ -106,6 +106,11 @@ typedef struct ScmPortImplRec {
      */
     ScmObj link;
 
+    /* An object the source of the port depends on, kept here so that
+       it isn't collected while the port is alive.  Currently it is only
+       used for the memory region of a memory-mapped input port. */
+    ScmObj srcOwner;
+
     /* Flags for private use.  See below. */
     u_long internalFlags;
 } ScmPortImpl;
@@ -151,6 +156,8 @@ enum {
                                           data. */
     SCM_PORT_PROC_EXTDATA = (1L << 2), /* src.vt.data points to heap-allocated
                                           data. */
+    SCM_PORT_ISTR_MAPPED = (1L << 3),  /* src.istr points to a memory-mapped
+                                          file, which is srcOwner. */
 };
 
 #define PORT_FLUSHED_P(port)  (P_(port)->internalFlags & SCM_PORT_FLUSHED)
@@ -48,12 +48,19 @@ struct ScmRegexpRec {
     ScmObj grpNames;     /* list of names for named groups. */
     int numSets;         /* # of charsets in sets */
     int flags;           /* internal; CASE_FOLD, BOL_ANCHORED etc. */
-    ScmString *mustMatch;
+    ScmString *mustMatch; /* literal every match contains, or NULL. */
+    int mustOffset;      /* byte offset of mustMatch from the beginning of
+                            the match, or -1 if it varies. */
     ScmObj laset;        /* lookahead set (char-set) or #f.
                             If not #f, it represents the condition that can
                             match at the beginning of the regexp.  It can be
                             used to skip input start position when regexp
                             isn't BOL_ANCHORED. */
+    const u_char *firstBytes; /* 256-entry table of bytes a match can
+                            begin with, derived from laset, or NULL. */
+    void *pike;          /* Program for the Pike VM matcher, built when
+                            the regexp is compiled, or NULL if the regexp
+                            uses backtracking.  See regexp.c */
 };
 
 struct ScmRegMatchRec {
@@ -130,6 +130,23 @@ enum {
 
 #define SCM_STRING_BODY_HAS_INDEX(sb) ((sb)->index != NULL)
 
+/* Automatic indexing
+ *
+ *  A long multibyte string body gets an index automatically once it is
+ *  accessed by character index a few times (see index2ptr in string.c).
+ *  The access count is kept in the bits of the body flags above
+ *  SCM_STRING_FLAG_MASK, which are otherwise unused in a body.
+ */
+#define STRING_BODY_ACCESS_SHIFT   20
+#define STRING_BODY_ACCESS_UNIT    (1UL<<STRING_BODY_ACCESS_SHIFT)
+#define STRING_BODY_ACCESS_COUNT(sb) \
+    (((sb)->flags>>STRING_BODY_ACCESS_SHIFT) & 0x0f)
+
+#define STRING_AUTO_INDEX_MIN_SIZE   256   /* smaller ones are just scanned */
+#define STRING_AUTO_INDEX_EAGER_SIZE 4096  /* indexed on the first access */
+#define STRING_AUTO_INDEX_COUNT      4     /* # of accesses to be indexed */
+#define STRING_AUTO_INDEX_MIN_SCAN   32    /* shorter scans aren't counted */
+
 SCM_EXTERN void Scm_StringBodyBuildIndex(ScmStringBody *sb);
 SCM_EXTERN void Scm_StringBodyIndexDump(const ScmStringBody *sb, ScmPort *port);
 
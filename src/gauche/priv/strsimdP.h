@@ -0,0 +1,75 @@
+/*
+ * priv/strsimdP.h - vectorized string primitives
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GAUCHE_PRIV_STRSIMDP_H
+#define GAUCHE_PRIV_STRSIMDP_H
+
+/* Byte-level kernels for string operations.
+
+   These work on raw utf-8 octets and know nothing about string bodies;
+   string.c calls them for searching, scanning and counting characters.
+   On x86 they use SSE2, or AVX2 if the cpu supports it, which is
+   checked at runtime.  Elsewhere the scalar versions are used.
+
+   Scm__StringSimdLevel returns the current level, and Scm__SetStringSimdLevel
+   can lower it (e.g. to compare the kernels in benchmarks).  A level
+   the cpu doesn't support is capped to the supported one.
+ */
+
+enum {
+    SCM_STRING_SIMD_NONE,
+    SCM_STRING_SIMD_SSE2,
+    SCM_STRING_SIMD_AVX2
+};
+
+SCM_EXTERN int Scm__StringSimdLevel(void);
+SCM_EXTERN int Scm__SetStringSimdLevel(int level);
+
+/* Returns the byte offset of the first (or last) occurrence of the
+   octet sequence S2 in S1, or -1 if not found. */
+SCM_EXTERN ScmSmallInt Scm__ByteSearch(const char *s1, ScmSmallInt siz1,
+                                       const char *s2, ScmSmallInt siz2);
+SCM_EXTERN const char *Scm__MemRChr(const char *s, int c, ScmSmallInt siz);
+
+/* Number of characters in a valid utf-8 sequence, i.e. the number of
+   octets that are not continuation octets.  The result is meaningless
+   if the sequence isn't valid. */
+SCM_EXTERN ScmSmallInt Scm__CountChars(const char *s, ScmSmallInt siz);
+
+/* Validates S as utf-8 in Gauche's sense (up to 6-octet sequences,
+   no overlong forms) and returns the number of characters, or -1
+   if it isn't valid.  NUL is allowed. */
+SCM_EXTERN ScmSmallInt Scm__Utf8Length(const char *s, ScmSmallInt siz);
+
+#endif /*GAUCHE_PRIV_STRSIMDP_H*/
@@ -206,6 +206,66 @@ SCM_EXTERN int Scm_VMUndefinedBool(ScmVM*); /* in boolean.c */
 /* For machine-level introspection */
 SCM_EXTERN ScmObj Scm__VMInsnAddress(int, _Bool);
 
+/*
+ * Allocation cache
+ *
+ *   Pairs and flonums are by far the most frequently allocated objects,
+ *   and both fit in the same GC size class.  Each VM keeps a list of
+ *   free cells of that size, obtained in a batch by GC_malloc_many, so
+ *   that the VM can allocate them with a few instructions, without
+ *   taking the GC lock or calling the allocator.  The cells are linked
+ *   through their first word, which keeps them alive while they're in
+ *   the cache.
+ *
+ *   The cache must only be used by the thread running the VM.
+ */
+
+#define SCM_VM_CELL_SIZE  sizeof(ScmPair)
+
+SCM_EXTERN void *Scm__VMRefillCells(ScmVM *vm);
+SCM_EXTERN int   Scm__VMAllocCacheEnabled(int flag); /* for benchmark */
+SCM_EXTERN u_long Scm__VMJitThreshold(long threshold);  /* see vmjit.c */
+
+static inline void *Scm__VMAllocCell(ScmVM *vm)
+{
+    void *p = vm->cells;
+    if (p == NULL) p = Scm__VMRefillCells(vm);
+    vm->cells = *(void**)p;
+    *(void**)p = NULL;
+    vm->allocBytes += SCM_VM_CELL_SIZE;
+    return p;
+}
+
+static inline ScmObj Scm__VMMakeFlonum(ScmVM *vm, double d)
+{
+    ScmFlonum *f = (ScmFlonum*)Scm__VMAllocCell(vm);
+    SCM_FLONUM_VALUE(f) = d;
+    return SCM_MAKE_FLONUM_MEM(f);
+}
+
+/* Like SCM_FLONUM_ENSURE_MEM, but allocates from the cache.
+   This macro assumes the local variable VM holding ScmVM*. */
+#if GAUCHE_FFX
+#define SCM_VM_FLONUM_ENSURE_MEM(var)                           \
+    do {                                                        \
+        if (SCM_FLONUM_REG_P(var)) {                            \
+            var = Scm__VMMakeFlonum(vm, SCM_FLONUM_VALUE(var)); \
+        }                                                       \
+    } while (0)
+#else  /*!GAUCHE_FFX*/
+#define SCM_VM_FLONUM_ENSURE_MEM(var) /* empty */
+#endif /*!GAUCHE_FFX*/
+
+static inline ScmObj Scm__VMCons(ScmVM *vm, ScmObj car, ScmObj cdr)
+{
+    SCM_VM_FLONUM_ENSURE_MEM(car);
+    SCM_VM_FLONUM_ENSURE_MEM(cdr);
+    ScmPair *z = (ScmPair*)Scm__VMAllocCell(vm);
+    SCM_SET_CAR_UNCHECKED(z, car);
+    SCM_SET_CDR_UNCHECKED(z, cdr);
+    return SCM_OBJ(z);
+}
+
 /*
  * Thread Locals
  *   We keep the definition private, so that we can extend it later.
@@ -0,0 +1,92 @@
+/*
+ * priv/wsdequeP.h - work-stealing deque
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_PRIV_WSDEQUEP_H
+#define GAUCHE_PRIV_WSDEQUEP_H
+
+#include "gauche/priv/atomicP.h"
+
+/* Work-stealing deque is the building block of work-stealing schedulers.
+   Each worker thread owns one deque.  The owner pushes and pops items
+   at the bottom end (LIFO), while other threads steal items from the
+   top end (FIFO).  No operation takes a lock.
+
+   This is the algorithm of Chase and Lev, "Dynamic Circular Work-Stealing
+   Deque" (SPAA 2005).  Items live in a circular buffer indexed by
+   ever-increasing integers TOP and BOTTOM; the buffer holds items
+   in [TOP, BOTTOM).
+
+   - Only the owner modifies BOTTOM and the buffer pointer.
+   - Thieves (and the owner, when it takes the last item) advance TOP
+     by CAS.  The one that succeeds gets the item.
+   - When the buffer is full, the owner copies the items to a buffer
+     twice as large and swaps the pointer.  A thief that loaded the old
+     buffer still reads the right item, since the items in [TOP, BOTTOM)
+     are never overwritten in the old buffer.  GC reclaims the old buffer.
+
+   The owner is the first thread that pushes or pops.  Other threads
+   get an error if they try to push or pop.
+ */
+
+typedef struct ScmWorkDequeBufferRec {
+    u_long size;                /* power of 2.  read only */
+    ScmAtomicVar items[1];      /* [size] */
+} ScmWorkDequeBuffer;
+
+typedef struct ScmWorkDequeRec {
+    SCM_HEADER;
+    ScmObj name;                /* for information only */
+    ScmAtomicVar top;
+    ScmAtomicVar bottom;
+    ScmAtomicVar buffer;        /* ScmWorkDequeBuffer* */
+    ScmAtomicVar owner;         /* ScmVM*, or 0 */
+} ScmWorkDeque;
+
+SCM_CLASS_DECL(Scm_WorkDequeClass);
+#define SCM_CLASS_WORK_DEQUE   (&Scm_WorkDequeClass)
+#define SCM_WORK_DEQUE(obj)    ((ScmWorkDeque*)(obj))
+#define SCM_WORK_DEQUE_P(obj)  SCM_XTYPEP(obj, SCM_CLASS_WORK_DEQUE)
+
+SCM_EXTERN ScmObj Scm_MakeWorkDeque(ScmObj name);
+/* Owner only */
+SCM_EXTERN void   Scm_WorkDequePush(ScmWorkDeque *dq, ScmObj item);
+/* The following three return SCM_UNBOUND if the deque is empty.
+   Pop is owner only.  Steal may be called from any thread. */
+SCM_EXTERN ScmObj Scm_WorkDequePop(ScmWorkDeque *dq);
+SCM_EXTERN ScmObj Scm_WorkDequeSteal(ScmWorkDeque *dq);
+/* Returns the number of items at the moment.  It can be stale as soon
+   as it is returned, unless called by the owner and no thieves are
+   around. */
+SCM_EXTERN ScmSmallInt Scm_WorkDequeLength(ScmWorkDeque *dq);
+
+#endif /*GAUCHE_PRIV_WSDEQUEP_H*/
@@ -71,7 +71,8 @@
 */
 /* The 'index' slot may contain an index vector to realize O(1) random-access
  * of the string.  Building index costs time and space, so it is only
- * constructed when explicitly asked.  Srfi-135 (Immutable Texts) is
+ * constructed when explicitly asked, or when a long multibyte string is
+ * accessed by index repeatedly.  Srfi-135 (Immutable Texts) is
  * really an immutable string with an indexed body.
  * The user should treat index field as a opaque pointer.
  * See priv/stringP.h for the details.
@@ -304,6 +305,8 @@ SCM_EXTERN ScmObj  Scm_StringScan(ScmString *s1, ScmString *s2, int retmode);
 SCM_EXTERN ScmObj  Scm_StringScanChar(ScmString *s1, ScmChar ch, int retmode);
 SCM_EXTERN ScmObj  Scm_StringScanRight(ScmString *s1, ScmString *s2, int retmode);
 SCM_EXTERN ScmObj  Scm_StringScanCharRight(ScmString *s1, ScmChar ch, int retmode);
+SCM_EXTERN ScmObj  Scm_StringScanCharCursor(ScmString *s1, ScmChar ch,
+                                            ScmObj start, ScmObj end);
 
 /* "retmode" argument for string scan */
 enum {
@@ -585,6 +585,13 @@ struct ScmVMRec {
                                    appears in 'reset' and the end marker of
                                    partial continuation is set. */
 
+    /* Fields below are appended to keep the offsets of the above
+       fields intact.  They are private to the VM. */
+    void *cells;                /* Allocation cache for pairs and
+                                   flonums.  See priv/vmP.h. */
+    size_t allocBytes;          /* Bytes allocated from the cache in
+                                   this thread.  Unlike stat, this is
+                                   always counted.  */
 };
 
 SCM_EXTERN ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name);
@@ -768,10 +775,12 @@ enum {
     SCM_COMPILE_MUTABLE_LITERALS = (1L<<12),/* Literal pairs are mutable */
     SCM_COMPILE_SRFI_FEATURE_ID = (1L<<13), /* Allow srfi-N feature id in
                                                cond-expand */
-    SCM_COMPILE_NOINLINE_INLINER = (1L<<14)/* (internal) Do not invoke custom
+    SCM_COMPILE_NOINLINE_INLINER = (1L<<14),/* (internal) Do not invoke custom
                                               inliner and ASM inliners.
                                               hybrid macro is still expanded.
                                               used for macroexpand-all */
+    SCM_COMPILE_NO_SPECIALIZE = (1L<<15)   /* Do not specialize arithmetic
+                                              by inferred types (pass3). */
 };
 
 #define SCM_VM_COMPILER_FLAG_IS_SET(vm, flag) ((vm)->compilerFlags & (flag))
@@ -36,6 +36,7 @@
 #include "gauche.h"
 #include "gauche/priv/configP.h"
 #include "gauche/priv/atomicP.h"
+#include "gauche/bits_inline.h"
 
 /*============================================================
  * Internal structures
@@ -45,15 +46,25 @@
 typedef struct EntryRec {
     intptr_t key;
     intptr_t value;
-    struct EntryRec *next;
     u_long   hashval;
 } Entry;
 
-#define BUCKETS(hc)   ((Entry**)hc->buckets)
+/* The buckets, the control bytes and the size of the table are kept in
+   one record, which ScmHashCore's buckets field points to.  Rehashing
+   replaces the whole record at once; see the note on lock-free readers
+   below. */
+typedef struct BucketsRec {
+    int numBuckets;             /* always power of 2 */
+    int numBucketsLog2;
+    int numTombstones;          /* # of deleted buckets */
+    u_char *ctrl;               /* control byte for each bucket */
+    Entry *entries[1];          /* numBuckets elements */
+} Buckets;
 
-#define DEFAULT_NUM_BUCKETS    4
-#define MAX_AVG_CHAIN_LIMITS   3
-#define EXTEND_BITS            2
+/* For the writer, or when no one else touches the table. */
+#define BUCKETS(hc)   ((Buckets*)(hc)->buckets)
+
+#define DEFAULT_NUM_BUCKETS    8 /* must be a multiple of GROUP_WIDTH */
 
 /* We limit portable hash value to 32bits */
 #define PORTABLE_HASHMASK  0xffffffffUL
@@ -527,86 +538,291 @@ u_long Scm_CombineHashValue(u_long a, u_long b)
  * throw Scheme error.  Be aware of that.
  */
 
+/*
+ * Table layout
+ *
+ *   The hash core is an open-addressing table.  It has two parallel
+ *   arrays of numBuckets elements: entries[] keeps pointers to the
+ *   entries, and ctrl[] keeps a control byte for each bucket.  They
+ *   are kept in a Buckets record with the size.
+ *
+ *     0xxxxxxx  - The bucket is used.  The lower 7 bits are taken
+ *                 from the entry's hash value (H2).
+ *     10000000  - EMPTY.  The bucket has never been used.
+ *     11111110  - DELETED.  The entry has been deleted (tombstone).
+ *
+ *   Buckets are grouped by GROUP_WIDTH, which is the size of a word.
+ *   Probing starts from the group chosen by the hash value and visits
+ *   the following groups until it sees a group with an EMPTY bucket.
+ *   In each group, we compare all the control bytes with H2 at once by
+ *   word operations, and only look at the entries whose control byte
+ *   matches.  Most of the mismatching entries are rejected without
+ *   touching them.
+ *
+ *   The entries are allocated separately, since ScmDictEntry* is handed
+ *   out to the caller and it may be kept while the table is modified
+ *   (e.g. hash-table-update!).  Rehashing moves only pointers.
+ *
+ *   Lock-free readers racing with a writer (module binding tables are
+ *   read that way) may miss an entry transiently, but never read out of
+ *   the arrays: rehashing builds a new Buckets record and publishes it
+ *   with a single atomic store, and readers load the pointer once and
+ *   take the size and both arrays from the same record.  The numBuckets
+ *   and numBucketsLog2 fields of ScmHashCore are only updated for
+ *   information; we never use them.
+ */
+
+#define CTRL_EMPTY     0x80
+#define CTRL_DELETED   0xfe
+#define CTRL_H2(hashval)  ((u_char)(((hashval) >> 18) & 0x7f))
+
+/* Maximum number of used buckets (including tombstones) */
+#define MAX_LOAD(numBuckets)  ((numBuckets) - (numBuckets)/8)
+
+#define GROUP_WIDTH   SIZEOF_LONG
+#define GROUP_LSBS    (~0UL/0xff)       /* 0x01 in each byte */
+#define GROUP_MSBS    (GROUP_LSBS<<7)   /* 0x80 in each byte */
+
+static inline u_long group_load(const u_char *ctrl)
+{
+    u_long w;
+    memcpy(&w, ctrl, sizeof(u_long));
+    return w;
+}
+
+/* The following three return a word whose MSB of each byte is set
+   if the corresponding control byte satisfies the condition. */
+
+/* Control byte is H2.  This can have a false positive on a used bucket
+   next to a true match, which is harmless since we check the entry
+   anyway. */
+static inline u_long group_match(u_long w, u_char h2)
+{
+    u_long x = w ^ (GROUP_LSBS * h2);
+    return (x - GROUP_LSBS) & ~x & GROUP_MSBS;
+}
+
+/* Control byte is EMPTY. */
+static inline u_long group_match_empty(u_long w)
+{
+    return w & (~w << 6) & GROUP_MSBS;
+}
+
+/* Control byte is EMPTY or DELETED. */
+static inline u_long group_match_free(u_long w)
+{
+    return w & ~(w << 7) & GROUP_MSBS;
+}
+
+/* Returns the bucket offset in the group for the lowest bit of MASK. */
+static inline int group_first(u_long mask)
+{
+#if defined(__GNUC__)
+    int bit = __builtin_ctzl(mask);
+#else
+    int bit = Scm__LowestBitNumber(mask);
+#endif
+#if defined(WORDS_BIGENDIAN)
+    return GROUP_WIDTH - 1 - bit/8;
+#else
+    return bit/8;
+#endif
+}
+
+static inline u_long start_group(int numBuckets, int bits, u_long hashval)
+{
+    return HASH2INDEX((u_long)numBuckets, bits, hashval) / GROUP_WIDTH;
+}
+
+/* Returns a free bucket for HASHVAL.  Used when we know the key isn't
+   in the table. */
+static u_long find_free_bucket(const u_char *ctrl, int numBuckets, int bits,
+                               u_long hashval)
+{
+    u_long ngroups = numBuckets / GROUP_WIDTH;
+    u_long g = start_group(numBuckets, bits, hashval);
+    for (;;) {
+        u_long m = group_match_free(group_load(ctrl + g*GROUP_WIDTH));
+        if (m) return g*GROUP_WIDTH + group_first(m);
+        g = (g+1) & (ngroups-1);
+    }
+}
+
+static Buckets *make_buckets(int size, int bits)
+{
+    Buckets *b = SCM_NEW2(Buckets*, sizeof(Buckets)+sizeof(Entry*)*(size-1));
+    b->numBuckets = size;
+    b->numBucketsLog2 = bits;
+    b->numTombstones = 0;
+    b->ctrl = SCM_NEW_ATOMIC2(u_char*, size);
+    memset(b->ctrl, CTRL_EMPTY, size);
+    for (int i=0; i<size; i++) b->entries[i] = NULL;
+    return b;
+}
+
+/* Readers running without a lock must get the buckets by this. */
+static inline Buckets *load_buckets(const ScmHashCore *table)
+{
+    return (Buckets*)Scm_AtomicLoad((ScmAtomicVar*)&table->buckets);
+}
+
+/* B must be filled before it is published. */
+static void publish_buckets(ScmHashCore *table, Buckets *b)
+{
+    Scm_AtomicStoreFull((ScmAtomicVar*)&table->buckets, (ScmAtomicWord)b);
+    table->numBuckets = b->numBuckets;
+    table->numBucketsLog2 = b->numBucketsLog2;
+}
+
+/* Rebuild the table.  We double the size if live entries occupy
+   more than a half of the maximum load; otherwise we just sweep out
+   the tombstones. */
+static void rehash(ScmHashCore *table)
+{
+    Buckets *oldb = BUCKETS(table);
+    int oldsize = oldb->numBuckets;
+    int newsize = oldsize, newbits = oldb->numBucketsLog2;
+
+    if (table->numEntries + 1 > MAX_LOAD(oldsize)/2) {
+        newsize <<= 1;
+        newbits++;
+        SCM_ASSERT(newsize > 0); /* check overflow */
+    }
+
+    Buckets *newb = make_buckets(newsize, newbits);
+    for (int i=0; i<oldsize; i++) {
+        Entry *e = oldb->entries[i];
+        if (e == NULL) continue;
+        u_long k = find_free_bucket(newb->ctrl, newsize, newbits, e->hashval);
+        newb->entries[k] = e;
+        newb->ctrl[k] = CTRL_H2(e->hashval);
+    }
+    publish_buckets(table, newb);
+}
+
 /*
  * Common function called when the accessor function needs to add an entry.
+ * K is the free bucket found during probing.
  */
 static Entry *insert_entry(ScmHashCore *table,
                            intptr_t key,
                            u_long   hashval,
-                           int index)
-{
+                           long k)
+{
+    Buckets *b = BUCKETS(table);
+    if (k < 0
+        || (b->ctrl[k] == CTRL_EMPTY
+            && (table->numEntries + b->numTombstones + 1
+                > MAX_LOAD(b->numBuckets)))) {
+        rehash(table);
+        b = BUCKETS(table);
+        k = (long)find_free_bucket(b->ctrl, b->numBuckets,
+                                   b->numBucketsLog2, hashval);
+    }
+    if (b->ctrl[k] == CTRL_DELETED) b->numTombstones--;
+
     Entry *e = SCM_NEW(Entry);
-    Entry **buckets = BUCKETS(table);
     e->key = key;
     e->value = 0;
-    e->next = buckets[index];
     e->hashval = hashval;
-    buckets[index] = e;
+    b->entries[k] = e;
+    b->ctrl[k] = CTRL_H2(hashval);
     table->numEntries++;
-
-    if (table->numEntries > table->numBuckets*MAX_AVG_CHAIN_LIMITS) {
-        /* Extend the table */
-        int newsize = (table->numBuckets << EXTEND_BITS);
-        int newbits = table->numBucketsLog2 + EXTEND_BITS;
-
-        Entry **newb = SCM_NEW_ARRAY(Entry*, newsize);
-        for (int i=0; i<newsize; i++) newb[i] = NULL;
-
-        ScmHashIter iter;
-        Entry *f;
-        Scm_HashIterInit(&iter, table);
-        while ((f = (Entry*)Scm_HashIterNext(&iter)) != NULL) {
-            index = HASH2INDEX(newsize, newbits, f->hashval);
-            f->next = newb[index];
-            newb[index] = f;
-        }
-        /* gc friendliness */
-        for (int i=0; i<table->numBuckets; i++) table->buckets[i] = NULL;
-
-        table->numBuckets = newsize;
-        table->numBucketsLog2 = newbits;
-        table->buckets = (void**)newb;
-    }
     return e;
 }
 
-/* NB: Deleting entry E doesn't modify E's key and value, but cut
-   the "next" link for the sake of weak-gc robustness.  The hash core
-   iterator prefetches a pointer to the next entry, so deleting the
-   "current" entry of iteration is safe as far as other iterators
-   are running on the same hash table. */
-static Entry *delete_entry(ScmHashCore *table,
-                           Entry *entry, Entry *prev,
-                           int index)
+/* NB: Deleting entry E doesn't modify E's key and value.  Other buckets
+   don't move, so deleting the "current" entry of iteration is safe.
+
+   If the group of the bucket has an EMPTY bucket, no probe sequence
+   has ever passed through the group, so we can make the bucket EMPTY
+   as well.  Otherwise we leave a tombstone.  W is the control word of
+   the group. */
+static Entry *delete_entry(ScmHashCore *table, u_long k, u_long w)
 {
-    if (prev) prev->next = entry->next;
-    else table->buckets[index] = (void*)entry->next;
+    Buckets *b = BUCKETS(table);
+    Entry *e = b->entries[k];
+    if (group_match_empty(w)) {
+        b->ctrl[k] = CTRL_EMPTY;
+    } else {
+        b->ctrl[k] = CTRL_DELETED;
+        b->numTombstones++;
+    }
+    b->entries[k] = NULL;
     table->numEntries--;
     SCM_ASSERT(table->numEntries >= 0);
-    entry->next = NULL;         /* GC friendliness */
-    return entry;
-}
-
-#define FOUND(table, op, e, p, index)                   \
-    do {                                                \
-        switch (op) {                                   \
-        case SCM_DICT_GET:;                             \
-        case SCM_DICT_CREATE:;                          \
-            return e;                                   \
-        case SCM_DICT_DELETE:;                          \
-            return delete_entry(table, e, p, index);    \
-        }                                               \
-    } while (0)
-
-#define NOTFOUND(table, op, key, hashval, index)                \
-    do {                                                        \
-        if (op == SCM_DICT_CREATE) {                            \
-           return insert_entry(table, key, hashval, index);     \
-        } else {                                                \
-           return NULL;                                         \
-        }                                                       \
-    } while (0)
+    return e;
+}
 
+/*
+ * The common body of accessor functions.  KIND is a constant, so
+ * the comparison is resolved when this is inlined.
+ */
+enum {
+    KEY_ADDRESS,                /* compare by == */
+    KEY_STRING,                 /* compare string contents */
+    KEY_GENERAL                 /* use cmpfn */
+};
+
+static inline int key_match(ScmHashCore *table, int kind,
+                            intptr_t key, Entry *e)
+{
+    switch (kind) {
+    case KEY_ADDRESS:
+        return e->key == key;
+    case KEY_STRING: {
+        const ScmStringBody *kb = SCM_STRING_BODY(key);
+        const ScmStringBody *eb = SCM_STRING_BODY(e->key);
+        return (SCM_STRING_BODY_SIZE(kb) == SCM_STRING_BODY_SIZE(eb)
+                && memcmp(SCM_STRING_BODY_START(kb),
+                          SCM_STRING_BODY_START(eb),
+                          SCM_STRING_BODY_SIZE(eb)) == 0);
+    }
+    default:
+        return table->cmpfn(table, key, e->key);
+    }
+}
+
+static inline Entry *hash_core_access(ScmHashCore *table,
+                                      intptr_t key,
+                                      u_long hashval,
+                                      ScmDictOp op,
+                                      int kind)
+{
+    /* See the note on lock-free readers. */
+    const Buckets *b = load_buckets(table);
+    int numBuckets = b->numBuckets;
+    int bits = b->numBucketsLog2;
+    u_long ngroups = numBuckets / GROUP_WIDTH;
+    const u_char *ctrl = b->ctrl;
+    Entry * const *buckets = b->entries;
+    u_char h2 = CTRL_H2(hashval);
+    u_long g = start_group(numBuckets, bits, hashval);
+    long freeb = -1;
+
+    for (u_long n = 0; n < ngroups; n++, g = (g+1) & (ngroups-1)) {
+        u_long base = g * GROUP_WIDTH;
+        u_long w = group_load(ctrl + base);
+        for (u_long m = group_match(w, h2); m; m &= m-1) {
+            u_long k = base + group_first(m);
+            Entry *e = buckets[k];
+            if (e && e->hashval == hashval && key_match(table, kind, key, e)) {
+                if (op == SCM_DICT_DELETE) return delete_entry(table, k, w);
+                return e;
+            }
+        }
+        if (freeb < 0) {
+            u_long f = group_match_free(w);
+            if (f) freeb = (long)(base + group_first(f));
+        }
+        if (group_match_empty(w)) break;
+    }
+    if (op == SCM_DICT_CREATE) {
+        return insert_entry(table, key, hashval, freeb);
+    } else {
+        return NULL;
+    }
+}
 /*
  * Accessor function for address.   Used for EQ-type hash.
  */
@@ -614,16 +830,9 @@ static Entry *address_access(ScmHashCore *table,
                              intptr_t key,
                              ScmDictOp op)
 {
-    u_long hashval, index;
-    Entry **buckets = (Entry**)table->buckets;
-
+    u_long hashval;
     ADDRESS_HASH(hashval, key);
-    index = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
-
-    for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        if (e->key == key) FOUND(table, op, e, p, index);
-    }
-    NOTFOUND(table, op, key, hashval, index);
+    return hash_core_access(table, key, hashval, op, KEY_ADDRESS);
 }
 
 static u_long address_hash(const ScmHashCore *ht SCM_UNUSED, intptr_t obj)
@@ -675,22 +884,7 @@ static Entry *string_access(ScmHashCore *table, intptr_t k, ScmDictOp op)
         Scm_Error("Got non-string key %S to the string hashtable.", key);
     }
     u_long hashval = Scm_HashString(SCM_STRING(key), 0);
-    u_long index = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
-    Entry **buckets = (Entry**)table->buckets;
-
-    const ScmStringBody *keyb = SCM_STRING_BODY(key);
-    long size = SCM_STRING_BODY_SIZE(keyb);
-    for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        ScmObj ee = SCM_OBJ(e->key);
-        const ScmStringBody *eeb = SCM_STRING_BODY(ee);
-        int eesize = SCM_STRING_BODY_SIZE(eeb);
-        if (size == eesize
-            && memcmp(SCM_STRING_BODY_START(keyb),
-                      SCM_STRING_BODY_START(eeb), eesize) == 0){
-            FOUND(table, op, e, p, index);
-        }
-    }
-    NOTFOUND(table, op, k, hashval, index);
+    return hash_core_access(table, k, hashval, op, KEY_STRING);
 }
 
 static u_long string_hash(const ScmHashCore *ht SCM_UNUSED, intptr_t key)
@@ -714,16 +908,8 @@ static int string_cmp(const ScmHashCore *ht SCM_UNUSED, intptr_t k1, intptr_t k2
  */
 static Entry *general_access(ScmHashCore *table, intptr_t key, ScmDictOp op)
 {
-    u_long hashval, index;
-
-    hashval = table->hashfn(table, key);
-    index = HASH2INDEX(table->numBuckets, table->numBucketsLog2, hashval);
-    Entry **buckets = (Entry**)table->buckets;
-
-    for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        if (table->cmpfn(table, key, e->key)) FOUND(table, op, e, p, index);
-    }
-    NOTFOUND(table, op, key, hashval, index);
+    u_long hashval = table->hashfn(table, key);
+    return hash_core_access(table, key, hashval, op, KEY_GENERAL);
 }
 
 /*============================================================
@@ -737,22 +923,18 @@ static void hash_core_init(ScmHashCore *table,
                            unsigned int initSize,
                            void *data)
 {
-    if (initSize != 0) initSize = round2up(initSize);
-    else initSize = DEFAULT_NUM_BUCKETS;
+    /* Make room for INITSIZE entries without rehashing. */
+    unsigned int size = round2up(initSize + initSize/4);
+    if (size < DEFAULT_NUM_BUCKETS) size = DEFAULT_NUM_BUCKETS;
+    int bits = 0;
+    for (u_int i=size; i > 1; i /= 2) bits++;
 
-    Entry **b = SCM_NEW_ARRAY(Entry*, initSize);
-    table->buckets = (void**)b;
-    table->numBuckets = initSize;
     table->numEntries = 0;
     table->accessfn = (void*)accessfn;
     table->hashfn = hashfn;
     table->cmpfn = cmpfn;
     table->data = data;
-    table->numBucketsLog2 = 0;
-    for (u_int i=initSize; i > 1; i /= 2) {
-        table->numBucketsLog2++;
-    }
-    for (u_int i=0; i<initSize; i++) table->buckets[i] = NULL;
+    publish_buckets(table, make_buckets(size, bits));
 }
 
 /* choose appropriate procedures for predefined hash types. */
@@ -823,43 +1005,40 @@ int Scm_HashCoreTypeToProcs(ScmHashType type,
 
 void Scm_HashCoreCopy(ScmHashCore *dst, const ScmHashCore *src)
 {
-    Entry **b = SCM_NEW_ARRAY(Entry*, src->numBuckets);
+    const Buckets *sb = load_buckets(src);
+    int size = sb->numBuckets;
+    Buckets *b = make_buckets(size, sb->numBucketsLog2);
 
-    for (int i=0; i<src->numBuckets; i++) {
-        Entry *p = NULL;
-        Entry *s = (Entry*)src->buckets[i];
-        b[i] = NULL;
-        while (s) {
+    /* We keep the tombstones, so that the probe sequences stay valid. */
+    memcpy(b->ctrl, sb->ctrl, size);
+    b->numTombstones = sb->numTombstones;
+    for (int i=0; i<size; i++) {
+        Entry *s = sb->entries[i];
+        if (s) {
             Entry *e = SCM_NEW(Entry);
             e->key = s->key;
             e->value = s->value;
-            e->next = NULL;
             e->hashval = s->hashval;
-            if (p) p->next = e;
-            else   b[i] = e;
-            p = e;
-            s = s->next;
+            b->entries[i] = e;
         }
     }
 
-    /* A little trick to avoid hazard in careless race condition */
-    dst->numBuckets = dst->numEntries = 0;
-
-    dst->buckets = (void**)b;
     dst->hashfn   = src->hashfn;
     dst->cmpfn    = src->cmpfn;
     dst->accessfn = src->accessfn;
     dst->data     = src->data;
     dst->numEntries = src->numEntries;
-    dst->numBucketsLog2 = src->numBucketsLog2;
-    dst->numBuckets = src->numBuckets;
+    publish_buckets(dst, b);
 }
 
 void Scm_HashCoreClear(ScmHashCore *table)
 {
-    for (int i=0; i<table->numBuckets; i++) {
-        table->buckets[i] = NULL;
+    Buckets *b = BUCKETS(table);
+    for (int i=0; i<b->numBuckets; i++) {
+        b->entries[i] = NULL;
     }
+    memset(b->ctrl, CTRL_EMPTY, b->numBuckets);
+    b->numTombstones = 0;
     table->numEntries = 0;
 }
 
@@ -876,41 +1055,26 @@ int Scm_HashCoreNumEntries(ScmHashCore *table)
 }
 
 /*
- * NB: It is important to keep the pointer to the "next" entry,
- * not the "current", since the current entry may be deleted,
- * erasing its next pointer.
+ * NB: Entries never move unless the table is rehashed, which only happens
+ * on insertion.  So it is safe to delete entries during iteration.
+ * ITER->bucket is the index of the next bucket to look at.  ITER->next
+ * isn't used any more.
  */
 void Scm_HashIterInit(ScmHashIter *iter, ScmHashCore *table)
 {
     iter->core = table;
-    for (int i=0; i<table->numBuckets; i++) {
-        if (table->buckets[i]) {
-            iter->bucket = i;
-            iter->next = table->buckets[i];
-            return;
-        }
-    }
+    iter->bucket = 0;
     iter->next = NULL;
 }
 
 ScmDictEntry *Scm_HashIterNext(ScmHashIter *iter)
 {
-    Entry *e = (Entry*)iter->next;
-    if (e != NULL) {
-        if (e->next) iter->next = e->next;
-        else {
-            int i = iter->bucket + 1;
-            for (; i < iter->core->numBuckets; i++) {
-                if (iter->core->buckets[i]) {
-                    iter->bucket = i;
-                    iter->next = iter->core->buckets[i];
-                    return (ScmDictEntry*)e;
-                }
-            }
-            iter->next = NULL;
-        }
+    const Buckets *b = load_buckets(iter->core);
+    while (iter->bucket < b->numBuckets) {
+        Entry *e = b->entries[iter->bucket++];
+        if (e) return (ScmDictEntry*)e;
     }
-    return (ScmDictEntry*)e;
+    return NULL;
 }
 
 /*============================================================
@@ -1022,21 +1186,21 @@ ScmObj Scm_HashTableStat(ScmHashTable *table)
 {
     ScmObj h = SCM_NIL, t = SCM_NIL;
     ScmHashCore *c = SCM_HASH_TABLE_CORE(table);
+    const Buckets *b = load_buckets(c);
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-entries"));
     SCM_APPEND1(h, t, Scm_MakeInteger(c->numEntries));
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-buckets"));
-    SCM_APPEND1(h, t, Scm_MakeInteger(c->numBuckets));
+    SCM_APPEND1(h, t, Scm_MakeInteger(b->numBuckets));
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-buckets-log2"));
-    SCM_APPEND1(h, t, Scm_MakeInteger(c->numBucketsLog2));
+    SCM_APPEND1(h, t, Scm_MakeInteger(b->numBucketsLog2));
+    SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("num-tombstones"));
+    SCM_APPEND1(h, t, Scm_MakeInteger(b->numTombstones));
 
-    Entry** b = BUCKETS(c);
-    ScmVector *v = SCM_VECTOR(Scm_MakeVector(c->numBuckets, SCM_NIL));
+    ScmVector *v = SCM_VECTOR(Scm_MakeVector(b->numBuckets, SCM_NIL));
     ScmObj *vp = SCM_VECTOR_ELEMENTS(v);
-    for (int i = 0; i<c->numBuckets; i++, vp++) {
-        Entry *e = b[i];
-        for (; e; e = e->next) {
-            *vp = Scm_Acons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e), *vp);
-        }
+    for (int i = 0; i<b->numBuckets; i++, vp++) {
+        Entry *e = b->entries[i];
+        if (e) *vp = SCM_LIST1(Scm_Cons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e)));
     }
     SCM_APPEND1(h, t, SCM_MAKE_KEYWORD("contents"));
     SCM_APPEND1(h, t, SCM_OBJ(v));
@@ -0,0 +1,150 @@
+;;;
+;;; libaio.scm - asynchronous I/O
+;;;
+;;;   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(declare) ;; a dummy form to suppress generation of "sci" file
+(define-module gauche.aio
+  (export <aio-context> <aio-request>
+          make-aio-context aio-context? aio-context-backend
+          aio-context-close aio-pending-count
+          aio-read aio-write aio-accept aio-connect
+          aio-submit aio-wait aio-dispatch
+          aio-request? aio-request-op aio-request-target
+          aio-request-buffer aio-request-data aio-request-done?
+          aio-request-result aio-request-errno)
+  )
+(select-module gauche.aio)
+
+;; See gauche/priv/aioP.h for the design.
+
+(inline-stub
+ (.include "gauche/priv/configP.h"
+           "gauche/priv/aioP.h")
+
+ (declare-stub-type <aio-context> "ScmAioContext*")
+ (declare-stub-type <aio-request> "ScmAioRequest*")
+ )
+
+;;----------------------------------------------------------
+;; Context
+
+;; BACKEND may be #f (io_uring if available, epoll otherwise),
+;; io-uring or epoll.  SIZE is the size of the io_uring queues.
+(define-cproc make-aio-context (:key (size::<int> 256) (backend #f))
+  (return (Scm_MakeAioContext size backend)))
+
+(define-cproc aio-context? (obj) ::<boolean> SCM_AIO_CONTEXT_P)
+
+(define-cproc aio-context-backend (ctx::<aio-context>) Scm_AioContextBackend)
+
+(define-cproc aio-context-close (ctx::<aio-context>) ::<void>
+  Scm_AioContextClose)
+
+;; Number of requests that haven't completed.
+(define-cproc aio-pending-count (ctx::<aio-context>) ::<long>
+  (return (-> ctx numRequests)))
+
+;;----------------------------------------------------------
+;; Requests
+
+;; TARGET is a socket, a port with an fd, or an fd.  These only queue
+;; the request and return an <aio-request>; the result is available
+;; after aio-wait returns it.
+;; OFFSET is the file position; negative means the current position,
+;; which is the only choice for sockets and pipes.
+(define-cproc aio-read (ctx::<aio-context> target buf::<uvector>
+                        :key (start::<fixnum> 0) (end::<fixnum> -1)
+                             (offset::<int64> -1) (data #f))
+  (return (Scm_AioRead ctx target buf start end offset data)))
+
+(define-cproc aio-write (ctx::<aio-context> target buf::<uvector>
+                         :key (start::<fixnum> 0) (end::<fixnum> -1)
+                              (offset::<int64> -1) (data #f))
+  (return (Scm_AioWrite ctx target buf start end offset data)))
+
+;; If TARGET is a <socket>, the result is a connected <socket>.
+;; Otherwise it is a new fd.
+(define-cproc aio-accept (ctx::<aio-context> target :key (data #f))
+  (return (Scm_AioAccept ctx target data)))
+
+(define-cproc aio-connect (ctx::<aio-context> target addr :key (data #f))
+  (return (Scm_AioConnect ctx target addr data)))
+
+(define-cproc aio-submit (ctx::<aio-context>) ::<int> Scm_AioSubmit)
+
+(define-cproc %aio-wait (ctx::<aio-context> usec::<long>) Scm_AioWait)
+
+(define-cproc aio-request? (obj) ::<boolean> SCM_AIO_REQUEST_P)
+
+(define-cproc aio-request-op (req::<aio-request>) Scm_AioRequestOp)
+
+(define-cproc aio-request-target (req::<aio-request>)
+  (return (-> req target)))
+
+(define-cproc aio-request-buffer (req::<aio-request>)
+  (return (-> req buffer)))
+
+(define-cproc aio-request-data (req::<aio-request>)
+  (return (-> req data)))
+
+(define-cproc aio-request-done? (req::<aio-request>) ::<boolean>
+  (return (== (-> req state) SCM_AIO_DONE)))
+
+;; Number of bytes for read/write, a socket or an fd for accept, and
+;; the target for connect.  #f if the request is pending or failed.
+(define-cproc aio-request-result (req::<aio-request>)
+  (return (-> req result)))
+
+;; errno if the request failed, 0 otherwise.
+(define-cproc aio-request-errno (req::<aio-request>) ::<int>
+  (return (-> req error)))
+
+;;----------------------------------------------------------
+;; Waiting
+
+;; Timeout is given in the same way as sys-select: #f, a real number
+;; in microseconds, or a list of seconds and microseconds.
+;; Returns a list of completed requests, in the order of completion.
+(define (aio-wait ctx :optional (timeout #f))
+  (%aio-wait ctx (or ((with-module gauche.internal %timeout->usec) timeout)
+                     -1)))
+
+;; Waits like aio-wait, then calls the data of each completed request
+;; with the request, if it is a procedure.  A scheduler can keep a
+;; continuation in the data to resume the task.  Returns the number of
+;; completed requests.
+(define (aio-dispatch ctx :optional (timeout #f))
+  (let1 reqs (aio-wait ctx timeout)
+    (dolist [r reqs]
+      (let1 proc (aio-request-data r)
+        (when (procedure? proc) (proc r))))
+    (length reqs)))
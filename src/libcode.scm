@@ -262,3 +262,20 @@
        (set! (-> p decoded) decoded)))
    (return (-> p decoded)))
  )
+
+;; Binary serialization of compiled code (see serial.c).
+;; Used by the compile cache in libeval.scm.
+(select-module gauche.internal)
+(define-cproc %fasl-encode (obj) Scm_FaslEncode) ; u8vector or #f
+(define-cproc %fasl-read (port::<input-port>) Scm_FaslRead)
+(define-cproc %fasl-version () Scm_FaslVersion)
+(define-cproc %fasl-write-encoded (v::<u8vector> port::<output-port>) ::<void>
+  (Scm_Putz (cast (const char*) (SCM_U8VECTOR_ELEMENTS v))
+            (SCM_U8VECTOR_SIZE v) port))
+
+;; The data mode, used by gauche.serializer.bserializer.
+(define-cproc %fasl-write-data (obj port::<output-port>
+                                    :optional (shared::<boolean> #t))
+  ::<void>
+  Scm_FaslWriteData)
+(define-cproc %fasl-read-data (port::<input-port>) Scm_FaslReadData)
@@ -98,11 +98,11 @@
       (if (not (input-port? port))
         (and error-if-not-found (raise port))
         (begin
-          (load-from-port (if ignore-coding
-                            port
-                            (open-coding-aware-port port))
-                          :environment environment
-                          :paths remaining-paths)
+          (%load-from-port (if ignore-coding
+                             port
+                             (open-coding-aware-port port))
+                           remaining-paths environment
+                           (and (not hooked?) path))
           path)))))
 
 
@@ -112,6 +112,13 @@
 (define-in-module gauche (load-from-port port
                                          :key (paths #f)
                                               (environment #f))
+  (%load-from-port port paths environment #f))
+
+;; SOURCE is the path of the file PORT reads from, if it is a regular
+;; file.  It is used for the compile cache and the heap image.
+;; If REPLAY is given, it is called to run the forms, instead of
+;; reading them from PORT.  It is used to replay the heap image.
+(define (%load-from-port port paths environment source :optional (replay #f))
   (unless (input-port? port)
     (error "input port required, but got:" port))
   (unless (or (module? environment) (not environment))
@@ -121,11 +128,16 @@
         [prev-history (current-load-history)]
         [prev-next    (current-load-next)]
         [prev-reader-lexical-mode (reader-lexical-mode)]
-        [prev-eval-situation (vm-eval-situation)])
+        [prev-eval-situation (vm-eval-situation)]
+        [prev-deps    (%load-dependencies)]
+        [prev-image   (%image-records)]
+        [feature      (%require-feature)]
+        [cache-file   (and source (not replay) (%compile-cache-file source))])
 
     (define (setup-load-context)
       (when (port-closed? port) (error "port already closed:" port))
       (%port-lock! port)
+      (%require-feature #f)             ;it's not for nested loads
       (when environment (vm-set-current-module environment))
       (current-load-port port)
       (current-load-next paths)
@@ -135,8 +147,13 @@
                (list #f))
              prev-history))
       (vm-eval-situation SCM_VM_LOADING)
+      (%load-dependencies (and (or cache-file (image-block?)) '()))
       (%record-load-stat (or (current-load-path) "(unnamed source)")))
 
+    ;; Files loaded by require are saved in the heap image being dumped.
+    (define (image-block?)
+      (and feature (not replay) (pair? prev-image)))
+
     (define (restore-load-context)
       (vm-set-current-module prev-module)
       (current-load-port prev-port)
@@ -144,6 +161,8 @@
       (current-load-next prev-next)
       (reader-lexical-mode prev-reader-lexical-mode)
       (vm-eval-situation prev-eval-situation)
+      (%load-dependencies prev-deps)
+      (%image-records prev-image)
       (close-port port)
       (%record-load-stat #f)
       (%port-unlock! port))
@@ -163,10 +182,290 @@
        ;; Discard BOM
        (when (eqv? (peek-char port) #\ufeff)
          (read-char port))
-       (generator-for-each (^s (eval s #f)) (cut read-code port))))
+       (cond [replay (replay)]
+             [(image-block?) (%record-image-block port source feature)]
+             [cache-file (%load-with-compile-cache port source cache-file)]
+             [else
+              (generator-for-each (^s (eval s #f)) (cut read-code port))])))
     (restore-load-context)
     #t))
 
+;; Compile cache
+;;
+;;   If compile-cache-directory is set, load saves the compiled code of
+;;   the toplevel forms of a file in a cache file, and the next load of
+;;   the same file runs the saved code instead of reading and compiling
+;;   the source.  The cache file is a sequence of FASL records (see
+;;   serial.c).  The first one is the header:
+;;
+;;     (gauche-compile-cache <fasl-version> <module> <deps>)
+;;
+;;   <module> is the name of the current module at the beginning of the
+;;   load.  <deps> is a list of (<path> <size> <mtime>) of the source
+;;   file and the files it includes or requires during compilation.
+;;   The cache is used only if all of them match.  Each of the rest is
+;;   a saved toplevel form (see %record-toplevel-forms).
+
+(define (%compile-cache-file source)
+  (and-let* ([dir (compile-cache-directory)]
+             [dir (if (string? dir) dir (%default-compile-cache-directory))]
+             [abs (sys-normalize-pathname source :absolute #t
+                                          :canonicalize #t)])
+    (string-append dir "/" (sys-basename abs) "-"
+                   (number->string (portable-hash abs 0) 16)
+                   ".gosh-cache")))
+
+(define (%default-compile-cache-directory)
+  (let ([xdg (sys-getenv "XDG_CACHE_HOME")]
+        [home (sys-getenv "HOME")])
+    (cond [(and xdg (not (equal? xdg ""))) (string-append xdg "/gauche")]
+          [home (string-append home "/.cache/gauche")]
+          [else #f])))
+
+(define (%file-signature path)
+  (and-let* ([st (guard (e [else #f]) (sys-stat path))]
+             [ (eq? (slot-ref st 'type) 'regular) ])
+    (list path (slot-ref st 'size) (time->seconds (slot-ref st 'mtim)))))
+
+;; Called from %require and include, to record the files the
+;; current load depends on.
+(define (%add-load-dependency! path)
+  (let1 deps (%load-dependencies)
+    (when (list? deps)
+      (%load-dependencies
+       (cons (sys-normalize-pathname path :absolute #t) deps)))))
+
+(define (%load-with-compile-cache port source cache-file)
+  (let ([source (sys-normalize-pathname source :absolute #t)]
+        [in (guard (e [else #f])
+              (and (file-exists? cache-file)
+                   (open-input-file cache-file)))])
+    (if (and in (%valid-compile-cache? in source))
+      (%replay-compile-cache in cache-file)
+      (begin
+        (when in (close-port in))
+        (%compile-and-record port source cache-file)))))
+
+(define (%valid-compile-cache? in source)
+  (guard (e [else #f])
+    (match (%fasl-read in)
+      [('gauche-compile-cache version mod (and deps ((path . _) . _)))
+       (and (equal? version (%fasl-version))
+            (eq? mod (module-name (vm-current-module)))
+            (equal? path source)
+            (every (^d (equal? d (%file-signature (car d)))) deps))]
+      [_ #f])))
+
+(define (%replay-compile-cache in cache-file)
+  (unwind-protect
+      (let loop ()
+        (let1 x (guard (e [else (%remove-file cache-file) (raise e)])
+                  (%fasl-read in))
+          (unless (eof-object? x)
+            (%run-saved-form x)
+            (loop))))
+    (close-port in)))
+
+;; RECORDS becomes #f once we find a form we can't save.
+(define (%compile-and-record port source cache-file)
+  (let ([mod (vm-current-module)]
+        [records '()])
+    (%record-toplevel-forms port
+                            (^r (set! records (and records r
+                                                   (cons r records)))))
+    (when (and records (module-name mod))
+      (%write-compile-cache cache-file source mod (reverse! records)))))
+
+(define (%write-compile-cache cache-file source mod records)
+  (and-let* ([deps (let loop ([ps (cons source (reverse (%load-dependencies)))]
+                              [r '()])
+                     (cond [(null? ps) (reverse! r)]
+                           [(%file-signature (car ps))
+                            => (^s (loop (cdr ps) (cons s r)))]
+                           [else #f]))]
+             [header (%fasl-encode `(gauche-compile-cache ,(%fasl-version)
+                                                          ,(module-name mod)
+                                                          ,deps))]
+             [tmp (string-append cache-file "."
+                                 (number->string (sys-getpid)) ".tmp")])
+    ;; Failure to save the cache isn't an error.
+    (guard (e [else (%remove-file tmp) #f])
+      (%make-directory* (sys-dirname cache-file))
+      (call-with-output-file tmp
+        (^[out]
+          (%fasl-write-encoded header out)
+          (dolist [r records] (%fasl-write-encoded r out))))
+      (sys-rename tmp cache-file))))
+
+;; Reads, compiles and runs the toplevel forms from PORT as load does,
+;; calling (SAVE <record>) before running each form.  <Record> is a
+;; FASL record of the compiled code, or of (eval <form>) if the form
+;; has a compile-time effect, such as a macro definition or an import,
+;; for running its compiled code doesn't reproduce the effect.  We
+;; detect it by the module stamp, which is bumped by any change of the
+;; module system (see module.c).  <Record> is #f if the form can't be
+;; saved.
+(define (%record-toplevel-forms port save)
+  (let loop ()
+    (let1 form (read-code port)
+      (unless (eof-object? form)
+        (let* ([stamp (%module-stamp)]
+               [code (compile form #f)]
+               [line (port-current-line port)])
+          (save (or (and (= stamp (%module-stamp))
+                         (%fasl-encode code))
+                    (%fasl-encode (list 'eval form))))
+          ;; Files loaded while running the form are loaded again when
+          ;; the form is replayed, so they don't go to the heap image.
+          (let1 image (%image-records)
+            (%image-records #f)
+            ((make-toplevel-closure code))
+            (%image-records image))
+          ;; The form may read the rest of the source by itself.
+          (unless (= line (port-current-line port))
+            (save #f))
+          (loop))))))
+
+(define (%run-saved-form x)
+  (match x
+    [('eval form) (eval form #f)]
+    [_ (if (is-a? x <compiled-code>)
+         ((make-toplevel-closure x))
+         (error "broken saved form:" x))]))
+
+;; Heap image
+;;
+;;   gosh --dump-image=FILE runs the command-line options and the script
+;;   as usual, saving the files loaded by require in FILE.  Later,
+;;   gosh --image=FILE replays the saved forms at startup, so that the
+;;   features are already provided when the options and the script
+;;   require them.  It saves searching, reading and compiling the files.
+;;   It is not a memory snapshot; runtime state is rebuilt by running
+;;   the saved forms.
+;;
+;;   The image is a sequence of FASL records.  The first one is the
+;;   header:
+;;
+;;     (gauche-image <fasl-version> <load-paths> <deps>)
+;;
+;;   <load-paths> is (load-paths) when dumping started; the image is
+;;   ignored if it differs at startup, for the same require could find
+;;   other files.  <deps> is the same as in the compile cache, for all
+;;   the files saved in the image.  The rest is a sequence of blocks, each of which
+;;   corresponds to a file loaded by require:
+;;
+;;     (load <feature> <module> <path> <load-next>)
+;;     <saved-form-or-block> ...
+;;     (end <feature> <provided?>)
+;;
+;;   Blocks nest, for a file may be required while compiling a form of
+;;   another file.  Files loaded while running a form aren't saved,
+;;   since they are loaded again when the form is replayed.  If a form
+;;   of a file can't be saved, the file's block (with the blocks nested
+;;   in it) is left out of the image.
+;;
+;;   While dumping, %image-records holds a list of the records in reverse
+;;   order and the load paths.  The end of a block is kept as
+;;   (end <feature> <path> <dep> ...) until the image is written, for
+;;   <provided?> isn't known before the feature's require returns.
+
+(define (%record-image-block port source feature)
+  (let* ([cell (%image-records)]
+         [mark (car cell)]
+         [path (sys-normalize-pathname source :absolute #t)]
+         [saved? #t])
+    (define (push! r)
+      (if r
+        (set-car! cell (cons r (car cell)))
+        (set! saved? #f)))
+    (push! (%fasl-encode `(load ,feature ,(module-name (vm-current-module))
+                                ,path ,(current-load-next))))
+    (%record-toplevel-forms port push!)
+    ;; If any form can't be saved, we drop the whole block, so that
+    ;; the feature is required as usual when the image is used.
+    (if saved?
+      (push! (list* 'end feature path (%load-dependencies)))
+      (begin
+        (set-car! cell mark)
+        (warn "Can't save ~a in the heap image; it will be loaded at startup.\n"
+              path)))))
+
+;; Called from main.c
+(define (%dump-image-start!)
+  (%image-records (list '() (load-paths))))
+
+;; Called from main.c
+(define (%dump-image file)
+  (let* ([items (reverse (car (%image-records)))]
+         [paths (cadr (%image-records))]
+         [sigs (map (^p (or (%file-signature p)
+                            (error "can't save the file in the image:" p)))
+                    (delete-duplicates
+                     (append-map (^x (if (pair? x) (cddr x) '())) items)))]
+         [header (%fasl-encode `(gauche-image ,(%fasl-version) ,paths ,sigs))]
+         [tmp (string-append file "." (number->string (sys-getpid)) ".tmp")])
+    (%image-records #f)
+    (guard (e [else (%remove-file tmp) (raise e)])
+      (call-with-output-file tmp
+        (^[out]
+          (%fasl-write-encoded header out)
+          (dolist [x items]
+            (%fasl-write-encoded
+             (if (pair? x)
+               (%fasl-encode `(end ,(cadr x) ,(provided? (cadr x))))
+               x)
+             out))))
+      (sys-rename tmp file))))
+
+;; Called from main.c.  Returns #t if the image is loaded, or a string
+;; telling why it isn't.
+(define (%load-image file)
+  (if-let1 in (guard (e [else #f]) (open-input-file file))
+    (unwind-protect
+        (match (guard (e [else #f]) (%fasl-read in))
+          [('gauche-image version paths sigs)
+           (cond [(not (equal? version (%fasl-version)))
+                  "it is made by a different version or settings of Gauche"]
+                 [(not (equal? paths (load-paths)))
+                  "it is made with different load paths"]
+                 [(every (^s (equal? s (%file-signature (car s)))) sigs)
+                  (%replay-image in)
+                  #t]
+                 [else "it is out of date"])]
+          [_ "it is not an image file"])
+      (close-port in))
+    "can't open the file"))
+
+(define (%replay-image in)
+  (let loop ()
+    (match (%fasl-read in)
+      [('load . args) (apply %replay-image-block in args) (loop)]
+      [(? eof-object?) #t]
+      [x (error "broken image:" x)])))
+
+(define (%replay-image-block in feature modname path paths)
+  (%load-from-port (open-input-string "" :name path) paths
+                   (or (find-module modname)
+                       (error "module not found in image:" modname))
+                   #f
+                   (^[] (let loop ()
+                          (match (%fasl-read in)
+                            [('load . args)
+                             (apply %replay-image-block in args)
+                             (loop)]
+                            [('end f provided?)
+                             (when provided? (provide f))]
+                            [(? eof-object?) (error "truncated image")]
+                            [x (%run-saved-form x) (loop)])))))
+
+(define (%remove-file path)
+  (guard (e [else #f]) (sys-unlink path)))
+
+(define (%make-directory* dir)
+  (unless (file-exists? dir)
+    (%make-directory* (sys-dirname dir))
+    (sys-mkdir dir #o755)))
+
 ;; A few helper procedures
 (define-cproc %record-load-stat (path) ::<void>
   (.when "defined(HAVE_GETTIMEOFDAY)"
@@ -229,9 +528,18 @@
 (select-module gauche.internal)
 ;; NB: 'require' is recognized by the compiler, which calls
 ;; this one directly.
-(define-cproc %require (feature) ::<boolean>
+(define-cproc %%require (feature) ::<boolean>
   (return (not (Scm_Require feature SCM_LOAD_PROPAGATE_ERROR NULL))))
 
+(define (%require feature)
+  (rlet1 r (%%require feature)
+    ;; Record the file for the compile cache.  Built-in features don't
+    ;; have files.
+    (when (and (%load-dependencies) (string? feature))
+      (and-let* ([p (find-load-file feature (load-paths) (load-suffixes))]
+                 [ (null? (cddr p)) ])
+        (%add-load-dependency! (car p))))))
+
 (define-cproc %add-load-path (path::<const-cstring> :optional afterp)
   (return (Scm_AddLoadPath path (not (SCM_FALSEP afterp)))))
 
@@ -597,11 +905,69 @@
     (add-gc-stat :obtained-from-os-bytes obtained_from_os_bytes)
 
     (return h)))
+;; API
+;; Returns the current GC parameters in the same format as gc-stat.
+(define-cproc gc-configuration () Scm_GCParameters)
+
+;; API
+;; Changes GC parameters, e.g. (gc-configure! :incremental #t :time-limit 5).
+;; The number of marker threads can only be set by -G option of gosh.
+(define (gc-configure! . kvs)
+  (define set-parameter! (with-module gauche.internal %gc-set-parameter!))
+  (let loop ([kvs kvs])
+    (unless (null? kvs)
+      (unless (and (keyword? (car kvs)) (pair? (cdr kvs)))
+        (error "keyword-value list required, but got:" kvs))
+      (let ([k (car kvs)] [v (cadr kvs)])
+        (set-parameter! (keyword->string k)
+                        (cond [(eq? k :incremental) (if v 1 0)]
+                              [(and (exact-integer? v) (>= v 0)) v]
+                              [else (errorf "GC parameter ~s requires a \
+                                             nonnegative integer, but got: ~s"
+                                            k v)])))
+      (loop (cddr kvs)))))
+
+;; API
+;; Statistics of the collections since the start or the last reset.
+;; Times are in microseconds.
+(define-cproc gc-telemetry () Scm_GCTelemetry)
+(define-cproc gc-telemetry-reset! () ::<void> Scm_GCTelemetryReset)
+
+;; API
+;; Bytes of pairs and flonums allocated from the per-VM allocation cache
+;; on the thread.  Other allocations aren't counted; see the manual.
+(define-cproc vm-cache-allocated-bytes
+  (:optional (vm::<thread> (c "SCM_OBJ(Scm_VM())")))
+  ::<ulong>
+  (return (-> vm allocBytes)))
 
 (select-module gauche.internal)
 ;; for diagnostics
 (define-cproc gc-print-static-roots () ::<void> Scm_PrintStaticRoots)
 
+(define-cproc %gc-set-parameter! (name::<const-cstring> value::<ulong>)
+  ::<void>
+  (case (Scm_GCSetParameter name value)
+    [(SCM_GC_PARAM_OK) (return)]
+    [(SCM_GC_PARAM_UNKNOWN) (Scm_Error "unknown GC parameter: %s" name)]
+    [(SCM_GC_PARAM_TOO_LATE)
+     (Scm_Error "GC parameter %s can't be changed at this point" name)]
+    [else (Scm_Error "invalid value for GC parameter %s: %lu" name value)]))
+
+;; Turns the per-VM allocation cache of pairs and flonums on and off.
+;; Returns the previous setting.  For benchmarks; see
+;; tests/alloc-performance.scm.
+(define-cproc %vm-alloc-cache (:optional flag) ::<boolean>
+  (return (Scm__VMAllocCacheEnabled (?: (SCM_UNBOUNDP flag) -1
+                                        (?: (SCM_FALSEP flag) 0 1)))))
+
+;; Sets the number of calls of a closure before its body is translated
+;; into native code by the baseline JIT (see vmjit.c); 0 turns JIT off.
+;; Returns the previous setting.  It is a no-op on platforms where the
+;; JIT isn't available.
+(define-cproc %vm-jit-threshold (:optional (threshold::<fixnum> -1)) ::<ulong>
+  (return (Scm__VMJitThreshold threshold)))
+
 ;;;
 ;;; Some system introspection
 ;;;
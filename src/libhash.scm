@@ -626,6 +626,159 @@
                                               (cut =? value-cmpr <> <>)
                                               100))))) ;; any non-zero number
 
+;;;
+;;; Concurrent hashtables
+;;;
+
+;; A concurrent hash table can be shared among threads without locking.
+;; Lookups are lock-free; updates are serialized per key.  Iteration
+;; works on a snapshot.  See gauche/priv/chashP.h for the details.
+
+(select-module gauche)
+(inline-stub
+ (.include "gauche/priv/chashP.h")
+ (declare-stub-type <concurrent-hash-table> "ScmConcurrentHashTable*")
+ )
+
+(define-cproc %make-concurrent-hash-table (type init-size::<ulong>)
+  (let* ([ctype::int 0])
+    (set-hash-type! ctype type)
+    (return (Scm_MakeConcurrentHashTable ctype init-size))))
+
+;; Comparator argument can be one of the symbols eq?, eqv?, equal? or
+;; string=?, or one of the predefined comparators that corresponds to them.
+(define (make-concurrent-hash-table :optional (comparator 'eq?)
+                                              (init-size 0))
+  (define (type-of cmpr)
+    (cond [(memq cmpr '(eq? eqv? equal? string=?)) cmpr]
+          [(eq? cmpr eq-comparator) 'eq?]
+          [(eq? cmpr eqv-comparator) 'eqv?]
+          [(eq? cmpr equal-comparator) 'equal?]
+          [(eq? cmpr string-comparator) 'string=?]
+          [(and (comparator? cmpr)
+                (memq (comparator-equality-predicate cmpr) (list eq? eqv?)))
+           => (^p (if (eq? (car p) eq?) 'eq? 'eqv?))]
+          [else
+           (error "make-concurrent-hash-table requires one of the symbols \
+                   eq?, eqv?, equal? or string=?, or the corresponding \
+                   comparator, but got:" cmpr)]))
+  (%make-concurrent-hash-table (type-of comparator) init-size))
+
+(define-cproc concurrent-hash-table? (obj) ::<boolean>
+  SCM_CONCURRENT_HASH_TABLE_P)
+
+(define-cproc concurrent-hash-table-type (ht::<concurrent-hash-table>)
+  (get-hash-type (-> ht type)))
+
+(define (concurrent-hash-table-comparator ht)
+  (case (concurrent-hash-table-type ht)
+    [(eq?) eq-comparator]
+    [(eqv?) eqv-comparator]
+    [(equal?) equal-comparator]
+    [(string=?) string-comparator]
+    [else (error "unknown concurrent hashtable type:" ht)]))
+
+(define-cproc concurrent-hash-table-num-entries (ht::<concurrent-hash-table>)
+  ::<long>
+  (return (Scm_ConcurrentHashTableNumEntries ht)))
+
+(define-cproc concurrent-hash-table-clear! (ht::<concurrent-hash-table>)
+  ::<void> Scm_ConcurrentHashTableClear)
+
+(define-cproc concurrent-hash-table-get (ht::<concurrent-hash-table> key
+                                         :optional fallback)
+  (dict-get ht Scm_ConcurrentHashTableRef))
+
+(define-cproc concurrent-hash-table-put! (ht::<concurrent-hash-table>
+                                          key value)
+  ::<void>
+  (Scm_ConcurrentHashTableSet ht key value 0))
+
+(define-cproc concurrent-hash-table-adjoin! (ht::<concurrent-hash-table>
+                                             key value)
+  ::<void>
+  (Scm_ConcurrentHashTableSet ht key value SCM_DICT_NO_OVERWRITE))
+
+(define-cproc concurrent-hash-table-replace! (ht::<concurrent-hash-table>
+                                              key value)
+  ::<void>
+  (Scm_ConcurrentHashTableSet ht key value SCM_DICT_NO_CREATE))
+
+(define-cproc concurrent-hash-table-delete! (ht::<concurrent-hash-table> key)
+  ::<boolean>
+  (return (not (SCM_UNBOUNDP (Scm_ConcurrentHashTableDelete ht key)))))
+
+(define-cproc concurrent-hash-table-exists? (ht::<concurrent-hash-table> key)
+  ::<boolean>
+  (return (dict-exists? ht Scm_ConcurrentHashTableRef)))
+
+;; Atomically replaces the value of KEY with NEW if it is EXPECTED (eq?).
+;; ABSENT is a marker object; as EXPECTED it means KEY must not be in
+;; the table, and as NEW it means deleting the entry.
+(select-module gauche.internal)
+(define-cproc %concurrent-hash-table-cas! (ht::<concurrent-hash-table>
+                                           key expected new absent)
+  ::<boolean>
+  (when (SCM_EQ expected absent) (set! expected SCM_UNBOUND))
+  (when (SCM_EQ new absent) (set! new SCM_UNBOUND))
+  (return (Scm_ConcurrentHashTableCompareAndSwap ht key expected new)))
+
+(select-module gauche)
+(define-cproc concurrent-hash-table-keys (ht::<concurrent-hash-table>)
+  Scm_ConcurrentHashTableKeys)
+(define-cproc concurrent-hash-table-values (ht::<concurrent-hash-table>)
+  Scm_ConcurrentHashTableValues)
+(define-cproc concurrent-hash-table->alist (ht::<concurrent-hash-table>)
+  Scm_ConcurrentHashTableToAlist)
+
+;; Read-modify-write operations are done by compare-and-swap, so PROC
+;; may be called more than once when other threads update the same key
+;; concurrently.  PROC shouldn't have side effects.
+(define (concurrent-hash-table-update! ht key proc :optional fallback)
+  (define cas! (with-module gauche.internal %concurrent-hash-table-cas!))
+  (define unique (with-module gauche.internal *unique*))
+  (let loop ()
+    (let* ([old (concurrent-hash-table-get ht key unique)]
+           [cur (if (eq? old unique)
+                  (if (undefined? fallback)
+                    (errorf "~s doesn't have an entry for key ~s" ht key)
+                    fallback)
+                  old)]
+           [new (proc cur)])
+      (if (cas! ht key old new unique)
+        new
+        (loop)))))
+
+(define (concurrent-hash-table-push! ht key value)
+  (concurrent-hash-table-update! ht key (cut cons value <>) '()))
+
+(define (concurrent-hash-table-pop! ht key :optional fallback)
+  (define cas! (with-module gauche.internal %concurrent-hash-table-cas!))
+  (define unique (with-module gauche.internal *unique*))
+  (let loop ()
+    (let1 old (concurrent-hash-table-get ht key unique)
+      (cond [(pair? old)
+             (if (cas! ht key old (cdr old) unique)
+               (car old)
+               (loop))]
+            [(not (undefined? fallback)) fallback]
+            [(eq? old unique)
+             (errorf "~s doesn't have an entry for key ~s" ht key)]
+            [else
+             (errorf "~s's value for key ~s is not a pair: ~s" ht key old)]))))
+
+(define (concurrent-hash-table-fold ht kons knil)
+  (fold (^[kv r] (kons (car kv) (cdr kv) r)) knil
+        (concurrent-hash-table->alist ht)))
+
+(define (concurrent-hash-table-for-each ht proc)
+  (for-each (^[kv] (proc (car kv) (cdr kv)))
+            (concurrent-hash-table->alist ht)))
+
+(define (concurrent-hash-table-map ht proc)
+  (map (^[kv] (proc (car kv) (cdr kv)))
+       (concurrent-hash-table->alist ht)))
+
 ;;;
 ;;; TreeMap
 ;;;
@@ -191,7 +191,8 @@
 (define-cproc %open-input-file (path::<string>
                                 :key (if-does-not-exist :error)
                                 (buffering #f)
-                                (element-type :binary))
+                                (element-type :binary)
+                                (mmap #f))
   (let* ([ignerr::int FALSE]
          [flags::int O_RDONLY])
     (cond [(SCM_FALSEP if-does-not-exist) (set! ignerr TRUE)]
@@ -208,8 +209,10 @@
         (logior= flags O_BINARY)))
     (let* ([bufmode::int (Scm_BufferingMode buffering SCM_PORT_INPUT
                                             SCM_PORT_BUFFER_FULL)]
-           [o (Scm_OpenFilePort (Scm_GetStringConst path)
-                                flags bufmode 0)])
+           [o (?: (SCM_FALSEP mmap)
+                  (Scm_OpenFilePort (Scm_GetStringConst path)
+                                    flags bufmode 0)
+                  (Scm_OpenMmapInputPort (Scm_GetStringConst path)))])
       (when (and (SCM_FALSEP o) (not (%open/allow-noexist? ignerr)))
         (Scm_SysError "couldn't open input file: %S" path))
       (return o))))
@@ -842,6 +845,14 @@
 
 (define-cproc flush-all-ports () ::<void> (Scm_FlushAllPorts FALSE))
 
+;; Block output without going through the port buffer, if possible.
+(define-cproc port-writev (port::<output-port> bufs::<list>)
+  (return (Scm_MakeInteger (Scm_PortWritev port bufs))))
+
+(define-cproc port-sendfile (src::<input-port> dst::<output-port>
+                             :optional (size::<fixnum> -1))
+  (return (Scm_MakeInteger (Scm_PortSendfile src dst size))))
+
 ;;
 ;; Internal recusive writer
 ;;
@@ -211,6 +211,11 @@
 (define-cproc %seal-module! (mod::<module>) ::<void>
   Scm_ModuleSeal)
 
+;; Module stamp; changes whenever the module system is changed.
+;; Used by the compile cache to detect compile-time effects.
+(define-cproc %module-stamp () ::<ulong> Scm__ModuleStamp)
+(define-cproc %touch-modules () ::<void> Scm__TouchModules)
+
 (select-module gauche)
 (inline-stub
  (define-cfn module-print (obj port::ScmPort* _::ScmWriteContext*)
@@ -46,7 +46,8 @@
           socket-shutdown socket-close socket-bind socket-connect socket-fd
           socket-listen socket-accept socket-setsockopt socket-getsockopt
           socket-getsockname socket-getpeername socket-ioctl
-          socket-send socket-sendto socket-sendmsg socket-buildmsg
+          socket-send socket-sendv socket-sendto socket-sendmsg
+          socket-buildmsg
           socket-recv socket-recv! socket-recvfrom socket-recvfrom!
           <sockaddr> <sockaddr-in> <sockaddr-un> make-sockaddrs
           sockaddr-name sockaddr-family sockaddr-addr sockaddr-port
@@ -298,6 +299,10 @@
                            :optional (flags::<fixnum> 0))
   Scm_SocketSend)
 
+(define-cproc socket-sendv (sock::<socket> msgs
+                            :optional (flags::<fixnum> 0))
+  Scm_SocketSendV)
+
 (define-cproc socket-sendto (sock::<socket> msg to::<socket-address>
                              :optional (flags::<fixnum> 0))
   Scm_SocketSendTo)
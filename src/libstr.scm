@@ -38,6 +38,7 @@
            "gauche/vminsn.h"
            "gauche/priv/bignumP.h"
            "gauche/priv/stringP.h"
+           "gauche/priv/strsimdP.h"
            "gauche/priv/writerP.h"))
 
 ;; Ellipsis, used when output is truncated.
@@ -347,6 +348,20 @@
 (define-cproc %string-index-dump (s::<string> :optional (p::<port> (current-output-port))) ::<void>
   (Scm_StringBodyIndexDump (SCM_STRING_BODY s) p))
 
+;; Fast path of srfi-13 string-index with a character.  Returns a cursor
+;; or #f.
+(define-cproc %string-scan-char-cursor (s::<string> c::<char> start end)
+  Scm_StringScanCharCursor)
+
+;; Vector kernels used for string search (see strsimd.c).  Returns the
+;; level in use: 0 (scalar), 1 (SSE2) or 2 (AVX2).  If LEVEL is given,
+;; use it or the highest supported one below it.  Mainly for testing
+;; and benchmarking.
+(define-cproc %string-simd-level (:optional (level #f)) ::<int>
+  (if (SCM_FALSEP level)
+    (return (Scm__StringSimdLevel))
+    (return (Scm__SetStringSimdLevel (Scm_GetInteger level)))))
+
 ;;
 ;; Comparison
 ;;
@@ -48,6 +48,7 @@
   (.when "HAVE_SYS_LOADAVG_H"  (.include <sys/loadavg.h>))
   (.when "HAVE_UNISTD_H"       (.include <unistd.h>))
   (.when "HAVE_SYS_MMAN_H"     (.include <sys/mman.h>))
+  (.when "HAVE_SYS_EPOLL_H"    (.include <sys/epoll.h>))
 
   (.when (defined "GAUCHE_WINDOWS")
     (.undef _SC_CLK_TCK)) ;; avoid undefined reference to sysconf
@@ -1445,6 +1446,118 @@
    ) ;; when defined(HAVE_SELECT)
  )
 
+;; Timeout is given in the same way as sys-select: #f, a real number
+;; in microseconds, or a list of seconds and microseconds.  Returns
+;; microseconds, or #f for no timeout.  Used by gauche.selector and
+;; gauche.aio.
+(select-module gauche.internal)
+(define (%timeout->usec timeout)
+  (cond [(not timeout) #f]
+        [(and (real? timeout) (>= timeout 0)) (exact (floor timeout))]
+        [(and (list? timeout) (= (length timeout) 2)
+              (every (^x (and (exact-integer? x) (>= x 0))) timeout))
+         (+ (* (car timeout) 1000000) (cadr timeout))]
+        [else (error "timeout must be a nonnegative real number \
+                      (in microseconds) or a list of two integers \
+                      (seconds and microseconds), but got:" timeout)]))
+(select-module gauche)
+
+;;---------------------------------------------------------------------
+;; epoll
+;;   Low-level interface used by gauche.selector.  The epoll instance
+;;   is wrapped by <sys-epoll>, so that its fd is closed when the object
+;;   is collected.
+
+(inline-stub
+ (.when (defined "HAVE_SYS_EPOLL_H")
+   (define-ctype ScmSysEpoll::(.struct
+                               (SCM_HEADER :: ""
+                                fd::int   ; -1 if closed
+                                )))
+
+   (define-cclass <sys-epoll> :private ScmSysEpoll* "Scm_SysEpollClass" ()
+     ()
+     [printer
+      (Scm_Printf port "#<sys-epoll %d>" (-> (SCM_SYS_EPOLL obj) fd))])
+
+   (define-cfn epoll_finalize (obj _::void*) ::void :static
+     (let* ([ep::ScmSysEpoll* (SCM_SYS_EPOLL obj)])
+       (when (>= (-> ep fd) 0)
+         (close (-> ep fd))
+         (set! (-> ep fd) -1))))
+
+   (define-cise-stmt CHECK_EPOLL
+     [(_ ep)
+      `(when (< (-> ,ep fd) 0) (Scm_Error "epoll already closed: %S" ,ep))])
+
+   (.define EPOLL_WAIT_MAX 256)
+
+   (define-enum EPOLLIN)
+   (define-enum EPOLLOUT)
+   (define-enum EPOLLPRI)
+   (define-enum EPOLLERR)
+   (define-enum EPOLLHUP)
+   (define-enum EPOLLET)
+   (define-enum EPOLLONESHOT)
+   (define-enum-conditionally EPOLLRDHUP)
+   (define-enum EPOLL_CTL_ADD)
+   (define-enum EPOLL_CTL_MOD)
+   (define-enum EPOLL_CTL_DEL)
+
+   (define-cproc sys-epoll-create ()
+     (let* ([fd::int (epoll_create1 EPOLL_CLOEXEC)])
+       (when (< fd 0) (Scm_SysError "epoll_create1 failed"))
+       (let* ([z::ScmSysEpoll* (SCM_NEW ScmSysEpoll)])
+         (SCM_SET_CLASS z (& Scm_SysEpollClass))
+         (set! (-> z fd) fd)
+         (Scm_RegisterFinalizer (SCM_OBJ z) epoll_finalize NULL)
+         (return (SCM_OBJ z)))))
+
+   (define-cproc sys-epoll-close (ep::<sys-epoll>) ::<void>
+     (epoll_finalize (SCM_OBJ ep) NULL))
+
+   ;; NB: The kernel drops closed fds from the interest list by itself,
+   ;; so we don't complain if we're asked to delete such fd.
+   (define-cproc sys-epoll-ctl (ep::<sys-epoll> op::<int> port-or-fd
+                                events::<uint32>)
+     ::<void>
+     (CHECK_EPOLL ep)
+     (let* ([fd::int (Scm_GetPortFd port-or-fd TRUE)]
+            [ev::(struct epoll_event)]
+            [r::int 0])
+       (memset (& ev) 0 (sizeof ev))
+       (set! (ref ev events) events
+             (ref ev data fd) fd)
+       (SCM_SYSCALL r (epoll_ctl (-> ep fd) op fd (& ev)))
+       (when (and (< r 0)
+                  (not (and (== op EPOLL_CTL_DEL)
+                            (or (== errno EBADF) (== errno ENOENT)))))
+         (Scm_SysError "epoll_ctl failed on %S" port-or-fd))))
+
+   ;; Waits for events up to TIMEOUT milliseconds (negative to wait
+   ;; indefinitely), and stores the ready fds and their event bits into
+   ;; BUF alternately.  Returns the number of ready fds.  Nothing is
+   ;; allocated here, so the caller can reuse BUF for every wakeup.
+   (define-cproc sys-epoll-wait! (ep::<sys-epoll> buf::<s32vector>
+                                  timeout::<int>)
+     ::<int>
+     (CHECK_EPOLL ep)
+     (SCM_UVECTOR_CHECK_MUTABLE buf)
+     (let* ([evs::(.array (struct epoll_event) [EPOLL_WAIT_MAX])]
+            [n::int (cast int (/ (SCM_S32VECTOR_SIZE buf) 2))]
+            [v::int32_t* (SCM_S32VECTOR_ELEMENTS buf)]
+            [r::int 0])
+       (when (> n EPOLL_WAIT_MAX) (set! n EPOLL_WAIT_MAX))
+       (when (<= n 0) (Scm_Error "buffer too small: %S" buf))
+       (SCM_SYSCALL r (epoll_wait (-> ep fd) evs n timeout))
+       (when (< r 0) (Scm_SysError "epoll_wait failed"))
+       (dotimes [i r]
+         (set! (aref v (* i 2)) (ref (aref evs i) data fd)
+               (aref v (+ (* i 2) 1)) (cast int32_t (ref (aref evs i) events))))
+       (return r)))
+   ) ;; when defined(HAVE_SYS_EPOLL_H)
+ )
+
 ;;---------------------------------------------------------------------
 ;; miscellaneous
 
@@ -88,6 +88,9 @@
           latch-dec! latch-clear! latch-await
           <barrier> make-barrier barrier?
           barrier-reset! barrier-await barrier-broken?
+          <work-deque> make-work-deque work-deque? work-deque-name
+          work-deque-length work-deque-empty?
+          work-deque-push! work-deque-pop! work-deque-steal!
           ))
 (select-module gauche.threads)
 
@@ -578,3 +581,45 @@
              (condition-variable-broadcast! (~ barrier'cv))
              (mutex-unlock! (~ barrier'mutex))
              timeout-val]))))
+
+;;===============================================================
+;; Work-stealing deque
+;;
+
+;; A building block of work-stealing schedulers.  The thread that
+;; first pushes or pops becomes the owner; only the owner can push
+;; and pop (at the bottom), while any thread can steal (from the top).
+;; None of the operations locks.  See gauche/priv/wsdequeP.h.
+
+(inline-stub
+ (.include "gauche/priv/wsdequeP.h")
+ (declare-stub-type <work-deque> "ScmWorkDeque*")
+
+ (define-cproc make-work-deque (:optional (name #f)) Scm_MakeWorkDeque)
+ (define-cproc work-deque? (obj) ::<boolean> SCM_WORK_DEQUE_P)
+ (define-cproc work-deque-name (dq::<work-deque>) (return (-> dq name)))
+ (define-cproc work-deque-length (dq::<work-deque>) ::<fixnum>
+   Scm_WorkDequeLength)
+ (define-cproc work-deque-empty? (dq::<work-deque>) ::<boolean>
+   (return (== (Scm_WorkDequeLength dq) 0)))
+ (define-cproc work-deque-push! (dq::<work-deque> obj) ::<void>
+   Scm_WorkDequePush)
+ (define-cproc work-deque-pop! (dq::<work-deque> :optional fallback)
+   (let* ([r (Scm_WorkDequePop dq)])
+     (when (SCM_UNBOUNDP r)
+       (when (SCM_UNBOUNDP fallback)
+         (Scm_Error "work deque is empty: %S" dq))
+       (set! r fallback))
+     (return r)))
+ (define-cproc work-deque-steal! (dq::<work-deque> :optional fallback)
+   (let* ([r (Scm_WorkDequeSteal dq)])
+     (when (SCM_UNBOUNDP r)
+       (when (SCM_UNBOUNDP fallback)
+         (Scm_Error "work deque is empty: %S" dq))
+       (set! r fallback))
+     (return r)))
+
+ ;; Full memory barrier.  Schedulers built on work deques use it to
+ ;; check a waiter count without locking; see control.thread-pool.
+ (define-cproc %memory-barrier () ::<void> (Scm_AtomicThreadFence))
+ )
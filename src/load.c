@@ -74,6 +74,18 @@ static struct {
                                             searched. */
     ScmPrimitiveParameter *load_port;    /* current port from which we are
                                             loading */
+    ScmPrimitiveParameter *load_deps;    /* files and features the current
+                                            load depends on, for the compile
+                                            cache and the heap image.
+                                            #f if not recording. */
+    ScmPrimitiveParameter *require_feature; /* feature being loaded by
+                                               require.  Taken by
+                                               load-from-port, for the
+                                               heap image. */
+
+    /* Compile cache directory (see libeval.scm).  #f to disable the
+       compile cache, #t to use the default directory. */
+    ScmPrimitiveParameter *compile_cache_dir;
 
     /* Dynamic linking */
     ScmObj dso_suffixes;
@@ -895,6 +907,7 @@ static inline void require_error_cleanup(ScmVM *vm,
                                          ScmObj feature,
                                          ScmModule *prev_mod)
 {
+    Scm_PrimitiveParameterSet(vm, ldinfo.require_feature, SCM_FALSE);
     vm->module = prev_mod;
     (void)SCM_INTERNAL_MUTEX_LOCK(ldinfo.prov_mutex);
     ldinfo.providing = Scm_AssocDeleteX(feature, ldinfo.providing, SCM_CMP_EQUAL);
@@ -910,6 +923,9 @@ int do_require(ScmObj feature, int flags, ScmModule *base_mod,
     int loop = FALSE;
 
     load_packet_prepare(packet);
+    /* Even if the feature is already provided, a compile-time require
+       must be replayed when its compiled code is reused. */
+    Scm__TouchModules();
     if (!SCM_STRINGP(feature)) {
         ScmObj e = Scm_MakeError(Scm_Sprintf("require: string expected, but got %S\n", feature));
         if (flags&SCM_LOAD_PROPAGATE_ERROR) Scm_Raise(e, 0);
@@ -965,6 +981,7 @@ int do_require(ScmObj feature, int flags, ScmModule *base_mod,
     ScmLoadPacket xresult;
     ScmModule *prev_mod = vm->module;
     vm->module = base_mod;
+    Scm_PrimitiveParameterSet(vm, ldinfo.require_feature, feature);
 
     /* A bit awkward, but if SCM_LOAD_PROPAGATE_ERROR is given, we don't
        want to 'stop' the error, for we don't want to lose the stack trace.
@@ -987,6 +1004,7 @@ int do_require(ScmObj feature, int flags, ScmModule *base_mod,
         }
     }
     vm->module = prev_mod;
+    Scm_PrimitiveParameterSet(vm, ldinfo.require_feature, SCM_FALSE);
 
     /* Success */
     (void)SCM_INTERNAL_MUTEX_LOCK(ldinfo.prov_mutex);
@@ -1225,6 +1243,19 @@ ScmObj Scm_CurrentLoadHistory() { return PARAM_REF(Scm_VM(), load_history); }
 ScmObj Scm_CurrentLoadNext()    { return PARAM_REF(Scm_VM(), load_next); }
 ScmObj Scm_CurrentLoadPort()    { return PARAM_REF(Scm_VM(), load_port); }
 
+ScmObj Scm_CompileCacheDirectory(void)
+{
+    return PARAM_REF(Scm_VM(), compile_cache_dir);
+}
+
+void Scm_SetCompileCacheDirectory(ScmObj dir)
+{
+    if (!(SCM_BOOLP(dir) || SCM_STRINGP(dir))) {
+        Scm_Error("boolean or string required, but got: %S", dir);
+    }
+    Scm_PrimitiveParameterSet(Scm_VM(), ldinfo.compile_cache_dir, dir);
+}
+
 /*------------------------------------------------------------------
  * Initialization
  */
@@ -1286,6 +1317,15 @@ void Scm__InitLoad(void)
                                    SCM_NIL,
                                    SCM_PARAMETER_SHARED);
 
+    const char *cache_dir = Scm_GetEnv("GAUCHE_COMPILE_CACHE");
+    ldinfo.compile_cache_dir =
+        Scm_BindPrimitiveParameter(Scm_GaucheModule(),
+                                   "compile-cache-directory",
+                                   ((cache_dir && *cache_dir)
+                                    ? SCM_MAKE_STR_COPYING(cache_dir)
+                                    : SCM_FALSE),
+                                   SCM_PARAMETER_SHARED);
+
     /* NB: Some modules are built-in.  We'll register them to the
        provided list, in libomega.scm. */
     ldinfo.provided = SCM_NIL;
@@ -1303,4 +1343,13 @@ void Scm__InitLoad(void)
     PARAM_INIT(load_history, "current-load-history", SCM_NIL);
     PARAM_INIT(load_next, "current-load-next", SCM_NIL);
     PARAM_INIT(load_port, "current-load-port", SCM_FALSE);
+    ldinfo.load_deps =
+        Scm_BindPrimitiveParameter(Scm_GaucheInternalModule(),
+                                   "%load-dependencies", SCM_FALSE, 0);
+    ldinfo.require_feature =
+        Scm_BindPrimitiveParameter(Scm_GaucheInternalModule(),
+                                   "%require-feature", SCM_FALSE, 0);
+    /* Records of the heap image being dumped.  Only used in libeval.scm. */
+    (void)Scm_BindPrimitiveParameter(Scm_GaucheInternalModule(),
+                                     "%image-records", SCM_FALSE, 0);
 }
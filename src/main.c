@@ -64,6 +64,8 @@ int test_mode = FALSE;          /* add . and ../lib implicitly  */
 int profiling_mode = FALSE;     /* profile the script? */
 int stats_mode = FALSE;         /* collect stats (EXPERIMENTAL) */
 int version_mode = FALSE;       /* show version and exit (-V option) */
+const char *image_file = NULL;  /* heap image to load (--image) */
+const char *dump_image_file = NULL; /* heap image to dump (--dump-image) */
 
 ScmObj pre_cmds = SCM_NIL;      /* assoc list of commands that needs to be
                                    processed before entering repl.
@@ -93,7 +95,7 @@ ScmModule *default_toplevel_module = NULL;
 void usage(int errorp)
 {
     fprintf(errorp? stderr:stdout,
-            "Usage: gosh [-biqV][-I<path>][-A<path>][-u<module>][-m<module>][-l<file>][-L<file>][-e<expr>][-E<expr>][-p<type>][-F<feature>][-r<standard>][-f<flag>][--] [file]\n"
+            "Usage: gosh [-biqV][-I<path>][-A<path>][-u<module>][-m<module>][-l<file>][-L<file>][-e<expr>][-E<expr>][-p<type>][-F<feature>][-r<standard>][-f<flag>][-G<gc-option>][--image=<file>][--dump-image=<file>][--] [file]\n"
             "Options:\n"
             "  -V       Prints version and exits.\n"
             "  -h       Shows this message to stdout.\n"
@@ -134,6 +136,8 @@ void usage(int errorp)
             "      7               R7RS (R7RS-small)\n"
             "  -f<flag> Sets various flags\n"
             "      case-fold       uses case-insensitive reader (as in R5RS)\n"
+            "      compile-cache   caches compiled code of loaded files.  See also\n"
+            "                      GAUCHE_COMPILE_CACHE below.\n"
             "      include-verbose reports while including files\n"
             "      load-verbose    reports while loading files\n"
             "      no-inline       doesn't inline procedures & constants (combined\n"
@@ -151,6 +155,8 @@ void usage(int errorp)
             "                      doesn't run lambda lifting pass.\n"
             "      no-post-inline-pass\n"
             "                      doesn't run post-inline optimization pass.\n"
+            "      no-specialization-pass\n"
+            "                      doesn't specialize arithmetic by inferred types.\n"
             "      no-source-info  doesn't preserve source information for debugging\n"
             "      read-edit\n"
             "                      enables input-editing mode, if terminal supports it.\n"
@@ -166,6 +172,27 @@ void usage(int errorp)
             "                      prints warning when srfi-N is used as a feature id.\n"
             "      no-warn-srfi-feature-id\n"
             "                      doesn't print warning when srfi-N is used as a feature id.\n"
+            "  -G<gc-option> Sets GC parameters.  See also gc-configure!.\n"
+            "      markers=<n>     uses <n> threads for marking (0: automatic).\n"
+            "      incremental     enables incremental/generational collection.\n"
+            "      time-limit=<ms> pause time target of incremental collection.\n"
+            "      free-space-divisor=<n>\n"
+            "                      larger value uses less heap and more GC time.\n"
+            "      full-freq=<n>   number of partial collections between full\n"
+            "                      collections in incremental mode.\n"
+            "      max-heap-size=<size>\n"
+            "                      limits the heap size.  <size> can have k, m\n"
+            "                      or g suffix.\n"
+            "  --image=<file>\n"
+            "           Loads the heap image <file> made by --dump-image before\n"
+            "           processing other options.  The features saved in it are\n"
+            "           provided without loading files.  If the image is out of\n"
+            "           date or made with other load paths, it is ignored with a\n"
+            "           warning.  -I and -A are processed before the image.\n"
+            "  --dump-image=<file>\n"
+            "           Processes other options and loads the script file (without\n"
+            "           calling main), then saves the files loaded by require\n"
+            "           into the heap image <file> and exits.\n"
             "Environment variables:\n"
             "  GAUCHE_AVAILABLE_PROCESSORS\n"
             "      Value must be an integer.  If set, it overrides the number of\n"
@@ -174,6 +201,9 @@ void usage(int errorp)
             "  GAUCHE_ALLOW_UNDEFINED_TEST\n"
             "      Suppress a warning when #<undef> is used in the test expression\n"
             "      of branch instructions.\n"
+            "  GAUCHE_COMPILE_CACHE\n"
+            "      Directory to keep the compiled code of loaded files.  If set,\n"
+            "      loading a file that has been loaded before skips compilation.\n"
             "  GAUCHE_DYNLOAD_PATH\n"
             "      Directories separated by colon (on Unix) or semilcolon (on Windows)\n"
             "      to search dynamically loadable files.\n"
@@ -325,6 +355,9 @@ void further_options(const char *optarg)
     else if (strcmp(optarg, "no-lambda-lifting-pass") == 0) {
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NO_LIFTING);
     }
+    else if (strcmp(optarg, "no-specialization-pass") == 0) {
+        SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NO_SPECIALIZE);
+    }
     else if (strcmp(optarg, "no-dissolve-apply") == 0) {
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NODISSOLVE_APPLY);
     }
@@ -337,6 +370,11 @@ void further_options(const char *optarg)
     else if (strcmp(optarg, "include-verbose") == 0) {
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_INCLUDE_VERBOSE);
     }
+    else if (strcmp(optarg, "compile-cache") == 0) {
+        if (SCM_FALSEP(Scm_CompileCacheDirectory())) {
+            Scm_SetCompileCacheDirectory(SCM_TRUE);
+        }
+    }
     else if (strcmp(optarg, "case-fold") == 0) {
         SCM_VM_RUNTIME_FLAG_SET(vm, SCM_CASE_FOLD);
     }
@@ -386,11 +424,13 @@ void further_options(const char *optarg)
     }
     else {
         fprintf(stderr, "unknown -f option: %s\n", optarg);
-        fprintf(stderr, "supported options are: -fcase-fold, -fload-verbose, "
-                "-finclude-verbose, -fno-dissolve-apply -fno-inline, "
+        fprintf(stderr, "supported options are: -fcase-fold, -fcompile-cache, "
+                "-fload-verbose, -finclude-verbose, "
+                "-fno-dissolve-apply -fno-inline, "
                 "-fno-inline-globals, -fno-inline-locals, "
                 "-fno-inline-constants, -fno-inline-setters, -fno-source-info, "
                 "-fno-post-inline-pass, -fno-lambda-lifting-pass, "
+                "-fno-specialization-pass, "
                 "-fread-edit, -fno-read-edit, "
                 "-fsafe-string-cursors, -fwarn-legacy-syntax, "
                 "-fwarn-srfi-feature-id, -fno-warn-srfi-feature-id, "
@@ -424,10 +464,114 @@ void feature_options(const char *optarg)
     }
 }
 
+/* -G<name>[=<value>] sets a GC parameter.  Size can have k, m or g
+   suffix. */
+void gc_option(const char *optarg)
+{
+    char name[64];
+    size_t value = 1;
+    const char *eq = strchr(optarg, '=');
+    size_t namelen = eq? (size_t)(eq - optarg) : strlen(optarg);
+
+    if (namelen >= sizeof(name)) goto bad;
+    memcpy(name, optarg, namelen);
+    name[namelen] = '\0';
+    if (eq) {
+        char *end;
+        value = strtoul(eq+1, &end, 10);
+        if (end == eq+1) goto bad;
+        switch (*end) {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+        }
+        if (*end != '\0') goto bad;
+    }
+    switch (Scm_GCSetParameter(name, value)) {
+    case SCM_GC_PARAM_OK: return;
+    case SCM_GC_PARAM_UNKNOWN:
+        fprintf(stderr, "unknown -G option: %s\n", optarg);
+        fprintf(stderr, "supported options are: -Gmarkers=<n>, "
+                "-Gincremental, -Gtime-limit=<ms>, "
+                "-Gfree-space-divisor=<n>, -Gfull-freq=<n>, "
+                "or -Gmax-heap-size=<size>\n");
+        exit(1);
+    case SCM_GC_PARAM_TOO_LATE:
+        fprintf(stderr, "-G%s must be given before -Gincremental\n", name);
+        exit(1);
+    }
+  bad:
+    fprintf(stderr, "invalid -G option: %s\n", optarg);
+    exit(1);
+}
+
+/* GC parameters need to be set before GC is initialized, so we scan
+   -G options before everything else.  The number of markers is set
+   first, for enabling incremental mode initializes GC.
+   We walk argv the same way getopt() in parse_options() does, including
+   clustered flags such as -bGincremental, so that an argument of other
+   options is never taken as -G. */
+void scan_gc_options(int argc, char *argv[])
+{
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 1; i < argc; i++) {
+            const char *a = argv[i];
+            if (a[0] != '-' || a[1] == '\0' || strcmp(a, "--") == 0) break;
+            if (a[1] == '-') continue; /* long option */
+            for (const char *p = a+1; *p; p++) {
+                if (strchr("eEpmulLvrFfGIA", *p) == NULL) continue;
+                /* The option takes an argument; the rest of this word,
+                   or the next word. */
+                const char *opt = (p[1] != '\0')? p+1
+                    : (i+1 < argc)? argv[++i] : "";
+                if (*p == 'G') {
+                    int markers = (strncmp(opt, "markers", 7) == 0);
+                    if (pass == 0 && markers) gc_option(opt);
+                    if (pass == 1 && !markers) gc_option(opt);
+                }
+                break;
+            }
+        }
+    }
+}
+
+/* Long options are taken out of argv before getopt sees them.  Like
+   other options, they must come before the script file.  Returns the
+   new argc. */
+int scan_long_options(int argc, char *argv[])
+{
+    int i, j;
+    for (i = j = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (a[0] != '-' || a[1] == '\0' || strcmp(a, "--") == 0) break;
+        if (strncmp(a, "--image=", 8) == 0) {
+            image_file = a+8;
+            continue;
+        }
+        if (strncmp(a, "--dump-image=", 13) == 0) {
+            dump_image_file = a+13;
+            continue;
+        }
+        if (a[1] == '-') {
+            fprintf(stderr, "unknown option: %s\n", a);
+            usage(TRUE);
+        }
+        argv[j++] = argv[i];
+        /* Keep the argument of other options. */
+        if (a[2] == '\0' && strchr("eEpmulLvrFfGIA", a[1]) != NULL
+            && i+1 < argc) {
+            argv[j++] = argv[++i];
+        }
+    }
+    while (i < argc) argv[j++] = argv[i++];
+    argv[j] = NULL;
+    return j;
+}
+
 int parse_options(int argc, char *argv[])
 {
     int c;
-    while ((c = getopt(argc, argv, "+be:E:hip:ql:L:m:u:Vv:r:F:f:I:A:-")) >= 0) {
+    while ((c = getopt(argc, argv, "+be:E:hip:ql:L:m:u:Vv:r:F:f:G:I:A:-")) >= 0) {
         switch (c) {
         case 'b': batch_mode = TRUE; break;
         case 'i': interactive_mode = TRUE; break;
@@ -436,6 +580,7 @@ int parse_options(int argc, char *argv[])
         case 'f': further_options(optarg); break;
         case 'p': profiler_options(optarg); break;
         case 'F': feature_options(optarg); break;
+        case 'G': break;        /* processed by scan_gc_options() */
         case 'm':
             main_module = Scm_Intern(SCM_STRING(SCM_MAKE_STR_COPYING(optarg)));
             break;
@@ -726,6 +871,63 @@ static void process_command_args(ScmObj cmd_args)
     }
 }
 
+/* Processes -I and -A options in CMD_ARGS, and returns the rest. */
+static ScmObj process_load_path_args(ScmObj cmd_args)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL, cp;
+
+    SCM_FOR_EACH(cp, cmd_args) {
+        ScmObj p = SCM_CAR(cp);
+        ScmObj v = SCM_CDR(p);
+
+        switch (SCM_CHAR_VALUE(SCM_CAR(p))) {
+        case 'I':
+            Scm_AddLoadPath(Scm_GetStringConst(SCM_STRING(v)), FALSE);
+            break;
+        case 'A':
+            Scm_AddLoadPath(Scm_GetStringConst(SCM_STRING(v)), TRUE);
+            break;
+        default:
+            SCM_APPEND1(h, t, p);
+        }
+    }
+    return h;
+}
+
+/* Heap image (see libeval.scm) */
+static void load_image(const char *file)
+{
+    static ScmObj load_image_proc = SCM_UNDEFINED;
+    SCM_BIND_PROC(load_image_proc, "%load-image", Scm_GaucheInternalModule());
+
+    ScmEvalPacket epak;
+    if (Scm_Apply(load_image_proc, SCM_LIST1(SCM_MAKE_STR_COPYING(file)),
+                  &epak) < 0) {
+        error_exit(epak.exception);
+    }
+    if (SCM_STRINGP(epak.results[0])) {
+        Scm_Warn("heap image %s is ignored, since %A", file, epak.results[0]);
+    }
+}
+
+static void dump_image(const char *file, const char *scriptfile)
+{
+    static ScmObj dump_image_proc = SCM_UNDEFINED;
+    SCM_BIND_PROC(dump_image_proc, "%dump-image", Scm_GaucheInternalModule());
+
+    if (scriptfile != NULL) {
+        ScmLoadPacket lpak;
+        if (Scm_Load(scriptfile, SCM_LOAD_MAIN_SCRIPT, &lpak) < 0) {
+            error_exit(lpak.exception);
+        }
+    }
+    ScmEvalPacket epak;
+    if (Scm_Apply(dump_image_proc, SCM_LIST1(SCM_MAKE_STR_COPYING(file)),
+                  &epak) < 0) {
+        error_exit(epak.exception);
+    }
+}
+
 /* When scriptfile is provided, execute it.  Returns exit code. */
 int execute_script(const char *scriptfile, ScmObj args)
 {
@@ -842,6 +1044,7 @@ int main(int ac, char **av)
         }
     }
 
+    scan_gc_options(argc, argv);
     GC_INIT();
     Scm_Init(GAUCHE_SIGNATURE);
     sig_setup();
@@ -867,6 +1070,7 @@ int main(int ac, char **av)
     }
 
     /* Check command-line options */
+    argc = scan_long_options(argc, argv);
     int argind = parse_options(argc, argv);
 
     /* If -ftest option is given and we seem to be in the source
@@ -917,7 +1121,26 @@ int main(int ac, char **av)
         Scm_InitCommandLine2(1, (const char*[]){""}, SCM_COMMAND_LINE_SCRIPT);
     }
 
-    process_command_args(Scm_Reverse(pre_cmds));
+    /* The heap image is loaded before options, so that it can provide
+       the features the options require.  The load paths are set up
+       first, though, for an image is only valid with the load paths
+       it is made with. */
+    ScmObj cmds = Scm_Reverse(pre_cmds);
+    if (image_file != NULL || dump_image_file != NULL) {
+        cmds = process_load_path_args(cmds);
+    }
+    if (image_file != NULL) load_image(image_file);
+    if (dump_image_file != NULL) {
+        Scm_EvalCString("(%dump-image-start!)",
+                        SCM_OBJ(Scm_GaucheInternalModule()), NULL);
+    }
+
+    process_command_args(cmds);
+
+    if (dump_image_file != NULL) {
+        dump_image(dump_image_file, scriptfile);
+        Scm_Exit(0);
+    }
 
     /* Set up instruments. */
     ScmLoadPacket lpak;
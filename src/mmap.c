@@ -46,9 +46,10 @@
 #include <sys/mman.h>
 #endif
 
-static void mem_finalize(ScmObj obj, void *data SCM_UNUSED)
+/* Unmaps the region before it is collected.  It is safe to call this
+   more than once. */
+void Scm_SysMunmap(ScmMemoryRegion *m)
 {
-    ScmMemoryRegion *m = SCM_MEMORY_REGION(obj);
     if (m->ptr != NULL) {
 #if !defined(GAUCHE_WINDOWS)
         int r;
@@ -68,6 +69,11 @@ static void mem_finalize(ScmObj obj, void *data SCM_UNUSED)
     }
 }
 
+static void mem_finalize(ScmObj obj, void *data SCM_UNUSED)
+{
+    Scm_SysMunmap(SCM_MEMORY_REGION(obj));
+}
+
 static ScmObj make_memory_region(void *ptr, size_t size, int prot, int flags
 #if defined(GAUCHE_WINDOWS)
                                  , HANDLE fileMapping
@@ -134,6 +134,27 @@ static struct {
                                lookup_module may hold the lock. */
 } modules;
 
+/* Module stamp.  Bumped by every operation that changes the module
+ * system: creating a module, inserting or hiding a binding, importing,
+ * exporting, extending, sealing, and switching the current module.
+ * The compile cache (see load-from-port in libeval.scm) compares it
+ * before and after compiling a toplevel form, to find out whether
+ * the form has compile-time effects that need to be replayed.
+ * We don't lock it; a lost update still changes the value, and
+ * a false positive is harmless.
+ */
+static volatile u_long module_stamp = 0;
+
+u_long Scm__ModuleStamp(void)
+{
+    return module_stamp;
+}
+
+void Scm__TouchModules(void)
+{
+    module_stamp++;
+}
+
 /* Predefined modules - slots will be initialized by Scm__InitModule */
 #define DEFINE_STATIC_MODULE(cname) \
     static ScmModule cname;
@@ -180,6 +201,7 @@ static ScmObj make_module(ScmObj name, ScmHashTable *internal)
     ScmModule *m = SCM_NEW(ScmModule);
     SCM_SET_CLASS(m, SCM_CLASS_MODULE);
     init_module(m, name, internal);
+    module_stamp++;
     return SCM_OBJ(m);
 }
 
@@ -500,6 +522,10 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
 
     g->value = value;
     Scm_GlocMark(g, flags);
+    /* A placeholder binding inserted by the compiler for a toplevel
+       define carries nothing but its existence, which is recreated
+       by executing the definition.  So it doesn't count. */
+    if (!SCM_UNINITIALIZEDP(value)) module_stamp++;
     return g;
 }
 
@@ -547,6 +573,7 @@ void Scm_HideBinding(ScmModule *module, ScmSymbol *symbol)
         Scm_HashTableSet(module->external, SCM_OBJ(symbol), SCM_OBJ(g), 0);
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
+    module_stamp++;
 
     if (err_exists) {
         Scm_Error("hide-binding: binding already exists: %S (exports=%S)", SCM_OBJ(symbol), Scm_ModuleExports(module));
@@ -589,6 +616,7 @@ int Scm_AliasBinding(ScmModule *target, ScmSymbol *targetName,
     Scm_HashTableSet(target->external, SCM_OBJ(targetName), SCM_OBJ(g), 0);
     Scm_HashTableSet(target->internal, SCM_OBJ(targetName), SCM_OBJ(g), 0);
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    module_stamp++;
     return TRUE;
 }
 
@@ -643,6 +671,7 @@ ScmObj Scm_ImportModule(ScmModule *module,
         module->imported = p;
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
+    module_stamp++;
 
     return module->imported;
 }
@@ -741,6 +770,7 @@ ScmObj Scm_ExportSymbols(ScmModule *module, ScmObj specs)
         }
     }
 
+    module_stamp++;
     return SCM_UNDEFINED;  /* we might want to return something more useful...*/
 }
 
@@ -766,6 +796,7 @@ ScmObj Scm_ExportAll(ScmModule *module)
         }
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
+    module_stamp++;
     return SCM_OBJ(module);
 }
 
@@ -851,6 +882,7 @@ ScmObj Scm_ExtendModule(ScmModule *module, ScmObj supers)
         Scm_Error("can't extend those modules simultaneously because of inconsistent precedence lists: %S", supers);
     }
     module->mpl = Scm_Cons(SCM_OBJ(module), mpl);
+    module_stamp++;
     return module->mpl;
 }
 
@@ -864,6 +896,7 @@ ScmObj Scm_ExtendModule(ScmModule *module, ScmObj supers)
 void Scm_ModuleSeal(ScmModule *module)
 {
     module->sealed = TRUE;
+    module_stamp++;
 }
 
 /*----------------------------------------------------------------------
@@ -945,6 +978,7 @@ void Scm_SelectModule(ScmModule *mod)
 {
     SCM_ASSERT(SCM_MODULEP(mod));
     Scm_VM()->module = mod;
+    module_stamp++;
 }
 
 /*----------------------------------------------------------------------
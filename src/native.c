@@ -71,15 +71,27 @@ static long sys_getpagesize()
  */
 
 /*
- * For the time being, we use a fixed area (mmapped executable page)
- * as the scratch code pad, and simply manage it like a stack.  That is,
- * the region below free is 'used'.  It's enough for simple FFI, since
- * the generated code won't live after the dynamic extent of FFI call.
+ * We use mmapped executable pages as the scratch code pad, and simply
+ * manage it like a stack.  That is, the region below free is 'used'.
+ * It's enough for simple FFI, since the generated code won't live after
+ * the dynamic extent of FFI call.
+ *
+ * A code pad has a fixed size.  When a request doesn't fit in the current
+ * pad (e.g. nested FFI calls through callbacks, or a large stub), we
+ * allocate a fresh pad large enough for it and chain it on top of the
+ * current one.  Pads are popped again when the code in them is freed.
+ * Popped pads are just dropped; the finalizer of ScmMemoryRegion unmaps
+ * them.  The bottom pad is kept for the lifetime of the VM.
  */
-struct ScmCodeCacheRec {
+typedef struct ScmCodePadRec {
     ScmMemoryRegion *wpad;      /* writable page */
     ScmMemoryRegion *xpad;      /* executable page */
     void *free;
+    struct ScmCodePadRec *prev; /* pad below this one, or NULL */
+} ScmCodePad;
+
+struct ScmCodeCacheRec {
+    ScmCodePad *pad;            /* current (topmost) pad */
 };
 
 #define CODE_PAD_SIZE 4096
@@ -96,37 +108,60 @@ static ScmObj sym_f;
 static ScmObj sym_s;
 static ScmObj sym_v;
 
+static ScmCodePad *make_code_pad(size_t size, ScmCodePad *prev)
+{
+    ScmCodePad *pad = SCM_NEW(ScmCodePad);
+    Scm_SysMmapWX(size, &pad->wpad, &pad->xpad);
+    pad->free = pad->wpad->ptr;
+    pad->prev = prev;
+    return pad;
+}
+
+static inline int code_pad_contains(ScmCodePad *pad, void *ptr)
+{
+    return (ptr >= pad->wpad->ptr && ptr < pad->wpad->ptr + pad->wpad->size);
+}
+
 static void init_code_cache(ScmVM *vm) {
     if (vm->codeCache != NULL) return;
 
     ScmCodeCache *cc = SCM_NEW(ScmCodeCache);
-    Scm_SysMmapWX(CODE_PAD_SIZE, &cc->wpad, &cc->xpad);
-    cc->free = cc->wpad->ptr;
+    cc->pad = make_code_pad(CODE_PAD_SIZE, NULL);
     vm->codeCache = cc;
 }
 
 static inline void *allocate_code_cache(ScmVM *vm, size_t size)
 {
     ScmCodeCache *cc = vm->codeCache;
-    if (cc->free + size > cc->wpad->ptr + cc->wpad->size) {
-        Scm_Error("VM code cache overflow");
+    ScmCodePad *pad = cc->pad;
+    if (pad->free + size > pad->wpad->ptr + pad->wpad->size) {
+        long pagesize = sys_getpagesize();
+        size_t padsize = ((size+pagesize-1)/pagesize)*pagesize;
+        if (padsize < CODE_PAD_SIZE) padsize = CODE_PAD_SIZE;
+        pad = cc->pad = make_code_pad(padsize, pad);
     }
-    void *region = cc->free;
-    cc->free += size;
+    void *region = pad->free;
+    pad->free += size;
     return region;
 }
 
 static inline void free_code_cache(ScmVM *vm, void *ptr)
 {
     ScmCodeCache *cc = vm->codeCache;
-    SCM_ASSERT(ptr >= cc->wpad->ptr && ptr < cc->wpad->ptr + cc->wpad->size);
-    cc->free = ptr;
+    while (!code_pad_contains(cc->pad, ptr)) {
+        SCM_ASSERT(cc->pad->prev != NULL);
+        cc->pad = cc->pad->prev;
+    }
+    cc->pad->free = ptr;
 }
 
-/* Returns address in xpad that corresponds to the wpad_ptr. */
+/* Returns address in xpad that corresponds to the wpad_ptr.  WPAD_PTR
+   must be in the current pad, which is the case right after allocation. */
 static inline void *get_entry_address(ScmCodeCache *cc, void *wpad_ptr)
 {
-    return cc->xpad->ptr + (wpad_ptr - cc->wpad->ptr);
+    ScmCodePad *pad = cc->pad;
+    SCM_ASSERT(code_pad_contains(pad, wpad_ptr));
+    return pad->xpad->ptr + (wpad_ptr - pad->wpad->ptr);
 }
 
 /*
@@ -358,6 +393,40 @@ ScmObj Scm__AllocateCodePage(ScmU8Vector *code)
     return SCM_OBJ(xpad);
 }
 
+/*
+ * Code area for the baseline JIT (see vmjit.c).  Unlike the FFI scratch
+ * pad, code placed here is never freed; the translated code of a compiled
+ * code packet lives as long as the process.  Pads are chained so that
+ * they stay reachable.  Returns the executable address of the copy.
+ */
+
+#define JIT_PAD_SIZE 65536
+
+static struct {
+    ScmCodePad *pad;
+    ScmInternalMutex mutex;
+} jit_code_area = { NULL, SCM_INTERNAL_MUTEX_INITIALIZER };
+
+void *Scm__AllocateJitCode(const void *code, size_t size)
+{
+    void *entry;
+    size_t asize = (size + 15) & ~(size_t)15;
+
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(jit_code_area.mutex);
+    ScmCodePad *pad = jit_code_area.pad;
+    if (pad == NULL || pad->free + asize > pad->wpad->ptr + pad->wpad->size) {
+        long pagesize = sys_getpagesize();
+        size_t padsize = ((asize+pagesize-1)/pagesize)*pagesize;
+        if (padsize < JIT_PAD_SIZE) padsize = JIT_PAD_SIZE;
+        pad = jit_code_area.pad = make_code_pad(padsize, pad);
+    }
+    memcpy(pad->free, code, size);
+    entry = pad->xpad->ptr + (pad->free - pad->wpad->ptr);
+    pad->free += asize;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    return entry;
+}
+
 
 /*======================================================================
  * Initialization
@@ -291,7 +291,6 @@ ScmObj Scm_SocketAccept(ScmSocket *sock)
     Socket newfd;
     struct sockaddr_storage addrbuf;
     socklen_t addrlen = sizeof(addrbuf);
-    ScmClass *addrClass = Scm_ClassOf(SCM_OBJ(sock->address));
 
     CLOSE_CHECK(sock->fd, "accept from", sock);
 #if defined(GAUCHE_WINDOWS)
@@ -307,11 +306,20 @@ ScmObj Scm_SocketAccept(ScmSocket *sock)
             Scm_SysError("accept(2) failed");
         }
     }
+    return Scm_MakeAcceptedSocket(sock, newfd, (struct sockaddr*)&addrbuf,
+                                  addrlen);
+}
+
+/* Wraps NEWFD, a connection accepted on SOCK, with a socket object.
+   Also used by gauche.aio, which accepts connections asynchronously. */
+ScmObj Scm_MakeAcceptedSocket(ScmSocket *sock, Socket newfd,
+                              struct sockaddr *addr, socklen_t addrlen)
+{
+    ScmClass *addrClass = (sock->address
+                           ? Scm_ClassOf(SCM_OBJ(sock->address))
+                           : NULL);
     ScmSocket *newsock = make_socket(newfd, sock->type);
-    newsock->address =
-        SCM_SOCKADDR(Scm_MakeSockAddr(addrClass,
-                                      (struct sockaddr*)&addrbuf,
-                                      addrlen));
+    newsock->address = SCM_SOCKADDR(Scm_MakeSockAddr(addrClass, addr, addrlen));
     newsock->status = SCM_SOCKET_STATUS_CONNECTED;
     return SCM_OBJ(newsock);
 }
@@ -405,6 +413,64 @@ ScmObj Scm_SocketSendTo(ScmSocket *sock, ScmObj msg, ScmSockAddr *to,
     return SCM_MAKE_INT(r);
 }
 
+/* Send a list of strings/uvectors MSGS as if they're concatenated,
+   without copying them to a single buffer. */
+#define SENDV_MAX_IOV 64
+
+ScmObj Scm_SocketSendV(ScmSocket *sock, ScmObj msgs, int flags)
+{
+    ScmSmallInt len = Scm_Length(msgs);
+    if (len < 0) Scm_Error("proper list required, but got: %S", msgs);
+    CLOSE_CHECK(sock->fd, "send to", sock);
+#if !GAUCHE_WINDOWS
+#if defined(IOV_MAX)
+    /* Like send(2), we may send partially; the caller should check
+       the returned byte count. */
+    if (len > IOV_MAX) len = IOV_MAX;
+#endif
+    struct iovec iovs[SENDV_MAX_IOV];
+    struct iovec *iov = iovs;
+    if (len > SENDV_MAX_IOV) iov = SCM_NEW_ATOMIC_ARRAY(struct iovec, len);
+    int niov = 0;
+    ScmObj cp;
+    SCM_FOR_EACH(cp, msgs) {
+        if (niov >= len) break;
+        ScmSmallInt size;
+        const char *cmsg = get_message_body(SCM_CAR(cp), &size);
+        iov[niov].iov_base = (void*)cmsg;
+        iov[niov].iov_len = size;
+        niov++;
+    }
+
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = iov;
+    hdr.msg_iovlen = niov;
+    ssize_t r;
+    SCM_SYSCALL(r, sendmsg(sock->fd, &hdr, flags));
+    if (r < 0) Scm_SysError("sendmsg(2) failed");
+    return Scm_MakeInteger(r);
+#else  /*GAUCHE_WINDOWS*/
+    /* Check all messages first, then send them one by one. */
+    ScmObj cp;
+    SCM_FOR_EACH(cp, msgs) {
+        ScmSmallInt size;
+        (void)get_message_body(SCM_CAR(cp), &size);
+    }
+    ScmSmallInt total = 0;
+    SCM_FOR_EACH(cp, msgs) {
+        ScmSmallInt size;
+        int r;
+        const char *cmsg = get_message_body(SCM_CAR(cp), &size);
+        SCM_SYSCALL(r, send(sock->fd, cmsg, size, flags));
+        if (r < 0) Scm_SysError("send(2) failed");
+        total += r;
+        if (r < size) break;
+    }
+    return Scm_MakeInteger(total);
+#endif /*GAUCHE_WINDOWS*/
+}
+
 ScmObj Scm_SocketSendMsg(ScmSocket *sock, ScmObj msg, int flags)
 {
 #if !GAUCHE_WINDOWS
@@ -4403,6 +4403,10 @@ static ScmObj read_uint(const char **strp, int *lenp,
     u_long limit = longlimit[radix-SCM_RADIX_MIN], bdig = bigdig[radix-SCM_RADIX_MIN];
     u_long value_int = 0;
     ScmBignum *value_big = NULL;
+    /* Big digits read after value_big is set up.  They're combined
+       into value_big at once, which is much faster for long integers. */
+    u_long chunkbuf[64], *chunks = chunkbuf;
+    int nchunks = 0, chunkcap = 64;
     static const char tab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
 
     if (!SCM_FALSEP(initval)) {
@@ -4465,7 +4469,13 @@ static ScmObj read_uint(const char **strp, int *lenp,
                 value_int = digits = 0;
             }
         } else if (digits > diglimit) {
-            value_big = Scm_BignumAccMultAddUI(value_big, bdig, value_int);
+            if (nchunks == chunkcap) {
+                u_long *newchunks = SCM_NEW_ATOMIC_ARRAY(u_long, chunkcap*2);
+                memcpy(newchunks, chunks, chunkcap * sizeof(u_long));
+                chunks = newchunks;
+                chunkcap *= 2;
+            }
+            chunks[nchunks++] = value_int;
             value_int = digits = 0;
         }
     }
@@ -4482,6 +4492,10 @@ static ScmObj read_uint(const char **strp, int *lenp,
         return SCM_FALSE;       /* caller will handle this */
     }
     if (value_big == NULL) return Scm_MakeInteger(value_int);
+    if (nchunks > 0) {
+        value_big = Scm_BignumAccMultAddUIArray(value_big, bdig,
+                                                chunks, nchunks);
+    }
     if (digits > 0) {
         value_big = Scm_BignumAccMultAddUI(value_big,
                                            ipow(radix, digits),
@@ -35,12 +35,22 @@
 #include "gauche.h"
 #include "gauche/priv/configP.h"
 #include "gauche/priv/portP.h"
+#include "gauche/priv/mmapP.h"
 #include "gauche/priv/builtin-syms.h"
 
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #undef MAX
 #undef MIN
@@ -204,6 +214,16 @@ static void port_cleanup(ScmPort *port, _Bool final)
     case SCM_PORT_PROC:
         if (!final && PORT_VT(port)->Close) PORT_VT(port)->Close(port);
         break;
+    case SCM_PORT_ISTR:
+        if (P_(port)->internalFlags & SCM_PORT_ISTR_MAPPED) {
+            /* No string shares the mapped memory (see
+               Scm_GetRemainingInputString), so we can unmap it now. */
+            Scm_SysMunmap(SCM_MEMORY_REGION(P_(port)->srcOwner));
+            PORT_ISTR(port)->start = NULL;
+            PORT_ISTR(port)->current = NULL;
+            PORT_ISTR(port)->end = NULL;
+        }
+        break;
     default:
         break;
     }
@@ -270,6 +290,7 @@ static ScmPort *make_port(ScmClass *klass, ScmObj name, int dir, int type)
                             SCM_LIST2(SCM_SYM_READER_LEXICAL_MODE,
                                       Scm_ReaderLexicalMode()));
     port->link = SCM_FALSE;
+    port->srcOwner = SCM_FALSE;
     port->internalFlags = 0;
 
     /* If fast lock doesn't require finalization, we can skip to register
@@ -1459,6 +1480,22 @@ static ScmSize file_filler(ScmPort *p, ScmSize cnt)
     return nread;
 }
 
+/* Called when write(2) to the fd of a file port fails. */
+static void file_write_error(ScmPort *p)
+{
+    if (errno == EPIPE && PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) {
+        /* (sort of) emulate termination by SIGPIPE.
+           NB: The difference is visible from the outside world
+           as the process exit status differ (WIFEXITED
+           instead of WIFSIGNALED).  If it becomes a problem,
+           we can reset the signal handler to SIG_DFL and
+           send SIGPIPE to self. */
+        Scm_Exit(1);    /* exit code is somewhat arbitrary */
+    }
+    p->error = TRUE;
+    Scm_SysError("write failed on %S", p);
+}
+
 static ScmSize file_flusher(ScmPort *p, ScmSize cnt, int forcep)
 {
     ScmSize nwrote = 0;
@@ -1473,17 +1510,7 @@ static ScmSize file_flusher(ScmPort *p, ScmSize cnt, int forcep)
         errno = 0;
         SCM_SYSCALL(r, write(fd, datptr, datsiz-nwrote));
         if (r < 0) {
-            if (errno == EPIPE && PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) {
-                /* (sort of) emulate termination by SIGPIPE.
-                   NB: The difference is visible from the outside world
-                   as the process exit status differ (WIFEXITED
-                   instead of WIFSIGNALED).  If it becomes a problem,
-                   we can reset the signal handler to SIG_DFL and
-                   send SIGPIPE to self. */
-                Scm_Exit(1);    /* exit code is somewhat arbitrary */
-            }
-            p->error = TRUE;
-            Scm_SysError("write failed on %S", p);
+            file_write_error(p);
         } else {
             datptr += r;
             nwrote += r;
@@ -1614,6 +1641,306 @@ ScmObj Scm_MakePortWithFd(ScmObj name, int direction,
     return p;
 }
 
+/* Open a file as an input port whose content is the memory-mapped
+   image of the file.  It works as an input string port, so reading
+   doesn't involve system calls nor copying to the port buffer.
+   If the file can't be mapped, e.g. it is a pipe, we fall back to
+   an ordinary buffered port.  Returns #f if the file can't be opened.
+ */
+ScmObj Scm_OpenMmapInputPort(const char *path)
+{
+    int fd = open(path, O_RDONLY
+#if defined(O_BINARY)
+                  |O_BINARY
+#endif
+                  );
+    if (fd < 0) return SCM_FALSE;
+
+    ScmObj name = SCM_MAKE_STR_COPYING(path);
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+        || (uintmax_t)st.st_size > (uintmax_t)SIZE_MAX) {
+        return Scm_MakePortWithFd(name, SCM_PORT_INPUT, fd,
+                                  SCM_PORT_BUFFER_FULL, TRUE);
+    }
+
+    ScmObj region = SCM_FALSE;
+    if (st.st_size > 0) {
+        SCM_UNWIND_PROTECT {
+            region = Scm_SysMmap(NULL, fd, (size_t)st.st_size, 0,
+                                 PROT_READ, MAP_PRIVATE);
+        } SCM_WHEN_ERROR {
+            close(fd);
+            SCM_NEXT_HANDLER;
+        } SCM_END_PROTECT;
+    }
+    close(fd);
+
+    ScmPort *p = make_port(SCM_CLASS_PORT, name, SCM_PORT_INPUT,
+                           SCM_PORT_ISTR);
+    if (SCM_FALSEP(region)) {
+        PORT_ISTR(p)->start = PORT_ISTR(p)->current = PORT_ISTR(p)->end = "";
+    } else {
+        const char *start = SCM_MEMORY_REGION(region)->ptr;
+        PORT_ISTR(p)->start = PORT_ISTR(p)->current = start;
+        PORT_ISTR(p)->end = start + st.st_size;
+        P_(p)->srcOwner = region;
+        P_(p)->internalFlags |= SCM_PORT_ISTR_MAPPED;
+#if defined(SCM_INTERNAL_FASTLOCK_FINALIZATION_NOT_REQUIRED)
+        /* make_port doesn't do this for string ports. */
+        Scm_RegisterFinalizer(SCM_OBJ(p), port_finalize, NULL);
+#endif
+    }
+    return SCM_OBJ(p);
+}
+
+/*===============================================================
+ * Vectored output and fd-to-fd copying
+ *
+ *   If the port is directly connected to a file descriptor, we hand
+ *   the data to the kernel without copying it into the port buffer;
+ *   writev(2) for a list of buffers, and sendfile(2) between two fds.
+ *   For other ports these fall back to the ordinary port operations.
+ */
+
+#define WRITEV_MAX_IOV  64      /* # of iovecs passed to a writev call */
+#define SENDFILE_CHUNK  (1L<<24) /* max # of bytes per sendfile call */
+
+static int fd_port_p(ScmPort *p)
+{
+    return (SCM_PORT_TYPE(p) == SCM_PORT_FILE
+            && !SCM_PORT_CLOSED_P(p)
+            && file_buffered_port_p(p)
+            && FILE_PORT_FD(p) >= 0);
+}
+
+static const char *buffer_bytes(ScmObj obj, ScmSize *size)
+{
+    if (SCM_STRINGP(obj)) {
+        ScmSmallInt siz;
+        const char *s = Scm_GetStringContent(SCM_STRING(obj), &siz,
+                                             NULL, NULL);
+        *size = siz;
+        return s;
+    } else if (SCM_UVECTORP(obj)) {
+        *size = Scm_UVectorSizeInBytes(SCM_UVECTOR(obj));
+        return (const char*)SCM_UVECTOR_ELEMENTS(obj);
+    } else {
+        Scm_TypeError("buffer", "string or uniform vector", obj);
+        *size = 0;              /* dummy */
+        return NULL;
+    }
+}
+
+#if defined(HAVE_SYS_UIO_H)
+/* Write out BUFS to the fd of P.  P must be locked. */
+static void fd_writev(ScmPort *p, ScmObj bufs)
+{
+    struct iovec iov[WRITEV_MAX_IOV];
+    int fd = FILE_PORT_FD(p);
+    ScmObj cp = bufs;
+
+    bufport_flush(p, 0, TRUE);
+    while (SCM_PAIRP(cp)) {
+        int niov = 0;
+        ScmSize total = 0;
+        for (; SCM_PAIRP(cp) && niov < WRITEV_MAX_IOV; cp = SCM_CDR(cp)) {
+            ScmSize size;
+            const char *s = buffer_bytes(SCM_CAR(cp), &size);
+            if (size == 0) continue;
+            iov[niov].iov_base = (void*)s;
+            iov[niov].iov_len = size;
+            niov++;
+            total += size;
+        }
+
+        /* writev may write partially; skip over what's written and retry */
+        struct iovec *v = iov;
+        while (total > 0) {
+            ssize_t r;
+            SCM_SYSCALL(r, writev(fd, v, niov));
+            if (r < 0) file_write_error(p);
+            total -= r;
+            while (niov > 0 && (size_t)r >= v->iov_len) {
+                r -= v->iov_len;
+                v++;
+                niov--;
+            }
+            if (niov > 0) {
+                v->iov_base = (char*)v->iov_base + r;
+                v->iov_len -= r;
+            }
+        }
+    }
+}
+#endif /*HAVE_SYS_UIO_H*/
+
+static void port_writev(ScmPort *p, ScmObj bufs)
+{
+#if defined(HAVE_SYS_UIO_H)
+    if (fd_port_p(p)) {
+        fd_writev(p, bufs);
+        return;
+    }
+#endif /*HAVE_SYS_UIO_H*/
+    ScmObj cp;
+    SCM_FOR_EACH(cp, bufs) {
+        ScmSize size;
+        const char *s = buffer_bytes(SCM_CAR(cp), &size);
+        Scm_PutzUnsafe(s, size, p);
+    }
+}
+
+/* Writes out the contents of BUFS, a list of strings and/or uvectors,
+   to PORT as if they are concatenated.  Returns the number of bytes
+   written. */
+ScmSize Scm_PortWritev(ScmPort *port, ScmObj bufs)
+{
+    ScmSize total = 0;
+    ScmObj cp;
+
+    if (!SCM_OPORTP(port)) {
+        Scm_Error("output port required, but got: %S", port);
+    }
+    /* Check the arguments first, so that we won't write partially. */
+    SCM_FOR_EACH(cp, bufs) {
+        ScmSize size;
+        (void)buffer_bytes(SCM_CAR(cp), &size);
+        total += size;
+    }
+    if (!SCM_NULLP(cp)) Scm_Error("proper list required, but got: %S", bufs);
+
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(port, vm);
+    PORT_SAFE_CALL(port, port_writev(port, bufs), /*no cleanup*/);
+    PORT_UNLOCK(port);
+    return total;
+}
+
+/* Copies up to SIZE bytes (if SIZE < 0, until EOF) from the fd of SRC
+   to the fd of DST.  Both ports must be locked. */
+static ScmSize fd_sendfile(ScmPort *src, ScmPort *dst, ScmSize size)
+{
+    ScmSize total = 0;
+
+    /* Pass what SRC has already read into its buffer to DST first. */
+    for (;;) {
+        ScmSize avail = port_pending_bytes(src)
+            + (PORT_BUF(src)->end - PORT_BUF(src)->current);
+        if (size >= 0 && avail > size - total) avail = size - total;
+        if (avail <= 0) break;
+        char *buf = SCM_NEW_ATOMIC_ARRAY(char, avail);
+        ScmSize r = Scm_GetzUnsafe(buf, avail, src);
+        if (r <= 0) break;
+        Scm_PutzUnsafe(buf, r, dst);
+        total += r;
+    }
+    bufport_flush(dst, 0, TRUE);
+
+    int infd = FILE_PORT_FD(src);
+    int outfd = FILE_PORT_FD(dst);
+    ScmSize sent = 0;           /* bytes passed between fds */
+
+#if defined(HAVE_SYS_SENDFILE_H)
+    while (size < 0 || total + sent < size) {
+        size_t chunk = SENDFILE_CHUNK;
+        if (size >= 0 && size - total - sent < SENDFILE_CHUNK) {
+            chunk = size - total - sent;
+        }
+        ssize_t r;
+        SCM_SYSCALL(r, sendfile(outfd, infd, NULL, chunk));
+        if (r < 0) {
+            /* The kind of fds doesn't allow sendfile; e.g. the output
+               is opened with O_APPEND.  Use read/write. */
+            if (errno == EINVAL || errno == ENOSYS) break;
+            PORT_BYTES(src) += sent;
+            Scm_SysError("sendfile failed from %S to %S", src, dst);
+        }
+        if (r == 0) {
+            PORT_BYTES(src) += sent;
+            return total + sent;
+        }
+        sent += r;
+    }
+#endif /*HAVE_SYS_SENDFILE_H*/
+
+    char *buf = SCM_NEW_ATOMIC_ARRAY(char, SCM_PORT_DEFAULT_BUFSIZ);
+    while (size < 0 || total + sent < size) {
+        ScmSize chunk = SCM_PORT_DEFAULT_BUFSIZ;
+        if (size >= 0 && size - total - sent < chunk) {
+            chunk = size - total - sent;
+        }
+        ScmSize nread;
+        SCM_SYSCALL(nread, read(infd, buf, chunk));
+        if (nread < 0) {
+            PORT_BYTES(src) += sent;
+            src->error = TRUE;
+            Scm_SysError("read failed on %S", src);
+        }
+        if (nread == 0) break;
+        for (ScmSize nwrote = 0; nwrote < nread; ) {
+            ScmSize r;
+            SCM_SYSCALL(r, write(outfd, buf + nwrote, nread - nwrote));
+            if (r < 0) {
+                PORT_BYTES(src) += sent;
+                file_write_error(dst);
+            }
+            nwrote += r;
+        }
+        sent += nread;
+    }
+    PORT_BYTES(src) += sent;
+    return total + sent;
+}
+
+static ScmSize port_sendfile(ScmPort *src, ScmPort *dst, ScmSize size)
+{
+    if (fd_port_p(src) && fd_port_p(dst)) {
+        return fd_sendfile(src, dst, size);
+    }
+
+    char buf[SCM_PORT_DEFAULT_BUFSIZ];
+    ScmSize total = 0;
+    while (size < 0 || total < size) {
+        ScmSize chunk = SCM_PORT_DEFAULT_BUFSIZ;
+        if (size >= 0 && size - total < chunk) chunk = size - total;
+        ScmSize r = Scm_GetzUnsafe(buf, chunk, src);
+        if (r <= 0) break;
+        Scm_PutzUnsafe(buf, r, dst);
+        total += r;
+    }
+    return total;
+}
+
+/* Copies up to SIZE bytes from SRC to DST, or until EOF if SIZE < 0.
+   Returns the number of bytes copied. */
+ScmSize Scm_PortSendfile(ScmPort *src, ScmPort *dst, ScmSize size)
+{
+    volatile ScmSize r = 0;
+
+    if (!SCM_IPORTP(src)) {
+        Scm_Error("input port required, but got: %S", src);
+    }
+    if (!SCM_OPORTP(dst)) {
+        Scm_Error("output port required, but got: %S", dst);
+    }
+
+    /* NB: Always lock from src, then dst, as in Scm_LinkPorts. */
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(src, vm);
+    PORT_LOCK(dst, vm);
+    SCM_UNWIND_PROTECT {
+        r = port_sendfile(src, dst, size);
+    } SCM_WHEN_ERROR {
+        PORT_UNLOCK(dst);
+        PORT_UNLOCK(src);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    PORT_UNLOCK(dst);
+    PORT_UNLOCK(src);
+    return r;
+}
+
 /*===============================================================
  * String port
  */
@@ -1683,6 +2010,11 @@ ScmObj Scm_GetRemainingInputString(ScmPort *port, int flags)
        the port is pointing won't be changed. */
     const char *ep = PORT_ISTR(port)->end;
     const char *cp = PORT_ISTR(port)->current;
+    /* The memory of a memory-mapped port goes away when the port is
+       closed, so we can't share it. */
+    if (P_(port)->internalFlags & SCM_PORT_ISTR_MAPPED) {
+        flags |= SCM_STRING_COPYING;
+    }
     /* Things gets complicated if there's an ungotten char or bytes.
        We want to share the string body whenever possible, so we
        first check the ungotten stuff matches the content of the
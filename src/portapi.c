@@ -944,6 +944,25 @@ ScmObj readline_body(ScmPort *p)
 {
     ScmDString ds;
 
+    if (SCM_PORT_TYPE(p) == SCM_PORT_ISTR
+        && p->scrcnt == 0 && PORT_UNGOTTEN(p) == SCM_CHAR_INVALID) {
+        /* Fast path: we can scan the input directly. */
+        const char *s = PORT_ISTR(p)->current, *e = PORT_ISTR(p)->end;
+        if (s >= e) return SCM_EOF;
+        const char *q = s;
+        while (q < e && *q != '\n' && *q != '\r') q++;
+        ScmObj r = Scm_MakeString(s, q - s, -1, SCM_STRING_COPYING);
+        if (q < e) {
+            if (*q == '\r' && q+1 < e && q[1] == '\n') q++;
+            q++;
+            PORT_LINE(p)++;
+            reset_linked_column(p);
+        }
+        PORT_BYTES(p) += q - s;
+        PORT_ISTR(p)->current = q;
+        return r;
+    }
+
     Scm_DStringInit(&ds);
     int b1 = Scm_GetbUnsafe(p);
     if (b1 == EOF) return SCM_EOF;
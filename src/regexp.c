@@ -81,6 +81,11 @@
  * A possible fix is to check if recursion level exceeds some limit,
  * then save the C stack into heap (as in the C-stack-copying continuation
  * does) and reuse the stack area.
+ *
+ * Most regexps don't need backtracking features such as backreferences
+ * and lookaround assertions, though.  For them we run the same code
+ * with a Pike VM, which takes linear time and doesn't recurse.
+ * See "Pike VM" section below.
  */
 
 /* Instructions.  `RL' suffix indicates that the instruction moves the
@@ -93,6 +98,37 @@ enum {
     RE_NUM_INSN
 };
 
+/* Operand types of instructions.  See regexp_insn.h */
+enum {
+    OP_none,
+    OP_octet,
+    OP_string,
+    OP_cset,
+    OP_group,
+    OP_offset2,
+    OP_offset1_2,
+    OP_offset2_2
+};
+
+static const unsigned char re_optypes[] = {
+#define DEF_RE_INSN(_, optype) optype,
+#include "gauche/regexp_insn.h"
+#undef DEF_RE_INSN
+};
+
+/* Returns the length of the instruction at CODE, including operands. */
+static int re_insn_length(const unsigned char *code)
+{
+    switch (re_optypes[*code]) {
+    case OP_octet: case OP_cset: case OP_group: return 2;
+    case OP_string:    return 2 + code[1];
+    case OP_offset2:   return 3;
+    case OP_offset1_2: return 4;
+    case OP_offset2_2: return 5;
+    default:           return 1;
+    }
+}
+
 /* maximum # of {n,m}-type limited repeat count */
 #define MAX_LIMITED_REPEAT 255
 
@@ -102,6 +138,9 @@ enum {
 #define SCM_REGEXP_SIMPLE_PREFIX  (1L<<3) /* The regexp begins with a repeating
                                              character or charset, e.g. #/a+b/.
                                              See is_simple_prefixed() below. */
+#define SCM_REGEXP_BACKTRACK      (1L<<5) /* Always use the backtracking
+                                             matcher instead of the Pike VM.
+                                             See pike_count_insns() below. */
 
 /* AST - the first pass of regexp compiler creates intermediate AST.
  * Alternatively, you can provide AST directly to the regexp compiler,
@@ -172,9 +211,12 @@ static ScmRegexp *make_regexp(void)
     rx->sets = NULL;
     rx->grpNames = SCM_NIL;
     rx->mustMatch = NULL;
+    rx->mustOffset = -1;
+    rx->firstBytes = NULL;
     rx->flags = 0;
     rx->pattern = SCM_FALSE;
     rx->ast = SCM_FALSE;
+    rx->pike = NULL;
     return rx;
 }
 
@@ -211,6 +253,10 @@ static int regexp_compare(ScmObj x, ScmObj y, int equalp)
 
 #define REGEXP_OFFSET_MAX 65535
 
+/* Max # of words the Pike VM may use for a thread list.  Larger regexps
+   are run by the backtracking matcher. */
+#define PIKE_MAX_WORDS 65536
+
 /*=======================================================================
  * Compiler
  */
@@ -1870,6 +1916,162 @@ static ScmObj calculate_lasetn(ScmObj ast)
     else return calculate_laset(SCM_CAR(ast), SCM_CDR(ast));
 }
 
+/* Required literal.
+ *
+ * We look for a literal string that every match must contain, and if
+ * possible, its byte offset from the beginning of the match.  The
+ * matcher uses it to skip the input quickly.  Only the parts outside
+ * of case-folding are considered.  Anything we're not sure of breaks
+ * the run of literal characters; it is always safe to do so.
+ */
+
+#define MUST_MAX 64
+
+typedef struct must_ctx_rec {
+    char run[MUST_MAX];         /* current run of literal bytes */
+    int runlen;
+    int runoff;                 /* offset of run, or -1 */
+    int off;                    /* current offset, or -1 if it varies */
+    char best[MUST_MAX];        /* the best literal so far */
+    int bestlen;
+    int bestoff;
+} must_ctx;
+
+static void must_flush(must_ctx *ctx)
+{
+    if (ctx->runlen > ctx->bestlen
+        || (ctx->runlen == ctx->bestlen && ctx->runoff >= 0
+            && ctx->bestoff < 0)) {
+        memcpy(ctx->best, ctx->run, ctx->runlen);
+        ctx->bestlen = ctx->runlen;
+        ctx->bestoff = ctx->runoff;
+    }
+    ctx->runlen = 0;
+}
+
+/* An item of WIDTH bytes (-1 if unknown) that we can't use as literal. */
+static void must_break(must_ctx *ctx, int width)
+{
+    must_flush(ctx);
+    if (width < 0) ctx->off = -1;
+    else if (ctx->off >= 0) ctx->off += width;
+}
+
+static void must_char(must_ctx *ctx, ScmChar ch)
+{
+    int nb = SCM_CHAR_NBYTES(ch);
+    if (ctx->runlen + nb > MUST_MAX) must_flush(ctx);
+    if (ctx->runlen == 0) ctx->runoff = ctx->off;
+    SCM_CHAR_PUT(ctx->run + ctx->runlen, ch);
+    ctx->runlen += nb;
+    if (ctx->off >= 0) ctx->off += nb;
+}
+
+/* Width of a charset match in bytes, if we know it. */
+static int must_charset_width(ScmObj cs)
+{
+    return SCM_CHAR_SET_LARGE_P(cs)? -1 : 1;
+}
+
+static void must_rec(must_ctx *ctx, ScmObj ast)
+{
+    if (!SCM_PAIRP(ast)) {
+        if (SCM_CHARP(ast)) {
+            must_char(ctx, SCM_CHAR_VALUE(ast));
+        } else if (SCM_CHAR_SET_P(ast)) {
+            must_break(ctx, must_charset_width(ast));
+        } else if (SCM_EQ(ast, SCM_SYM_BOS) || SCM_EQ(ast, SCM_SYM_BOL)
+                   || SCM_EQ(ast, SCM_SYM_WB) || SCM_EQ(ast, SCM_SYM_NWB)
+                   || SCM_EQ(ast, SCM_SYM_BOW) || SCM_EQ(ast, SCM_SYM_EOW)
+                   || SCM_EQ(ast, SCM_SYM_BOG) || SCM_EQ(ast, SCM_SYM_EOG)
+                   || SCM_EQ(ast, SCM_SYM_EOS)) {
+            must_break(ctx, 0);
+        } else {
+            /* NB: eol may match a literal '$' in the middle. */
+            must_break(ctx, -1);
+        }
+        return;
+    }
+
+    ScmObj type = SCM_CAR(ast), ap;
+    if (SCM_EQ(type, SCM_SYM_SEQ) || SCM_EQ(type, SCM_SYM_SEQ_CASE)
+        || SCM_EQ(type, SCM_SYM_ONCE)) {
+        SCM_FOR_EACH(ap, SCM_CDR(ast)) must_rec(ctx, SCM_CAR(ap));
+    } else if (SCM_INTP(type)) {
+        SCM_FOR_EACH(ap, SCM_CDDR(ast)) must_rec(ctx, SCM_CAR(ap));
+    } else if (SCM_EQ(type, SCM_SYM_REP) || SCM_EQ(type, SCM_SYM_REP_WHILE)
+               || SCM_EQ(type, SCM_SYM_REP_MIN)) {
+        /* (rep <m> <n> . <ast>).  If m > 0, the first iteration
+           continues the current run. */
+        if (SCM_EQ(SCM_CADR(ast), SCM_MAKE_INT(0))) {
+            must_break(ctx, -1);
+        } else {
+            SCM_FOR_EACH(ap, SCM_CDR(SCM_CDDR(ast))) must_rec(ctx, SCM_CAR(ap));
+            must_break(ctx, -1);
+        }
+    } else if (SCM_EQ(type, SCM_SYM_COMP)) {
+        must_break(ctx, -1);
+    } else if (SCM_EQ(type, SCM_SYM_ASSERT) || SCM_EQ(type, SCM_SYM_NASSERT)
+               || SCM_EQ(type, SCM_SYM_LOOKBEHIND)) {
+        must_break(ctx, 0);
+    } else {
+        /* alt, seq-uncase, backref, cpat */
+        must_break(ctx, -1);
+    }
+}
+
+static void calculate_must(ScmRegexp *rx, ScmObj ast)
+{
+    must_ctx ctx;
+    ctx.runlen = ctx.bestlen = 0;
+    ctx.runoff = ctx.bestoff = -1;
+    ctx.off = 0;
+    must_rec(&ctx, ast);
+    must_flush(&ctx);
+    if (ctx.bestlen > 0) {
+        rx->mustMatch = SCM_STRING(Scm_MakeString(ctx.best, ctx.bestlen, -1,
+                                                  SCM_STRING_COPYING));
+        rx->mustOffset = ctx.bestoff;
+    }
+}
+
+/* Build a table of the first bytes of characters in laset.  In utf-8,
+   the first byte of the encoding grows monotonically with the codepoint,
+   so we can map each range of laset to a range of bytes.  If the match
+   always begins with a single ASCII character, we use it as mustMatch,
+   for it can be searched with memchr. */
+static void calculate_first_bytes(ScmRegexp *rx)
+{
+    if (!SCM_CHAR_SET_P(rx->laset)) return;
+
+    u_char *tab = SCM_NEW_ATOMIC_ARRAY(u_char, 256);
+    memset(tab, 0, 256);
+    ScmObj rp;
+    SCM_FOR_EACH(rp, Scm_CharSetRanges(SCM_CHAR_SET(rx->laset))) {
+        char lo[SCM_CHAR_MAX_BYTES], hi[SCM_CHAR_MAX_BYTES];
+        SCM_CHAR_PUT(lo, SCM_INT_VALUE(SCM_CAAR(rp)));
+        SCM_CHAR_PUT(hi, SCM_INT_VALUE(SCM_CDAR(rp)));
+        for (int b = (u_char)lo[0]; b <= (u_char)hi[0]; b++) tab[b] = 1;
+    }
+    rx->firstBytes = tab;
+
+    if (rx->mustMatch == NULL) {
+        int count = 0;
+        char c = 0;
+        for (int b = 0; b < 256; b++) {
+            if (tab[b]) { count++; c = (char)b; }
+        }
+        if (count == 1 && (u_char)c < 0x80) {
+            rx->mustMatch = SCM_STRING(Scm_MakeString(&c, 1, 1,
+                                                      SCM_STRING_COPYING));
+            rx->mustOffset = 0;
+        }
+    }
+}
+
+static int pike_count_insns(ScmRegexp *rx, int *pcmap, int *has_choice);
+static struct pike_prog_rec *pike_compile(ScmRegexp *rx);
+
 /* pass 3 */
 static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
 {
@@ -1881,6 +2083,8 @@ static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
     }
     else if (is_simple_prefixed(ast)) ctx->rx->flags |= SCM_REGEXP_SIMPLE_PREFIX;
     ctx->rx->laset = calculate_laset(ast, SCM_NIL);
+    calculate_must(ctx->rx, ast);
+    calculate_first_bytes(ctx->rx);
 
     /* pass 3-1 : count # of insns */
     ctx->codemax = 1;
@@ -1895,6 +2099,19 @@ static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
     ctx->rx->code = ctx->code;
     ctx->rx->numCodes = ctx->codep;
 
+    /* The Pike VM is worth only if the code has choice points; otherwise
+       the backtracking matcher never backtracks. */
+    int has_choice = FALSE;
+    int ninsns = pike_count_insns(ctx->rx, NULL, &has_choice);
+    if (ninsns < 0 || !has_choice
+        || ninsns * (ctx->rx->numGroups*2 + 1) > PIKE_MAX_WORDS) {
+        ctx->rx->flags |= SCM_REGEXP_BACKTRACK;
+    } else {
+        /* Built here, so that the regexp is immutable once it's
+           returned and can be shared by threads safely. */
+        ctx->rx->pike = pike_compile(ctx->rx);
+    }
+
     ctx->rx->ast = ast;
     return SCM_OBJ(ctx->rx);
 }
@@ -1908,31 +2125,19 @@ void Scm_RegDump(ScmRegexp *rx)
 #undef DEF_RE_INSN
     };
 
-    static enum {
-        OP_none,
-        OP_octet,
-        OP_string,
-        OP_cset,
-        OP_group,
-        OP_offset2,
-        OP_offset1_2,
-        OP_offset2_2
-    } optypes[] = {
-#define DEF_RE_INSN(_, optype) optype,
-#include "gauche/regexp_insn.h"
-#undef DEF_RE_INSN
-    };
-
     Scm_Printf(SCM_CUROUT, "Regexp %p: (flags=%08x", rx, rx->flags);
     if (rx->flags&SCM_REGEXP_BOL_ANCHORED)
         Scm_Printf(SCM_CUROUT, ",BOL_ANCHORED");
     if (rx->flags&SCM_REGEXP_SIMPLE_PREFIX)
         Scm_Printf(SCM_CUROUT, ",SIMPLE_PREFIX");
+    if (rx->flags&SCM_REGEXP_BACKTRACK)
+        Scm_Printf(SCM_CUROUT, ",BACKTRACK");
     Scm_Printf(SCM_CUROUT, ")\n");
     Scm_Printf(SCM_CUROUT, " laset = %S\n", rx->laset);
     Scm_Printf(SCM_CUROUT, "  must = ");
     if (rx->mustMatch) {
-        Scm_Printf(SCM_CUROUT, "%S\n", rx->mustMatch);
+        Scm_Printf(SCM_CUROUT, "%S (offset %d)\n", rx->mustMatch,
+                   rx->mustOffset);
     } else {
         Scm_Printf(SCM_CUROUT, "(none)\n");
     }
@@ -1940,7 +2145,7 @@ void Scm_RegDump(ScmRegexp *rx)
     int end = rx->numCodes;
     for (int codep = 0; codep < end; codep++) {
         int code = rx->code[codep];
-        int optype = optypes[code];
+        int optype = re_optypes[code];
         Scm_Printf(SCM_CUROUT, "%4d  ", codep);
         switch (optype) {
         case OP_none:
@@ -2805,6 +3010,508 @@ static inline const char *skip_input(const char *start, const char *limit,
     return limit;
 }
 
+/* Find a literal LIT of LEN bytes within [P, END).  Memchr is usually
+   vectorized in libc, so we let it find the candidates. */
+static const char *find_literal(const char *p, const char *end,
+                                const char *lit, int len)
+{
+    while (end - p >= len) {
+        const char *q = memchr(p, (u_char)lit[0], end - p - len + 1);
+        if (q == NULL) return NULL;
+        if (memcmp(q + 1, lit + 1, len - 1) == 0) return q;
+        p = q + 1;
+    }
+    return NULL;
+}
+
+/* Returns the first position in [P, LIMIT] where a match can begin,
+   judging from mustMatch and firstBytes, or NULL if there's none.
+   *MUSTP keeps the last found position of mustMatch; it must be
+   initialized to NULL, and once we return NULL, we shouldn't be called
+   again with a greater P. */
+static const char *next_candidate(ScmRegexp *rx, const char **mustp,
+                                  const char *p, const char *limit,
+                                  const char *end)
+{
+    const char *q;
+    do {
+        if (p > limit) return NULL;
+        q = p;
+        if (rx->mustMatch) {
+            const ScmStringBody *mb = SCM_STRING_BODY(rx->mustMatch);
+            int off = rx->mustOffset;
+            const char *from = (off >= 0)? p + off : p;
+            if (*mustp == NULL || *mustp < from) {
+                if (from > end) return NULL;
+                *mustp = find_literal(from, end, SCM_STRING_BODY_START(mb),
+                                      SCM_STRING_BODY_SIZE(mb));
+                if (*mustp == NULL) return NULL;
+            }
+            if (off >= 0) {
+                /* The bytes before mustMatch may not be the ones we
+                   expected; make sure we're at a character boundary. */
+                p = *mustp - off;
+                while (p < end && ((u_char)*p & 0xc0) == 0x80) p++;
+                if (p > limit) return NULL;
+            }
+        }
+        if (rx->firstBytes) {
+            while (p < end && !rx->firstBytes[(u_char)*p]) p++;
+            if (p >= end) return NULL;
+        }
+    } while (p != q);
+    return p;
+}
+
+/*=======================================================================
+ * Pike VM
+ */
+
+/* The Pike VM runs all the possible paths of the match in parallel,
+ * advancing them one character at a time.  Each path (thread) has
+ * its own capture slots.  The threads are kept in priority order, and
+ * when a thread reaches an instruction at the same input position as
+ * a thread of higher priority, it is dropped, for it can't produce
+ * a better match.  So the time is bounded by the input length times
+ * the code size, and we don't use the C stack at all.
+ *
+ * The program for the Pike VM is translated from the bytecode on
+ * demand.  The translation keeps the order of choices, so we get the
+ * same match as the backtracking matcher:
+ *
+ *  - TRY becomes SPLIT, which prefers the next instruction.
+ *  - BEGIN and END become SAVE.
+ *  - A string match becomes a sequence of single character matches.
+ *  - A repeating match such as SETR never gives back what it consumed.
+ *    It becomes a greedy loop followed by NOT_AHEAD, which fails if
+ *    the loop could go on.
+ *
+ * The bytecode that uses backreferences, lookaround assertions,
+ * conditional patterns, standalone patterns or grapheme boundaries
+ * can't be translated; it is always run by the backtracking matcher.
+ */
+
+enum {
+    /* consumes a character */
+    PI_CHAR,                    /* ch */
+    PI_CHAR_CI,                 /* ch, case insensitive */
+    PI_CHAR1_CI,                /* ch, case insensitive, single-byte only */
+    PI_ANY,
+    PI_SET,                     /* cset */
+    PI_NSET,                    /* cset */
+    PI_MATCH,
+    /* doesn't consume */
+    PI_SPLIT,                   /* try x, then y */
+    PI_JUMP,                    /* x */
+    PI_SAVE,                    /* x is a capture slot */
+    PI_ASSERT,                  /* x is RE_BOS, RE_BOL etc. */
+    PI_NOT_AHEAD,               /* fails if insns[pc-2] matches */
+    PI_FAIL
+};
+
+typedef struct pike_insn_rec {
+    int op;
+    int x;
+    int y;
+    ScmChar ch;
+    ScmCharSet *cset;
+} pike_insn;
+
+typedef struct pike_prog_rec {
+    int ninsns;
+    pike_insn *insns;
+} pike_prog;
+
+/* Counts the # of Pike VM instructions translated from rx->code.
+   If PCMAP isn't NULL, the index of the translated instruction for each
+   bytecode offset is stored in it.  Returns -1 if the code contains an
+   instruction the Pike VM can't handle.  HAS_CHOICE is set to TRUE
+   if the code contains TRY. */
+static int pike_count_insns(ScmRegexp *rx, int *pcmap, int *has_choice)
+{
+    const unsigned char *code = rx->code;
+    int n = 0;
+
+    for (int i = 0; i < rx->numCodes; i += re_insn_length(code + i)) {
+        if (pcmap) pcmap[i] = n;
+        switch (code[i]) {
+        case RE_MATCH: case RE_MATCH_CI: {
+            const unsigned char *p = code + i + 2, *e = p + code[i+1];
+            for (; p < e; p += SCM_CHAR_NFOLLOWS(*p) + 1) n++;
+            break;
+        }
+        case RE_SET1R: case RE_NSET1R: case RE_SETR: case RE_NSETR:
+        case RE_MATCH1R: case RE_MATCHR: case RE_ANYR:
+            n += 4;
+            break;
+        case RE_TRY:
+            *has_choice = TRUE;
+            n++;
+            break;
+        case RE_MATCH1: case RE_MATCH1_CI: case RE_ANY:
+        case RE_SET: case RE_NSET: case RE_SET1: case RE_NSET1:
+        case RE_JUMP: case RE_FAIL: case RE_SUCCESS:
+        case RE_BEGIN: case RE_END:
+        case RE_BOS: case RE_EOS: case RE_BOL: case RE_EOL:
+        case RE_BOW: case RE_EOW: case RE_WB: case RE_NWB:
+            n++;
+            break;
+        default:
+            return -1;
+        }
+    }
+    if (pcmap) pcmap[rx->numCodes] = n;
+    return n;
+}
+
+static void pike_put(pike_insn *insn, int op, int x, int y,
+                     ScmChar ch, ScmCharSet *cset)
+{
+    insn->op = op;
+    insn->x = x;
+    insn->y = y;
+    insn->ch = ch;
+    insn->cset = cset;
+}
+
+static pike_prog *pike_compile(ScmRegexp *rx)
+{
+    const unsigned char *code = rx->code;
+    int *pcmap = SCM_NEW_ATOMIC_ARRAY(int, rx->numCodes + 1);
+    int has_choice = FALSE;
+    int n = pike_count_insns(rx, pcmap, &has_choice);
+    SCM_ASSERT(n >= 0);
+
+    pike_insn *insns = SCM_NEW_ARRAY(pike_insn, n);
+    int k = 0;
+    for (int i = 0; i < rx->numCodes; i += re_insn_length(code + i)) {
+        const unsigned char *c = code + i;
+        switch (*c) {
+        case RE_MATCH: case RE_MATCH_CI: {
+            int op = (*c == RE_MATCH)? PI_CHAR : PI_CHAR_CI;
+            const char *p = (const char*)c + 2, *e = p + c[1];
+            while (p < e) {
+                ScmChar ch;
+                SCM_CHAR_GET(p, ch);
+                pike_put(&insns[k++], op, 0, 0, ch, NULL);
+                p += SCM_CHAR_NBYTES(ch);
+            }
+            break;
+        }
+        case RE_MATCH1:
+            pike_put(&insns[k++], PI_CHAR, 0, 0, c[1], NULL);
+            break;
+        case RE_MATCH1_CI:
+            pike_put(&insns[k++], PI_CHAR1_CI, 0, 0, c[1], NULL);
+            break;
+        case RE_ANY:
+            pike_put(&insns[k++], PI_ANY, 0, 0, 0, NULL);
+            break;
+        case RE_SET: case RE_SET1:
+            pike_put(&insns[k++], PI_SET, 0, 0, 0, rx->sets[c[1]]);
+            break;
+        case RE_NSET: case RE_NSET1:
+            pike_put(&insns[k++], PI_NSET, 0, 0, 0, rx->sets[c[1]]);
+            break;
+        case RE_TRY:
+            pike_put(&insns[k], PI_SPLIT, k+1, pcmap[c[1]*256 + c[2]], 0, NULL);
+            k++;
+            break;
+        case RE_JUMP:
+            pike_put(&insns[k++], PI_JUMP, pcmap[c[1]*256 + c[2]], 0, 0, NULL);
+            break;
+        case RE_FAIL:
+            pike_put(&insns[k++], PI_FAIL, 0, 0, 0, NULL);
+            break;
+        case RE_SUCCESS:
+            pike_put(&insns[k++], PI_MATCH, 0, 0, 0, NULL);
+            break;
+        case RE_BEGIN:
+            pike_put(&insns[k++], PI_SAVE, c[1]*2, 0, 0, NULL);
+            break;
+        case RE_END:
+            pike_put(&insns[k++], PI_SAVE, c[1]*2+1, 0, 0, NULL);
+            break;
+        case RE_SET1R: case RE_NSET1R: case RE_SETR: case RE_NSETR:
+        case RE_MATCH1R: case RE_MATCHR: case RE_ANYR: {
+            /*  k:   SPLIT k+1 k+3
+                k+1: <match one>
+                k+2: JUMP k
+                k+3: NOT_AHEAD      */
+            pike_insn *body = &insns[k+1];
+            switch (*c) {
+            case RE_SET1R: case RE_SETR:
+                pike_put(body, PI_SET, 0, 0, 0, rx->sets[c[1]]);
+                break;
+            case RE_NSET1R: case RE_NSETR:
+                pike_put(body, PI_NSET, 0, 0, 0, rx->sets[c[1]]);
+                break;
+            case RE_MATCH1R:
+                pike_put(body, PI_CHAR, 0, 0, c[1], NULL);
+                break;
+            case RE_MATCHR: {
+                ScmChar ch;
+                SCM_CHAR_GET((const char*)c + 2, ch);
+                pike_put(body, PI_CHAR, 0, 0, ch, NULL);
+                break;
+            }
+            default:
+                pike_put(body, PI_ANY, 0, 0, 0, NULL);
+                break;
+            }
+            pike_put(&insns[k], PI_SPLIT, k+1, k+3, 0, NULL);
+            pike_put(&insns[k+2], PI_JUMP, k, 0, 0, NULL);
+            pike_put(&insns[k+3], PI_NOT_AHEAD, 0, 0, 0, NULL);
+            k += 4;
+            break;
+        }
+        default:
+            /* BOS, EOS, BOL, EOL, BOW, EOW, WB and NWB */
+            pike_put(&insns[k++], PI_ASSERT, *c, 0, 0, NULL);
+            break;
+        }
+    }
+    SCM_ASSERT(k == n);
+
+    pike_prog *prog = SCM_NEW(pike_prog);
+    prog->ninsns = n;
+    prog->insns = insns;
+    return prog;
+}
+
+static inline int pike_char_match(const pike_insn *insn, ScmChar ch)
+{
+    switch (insn->op) {
+    case PI_CHAR:     return ch == insn->ch;
+    case PI_CHAR_CI:  return Scm_CharDowncase(ch) == insn->ch;
+    case PI_CHAR1_CI: return (SCM_CHAR_NBYTES(ch) == 1
+                              && SCM_CHAR_DOWNCASE(ch) == insn->ch);
+    case PI_ANY:      return TRUE;
+    case PI_SET:      return Scm_CharSetContains(insn->cset, ch);
+    case PI_NSET:     return !Scm_CharSetContains(insn->cset, ch);
+    default:          return FALSE;
+    }
+}
+
+static int pike_assert(struct match_ctx *ctx, const char *input, int code)
+{
+    switch (code) {
+    case RE_BOS: return input == ctx->input;
+    case RE_EOS: return input == ctx->stop;
+    case RE_BOL: return is_beginning_of_line(ctx, input);
+    case RE_EOL: return is_end_of_line(ctx, input);
+    case RE_NWB: return !is_word_boundary(ctx, input, RE_WB);
+    default:     return is_word_boundary(ctx, input, code);
+    }
+}
+
+/* A list of threads at the same input position, in priority order. */
+typedef struct pike_list_rec {
+    int n;
+    int *pcs;
+    const char **caps;          /* nslots entries per thread */
+} pike_list;
+
+typedef struct pike_ctx_rec {
+    struct match_ctx *mctx;     /* for assertions */
+    const pike_insn *insns;
+    int nslots;                 /* # of capture slots */
+    u_int gen;                  /* incremented for each new list */
+    u_int *visited;             /* gen when the insn is visited */
+    struct pike_frame {         /* stack to follow SPLITs */
+        int pc;                 /* -1 to restore a capture slot */
+        int slot;
+        const char *saved;
+    } *stack;
+    const char **caps;          /* capture slots of the current path */
+} pike_ctx;
+
+/* Adds the threads starting from PC at INPUT to list L, following
+   non-consuming instructions.  CAPS is the capture slots of the
+   thread.  Instructions already visited in the current generation are
+   skipped, for a thread of higher priority has been there.  Each
+   instruction is visited at most once, so the stack never overflows. */
+static void pike_add(pike_ctx *ctx, pike_list *l, int pc,
+                     const char *input, const char **caps)
+{
+    int sp = 0;
+
+    memcpy(ctx->caps, caps, ctx->nslots * sizeof(const char*));
+    ctx->stack[sp++].pc = pc;
+    while (sp > 0) {
+        struct pike_frame f = ctx->stack[--sp];
+        if (f.pc < 0) {
+            ctx->caps[f.slot] = f.saved;
+            continue;
+        }
+        for (pc = f.pc; ctx->visited[pc] != ctx->gen;) {
+            const pike_insn *insn = &ctx->insns[pc];
+            ctx->visited[pc] = ctx->gen;
+            if (insn->op == PI_JUMP) {
+                pc = insn->x;
+            } else if (insn->op == PI_SPLIT) {
+                ctx->stack[sp++].pc = insn->y;
+                pc = insn->x;
+            } else if (insn->op == PI_SAVE) {
+                ctx->stack[sp].pc = -1;
+                ctx->stack[sp].slot = insn->x;
+                ctx->stack[sp].saved = ctx->caps[insn->x];
+                sp++;
+                ctx->caps[insn->x] = input;
+                pc++;
+            } else if (insn->op == PI_ASSERT) {
+                if (!pike_assert(ctx->mctx, input, insn->x)) break;
+                pc++;
+            } else if (insn->op == PI_NOT_AHEAD) {
+                if (input < ctx->mctx->stop) {
+                    ScmChar ch;
+                    SCM_CHAR_GET(input, ch);
+                    if (pike_char_match(insn - 2, ch)) break;
+                }
+                pc++;
+            } else {
+                if (insn->op != PI_FAIL) {
+                    l->pcs[l->n] = pc;
+                    memcpy(l->caps + l->n * ctx->nslots, ctx->caps,
+                           ctx->nslots * sizeof(const char*));
+                    l->n++;
+                }
+                break;
+            }
+        }
+    }
+}
+
+/* The work area of rex_pike is allocated as one chunk.  If it's small
+   enough, it is on the C stack, so that a match doesn't allocate
+   except the result. */
+#define PIKE_LOCAL_WORDS 1024
+
+static size_t pike_work_size(int ninsns, int nslots)
+{
+    return sizeof(struct pike_frame) * (ninsns + 1)
+        + sizeof(const char*) * nslots * (2*ninsns + 3)
+        + sizeof(int) * 2 * ninsns
+        + sizeof(u_int) * ninsns;
+}
+
+/* Carves N elements of TYPE from the work area at *P. */
+#define PIKE_CARVE(p, type, n) \
+    ((type*)(((p) += sizeof(type)*(n)) - sizeof(type)*(n)))
+
+/* Same as rex(), except that this one tries all start positions
+   from START. */
+static ScmObj rex_pike(ScmRegexp *rx, ScmString *orig,
+                       const char *orig_start,
+                       const char *start, const char *end)
+{
+    const pike_prog *prog = (const pike_prog*)rx->pike;
+    SCM_ASSERT(prog != NULL);   /* built by rc3 */
+
+    struct match_ctx mctx;
+    mctx.rx = rx;
+    mctx.codehead = rx->code;
+    mctx.input = orig_start;
+    mctx.stop = end;
+    mctx.matches = NULL;
+    mctx.grapheme_predicate = SCM_UNDEFINED;
+
+    int n = prog->ninsns, nslots = rx->numGroups * 2;
+    intptr_t localbuf[PIKE_LOCAL_WORDS];
+    size_t worksize = pike_work_size(n, nslots);
+    char *work = (worksize <= sizeof(localbuf))
+        ? (char*)localbuf
+        : SCM_NEW_ATOMIC2(char*, worksize);
+
+    /* Pointer-sized ones first, to keep the alignment. */
+    pike_ctx ctx;
+    ctx.mctx = &mctx;
+    ctx.insns = prog->insns;
+    ctx.nslots = nslots;
+    ctx.gen = 1;
+    ctx.stack = PIKE_CARVE(work, struct pike_frame, n + 1);
+    ctx.caps = PIKE_CARVE(work, const char*, nslots);
+
+    pike_list lists[2];
+    pike_list *cl = &lists[0], *nl = &lists[1];
+    cl->n = nl->n = 0;
+    cl->caps = PIKE_CARVE(work, const char*, n * nslots);
+    nl->caps = PIKE_CARVE(work, const char*, n * nslots);
+
+    const char **nocaps = PIKE_CARVE(work, const char*, nslots);
+    const char **found = PIKE_CARVE(work, const char*, nslots);
+    for (int i = 0; i < nslots; i++) nocaps[i] = NULL;
+
+    cl->pcs = PIKE_CARVE(work, int, n);
+    nl->pcs = PIKE_CARVE(work, int, n);
+    ctx.visited = PIKE_CARVE(work, u_int, n);
+    memset(ctx.visited, 0, n * sizeof(u_int));
+
+    int anchored = (rx->flags & SCM_REGEXP_BOL_ANCHORED);
+    const char *must = NULL;
+    int matched = FALSE;
+    const char *input = start;
+
+    for (;;) {
+        /* Start a new thread at INPUT, with the lowest priority. */
+        if (!matched && (!anchored || input == start)) {
+            if (cl->n == 0 && !anchored) {
+                /* No thread is running; skip to where a match can begin. */
+                const char *p = next_candidate(rx, &must, input, end, end);
+                if (p == NULL) break;
+                if (p != input) {
+                    input = p;
+                    ctx.gen++;
+                }
+            }
+            pike_add(&ctx, cl, 0, input, nocaps);
+        }
+        if (cl->n == 0) {
+            if (matched || anchored || input >= end) break;
+            input += SCM_CHAR_NFOLLOWS(*input) + 1;
+            ctx.gen++;
+            continue;
+        }
+
+        ScmChar ch = 0;
+        const char *next = input;
+        if (input < end) {
+            SCM_CHAR_GET(input, ch);
+            next = input + SCM_CHAR_NBYTES(ch);
+        }
+        ctx.gen++;
+        nl->n = 0;
+        for (int i = 0; i < cl->n; i++) {
+            const pike_insn *insn = &prog->insns[cl->pcs[i]];
+            const char **caps = cl->caps + i * nslots;
+            if (insn->op == PI_MATCH) {
+                /* The rest of the threads have lower priority. */
+                memcpy(found, caps, nslots * sizeof(const char*));
+                matched = TRUE;
+                break;
+            }
+            if (input < end && pike_char_match(insn, ch)) {
+                pike_add(&ctx, nl, cl->pcs[i] + 1, next, caps);
+            }
+        }
+        if (input >= end) break;
+        pike_list *t = cl; cl = nl; nl = t;
+        input = next;
+    }
+    if (!matched) return SCM_FALSE;
+
+    mctx.matches = SCM_NEW_ARRAY(struct ScmRegMatchSub *, rx->numGroups);
+    for (int i = 0; i < rx->numGroups; i++) {
+        mctx.matches[i] = SCM_NEW(struct ScmRegMatchSub);
+        mctx.matches[i]->start = -1;
+        mctx.matches[i]->length = -1;
+        mctx.matches[i]->after = -1;
+        mctx.matches[i]->startp = found[i*2];
+        mctx.matches[i]->endp = found[i*2+1];
+    }
+    return make_match(rx, orig, &mctx);
+}
+
 /*----------------------------------------------------------------------
  * entry point
  */
@@ -2853,52 +3560,34 @@ ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str, ScmObj start_scm, ScmObj end_s
         end += SCM_STRING_BODY_SIZE(b);
     }
     start_limit = end - mustMatchLen;
-#if 0
-    /* Disabled for now; we need to use more heuristics to determine
-       when we should apply mustMatch.  For example, if the regexp
-       begins with BOL assertion and constant string, then it would be
-       faster to go for rex directly. */
-    if (rx->mustMatch) {
-        /* Prescreening.  If the input string doesn't contain mustMatch
-           string, it can't match the entire expression. */
-        if (SCM_FALSEP(Scm_StringScan(str, rx->mustMatch,
-                                      SCM_STRING_SCAN_INDEX))) {
-            return SCM_FALSE;
-        }
+    /* The Pike VM runs in linear time, trying all start positions
+       at once. */
+    if (!(rx->flags & SCM_REGEXP_BACKTRACK)) {
+        return rex_pike(rx, str, orig_start, start, end);
     }
-#endif
+
     /* short cut : if rx matches only at the beginning of the string,
        we only run from the beginning of the string */
     if (rx->flags & SCM_REGEXP_BOL_ANCHORED) {
         return rex(rx, str, orig_start, start, end);
     }
 
-    /* if we have lookahead-set, we may be able to skip input efficiently. */
-    if (!SCM_FALSEP(rx->laset)) {
+    /* Skip the input to the positions where a match can begin, using
+       mustMatch and the lookahead set. */
+    const char *must = NULL;
+    while ((start = next_candidate(rx, &must, start, start_limit, end))
+           != NULL) {
+        ScmObj r = rex(rx, str, orig_start, start, end);
+        if (!SCM_FALSEP(r)) return r;
         if (rx->flags & SCM_REGEXP_SIMPLE_PREFIX) {
-            while (start <= start_limit) {
-                ScmObj r = rex(rx, str, orig_start, start, end);
-                if (!SCM_FALSEP(r)) return r;
-                const char *next = skip_input(start, start_limit, rx->laset,
-                                              TRUE);
-                if (start != next) start = next;
-                else start = next + SCM_CHAR_NFOLLOWS(*start) + 1;
-            }
-        } else {
-            while (start <= start_limit) {
-                start = skip_input(start, start_limit, rx->laset, FALSE);
-                ScmObj r = rex(rx, str, orig_start, start, end);
-                if (!SCM_FALSEP(r)) return r;
-                start += SCM_CHAR_NFOLLOWS(*start)+1;
+            const char *next = skip_input(start, start_limit, rx->laset,
+                                          TRUE);
+            if (start != next) {
+                start = next;
+                continue;
             }
         }
-        return SCM_FALSE;
-    }
-
-    /* normal matching */
-    while (start <= start_limit) {
-        ScmObj r = rex(rx, str, orig_start, start, end);
-        if (!SCM_FALSEP(r)) return r;
+        if (start >= end) break;
         start += SCM_CHAR_NFOLLOWS(*start)+1;
     }
     return SCM_FALSE;
@@ -32,5 +32,1304 @@
  */
 
 #include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/code.h"
+#include "gauche/vminsn.h"
+#include "gauche/priv/codeP.h"
+#include "gauche/priv/glocP.h"
+#include "gauche/priv/identifierP.h"
+#include "gauche/priv/regexpP.h"
 
-/* NOT IMPLEMENTED YET */
+#include <string.h>
+
+/*
+ * FASL - binary serialization of compiled code
+ *
+ *   This is used by the compile cache (see load-from-port in libeval.scm)
+ *   to save the compiled code of toplevel forms and to read it back in
+ *   the later runs.  The format is tied to the running Gauche---the
+ *   instruction set, the word size, and the compiler settings.  See
+ *   Scm_FaslVersion().  There's no attempt to make it portable.
+ *
+ *   The data is a sequence of records.  Each record is
+ *
+ *     <record> : <length> <object>
+ *
+ *   where <length> is the number of octets of <object> in varint.
+ *   An <object> begins with a tag octet, followed by tag-specific data.
+ *   Unsigned integers are in LEB128 varint; signed integers are
+ *   zigzag-encoded then varint.
+ *
+ *   Within a record, eq-ness of heap objects is preserved; the second
+ *   and later occurrences of an object are written as TAG_REF with the
+ *   index of the object.  Objects are numbered in the order they are
+ *   registered; containers (pairs, vectors, compiled code) are registered
+ *   before their elements, so that circular structures are handled,
+ *   and other objects are registered after their contents.  Across
+ *   records nothing is shared.
+ *
+ *   Not everything is serializable.  Procedures, anonymous modules,
+ *   identifiers closed in local environment etc. can't be saved;
+ *   Scm_FaslEncode returns #f if the object contains them, and the
+ *   caller falls back to something else (the compile cache saves the
+ *   source form instead).  The exception is the debugging information
+ *   (debug-info and signature-info of compiled code, and pair attributes),
+ *   which we save in the "lossy" mode---unserializable objects in them
+ *   are replaced with #f, and identifiers with their names.
+ *
+ *   The same format is also used for general data, by Scm_FaslWriteData
+ *   and Scm_FaslReadData (gauche.serializer.bserializer).  In the data
+ *   mode, an object is written as one record, so the identity of
+ *   uninterned symbols can be kept, and hash tables and instances of
+ *   Scheme-defined classes can be written as well.  The record is
+ *   streamed to the port in chunks, so that we don't need to build
+ *   the whole image in memory:
+ *
+ *     <data>  : <chunk> ... 0
+ *     <chunk> : <length> <octets>
+ *
+ *   The first octet of the concatenated chunks is FASL_DATA_FORMAT.
+ *   Flonums and uvector elements are written in native byte order,
+ *   so the data can only be read on the machine with the same byte order.
+ */
+
+#define FASL_VERSION  1
+
+#if defined(WORDS_BIGENDIAN)
+#define FASL_DATA_FORMAT  ((1<<1)|1)
+#else
+#define FASL_DATA_FORMAT  (1<<1)
+#endif
+
+/* In the data mode, we flush the buffer to the port when it exceeds
+   FASL_CHUNK_SIZE.  The size is checked every FASL_FLUSH_INTERVAL
+   objects, since Scm_DStringSize isn't free. */
+#define FASL_CHUNK_SIZE      65536
+#define FASL_FLUSH_INTERVAL  1024
+
+enum {
+    TAG_REF = 1,            /* <index> */
+    TAG_FIXNUM,             /* <signed> */
+    TAG_IMMEDIATE,          /* <unsigned>; #f, #t, (), eof etc. */
+    TAG_CHAR,               /* <unsigned> */
+    TAG_FLONUM,             /* 8 octets, native endian */
+    TAG_BIGNUM,             /* <bytes>; hexadecimal representation */
+    TAG_RATNUM,             /* <object> <object> */
+    TAG_COMPNUM,            /* 16 octets */
+    TAG_STRING,             /* <flags> <size> <len> <octets> */
+    TAG_SYMBOL,             /* <bytes> */
+    TAG_UNINTERNED,         /* <bytes> */
+    TAG_KEYWORD,            /* <bytes>; without the prefix colon */
+    TAG_PAIR,               /* <car> <cdr> */
+    TAG_EPAIR,              /* <car> <attrs> <cdr>; extended pair */
+    TAG_IPAIR,              /* <car> <attrs> <cdr>; immutable pair */
+    TAG_VECTOR,             /* <immutable> <size> <object> ... */
+    TAG_UVECTOR,            /* <type> <immutable> <size> <octets> */
+    TAG_CHARSET,            /* <immutable> <nranges> <lo> <hi> ... */
+    TAG_REGEXP,             /* <flags> <pattern> */
+    TAG_MODULE,             /* <name> */
+    TAG_IDENTIFIER,         /* <name> <module> */
+    TAG_CLASS,              /* <name> <module> */
+    TAG_CODE,               /* see write_code */
+    TAG_HASH_TABLE,         /* <type> <count> <key> <value> ... */
+    TAG_INSTANCE            /* <class> <count> <slot-name> <value> ... */
+};
+
+/* Encodes N as varint into BUF, which must have at least 10 octets.
+   Returns the number of octets. */
+static int encode_uint(uint8_t *buf, u_long n)
+{
+    int len = 0;
+    while (n >= 0x80) {
+        buf[len++] = (uint8_t)((n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    buf[len++] = (uint8_t)n;
+    return len;
+}
+
+/*================================================================
+ * Writer
+ */
+
+/* The writer looks up every heap object it visits, so the object table
+   is on the critical path.  A general ScmHashCore allocates an entry
+   per object, which costs a GC allocation and extra marking for each
+   object written.  We use a flat open-addressing table keyed by the
+   address instead, with the key and the value side by side so that a
+   lookup touches one cache line.  The table is GC-visible, so that a
+   temporary object registered during writing can't be collected and
+   its address reused by another object. */
+#define FASL_TABLE_INITIAL_SIZE  256
+
+typedef struct fasl_slot_rec {
+    ScmObj key;             /* NULL for an empty slot */
+    u_long value;           /* (index<<1)|lossy */
+} fasl_slot;
+
+typedef struct fasl_out_rec {
+    ScmDString buf;
+    fasl_slot *table;       /* object table */
+    ScmSmallInt tableSize;  /* # of slots; a power of 2 */
+    ScmSmallInt tableUsed;  /* # of used slots */
+    ScmObj missed;          /* the object write_ref last failed to find, */
+    ScmSmallInt missedSlot; /*  and the empty slot where it would go */
+    ScmSmallInt count;      /* # of registered objects */
+    int failed;             /* TRUE if unserializable object is found */
+    ScmObj culprit;         /* the unserializable object */
+    int data;               /* TRUE in the data mode */
+    int shared;             /* FALSE if only symbols and keywords are
+                               tracked; see Scm_FaslWriteData */
+    ScmPort *port;          /* output port in the data mode */
+    int ticks;              /* counter for FASL_FLUSH_INTERVAL */
+} fasl_out;
+
+static void init_out(fasl_out *o, ScmPort *port)
+{
+    Scm_DStringInit(&o->buf);
+    o->tableSize = FASL_TABLE_INITIAL_SIZE;
+    o->tableUsed = 0;
+    o->table = SCM_NEW_ARRAY(fasl_slot, o->tableSize);
+    o->missed = NULL;
+    o->missedSlot = 0;
+    o->count = 0;
+    o->failed = FALSE;
+    o->culprit = SCM_FALSE;
+    o->data = (port != NULL);
+    o->shared = TRUE;
+    o->port = port;
+    o->ticks = 0;
+}
+
+static void write_obj(fasl_out *o, ScmObj obj, int lossy);
+
+static void put_byte(fasl_out *o, u_int b)
+{
+    Scm_DStringPutb(&o->buf, (char)b);
+}
+
+static void put_uint(fasl_out *o, u_long n)
+{
+    while (n >= 0x80) {
+        put_byte(o, (u_int)((n & 0x7f) | 0x80));
+        n >>= 7;
+    }
+    put_byte(o, (u_int)n);
+}
+
+static void put_int(fasl_out *o, long n)
+{
+    put_uint(o, ((u_long)n << 1) ^ (u_long)(n >> (SIZEOF_LONG*8-1)));
+}
+
+static void put_chunk(fasl_out *o, const void *p, ScmSize size)
+{
+    uint8_t hdr[16];
+    Scm_Putz((const char*)hdr, encode_uint(hdr, (u_long)size), o->port);
+    Scm_Putz((const char*)p, size, o->port);
+}
+
+static void flush_buf(fasl_out *o)
+{
+    ScmSmallInt size;
+    const char *p = Scm_DStringPeek(&o->buf, &size, NULL);
+    if (size > 0) {
+        put_chunk(o, p, size);
+        Scm_DStringInit(&o->buf);
+    }
+}
+
+static void put_octets(fasl_out *o, const void *p, ScmSize size)
+{
+    if (o->port && size >= FASL_CHUNK_SIZE) {
+        /* Large uvectors and strings go to the port directly. */
+        flush_buf(o);
+        put_chunk(o, p, size);
+        return;
+    }
+    Scm_DStringPutz(&o->buf, (const char*)p, size);
+}
+
+static void put_bytes(fasl_out *o, ScmString *s)
+{
+    ScmSmallInt size;
+    const char *p = Scm_GetStringContent(s, &size, NULL, NULL);
+    put_uint(o, size);
+    put_octets(o, p, size);
+}
+
+/* Returns the slot of OBJ in the object table, or the empty slot
+   where OBJ should go.  Linear probing; the table is kept at most
+   half full. */
+static ScmSmallInt table_slot(fasl_out *o, ScmObj obj)
+{
+    u_long h = (u_long)(SCM_WORD(obj) >> 3) * 2654435761UL;
+    ScmSmallInt mask = o->tableSize - 1;
+    ScmSmallInt k = (ScmSmallInt)((h ^ (h >> 16)) & mask);
+    while (o->table[k].key != NULL && o->table[k].key != obj) {
+        k = (k + 1) & mask;
+    }
+    return k;
+}
+
+static void table_grow(fasl_out *o)
+{
+    fasl_slot *old = o->table;
+    ScmSmallInt oldsize = o->tableSize;
+
+    o->tableSize = oldsize * 2;
+    o->table = SCM_NEW_ARRAY(fasl_slot, o->tableSize);
+    for (ScmSmallInt i=0; i<oldsize; i++) {
+        if (old[i].key == NULL) continue;
+        o->table[table_slot(o, old[i].key)] = old[i];
+    }
+    o->missed = NULL;
+}
+
+/* Without sharing, we still track symbols and keywords.  Their
+   identity is kept by name anyway, but a reference is shorter and
+   saves interning on reading.  Uninterned symbols need it to keep
+   their identity. */
+#define TRACKED(o, obj) \
+    ((o)->shared || SCM_SYMBOLP(obj) || SCM_KEYWORDP(obj))
+
+/* If OBJ has been written and the entry can be used in the mode LOSSY,
+   writes a reference and returns TRUE. */
+static int write_ref(fasl_out *o, ScmObj obj, int lossy)
+{
+    if (!TRACKED(o, obj)) return FALSE;
+    ScmSmallInt k = table_slot(o, obj);
+    if (o->table[k].key == NULL) {
+        /* Most of the time OBJ is registered next, so we remember
+           the slot to save another probe. */
+        o->missed = obj;
+        o->missedSlot = k;
+        return FALSE;
+    }
+    /* An object written in the lossy mode may have lost something,
+       so it can't be used in the strict mode. */
+    if ((o->table[k].value & 1) && !lossy) return FALSE;
+    put_byte(o, TAG_REF);
+    put_uint(o, o->table[k].value >> 1);
+    return TRUE;
+}
+
+/* Every object is numbered, for the reader numbers every object it
+   reads, but we only record the tracked ones. */
+static void register_obj(fasl_out *o, ScmObj obj, int lossy)
+{
+    if (!TRACKED(o, obj)) {
+        o->count++;
+        return;
+    }
+    /* The remembered slot is still good unless it has been taken, or
+       the table has grown (which clears o->missed).  Slots filled
+       before it on the probe sequence don't matter. */
+    ScmSmallInt k;
+    if (o->missed == obj && o->table[o->missedSlot].key == NULL) {
+        k = o->missedSlot;
+    } else {
+        k = table_slot(o, obj);
+    }
+    o->missed = NULL;
+    if (o->table[k].key == NULL) {
+        if (o->tableUsed + 1 > o->tableSize / 2) {
+            table_grow(o);
+            k = table_slot(o, obj);
+        }
+        o->table[k].key = obj;
+        o->tableUsed++;
+    }
+    o->table[k].value = ((u_long)o->count << 1) | (lossy? 1 : 0);
+    o->count++;
+}
+
+/* Called when OBJ can't be serialized.  In the lossy mode we write #f
+   instead. */
+static void unserializable(fasl_out *o, ScmObj obj, int lossy)
+{
+    if (lossy) {
+        put_byte(o, TAG_IMMEDIATE);
+        put_uint(o, (u_long)SCM_WORD(SCM_FALSE));
+    } else if (!o->failed) {
+        o->failed = TRUE;
+        o->culprit = obj;
+    }
+}
+
+static void write_pair(fasl_out *o, ScmObj obj, int lossy)
+{
+    /* We loop over cdr to avoid deep recursion on long lists. */
+    for (;;) {
+        int ext = SCM_EXTENDED_PAIR_P(obj);
+        if (!ext) put_byte(o, TAG_PAIR);
+        else if (Scm_ImmutablePairP(obj)) put_byte(o, TAG_IPAIR);
+        else put_byte(o, TAG_EPAIR);
+        register_obj(o, obj, lossy);
+        write_obj(o, SCM_CAR(obj), lossy);
+        if (ext) write_obj(o, Scm_PairAttr(SCM_PAIR(obj)), TRUE);
+        if (o->failed) return;
+
+        ScmObj cdr = SCM_CDR(obj);
+        if (SCM_PAIRP(cdr) && !write_ref(o, cdr, lossy)) {
+            obj = cdr;
+            continue;
+        }
+        if (!SCM_PAIRP(cdr)) write_obj(o, cdr, lossy);
+        return;
+    }
+}
+
+static void write_module(fasl_out *o, ScmModule *m, int lossy)
+{
+    if (!SCM_SYMBOLP(m->name)) {  /* anonymous module */
+        unserializable(o, SCM_OBJ(m), lossy);
+        return;
+    }
+    put_byte(o, TAG_MODULE);
+    write_obj(o, m->name, lossy);
+    register_obj(o, SCM_OBJ(m), lossy);
+}
+
+static void write_identifier(fasl_out *o, ScmIdentifier *id, int lossy)
+{
+    ScmSymbol *name = Scm_UnwrapIdentifier(id);
+    /* Identifiers closed in local environment, and the ones renamed by
+       the hygienic definition (see pass1/define), only make sense
+       within the running process. */
+    if (!SCM_NULLP(Scm_IdentifierEnv(id)) || !SCM_SYMBOL_INTERNED(name)
+        || !SCM_SYMBOLP(id->module->name)) {
+        if (lossy) write_obj(o, SCM_OBJ(name), lossy);
+        else unserializable(o, SCM_OBJ(id), lossy);
+        return;
+    }
+    put_byte(o, TAG_IDENTIFIER);
+    write_obj(o, SCM_OBJ(name), lossy);
+    write_obj(o, SCM_OBJ(id->module), lossy);
+    register_obj(o, SCM_OBJ(id), lossy);
+}
+
+/* Classes are written by the global name, as the precompiler does.
+   We make sure the name does refer to the class. */
+static void write_class(fasl_out *o, ScmClass *k, int lossy)
+{
+    if (!SCM_PAIRP(k->modules) || !SCM_MODULEP(SCM_CAR(k->modules))
+        || !SCM_SYMBOLP(k->name)) {
+        unserializable(o, SCM_OBJ(k), lossy);
+        return;
+    }
+    ScmModule *m = SCM_MODULE(SCM_CAR(k->modules));
+    if (!SCM_EQ(Scm_GlobalVariableRef(m, SCM_SYMBOL(k->name), 0),
+                SCM_OBJ(k))) {
+        unserializable(o, SCM_OBJ(k), lossy);
+        return;
+    }
+    put_byte(o, TAG_CLASS);
+    write_obj(o, k->name, lossy);
+    write_obj(o, SCM_OBJ(m), lossy);
+    register_obj(o, SCM_OBJ(k), lossy);
+}
+
+/* <code> : TAG_CODE <size> <maxstack> <reqargs> <optargs> <name> <parent>
+ *          <word> ... <operand> ... <debug-info> <signature-info>
+ *
+ * The code vector is written as instruction words, followed by their
+ * operands in order.  Label operands are written as the offset in
+ * the code vector.  Intermediate form for inlining isn't saved; the
+ * compile cache doesn't save define-inline forms as compiled code.
+ */
+static void write_code(fasl_out *o, ScmCompiledCode *cc, int lossy)
+{
+    if (cc->code == NULL || cc->builder != NULL) {
+        unserializable(o, SCM_OBJ(cc), lossy);
+        return;
+    }
+    put_byte(o, TAG_CODE);
+    register_obj(o, SCM_OBJ(cc), lossy);
+    put_uint(o, cc->codeSize);
+    put_uint(o, cc->maxstack);
+    put_uint(o, cc->requiredArgs);
+    put_uint(o, cc->optionalArgs);
+    write_obj(o, cc->name, TRUE);
+    write_obj(o, cc->parent, TRUE);
+
+    for (int i=0; i<cc->codeSize && !o->failed; i++) {
+        ScmWord insn = cc->code[i];
+        put_int(o, (long)insn);
+        switch (Scm_VMInsnOperandType(SCM_VM_INSN_CODE(insn))) {
+        case SCM_VM_OPERAND_OBJ:
+        case SCM_VM_OPERAND_CODE:
+        case SCM_VM_OPERAND_CODES: {
+            ScmObj operand = SCM_OBJ(cc->code[++i]);
+            if (SCM_GLOCP(operand)) {
+                /* GREF etc. may have been resolved by the VM. */
+                ScmGloc *g = SCM_GLOC(operand);
+                operand = Scm_MakeIdentifier(SCM_OBJ(g->name), g->module,
+                                             SCM_NIL);
+            }
+            write_obj(o, operand, lossy);
+            break;
+        }
+        case SCM_VM_OPERAND_LABEL:
+            i++;
+            put_uint(o, (u_long)((ScmWord*)cc->code[i] - cc->code));
+            break;
+        case SCM_VM_OPERAND_OBJ_LABEL:
+            write_obj(o, SCM_OBJ(cc->code[i+1]), lossy);
+            put_uint(o, (u_long)((ScmWord*)cc->code[i+2] - cc->code));
+            i += 2;
+            break;
+        case SCM_VM_OPERAND_OBJ_NATIVE:
+            unserializable(o, SCM_OBJ(cc), FALSE);
+            return;
+        default:
+            break;
+        }
+    }
+
+    ScmObj info = cc->debugInfo;
+    if (SCM_PACKED_DEBUG_INFO_P(info)) info = SCM_NIL;
+    write_obj(o, info, TRUE);
+    write_obj(o, cc->signatureInfo, TRUE);
+}
+
+/* Hash tables and instances are only written in the data mode.  */
+static void write_hash_table(fasl_out *o, ScmHashTable *ht, int lossy)
+{
+    ScmHashType type = Scm_HashTableType(ht);
+    if (type != SCM_HASH_EQ && type != SCM_HASH_EQV
+        && type != SCM_HASH_EQUAL && type != SCM_HASH_STRING) {
+        unserializable(o, SCM_OBJ(ht), lossy);
+        return;
+    }
+    ScmHashCore *core = SCM_HASH_TABLE_CORE(ht);
+    put_byte(o, TAG_HASH_TABLE);
+    register_obj(o, SCM_OBJ(ht), lossy);
+    put_uint(o, type);
+    put_uint(o, Scm_HashCoreNumEntries(core));
+
+    ScmHashIter iter;
+    ScmDictEntry *e;
+    Scm_HashIterInit(&iter, core);
+    while ((e = Scm_HashIterNext(&iter)) != NULL && !o->failed) {
+        write_obj(o, SCM_DICT_KEY(e), lossy);
+        write_obj(o, SCM_DICT_VALUE(e), lossy);
+    }
+}
+
+/* We only handle instances of pure Scheme classes.  If the class has
+   C-defined base, the instance may have states we can't see.
+   Instance-allocated slots are written with their names, so that
+   the data can be read after the slots are reordered. */
+static void write_instance(fasl_out *o, ScmObj obj, int lossy)
+{
+    ScmClass *k = Scm_ClassOf(obj);
+    if (SCM_CLASS_CATEGORY(k) != SCM_CLASS_SCHEME
+        || k->coreSize != (int)sizeof(ScmInstance)) {
+        unserializable(o, obj, lossy);
+        return;
+    }
+    ScmObj ap;
+    u_long nslots = 0;
+    SCM_FOR_EACH(ap, k->accessors) {
+        if (SCM_SLOT_ACCESSOR(SCM_CDAR(ap))->slotNumber >= 0) nslots++;
+    }
+    put_byte(o, TAG_INSTANCE);
+    write_obj(o, SCM_OBJ(k), lossy);
+    register_obj(o, obj, lossy);
+    put_uint(o, nslots);
+    SCM_FOR_EACH(ap, k->accessors) {
+        ScmSlotAccessor *sa = SCM_SLOT_ACCESSOR(SCM_CDAR(ap));
+        if (sa->slotNumber < 0) continue;
+        write_obj(o, sa->name, lossy);
+        write_obj(o, SCM_INSTANCE_SLOTS(obj)[sa->slotNumber], lossy);
+    }
+}
+
+static void write_obj(fasl_out *o, ScmObj obj, int lossy)
+{
+    if (o->failed) return;
+    if (o->port && ++o->ticks >= FASL_FLUSH_INTERVAL) {
+        o->ticks = 0;
+        if (Scm_DStringSize(&o->buf) >= FASL_CHUNK_SIZE) flush_buf(o);
+    }
+
+    if (SCM_INTP(obj)) {
+        put_byte(o, TAG_FIXNUM);
+        put_int(o, SCM_INT_VALUE(obj));
+        return;
+    }
+    if (SCM_CHARP(obj)) {
+        put_byte(o, TAG_CHAR);
+        put_uint(o, (u_long)SCM_CHAR_VALUE(obj));
+        return;
+    }
+    if (SCM_FLONUMP(obj)) {
+        double d = SCM_FLONUM_VALUE(obj);
+        put_byte(o, TAG_FLONUM);
+        put_octets(o, &d, sizeof(double));
+        return;
+    }
+    if (SCM_IMMEDIATEP(obj)) {
+        put_byte(o, TAG_IMMEDIATE);
+        put_uint(o, (u_long)SCM_WORD(obj));
+        return;
+    }
+    if (!SCM_PTRP(obj)) {
+        unserializable(o, obj, lossy);
+        return;
+    }
+
+    if (write_ref(o, obj, lossy)) return;
+
+    if (SCM_PAIRP(obj)) {
+        write_pair(o, obj, lossy);
+    } else if (SCM_KEYWORDP(obj)) {
+        put_byte(o, TAG_KEYWORD);
+        put_bytes(o, SCM_STRING(Scm_KeywordToString(SCM_KEYWORD(obj))));
+        register_obj(o, obj, lossy);
+    } else if (SCM_SYMBOLP(obj)) {
+        /* The identity of an uninterned symbol can't be kept across
+           records, so we allow it only in the lossy mode, or in the
+           data mode where everything is in one record. */
+        if (SCM_SYMBOL_INTERNED(obj)) {
+            put_byte(o, TAG_SYMBOL);
+        } else if (lossy || o->data) {
+            put_byte(o, TAG_UNINTERNED);
+        } else {
+            unserializable(o, obj, lossy);
+            return;
+        }
+        put_bytes(o, SCM_SYMBOL_NAME(obj));
+        register_obj(o, obj, lossy);
+    } else if (SCM_STRINGP(obj)) {
+        ScmSmallInt size, len;
+        u_long flags;
+        const char *p = Scm_GetStringContent(SCM_STRING(obj), &size, &len,
+                                             &flags);
+        put_byte(o, TAG_STRING);
+        put_uint(o, flags & (SCM_STRING_IMMUTABLE|SCM_STRING_INCOMPLETE));
+        put_uint(o, size);
+        put_uint(o, len);
+        put_octets(o, p, size);
+        register_obj(o, obj, lossy);
+    } else if (SCM_BIGNUMP(obj)) {
+        put_byte(o, TAG_BIGNUM);
+        put_bytes(o, SCM_STRING(Scm_NumberToString(obj, 16, 0)));
+    } else if (SCM_RATNUMP(obj)) {
+        put_byte(o, TAG_RATNUM);
+        write_obj(o, SCM_RATNUM_NUMER(obj), lossy);
+        write_obj(o, SCM_RATNUM_DENOM(obj), lossy);
+    } else if (SCM_COMPNUMP(obj)) {
+        double d[2];
+        d[0] = SCM_COMPNUM_REAL(obj);
+        d[1] = SCM_COMPNUM_IMAG(obj);
+        put_byte(o, TAG_COMPNUM);
+        put_octets(o, d, sizeof(d));
+    } else if (SCM_VECTORP(obj)) {
+        ScmSmallInt size = SCM_VECTOR_SIZE(obj);
+        put_byte(o, TAG_VECTOR);
+        register_obj(o, obj, lossy);
+        put_uint(o, SCM_VECTOR_IMMUTABLE_P(obj)? 1 : 0);
+        put_uint(o, size);
+        for (ScmSmallInt i=0; i<size; i++) {
+            write_obj(o, SCM_VECTOR_ELEMENT(obj, i), lossy);
+        }
+    } else if (SCM_UVECTORP(obj)) {
+        ScmUVectorType type = Scm_UVectorType(SCM_CLASS_OF(obj));
+        if (type < 0) {
+            unserializable(o, obj, lossy);
+            return;
+        }
+        put_byte(o, TAG_UVECTOR);
+        put_uint(o, type);
+        put_uint(o, SCM_UVECTOR_IMMUTABLE_P(obj)? 1 : 0);
+        put_uint(o, SCM_UVECTOR_SIZE(obj));
+        put_octets(o, SCM_UVECTOR_ELEMENTS(obj),
+                   Scm_UVectorSizeInBytes(SCM_UVECTOR(obj)));
+        register_obj(o, obj, lossy);
+    } else if (SCM_CHAR_SET_P(obj)) {
+        ScmObj ranges = Scm_CharSetRanges(SCM_CHAR_SET(obj)), rp;
+        put_byte(o, TAG_CHARSET);
+        put_uint(o, SCM_CHAR_SET_IMMUTABLE_P(obj)? 1 : 0);
+        put_uint(o, Scm_Length(ranges));
+        SCM_FOR_EACH(rp, ranges) {
+            put_uint(o, SCM_INT_VALUE(SCM_CAAR(rp)));
+            put_uint(o, SCM_INT_VALUE(SCM_CDAR(rp)));
+        }
+        register_obj(o, obj, lossy);
+    } else if (SCM_REGEXPP(obj)) {
+        ScmRegexp *rx = SCM_REGEXP(obj);
+        if (!SCM_STRINGP(rx->pattern)) { /* created from AST */
+            unserializable(o, obj, lossy);
+            return;
+        }
+        put_byte(o, TAG_REGEXP);
+        put_uint(o, rx->flags & (SCM_REGEXP_CASE_FOLD|SCM_REGEXP_MULTI_LINE));
+        write_obj(o, rx->pattern, lossy);
+        register_obj(o, obj, lossy);
+    } else if (SCM_MODULEP(obj)) {
+        write_module(o, SCM_MODULE(obj), lossy);
+    } else if (SCM_IDENTIFIERP(obj)) {
+        write_identifier(o, SCM_IDENTIFIER(obj), lossy);
+    } else if (SCM_CLASSP(obj)) {
+        write_class(o, SCM_CLASS(obj), lossy);
+    } else if (SCM_COMPILED_CODE_P(obj)) {
+        write_code(o, SCM_COMPILED_CODE(obj), lossy);
+    } else if (o->data && SCM_HASH_TABLE_P(obj)) {
+        write_hash_table(o, SCM_HASH_TABLE(obj), lossy);
+    } else if (o->data) {
+        write_instance(o, obj, lossy);
+    } else {
+        unserializable(o, obj, lossy);
+    }
+}
+
+/* Returns a u8vector containing a record of OBJ, or #f if OBJ
+   can't be serialized. */
+ScmObj Scm_FaslEncode(ScmObj obj)
+{
+    fasl_out o;
+    init_out(&o, NULL);
+
+    write_obj(&o, obj, FALSE);
+    if (o.failed) return SCM_FALSE;
+
+    ScmSmallInt size = Scm_DStringSize(&o.buf);
+    const char *body = Scm_DStringGetz(&o.buf);
+
+    /* prepend the length */
+    uint8_t hdr[16];
+    int hlen = encode_uint(hdr, (u_long)size);
+
+    uint8_t *rec = SCM_NEW_ATOMIC2(uint8_t*, hlen + size);
+    memcpy(rec, hdr, hlen);
+    memcpy(rec + hlen, body, size);
+    return Scm_MakeU8VectorFromArrayShared(hlen + size, rec);
+}
+
+/* Writes OBJ to PORT in the data mode.  If OBJ contains an object that
+   can't be serialized, an error is thrown; some chunks may already
+   have been written to PORT in that case.
+   If SHARED is FALSE, shared substructures are written as many times as
+   they appear, as write-simple does, and circular structures never
+   terminate.  It saves the object table, which is most of the cost of
+   writing large tree-shaped data.  The reader doesn't need to know. */
+void Scm_FaslWriteData(ScmObj obj, ScmPort *port, int shared)
+{
+    fasl_out o;
+    init_out(&o, port);
+    o.shared = shared;
+
+    put_byte(&o, FASL_DATA_FORMAT);
+    write_obj(&o, obj, FALSE);
+    if (o.failed) {
+        Scm_Error("binary serializer: can't serialize %S", o.culprit);
+    }
+    flush_buf(&o);
+    Scm_Putb(0, port);
+}
+
+/*================================================================
+ * Reader
+ */
+
+typedef struct fasl_in_rec {
+    uint8_t *buf;
+    ScmSmallInt pos;
+    ScmSmallInt end;
+    ScmSmallInt bufSize;    /* allocated size of buf */
+    ScmObj *table;          /* registered objects */
+    ScmSmallInt count;
+    ScmSmallInt tableSize;
+    ScmPort *port;          /* input port in the data mode */
+    u_long rest;            /* # of octets left in the current chunk */
+} fasl_in;
+
+static ScmObj read_obj(fasl_in *in);
+
+static void broken(const char *what)
+{
+    Scm_Error("broken fasl data (%s)", what);
+}
+
+/* In the data mode, BUF is NULL and we allocate the buffer. */
+static void init_in(fasl_in *in, uint8_t *buf, ScmSmallInt end,
+                    ScmPort *port)
+{
+    if (port != NULL) {
+        in->bufSize = FASL_CHUNK_SIZE;
+        in->buf = SCM_NEW_ATOMIC2(uint8_t*, in->bufSize);
+    } else {
+        in->bufSize = end;
+        in->buf = buf;
+    }
+    in->pos = 0;
+    in->end = end;
+    in->count = 0;
+    in->tableSize = 32;
+    in->table = SCM_NEW_ARRAY(ScmObj, in->tableSize);
+    in->port = port;
+    in->rest = 0;
+}
+
+/* Reads a varint directly from PORT.  If PORT is at the end before
+   the first octet, sets *eofp and returns 0 when EOFP isn't NULL. */
+static u_long get_port_uint(ScmPort *port, int *eofp)
+{
+    u_long n = 0;
+    for (int shift = 0; ; shift += 7) {
+        int b = Scm_Getb(port);
+        if (b == EOF) {
+            if (shift == 0 && eofp) {
+                *eofp = TRUE;
+                return 0;
+            }
+            broken("unexpected end of file");
+        }
+        if (shift >= SIZEOF_LONG*8) broken("varint overflow");
+        n |= (u_long)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    return n;
+}
+
+static void get_port_octets(ScmPort *port, void *buf, u_long size)
+{
+    for (u_long n = 0; n < size;) {
+        ScmSize r = Scm_Getz((char*)buf + n, size - n, port);
+        if (r <= 0) broken("unexpected end of file");
+        n += r;
+    }
+}
+
+/* Data mode: starts the next chunk if the current one is exhausted. */
+static void next_chunk(fasl_in *in)
+{
+    if (in->rest == 0) {
+        in->rest = get_port_uint(in->port, NULL);
+        if (in->rest == 0) broken("unexpected end of data");
+    }
+}
+
+/* Called when the buffer is exhausted. */
+static void fill(fasl_in *in)
+{
+    if (in->port == NULL) broken("unexpected end of record");
+    next_chunk(in);
+    u_long n = (in->rest < (u_long)in->bufSize)? in->rest : (u_long)in->bufSize;
+    get_port_octets(in->port, in->buf, n);
+    in->pos = 0;
+    in->end = n;
+    in->rest -= n;
+}
+
+/* Called before allocating memory for an object of SIZE octets, or of
+   SIZE elements each of which takes at least one octet.  A broken size
+   must be rejected here, for a huge allocation makes GC abort.
+   In the record mode, the whole record is in the buffer.  In the data
+   mode, we read ahead until SIZE octets are in the buffer.  The buffer
+   only grows as the data actually arrives, so it is bounded by the
+   size of the data. */
+static void check_size(fasl_in *in, u_long size, const char *what)
+{
+    if (size <= (u_long)(in->end - in->pos)) return;
+    if (in->port == NULL) broken(what);
+
+    while ((u_long)(in->end - in->pos) < size) {
+        if (in->end == in->bufSize) {
+            ScmSmallInt avail = in->end - in->pos;
+            if (in->pos > 0) {
+                memmove(in->buf, in->buf + in->pos, avail);
+            } else {
+                ScmSmallInt newSize = in->bufSize * 2;
+                uint8_t *newBuf = SCM_NEW_ATOMIC2(uint8_t*, newSize);
+                memcpy(newBuf, in->buf, avail);
+                in->buf = newBuf;
+                in->bufSize = newSize;
+            }
+            in->pos = 0;
+            in->end = avail;
+        }
+        if (in->rest == 0) {
+            in->rest = get_port_uint(in->port, NULL);
+            if (in->rest == 0) broken(what);
+        }
+        u_long room = (u_long)(in->bufSize - in->end);
+        u_long n = (in->rest < room)? in->rest : room;
+        get_port_octets(in->port, in->buf + in->end, n);
+        in->end += n;
+        in->rest -= n;
+    }
+}
+
+static u_int get_byte(fasl_in *in)
+{
+    if (in->pos >= in->end) fill(in);
+    return in->buf[in->pos++];
+}
+
+static u_int peek_byte(fasl_in *in)
+{
+    if (in->pos >= in->end) {
+        if (in->port == NULL) return 0;
+        fill(in);
+    }
+    return in->buf[in->pos];
+}
+
+static u_long get_uint(fasl_in *in)
+{
+    u_long n = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (shift >= SIZEOF_LONG*8) broken("varint overflow");
+        u_int b = get_byte(in);
+        n |= (u_long)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    return n;
+}
+
+static long get_int(fasl_in *in)
+{
+    u_long n = get_uint(in);
+    return (long)(n >> 1) ^ -(long)(n & 1);
+}
+
+/* Reads SIZE octets into DEST.  In the data mode, the octets beyond
+   the buffer are read from the port directly. */
+static void get_octets(fasl_in *in, void *dest, u_long size)
+{
+    u_long avail = (u_long)(in->end - in->pos);
+    if (size <= avail) {
+        memcpy(dest, in->buf + in->pos, size);
+        in->pos += size;
+        return;
+    }
+    if (in->port == NULL) broken("unexpected end of record");
+    memcpy(dest, in->buf + in->pos, avail);
+    in->pos = in->end;
+    char *d = (char*)dest + avail;
+    size -= avail;
+    while (size > 0) {
+        next_chunk(in);
+        u_long n = (size < in->rest)? size : in->rest;
+        get_port_octets(in->port, d, n);
+        d += n;
+        size -= n;
+        in->rest -= n;
+    }
+}
+
+static ScmObj get_string_body(fasl_in *in, u_long size, ScmSmallInt len,
+                              u_long flags)
+{
+    check_size(in, size, "string size");
+    char *p = SCM_NEW_ATOMIC2(char*, size+1);
+    get_octets(in, p, size);
+    p[size] = '\0';
+    return Scm_MakeString(p, size, len, flags);
+}
+
+static ScmObj get_string(fasl_in *in, u_long flags)
+{
+    u_long size = get_uint(in);
+    return get_string_body(in, size, -1, flags);
+}
+
+static ScmObj register_in(fasl_in *in, ScmObj obj)
+{
+    if (in->count >= in->tableSize) {
+        ScmSmallInt newSize = in->tableSize * 2;
+        ScmObj *newTable = SCM_NEW_ARRAY(ScmObj, newSize);
+        memcpy(newTable, in->table, sizeof(ScmObj)*in->count);
+        in->table = newTable;
+        in->tableSize = newSize;
+    }
+    in->table[in->count++] = obj;
+    return obj;
+}
+
+static ScmObj read_pair(fasl_in *in, u_int tag)
+{
+    ScmObj head = SCM_NIL, prev = SCM_FALSE;
+    for (;;) {
+        ScmObj p;
+        switch (tag) {
+        case TAG_PAIR:  p = Scm_Cons(SCM_FALSE, SCM_NIL); break;
+        case TAG_EPAIR: p = Scm_MakeExtendedPair(SCM_FALSE, SCM_NIL, SCM_NIL); break;
+        default:        p = Scm_MakeImmutablePair(SCM_FALSE, SCM_NIL, SCM_NIL); break;
+        }
+        register_in(in, p);
+        if (SCM_FALSEP(prev)) head = p;
+        else SCM_SET_CDR_UNCHECKED(prev, p);
+        SCM_SET_CAR_UNCHECKED(p, read_obj(in));
+        if (tag != TAG_PAIR) {
+            SCM_EXTENDED_PAIR(p)->attributes = read_obj(in);
+        }
+        prev = p;
+
+        u_int next = peek_byte(in);
+        if (next == TAG_PAIR || next == TAG_EPAIR || next == TAG_IPAIR) {
+            tag = get_byte(in);
+            continue;
+        }
+        SCM_SET_CDR_UNCHECKED(p, read_obj(in));
+        return head;
+    }
+}
+
+static ScmModule *read_module_name(fasl_in *in)
+{
+    ScmObj name = read_obj(in);
+    if (!SCM_SYMBOLP(name)) broken("module name");
+    /* The module may not be defined yet, if it is to be defined by
+       the code we're reading.  The precompiler does the same. */
+    return Scm_FindModule(SCM_SYMBOL(name),
+                          SCM_FIND_MODULE_CREATE|SCM_FIND_MODULE_PLACEHOLDING);
+}
+
+static ScmObj read_class(fasl_in *in)
+{
+    ScmObj name = read_obj(in);
+    ScmObj mod = read_obj(in);
+    if (!SCM_SYMBOLP(name) || !SCM_MODULEP(mod)) broken("class name");
+    ScmObj k = Scm_GlobalVariableRef(SCM_MODULE(mod), SCM_SYMBOL(name), 0);
+    if (!SCM_CLASSP(k)) {
+        Scm_Error("fasl: %S in %S isn't a class", name, mod);
+    }
+    return k;
+}
+
+static ScmObj read_code(fasl_in *in)
+{
+    ScmCompiledCode *cc = SCM_NEW(ScmCompiledCode);
+    SCM_SET_CLASS(cc, SCM_CLASS_COMPILED_CODE);
+    cc->code = NULL;
+    cc->constants = NULL;
+    cc->constantSize = 0;
+    cc->debugInfo = SCM_NIL;
+    cc->signatureInfo = SCM_FALSE;
+    cc->name = SCM_FALSE;
+    cc->parent = SCM_FALSE;
+    cc->intermediateForm = SCM_FALSE;
+    cc->builder = NULL;
+    register_in(in, SCM_OBJ(cc));
+
+    u_long size = get_uint(in);
+    check_size(in, size, "code size");
+    cc->maxstack = (int)get_uint(in);
+    cc->requiredArgs = (u_short)get_uint(in);
+    cc->optionalArgs = (u_short)get_uint(in);
+    cc->name = read_obj(in);
+    cc->parent = read_obj(in);
+
+    /* The code vector is atomic; objects in it are kept in constants.
+       We allocate constants for the worst case. */
+    ScmWord *code = SCM_NEW_ATOMIC2(ScmWord*, size * sizeof(ScmWord));
+    ScmObj *constants = SCM_NEW_ARRAY(ScmObj, size);
+    int nconsts = 0;
+#define OPERAND(obj)                                            \
+    do {                                                        \
+        ScmObj o_ = (obj);                                      \
+        if (SCM_PTRP(o_)) constants[nconsts++] = o_;            \
+        code[i] = SCM_WORD(o_);                                 \
+    } while (0)
+#define LABEL()                                                 \
+    do {                                                        \
+        u_long off_ = get_uint(in);                             \
+        if (off_ >= size) broken("label offset");               \
+        code[i] = SCM_WORD(code + off_);                        \
+    } while (0)
+
+    for (u_long i=0; i<size; i++) {
+        ScmWord insn = (ScmWord)get_int(in);
+        code[i] = insn;
+        int type = Scm_VMInsnOperandType(SCM_VM_INSN_CODE(insn));
+        if (type != SCM_VM_OPERAND_NONE && i+1 >= size) broken("operand");
+        switch (type) {
+        case SCM_VM_OPERAND_OBJ:
+        case SCM_VM_OPERAND_CODE:
+        case SCM_VM_OPERAND_CODES:
+            i++;
+            OPERAND(read_obj(in));
+            break;
+        case SCM_VM_OPERAND_LABEL:
+            i++;
+            LABEL();
+            break;
+        case SCM_VM_OPERAND_OBJ_LABEL:
+            if (i+2 >= size) broken("operand");
+            i++;
+            OPERAND(read_obj(in));
+            i++;
+            LABEL();
+            break;
+        case SCM_VM_OPERAND_OBJ_NATIVE:
+            broken("native operand");
+        default:
+            break;
+        }
+    }
+#undef OPERAND
+#undef LABEL
+
+    cc->code = code;
+    cc->codeSize = (int)size;
+    cc->constants = constants;
+    cc->constantSize = nconsts;
+    cc->debugInfo = read_obj(in);
+    cc->signatureInfo = read_obj(in);
+    return SCM_OBJ(cc);
+}
+
+static ScmClass *uvector_class(u_long type)
+{
+    switch (type) {
+    case SCM_UVECTOR_S8:   return SCM_CLASS_S8VECTOR;
+    case SCM_UVECTOR_U8:   return SCM_CLASS_U8VECTOR;
+    case SCM_UVECTOR_S16:  return SCM_CLASS_S16VECTOR;
+    case SCM_UVECTOR_U16:  return SCM_CLASS_U16VECTOR;
+    case SCM_UVECTOR_S32:  return SCM_CLASS_S32VECTOR;
+    case SCM_UVECTOR_U32:  return SCM_CLASS_U32VECTOR;
+    case SCM_UVECTOR_S64:  return SCM_CLASS_S64VECTOR;
+    case SCM_UVECTOR_U64:  return SCM_CLASS_U64VECTOR;
+    case SCM_UVECTOR_F16:  return SCM_CLASS_F16VECTOR;
+    case SCM_UVECTOR_F32:  return SCM_CLASS_F32VECTOR;
+    case SCM_UVECTOR_F64:  return SCM_CLASS_F64VECTOR;
+    case SCM_UVECTOR_C32:  return SCM_CLASS_C32VECTOR;
+    case SCM_UVECTOR_C64:  return SCM_CLASS_C64VECTOR;
+    case SCM_UVECTOR_C128: return SCM_CLASS_C128VECTOR;
+    default: broken("uvector type"); return NULL; /* dummy */
+    }
+}
+
+static ScmObj read_hash_table(fasl_in *in)
+{
+    u_long type = get_uint(in);
+    if (type != SCM_HASH_EQ && type != SCM_HASH_EQV
+        && type != SCM_HASH_EQUAL && type != SCM_HASH_STRING) {
+        broken("hash table type");
+    }
+    u_long count = get_uint(in);
+    /* Each entry takes at least two octets. */
+    if (count > SCM_SMALL_INT_MAX / 2) broken("hash table size");
+    check_size(in, count * 2, "hash table size");
+    ScmObj ht = Scm_MakeHashTableSimple((ScmHashType)type, 0);
+    register_in(in, ht);
+    for (u_long i=0; i<count; i++) {
+        ScmObj key = read_obj(in);
+        ScmObj val = read_obj(in);
+        Scm_HashTableSet(SCM_HASH_TABLE(ht), key, val, 0);
+    }
+    return ht;
+}
+
+/* Slots that no longer exist in the class are ignored; new slots are
+   left unbound.  We don't call initialize, as aserializer doesn't. */
+static ScmObj read_instance(fasl_in *in)
+{
+    ScmObj k = read_obj(in);
+    if (!SCM_CLASSP(k) || SCM_CLASS_CATEGORY(k) != SCM_CLASS_SCHEME
+        || SCM_CLASS(k)->coreSize != (int)sizeof(ScmInstance)) {
+        broken("instance class");
+    }
+    ScmObj obj = Scm_Allocate(SCM_CLASS(k), SCM_NIL);
+    register_in(in, obj);
+    u_long nslots = get_uint(in);
+    for (u_long i=0; i<nslots; i++) {
+        ScmObj name = read_obj(in);
+        ScmObj val = read_obj(in);
+        ScmObj p = Scm_Assq(name, SCM_CLASS(k)->accessors);
+        if (!SCM_PAIRP(p)) continue;
+        int n = SCM_SLOT_ACCESSOR(SCM_CDR(p))->slotNumber;
+        if (n >= 0) SCM_INSTANCE_SLOTS(obj)[n] = val;
+    }
+    return obj;
+}
+
+static ScmObj read_obj(fasl_in *in)
+{
+    u_int tag = get_byte(in);
+    switch (tag) {
+    case TAG_REF: {
+        u_long k = get_uint(in);
+        if (k >= (u_long)in->count) broken("reference");
+        return in->table[k];
+    }
+    case TAG_FIXNUM:
+        return Scm_MakeInteger(get_int(in));
+    case TAG_IMMEDIATE: {
+        ScmObj obj = SCM_OBJ(get_uint(in));
+        if (!SCM_IMMEDIATEP(obj)) broken("immediate");
+        return obj;
+    }
+    case TAG_CHAR:
+        return SCM_MAKE_CHAR(get_uint(in));
+    case TAG_FLONUM: {
+        double d;
+        get_octets(in, &d, sizeof(double));
+        return Scm_MakeFlonum(d);
+    }
+    case TAG_BIGNUM: {
+        ScmObj n = Scm_StringToNumber(SCM_STRING(get_string(in, 0)), 16, 0);
+        if (!SCM_INTEGERP(n)) broken("bignum");
+        return n;
+    }
+    case TAG_RATNUM: {
+        ScmObj numer = read_obj(in);
+        ScmObj denom = read_obj(in);
+        if (!SCM_INTEGERP(numer) || !SCM_INTEGERP(denom)) broken("ratnum");
+        return Scm_MakeRational(numer, denom);
+    }
+    case TAG_COMPNUM: {
+        double d[2];
+        get_octets(in, d, sizeof(d));
+        return Scm_MakeComplex(d[0], d[1]);
+    }
+    case TAG_STRING: {
+        u_long flags = get_uint(in) & (SCM_STRING_IMMUTABLE|SCM_STRING_INCOMPLETE);
+        u_long size = get_uint(in);
+        u_long len = get_uint(in);
+        if (len > size) broken("string length");
+        return register_in(in, get_string_body(in, size, len, flags));
+    }
+    case TAG_SYMBOL:
+        return register_in(in, Scm_Intern(SCM_STRING(get_string(in, 0))));
+    case TAG_UNINTERNED:
+        return register_in(in, Scm_MakeSymbol(SCM_STRING(get_string(in, 0)),
+                                              FALSE));
+    case TAG_KEYWORD:
+        return register_in(in, Scm_MakeKeyword(SCM_STRING(get_string(in, 0))));
+    case TAG_PAIR:
+    case TAG_EPAIR:
+    case TAG_IPAIR:
+        return read_pair(in, tag);
+    case TAG_VECTOR: {
+        int immutable = (int)get_uint(in);
+        u_long size = get_uint(in);
+        check_size(in, size, "vector size");
+        ScmObj v = Scm_MakeVector(size, SCM_FALSE);
+        register_in(in, v);
+        for (u_long i=0; i<size; i++) {
+            SCM_VECTOR_ELEMENT(v, i) = read_obj(in);
+        }
+        if (immutable) SCM_VECTOR_IMMUTABLE_SET(v, TRUE);
+        return v;
+    }
+    case TAG_UVECTOR: {
+        ScmClass *klass = uvector_class(get_uint(in));
+        int immutable = (int)get_uint(in);
+        u_long size = get_uint(in);
+        u_long esize = (u_long)Scm_UVectorElementSize(klass);
+        if (size > SCM_SMALL_INT_MAX / esize) broken("uvector size");
+        u_long nbytes = size * esize;
+        check_size(in, nbytes, "uvector size");
+        ScmObj v = Scm_MakeUVectorFull(klass, size, NULL, immutable, NULL);
+        get_octets(in, SCM_UVECTOR_ELEMENTS(v), nbytes);
+        return register_in(in, v);
+    }
+    case TAG_CHARSET: {
+        int immutable = (int)get_uint(in);
+        u_long n = get_uint(in);
+        ScmCharSet *cs = SCM_CHAR_SET(Scm_MakeEmptyCharSet());
+        for (u_long i=0; i<n; i++) {
+            ScmChar lo = (ScmChar)get_uint(in);
+            ScmChar hi = (ScmChar)get_uint(in);
+            Scm_CharSetAddRange(cs, lo, hi);
+        }
+        if (immutable) Scm_CharSetFreezeX(cs);
+        return register_in(in, SCM_OBJ(cs));
+    }
+    case TAG_REGEXP: {
+        int flags = (int)get_uint(in);
+        ScmObj pat = read_obj(in);
+        if (!SCM_STRINGP(pat)) broken("regexp");
+        return register_in(in, Scm_RegComp(SCM_STRING(pat), flags));
+    }
+    case TAG_MODULE:
+        return register_in(in, SCM_OBJ(read_module_name(in)));
+    case TAG_IDENTIFIER: {
+        ScmObj name = read_obj(in);
+        ScmObj mod = read_obj(in);
+        if (!SCM_SYMBOLP(name) || !SCM_MODULEP(mod)) broken("identifier");
+        return register_in(in, Scm_MakeIdentifier(name, SCM_MODULE(mod),
+                                                  SCM_NIL));
+    }
+    case TAG_CLASS:
+        return register_in(in, read_class(in));
+    case TAG_CODE:
+        return read_code(in);
+    case TAG_HASH_TABLE:
+        return read_hash_table(in);
+    case TAG_INSTANCE:
+        return read_instance(in);
+    default:
+        broken("unknown tag");
+        return SCM_UNDEFINED;   /* dummy */
+    }
+}
+
+/* Reads one record from PORT and returns the object.  Returns EOF
+   if PORT is at the end. */
+ScmObj Scm_FaslRead(ScmPort *port)
+{
+    int eof = FALSE;
+    u_long size = get_port_uint(port, &eof);
+    if (eof) return SCM_EOF;
+
+    uint8_t *buf = SCM_NEW_ATOMIC2(uint8_t*, size);
+    get_port_octets(port, buf, size);
+
+    fasl_in in;
+    init_in(&in, buf, size, NULL);
+    ScmObj obj = read_obj(&in);
+    if (in.pos != in.end) broken("garbage at the end of record");
+    return obj;
+}
+
+/* Reads an object written by Scm_FaslWriteData from PORT.  Returns EOF
+   if PORT is at the end.  We never read beyond the data, so the port
+   can be shared with other data. */
+ScmObj Scm_FaslReadData(ScmPort *port)
+{
+    int eof = FALSE;
+    fasl_in in;
+    init_in(&in, NULL, 0, port);
+    in.rest = get_port_uint(port, &eof);
+    if (eof) return SCM_EOF;
+    if (in.rest == 0) broken("empty data");
+
+    u_int format = get_byte(&in);
+    if (format != FASL_DATA_FORMAT) {
+        Scm_Error("binary serializer: unsupported data format: %u", format);
+    }
+    ScmObj obj = read_obj(&in);
+    if (in.pos != in.end || in.rest != 0
+        || get_port_uint(port, NULL) != 0) {
+        broken("garbage at the end of data");
+    }
+    return obj;
+}
+
+/* A string to identify the format.  Data written by one Gauche can only
+   be read by the Gauche with the same key.  Besides the version, it
+   covers the instruction set (which may change during development), the
+   word size, and the settings that affect the compiler output. */
+ScmObj Scm_FaslVersion(void)
+{
+    u_long h = 2166136261UL;    /* FNV-1a */
+    for (int i=0; i<SCM_VM_NUM_INSNS; i++) {
+        for (const char *p = Scm_VMInsnName(i); *p; p++) {
+            h = (h ^ (u_char)*p) * 16777619UL;
+        }
+        h = (h ^ (u_long)Scm_VMInsnNumParams(i)) * 16777619UL;
+        h = (h ^ (u_long)Scm_VMInsnOperandType(i)) * 16777619UL;
+    }
+    ScmVM *vm = Scm_VM();
+    u_long cflags = vm->compilerFlags
+        & ~(SCM_COMPILE_SHOWRESULT|SCM_COMPILE_INCLUDE_VERBOSE);
+    int casefold = SCM_VM_RUNTIME_FLAG_IS_SET(vm, SCM_CASE_FOLD)? 1 : 0;
+    return Scm_Sprintf("%s:%d:%d:%lx:%lx:%d", GAUCHE_VERSION, FASL_VERSION,
+                       SIZEOF_LONG, h & 0xffffffffUL, cflags, casefold);
+}
@@ -35,6 +35,7 @@
 #include "gauche.h"
 #include "gauche/priv/configP.h"
 #include "gauche/priv/stringP.h"
+#include "gauche/priv/strsimdP.h"
 #include "gauche/priv/writerP.h"
 #include "gauche/char_attr.h"
 
@@ -43,6 +44,7 @@
 
 void Scm_DStringDump(FILE *out, ScmDString *dstr);
 static ScmObj make_string_cursor(ScmString *src, const char *cursor);
+static const char *index2ptr(const ScmStringBody *body, ScmSmallInt nchars);
 
 static void string_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
 SCM_DEFINE_BUILTIN_CLASS(Scm_StringClass, string_print, NULL, NULL, NULL,
@@ -152,22 +154,11 @@ static inline ScmSmallInt count_size_and_length(const char *str,
     return len;
 }
 
-/* Calculate length of known size string.  str can contain NUL character. */
+/* Calculate length of known size string.  str can contain NUL character.
+   Returns -1 if str isn't a valid utf-8 sequence. */
 static inline ScmSmallInt count_length(const char *str, ScmSmallInt size)
 {
-    ScmSmallInt count = 0;
-    while (size-- > 0) {
-        unsigned char c = (unsigned char)*str;
-        int i = SCM_CHAR_NFOLLOWS(c);
-        if (i < 0 || i > size) return -1;
-        ScmChar ch;
-        SCM_CHAR_GET(str, ch);
-        if (ch == SCM_CHAR_INVALID) return -1;
-        count++;
-        str += i+1;
-        size -= i;
-    }
-    return count;
+    return Scm__Utf8Length(str, size);
 }
 
 /* Returns length of string, starts from str and end at stop.
@@ -228,6 +219,21 @@ static inline const char *string_cursor_ptr(const ScmStringBody *sb, ScmObj sc)
     return ptr;
 }
 
+/* Like string_cursor_ptr, but SC can also be an index. */
+static const char *string_position_ptr(const ScmStringBody *sb, ScmObj sc)
+{
+    const char *ptr = string_cursor_ptr(sb, sc);
+    if (ptr != NULL) return ptr;
+    if (!SCM_INTP(sc)) {
+        Scm_Error("must be either an index or a cursor: %S", sc);
+    }
+    ScmSmallInt index = SCM_INT_VALUE(sc);
+    if (index < 0 || index > SCM_STRING_BODY_LENGTH(sb)) {
+        Scm_Error("index out of range: %ld", index);
+    }
+    return index2ptr(sb, index);
+}
+
 /* Returns -1 if sc isn't a cursor.  No range check performed. */
 static inline ScmSmallInt string_cursor_offset(ScmObj sc) {
     if (SCM_STRING_CURSOR_LARGE_P(sc)) {
@@ -528,6 +534,41 @@ int Scm_StringCiCmp(ScmString *x, ScmString *y)
  * Reference
  */
 
+/* Counts characters in a word of UTF-8 octets, i.e. the octets that
+   are not continuation octets (10xxxxxx).  We collect bit7 & ~bit6 of
+   each octet, then sum them up with a multiplication. */
+#if SIZEOF_LONG == 4
+#define OCTET_ONES  0x01010101UL
+#else
+#define OCTET_ONES  0x0101010101010101UL
+#endif
+
+static inline int count_chars_in_word(u_long w)
+{
+    u_long cont = (w & ~(w << 1)) & (OCTET_ONES << 7);
+    return SIZEOF_LONG
+        - (int)((((cont >> 7) * OCTET_ONES) >> ((SIZEOF_LONG-1)*8)));
+}
+
+/* Skips NCHARS characters from P in a complete multibyte string ending
+   at END, a word at a time. */
+static const char *mb_skip_chars(const char *p, const char *end,
+                                 ScmSmallInt nchars)
+{
+    while (end - p >= SIZEOF_LONG) {
+        u_long w;
+        memcpy(&w, p, SIZEOF_LONG);
+        int k = count_chars_in_word(w);
+        if (k > nchars) break;
+        nchars -= k;
+        p += SIZEOF_LONG;
+    }
+    /* P may be in the middle of a character whose first octet is counted */
+    while (p < end && ((u_char)*p & 0xc0) == 0x80) p++;
+    while (nchars-- > 0) p += SCM_CHAR_NFOLLOWS(*p) + 1;
+    return p;
+}
+
 /* Advance ptr for NCHARS characters.  Args assumed in boundary. */
 static inline const char *forward_pos(const ScmStringBody *body,
                                       const char *current,
@@ -537,6 +578,9 @@ static inline const char *forward_pos(const ScmStringBody *body,
                  SCM_STRING_BODY_INCOMPLETE_P(body))) {
         return current + nchars;
     }
+    if (body && nchars >= 2*SIZEOF_LONG) {
+        return mb_skip_chars(current, SCM_STRING_BODY_END(body), nchars);
+    }
 
     while (nchars--) {
         int n = SCM_CHAR_NFOLLOWS(*current);
@@ -545,11 +589,47 @@ static inline const char *forward_pos(const ScmStringBody *body,
     return current;
 }
 
+static int string_body_index_needed(const ScmStringBody *sb);
+
+/* Called when we need a long scan on a body without an index.  Counts
+   the access, and builds the index if the body is accessed often enough,
+   or it is large.  Returns TRUE if the index is built.  Racing updates
+   of the count are harmless; we may just lose some counts.
+   A literal string may be in read-only memory, so we only touch bodies
+   in the GC heap. */
+static int auto_index(const ScmStringBody *body)
+{
+    if (SCM_STRING_BODY_SIZE(body) < STRING_AUTO_INDEX_MIN_SIZE
+        || !string_body_index_needed(body)
+        || GC_base((void*)body) == NULL) {
+        return FALSE;
+    }
+    ScmStringBody *b = (ScmStringBody*)body;
+    if (SCM_STRING_BODY_SIZE(b) < STRING_AUTO_INDEX_EAGER_SIZE
+        && STRING_BODY_ACCESS_COUNT(b) < STRING_AUTO_INDEX_COUNT-1) {
+        b->flags += STRING_BODY_ACCESS_UNIT;
+        return FALSE;
+    }
+    Scm_StringBodyBuildIndex(b);
+    return TRUE;
+}
+
+/* A string derived from an indexed string is likely to be accessed
+   in the same way, so we let it be indexed on its first long scan. */
+static void inherit_index_hint(ScmString *s, const ScmStringBody *src)
+{
+    if (SCM_STRING_BODY_HAS_INDEX(src)) {
+        s->initialBody.flags |=
+            (STRING_AUTO_INDEX_COUNT-1) << STRING_BODY_ACCESS_SHIFT;
+    }
+}
+
 /* Index -> ptr.  Args assumed in boundary. */
 static const char *index2ptr(const ScmStringBody *body,
                              ScmSmallInt nchars)
 {
-    if (body->index == NULL) {
+    if (body->index == NULL
+        && (nchars < STRING_AUTO_INDEX_MIN_SCAN || !auto_index(body))) {
         return forward_pos(body, SCM_STRING_BODY_START(body), nchars);
     }
     ScmStringIndex *index = STRING_INDEX(body->index);
@@ -692,7 +772,10 @@ ScmObj Scm_StringAppend2(ScmString *x, ScmString *y)
     if (SCM_STRING_BODY_INCOMPLETE_P(xb) || SCM_STRING_BODY_INCOMPLETE_P(yb)) {
         flags |= SCM_STRING_INCOMPLETE; /* yields incomplete string */
     }
-    return SCM_OBJ(make_str(lenx+leny, sizex+sizey, p, flags, NULL));
+    ScmString *r = make_str(lenx+leny, sizex+sizey, p, flags, NULL);
+    inherit_index_hint(r, xb);
+    inherit_index_hint(r, yb);
+    return SCM_OBJ(r);
 }
 
 ScmObj Scm_StringAppendC(ScmString *x, const char *str,
@@ -716,7 +799,9 @@ ScmObj Scm_StringAppendC(ScmString *x, const char *str,
     if (SCM_STRING_BODY_INCOMPLETE_P(xb) || leny < 0) {
         flags |= SCM_STRING_INCOMPLETE;
     }
-    return SCM_OBJ(make_str(lenx + leny, sizex + sizey, p, flags, NULL));
+    ScmString *r = make_str(lenx + leny, sizex + sizey, p, flags, NULL);
+    inherit_index_hint(r, xb);
+    return SCM_OBJ(r);
 }
 
 ScmObj Scm_StringAppend(ScmObj strs)
@@ -725,6 +810,7 @@ ScmObj Scm_StringAppend(ScmObj strs)
     ScmSmallInt size = 0, len = 0;
     u_long flags = 0;
     const ScmStringBody *bodies_s[BODY_ARRAY_SIZE], **bodies;
+    const ScmStringBody *indexed = NULL;
 
     /* It is trickier than it appears, since the strings may be modified
        by another thread during we're dealing with it.  So in the first
@@ -752,6 +838,7 @@ ScmObj Scm_StringAppend(ScmObj strs)
         if (SCM_STRING_BODY_INCOMPLETE_P(b)) {
             flags |= SCM_STRING_INCOMPLETE;
         }
+        if (SCM_STRING_BODY_HAS_INDEX(b)) indexed = b;
         bodies[i++] = b;
     }
 
@@ -765,7 +852,9 @@ ScmObj Scm_StringAppend(ScmObj strs)
     *bufp = '\0';
     bodies = NULL;              /* to help GC */
     flags |= SCM_STRING_TERMINATED;
-    return SCM_OBJ(make_str(len, size, buf, flags, NULL));
+    ScmString *r = make_str(len, size, buf, flags, NULL);
+    if (indexed) inherit_index_hint(r, indexed);
+    return SCM_OBJ(r);
 #undef BODY_ARRAY_SIZE
 }
 
@@ -775,6 +864,7 @@ ScmObj Scm_StringJoin(ScmObj strs, ScmString *delim, int grammar)
     ScmSmallInt size = 0, len = 0;
     u_long flags = 0;
     const ScmStringBody *bodies_s[BODY_ARRAY_SIZE], **bodies;
+    const ScmStringBody *indexed = NULL;
 
     ScmSmallInt nstrs = Scm_Length(strs);
     if (nstrs < 0) Scm_Error("improper list not allowed: %S", strs);
@@ -812,6 +902,7 @@ ScmObj Scm_StringJoin(ScmObj strs, ScmString *delim, int grammar)
         if (SCM_STRING_BODY_INCOMPLETE_P(b)) {
             flags |= SCM_STRING_INCOMPLETE;
         }
+        if (SCM_STRING_BODY_HAS_INDEX(b)) indexed = b;
         bodies[i++] = b;
     }
     if (grammar == SCM_STRING_JOIN_INFIX
@@ -846,7 +937,9 @@ ScmObj Scm_StringJoin(ScmObj strs, ScmString *delim, int grammar)
     *bufp = '\0';
     bodies = NULL;              /* to help GC */
     flags |= SCM_STRING_TERMINATED;
-    return SCM_OBJ(make_str(len, size, buf, flags, NULL));
+    ScmString *r = make_str(len, size, buf, flags, NULL);
+    if (indexed) inherit_index_hint(r, indexed);
+    return SCM_OBJ(r);
 #undef BODY_ARRAY_SIZE
 }
 
@@ -912,8 +1005,12 @@ static ScmObj substring(const ScmStringBody *xb,
             }
             flags &= ~SCM_STRING_TERMINATED;
         }
-        return SCM_OBJ(make_str(end - start,
-                                (ScmSmallInt)(e - s), s, flags, NULL));
+        /* The index of XB is valid for its prefix as well. */
+        const void *index = (start == 0)? xb->index : NULL;
+        ScmString *r = make_str(end - start, (ScmSmallInt)(e - s), s,
+                                flags, index);
+        if (index == NULL) inherit_index_hint(r, xb);
+        return SCM_OBJ(r);
     }
 }
 
@@ -1028,24 +1125,7 @@ ScmObj Scm_MaybeSubstring(ScmString *x, ScmObj start, ScmObj end)
  * Search & parse
  */
 
-/* Boyer-Moore string search.  assuming siz1 > siz2, siz2 < 256. */
-static ScmSmallInt boyer_moore(const char *ss1, ScmSmallInt siz1,
-                               const char *ss2, ScmSmallInt siz2)
-{
-    unsigned char shift[256];
-    for (ScmSmallInt i=0; i<256; i++) { shift[i] = siz2; }
-    for (ScmSmallInt j=0; j<siz2-1; j++) {
-        shift[(unsigned char)ss2[j]] = siz2-j-1;
-    }
-    for (ScmSmallInt i=siz2-1; i<siz1; i+=shift[(unsigned char)ss1[i]]) {
-        ScmSmallInt j, k;
-        for (j=siz2-1, k = i; j>=0 && ss1[k] == ss2[j]; j--, k--)
-            ;
-        if (j == -1) return k+1;
-    }
-    return -1;
-}
-
+/* Boyer-Moore reverse string search.  assuming siz1 > siz2, siz2 < 256. */
 static ScmSmallInt boyer_moore_reverse(const char *ss1, ScmSmallInt siz1,
                                        const char *ss2, ScmSmallInt siz2)
 {
@@ -1070,8 +1150,9 @@ static ScmSmallInt boyer_moore_reverse(const char *ss1, ScmSmallInt siz1,
 
    With utf-8, we can scan a string as if it si just a bytestring.  However,
    we need to calculate character index after we find the match.  It is still
-   a total win, for finding out non-matches using Boyer-Moore is a lot
-   faster than naive way.
+   a total win, for finding out non-matches with byte search is a lot
+   faster than naive way.  Forward search uses the vectorized kernel
+   (see strsimd.c).
  */
 
 /* return value of string_scan */
@@ -1079,17 +1160,6 @@ static ScmSmallInt boyer_moore_reverse(const char *ss1, ScmSmallInt siz1,
 #define FOUND_BOTH_INDEX 1  /* string found, and both indexes are calculated */
 #define FOUND_BYTE_INDEX 2  /* string found, and only byte index is calc'd */
 
-/* glibc has memrchr, but we need to provide fallback anyway and
-   we don't need it to be highly tuned, so we just roll our own. */
-static const void *my_memrchr(const void *s, int c, size_t n)
-{
-    const char *p = (const char*)s + n - 1;
-    for (;p >= (const char*)s; p--) {
-        if ((int)*p == c) return p;
-    }
-    return NULL;
-}
-
 /* NB: len1 and len2 only used in certain internal CES. */
 static int string_search(const char *s1, ScmSmallInt siz1,
                          ScmSmallInt len1 SCM_UNUSED,
@@ -1103,28 +1173,10 @@ static int string_search(const char *s1, ScmSmallInt siz1,
         return FOUND_BOTH_INDEX;
     }
 
-    if (siz2 == 1) {
-        /* Single ASCII character search case.  This is a huge win. */
-        const char *z = memchr(s1, s2[0], siz1);
-        if (z) { *bi = *ci = z - s1; return FOUND_BYTE_INDEX; }
-        else return NOT_FOUND;
-    } else {
-        ScmSmallInt i;
-        /* Shortcut for single-byte strings */
-        if (siz1 < siz2) return NOT_FOUND;
-        if (siz1 < 256 || siz2 >= 256) {
-            /* brute-force search */
-            for (i=0; i<=siz1-siz2; i++) {
-                if (memcmp(s2, s1+i, siz2) == 0) break;
-            }
-            if (i == siz1-siz2+1) return NOT_FOUND;
-        } else {
-            i = boyer_moore(s1, siz1, s2, siz2);
-            if (i < 0) return NOT_FOUND;
-        }
-        *bi = *ci = i;
-        return FOUND_BYTE_INDEX;
-    }
+    ScmSmallInt i = Scm__ByteSearch(s1, siz1, s2, siz2);
+    if (i < 0) return NOT_FOUND;
+    *bi = *ci = i;
+    return FOUND_BYTE_INDEX;
 }
 
 /* NB: len2 is only used in some internal CES */
@@ -1143,7 +1195,7 @@ static int string_search_reverse(const char *s1, ScmSmallInt siz1,
 
     if (siz2 == 1) {
         /* Single ASCII character search case.  This is a huge win. */
-        const char *z = my_memrchr(s1, s2[0], siz1);
+        const char *z = Scm__MemRChr(s1, s2[0], siz1);
         if (z) { *bi = *ci = z - s1; return FOUND_BYTE_INDEX; }
         else return NOT_FOUND;
     } else {
@@ -1231,7 +1283,8 @@ static int string_scan(ScmString *ss1, const char *s2,
 
     if (retmode != SCM_STRING_SCAN_CURSOR
         && (retcode == FOUND_BYTE_INDEX && !incomplete)) {
-        ci = count_length(s1, bi);
+        /* s1 is complete, so we don't need to validate it */
+        ci = Scm__CountChars(s1, bi);
     }
 
     switch (retmode) {
@@ -1316,6 +1369,26 @@ ScmObj Scm_StringScanCharRight(ScmString *s1, ScmChar ch, int retmode)
     else return Scm_Values2(v1, v2);
 }
 
+/* Returns a cursor pointing to the first CH in S1 between START and END,
+   each of which is either an index or a cursor, or #f if there's none.
+   This is the fast path of string-index with a character. */
+ScmObj Scm_StringScanCharCursor(ScmString *s1, ScmChar ch,
+                                ScmObj start, ScmObj end)
+{
+    const ScmStringBody *sb = SCM_STRING_BODY(s1);
+    const char *sp = string_position_ptr(sb, start);
+    const char *ep = string_position_ptr(sb, end);
+    if (sp >= ep) return SCM_FALSE;
+    if (SCM_STRING_BODY_INCOMPLETE_P(sb)) {
+        Scm_Error("incomplete string not allowed : %S", s1);
+    }
+    char buf[SCM_CHAR_MAX_BYTES];
+    SCM_CHAR_PUT(buf, ch);
+    ScmSmallInt i = Scm__ByteSearch(sp, ep - sp, buf, SCM_CHAR_NBYTES(ch));
+    if (i < 0) return SCM_FALSE;
+    return make_string_cursor(s1, sp + i);
+}
+
 #undef NOT_FOUND
 #undef FOUND_BOTH_INDEX
 #undef FOUND_BYTE_INDEX
@@ -1783,18 +1856,11 @@ ScmObj Scm_StringCursorIndex(ScmString *src, ScmObj sc)
         return SCM_MAKE_INT(ptr - SCM_STRING_BODY_START(srcb));
     }
 
-    const char *current = SCM_STRING_BODY_START(srcb);
-    ScmSmallInt len     = SCM_STRING_BODY_LENGTH(srcb);
-    ScmSmallInt index   = 0;
-    while (index < len && current < ptr) {
-        current += SCM_CHAR_NFOLLOWS(*current) + 1;
-        index++;
-    }
-    if (current != ptr) {
+    if (ptr < SCM_STRING_BODY_END(srcb) && (*ptr & 0xc0) == 0x80) {
         Scm_Error("cursor not pointed at the beginning of a character: %S", sc);
     }
-
-    return SCM_MAKE_INT(index);
+    const char *start = SCM_STRING_BODY_START(srcb);
+    return SCM_MAKE_INT(Scm__CountChars(start, ptr - start));
 }
 
 ScmObj Scm_StringCursorForward(ScmString* s, ScmObj sc, int nchars)
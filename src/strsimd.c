@@ -0,0 +1,594 @@
+/*
+ * strsimd.c - vectorized string primitives
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/priv/strsimdP.h"
+
+/* See gauche/priv/strsimdP.h for the interface.
+
+   The vector kernels are compiled only with gcc-compatible compilers
+   on x86.  SSE2 is the baseline of x86_64, so it's always there; AVX2
+   kernels are compiled with the target attribute, and chosen only if
+   the cpu supports it.
+ */
+
+#if defined(__GNUC__) && defined(__SSE2__) \
+    && (defined(__x86_64__) || defined(__i386__))
+#define USE_SSE2 1
+#define USE_AVX2 1
+#include <immintrin.h>
+#define AVX2_FN  __attribute__((target("avx2")))
+#endif
+
+/*================================================================
+ * Dispatch
+ */
+
+static int simd_level = -1;     /* -1: not determined yet */
+
+static int supported_level(void)
+{
+#if defined(USE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SCM_STRING_SIMD_AVX2;
+#endif
+#if defined(USE_SSE2)
+    return SCM_STRING_SIMD_SSE2;
+#else
+    return SCM_STRING_SIMD_NONE;
+#endif
+}
+
+/* Races are harmless; every thread gets the same value. */
+static inline int current_level(void)
+{
+    int level = simd_level;
+    if (level < 0) simd_level = level = supported_level();
+    return level;
+}
+
+int Scm__StringSimdLevel(void)
+{
+    return current_level();
+}
+
+int Scm__SetStringSimdLevel(int level)
+{
+    int supported = supported_level();
+    if (level < 0 || level > supported) level = supported;
+    simd_level = level;
+    return level;
+}
+
+/*================================================================
+ * Substring search
+ */
+
+/* Two-way string matching (Crochemore and Perrin), combined with
+   the bad-character shift of Horspool.  It runs in linear time with
+   constant space besides the shift table, so we use it as the scalar
+   search, and as the fallback when the vector filter below finds too
+   many false candidates. */
+
+/* Returns the starting position of the maximal suffix of N, minus one,
+   w.r.t. the ordering of octets (reversed if REV).  Its period is set
+   in *PERIOD. */
+static ScmSmallInt maximal_suffix(const unsigned char *n, ScmSmallInt m,
+                                  int rev, ScmSmallInt *period)
+{
+    ScmSmallInt ms = -1, j = 0, k = 1, p = 1;
+    while (j + k < m) {
+        unsigned char a = n[ms+k], b = n[j+k];
+        if (a == b) {
+            if (k == p) { j += p; k = 1; }
+            else k++;
+        } else if ((a > b) != rev) {
+            j += k; k = 1; p = j - ms;
+        } else {
+            ms = j++; k = p = 1;
+        }
+    }
+    *period = p;
+    return ms;
+}
+
+static ScmSmallInt two_way_search(const char *s1, ScmSmallInt siz1,
+                                  const char *s2, ScmSmallInt siz2)
+{
+    const unsigned char *h = (const unsigned char*)s1;
+    const unsigned char *n = (const unsigned char*)s2;
+    ScmSmallInt m = siz2, shift[256];
+
+    for (int i=0; i<256; i++) shift[i] = m;
+    for (ScmSmallInt i=0; i<m; i++) shift[n[i]] = m-1-i;
+
+    /* Critical factorization */
+    ScmSmallInt p, q;
+    ScmSmallInt ms = maximal_suffix(n, m, FALSE, &p);
+    ScmSmallInt ms2 = maximal_suffix(n, m, TRUE, &q);
+    if (ms2 > ms) { ms = ms2; p = q; }
+
+    /* If the needle is periodic, we remember how much of the prefix
+       is known to match after shifting by the period. */
+    ScmSmallInt mem0;
+    if (memcmp(n, n+p, ms+1) != 0) {
+        mem0 = 0;
+        p = ((ms > m-ms-1)? ms : m-ms-1) + 1;
+    } else {
+        mem0 = m - p;
+    }
+
+    ScmSmallInt pos = 0, mem = 0;
+    while (pos <= siz1 - m) {
+        const unsigned char *w = h + pos;
+        ScmSmallInt k = shift[w[m-1]];
+        if (k) {
+            if (k < mem) k = mem;
+            pos += k;
+            mem = 0;
+            continue;
+        }
+        /* Right half */
+        for (k = (ms+1 > mem)? ms+1 : mem; k < m && n[k] == w[k]; k++)
+            ;
+        if (k < m) {
+            pos += k - ms;
+            mem = 0;
+            continue;
+        }
+        /* Left half */
+        for (k = ms+1; k > mem && n[k-1] == w[k-1]; k--)
+            ;
+        if (k <= mem) return pos;
+        pos += p;
+        mem = mem0;
+    }
+    return -1;
+}
+
+/* For short haystacks, setting up two-way costs more than it saves. */
+static ScmSmallInt scalar_search(const char *s1, ScmSmallInt siz1,
+                                 const char *s2, ScmSmallInt siz2)
+{
+    if (siz1 < siz2) return -1;
+    if (siz1 >= 256) return two_way_search(s1, siz1, s2, siz2);
+    for (ScmSmallInt i=0; i<=siz1-siz2; i++) {
+        if (s1[i] == s2[0] && memcmp(s1+i, s2, siz2) == 0) return i;
+    }
+    return -1;
+}
+
+/* Vector search compares the first and the last octets of the needle
+   with a vector of positions at once, and verifies only the positions
+   where both match.  If the verification fails too often (e.g. the
+   needle is "aaa...ab" and the haystack is all 'a'), it'd degrade to
+   O(n*m), so we switch to two-way when the work spent on verification
+   exceeds twice the scanned size (plus some slack). */
+#define VERIFY_SLACK 1024
+
+#if defined(USE_SSE2)
+static ScmSmallInt search_sse2(const char *s1, ScmSmallInt siz1,
+                               const char *s2, ScmSmallInt siz2)
+{
+    const __m128i first = _mm_set1_epi8(s2[0]);
+    const __m128i last  = _mm_set1_epi8(s2[siz2-1]);
+    ScmSmallInt npos = siz1 - siz2 + 1; /* # of candidate positions */
+    ScmSmallInt i = 0, work = 0;
+
+    for (; i + 16 <= npos; i += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(s1+i));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(s1+i+siz2-1));
+        unsigned mask =
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf, first),
+                                            _mm_cmpeq_epi8(bl, last)));
+        while (mask) {
+            ScmSmallInt j = i + __builtin_ctz(mask);
+            if (memcmp(s1+j+1, s2+1, siz2-2) == 0) return j;
+            work += siz2;
+            if (work > 2*i + VERIFY_SLACK) goto fallback;
+            mask &= mask - 1;
+        }
+    }
+ fallback:;
+    ScmSmallInt r = scalar_search(s1+i, siz1-i, s2, siz2);
+    return (r < 0)? -1 : i + r;
+}
+#endif /*USE_SSE2*/
+
+#if defined(USE_AVX2)
+static AVX2_FN ScmSmallInt search_avx2(const char *s1, ScmSmallInt siz1,
+                                       const char *s2, ScmSmallInt siz2)
+{
+    const __m256i first = _mm256_set1_epi8(s2[0]);
+    const __m256i last  = _mm256_set1_epi8(s2[siz2-1]);
+    ScmSmallInt npos = siz1 - siz2 + 1;
+    ScmSmallInt i = 0, work = 0;
+
+    for (; i + 32 <= npos; i += 32) {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)(s1+i));
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(s1+i+siz2-1));
+        unsigned mask = (unsigned)
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(bf, first),
+                                                  _mm256_cmpeq_epi8(bl, last)));
+        while (mask) {
+            ScmSmallInt j = i + __builtin_ctz(mask);
+            if (memcmp(s1+j+1, s2+1, siz2-2) == 0) return j;
+            work += siz2;
+            if (work > 2*i + VERIFY_SLACK) goto fallback;
+            mask &= mask - 1;
+        }
+    }
+ fallback:;
+    ScmSmallInt r = scalar_search(s1+i, siz1-i, s2, siz2);
+    return (r < 0)? -1 : i + r;
+}
+#endif /*USE_AVX2*/
+
+ScmSmallInt Scm__ByteSearch(const char *s1, ScmSmallInt siz1,
+                            const char *s2, ScmSmallInt siz2)
+{
+    if (siz2 == 0) return 0;
+    if (siz1 < siz2) return -1;
+    if (siz2 == 1) {
+        /* libc's memchr is already vectorized. */
+        const char *z = memchr(s1, s2[0], siz1);
+        return z ? z - s1 : -1;
+    }
+    switch (current_level()) {
+#if defined(USE_AVX2)
+    case SCM_STRING_SIMD_AVX2: return search_avx2(s1, siz1, s2, siz2);
+#endif
+#if defined(USE_SSE2)
+    case SCM_STRING_SIMD_SSE2: return search_sse2(s1, siz1, s2, siz2);
+#endif
+    default: return scalar_search(s1, siz1, s2, siz2);
+    }
+}
+
+/*================================================================
+ * Reverse character scan
+ */
+
+/* glibc has memrchr, but not everywhere. */
+static const char *memrchr_scalar(const char *s, int c, ScmSmallInt siz)
+{
+    for (const char *p = s + siz - 1; p >= s; p--) {
+        if (*p == (char)c) return p;
+    }
+    return NULL;
+}
+
+#if defined(USE_SSE2)
+static const char *memrchr_sse2(const char *s, int c, ScmSmallInt siz)
+{
+    const __m128i v = _mm_set1_epi8((char)c);
+    while (siz >= 16) {
+        siz -= 16;
+        unsigned mask = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s+siz)), v));
+        if (mask) return s + siz + 31 - __builtin_clz(mask);
+    }
+    return memrchr_scalar(s, c, siz);
+}
+#endif /*USE_SSE2*/
+
+#if defined(USE_AVX2)
+static AVX2_FN const char *memrchr_avx2(const char *s, int c, ScmSmallInt siz)
+{
+    const __m256i v = _mm256_set1_epi8((char)c);
+    while (siz >= 32) {
+        siz -= 32;
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(s+siz)), v));
+        if (mask) return s + siz + 31 - __builtin_clz(mask);
+    }
+    return memrchr_scalar(s, c, siz);
+}
+#endif /*USE_AVX2*/
+
+const char *Scm__MemRChr(const char *s, int c, ScmSmallInt siz)
+{
+    switch (current_level()) {
+#if defined(USE_AVX2)
+    case SCM_STRING_SIMD_AVX2: return memrchr_avx2(s, c, siz);
+#endif
+#if defined(USE_SSE2)
+    case SCM_STRING_SIMD_SSE2: return memrchr_sse2(s, c, siz);
+#endif
+    default: return memrchr_scalar(s, c, siz);
+    }
+}
+
+/*================================================================
+ * Counting characters
+ */
+
+static ScmSmallInt count_chars_scalar(const char *s, ScmSmallInt siz)
+{
+    ScmSmallInt count = 0;
+    for (ScmSmallInt i=0; i<siz; i++) {
+        if ((s[i] & 0xc0) != 0x80) count++;
+    }
+    return count;
+}
+
+/* A non-continuation octet is greater than 0xbf (-65) as a signed char.
+   Comparison yields -1 for them, so we subtract it from per-lane
+   counters, and sum up the lanes at least every 255 iterations
+   before they overflow. */
+#if defined(USE_SSE2)
+static ScmSmallInt count_chars_sse2(const char *s, ScmSmallInt siz)
+{
+    const __m128i thresh = _mm_set1_epi8(-65);
+    ScmSmallInt count = 0, i = 0;
+    while (i + 16 <= siz) {
+        ScmSmallInt lim = (siz - i > 16*255)? i + 16*255 : siz;
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 16 <= lim; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+            acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(v, thresh));
+        }
+        __m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+        count += _mm_cvtsi128_si32(sum) + _mm_extract_epi16(sum, 4);
+    }
+    return count + count_chars_scalar(s+i, siz-i);
+}
+#endif /*USE_SSE2*/
+
+#if defined(USE_AVX2)
+static AVX2_FN ScmSmallInt count_chars_avx2(const char *s, ScmSmallInt siz)
+{
+    const __m256i thresh = _mm256_set1_epi8(-65);
+    ScmSmallInt count = 0, i = 0;
+    while (i + 32 <= siz) {
+        ScmSmallInt lim = (siz - i > 32*255)? i + 32*255 : siz;
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 32 <= lim; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(s+i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpgt_epi8(v, thresh));
+        }
+        __m256i sum = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+        __m128i sum2 = _mm_add_epi64(_mm256_castsi256_si128(sum),
+                                     _mm256_extracti128_si256(sum, 1));
+        count += _mm_cvtsi128_si32(sum2) + _mm_extract_epi16(sum2, 4);
+    }
+    return count + count_chars_scalar(s+i, siz-i);
+}
+#endif /*USE_AVX2*/
+
+ScmSmallInt Scm__CountChars(const char *s, ScmSmallInt siz)
+{
+    switch (current_level()) {
+#if defined(USE_AVX2)
+    case SCM_STRING_SIMD_AVX2: return count_chars_avx2(s, siz);
+#endif
+#if defined(USE_SSE2)
+    case SCM_STRING_SIMD_SSE2: return count_chars_sse2(s, siz);
+#endif
+    default: return count_chars_scalar(s, siz);
+    }
+}
+
+/*================================================================
+ * Validation
+ */
+
+/* Returns the size of the character at P if it is valid, -1 otherwise.
+   This must agree with Scm_CharUtf8Getc: a 2-octet sequence must encode
+   a value >= 0x80, a 3-octet one >= 0x800, and so on.  Only a lead
+   octet without payload bits (c0, e0, f0, f8, fc) can make an overlong
+   form, which is determined by the second octet. */
+static inline int utf8_char_size(const unsigned char *p,
+                                 const unsigned char *end)
+{
+    static const unsigned char min2[7] = {0, 0, 0, 0xa0, 0x90, 0x88, 0x84};
+    unsigned char c = p[0];
+    int n;
+    if (c < 0x80) return 1;
+    else if (c < 0xc2) return -1; /* stray continuation, or overlong */
+    else if (c < 0xe0) n = 2;
+    else if (c < 0xf0) n = 3;
+    else if (c < 0xf8) n = 4;
+    else if (c < 0xfc) n = 5;
+    else if (c < 0xfe) n = 6;
+    else return -1;
+    if (end - p < n) return -1;
+    for (int i=1; i<n; i++) {
+        if ((p[i] & 0xc0) != 0x80) return -1;
+    }
+    if (n > 2 && c == (unsigned char)(0xff << (8-n)) && p[1] < min2[n]) {
+        return -1;
+    }
+    return n;
+}
+
+static ScmSmallInt utf8_length_scalar(const unsigned char *p,
+                                      const unsigned char *end,
+                                      ScmSmallInt count)
+{
+    while (p < end) {
+        int n = utf8_char_size(p, end);
+        if (n < 0) return -1;
+        p += n;
+        count++;
+    }
+    return count;
+}
+
+/* Vector validation.
+
+   We handle the common case, where all characters are 1 to 3 octets,
+   with vectors; a vector containing an octet >= 0xf0 is checked by
+   the scalar routine instead.  Within that range, the sequence is
+   valid iff:
+
+   - An octet is a continuation octet iff the previous one is a lead
+     octet (>= 0xc0), or the one before it is a 3-octet lead (>= 0xe0).
+   - There's no c0 or c1 (always overlong).
+   - e0 isn't followed by an octet < 0xa0 (overlong).
+
+   The previous octets are loaded from unaligned addresses one and two
+   octets before, so the vector loop must start after the first two
+   octets, at a character boundary.  Those two octets and the last
+   character that may cross the end of the last vector are checked by
+   the scalar routine.  We only validate here; the characters are
+   counted by count_chars_*, which is faster than counting along.
+ */
+
+/* Scalar-validates characters from P until it passes LIM.  Returns the
+   position after the last character, or NULL if invalid. */
+static inline const unsigned char *utf8_skip_valid(const unsigned char *p,
+                                                   const unsigned char *lim,
+                                                   const unsigned char *end)
+{
+    while (p < lim) {
+        int n = utf8_char_size(p, end);
+        if (n < 0) return NULL;
+        p += n;
+    }
+    return p;
+}
+
+/* The last character checked by vectors may be incomplete, for its
+   continuation octets are checked with the next vector.  Returns the
+   beginning of the last character in [P-3, P), from where the scalar
+   routine should take over.  If there's none, P is at a character
+   boundary after a character checked by the scalar routine. */
+static inline const unsigned char *last_char_start(const unsigned char *s,
+                                                   const unsigned char *p)
+{
+    for (int i=1; i<=3 && p-i >= s; i++) {
+        if ((p[-i] & 0xc0) != 0x80) return p-i;
+    }
+    return p;
+}
+
+#if defined(USE_SSE2)
+/* unsigned x >= y */
+#define GE_U8_SSE2(x, y)  _mm_cmpeq_epi8(_mm_max_epu8(x, y), x)
+
+static int utf8_valid_sse2(const char *str, ScmSmallInt siz)
+{
+    const unsigned char *s = (const unsigned char*)str, *end = s + siz;
+    const unsigned char *p = utf8_skip_valid(s, s+2, end);
+    if (p == NULL) return FALSE;
+
+    const __m128i x80 = _mm_set1_epi8((char)0x80), xa0 = _mm_set1_epi8((char)0xa0);
+    const __m128i xc0 = _mm_set1_epi8((char)0xc0), xe0 = _mm_set1_epi8((char)0xe0);
+    const __m128i xf0 = _mm_set1_epi8((char)0xf0), xfe = _mm_set1_epi8((char)0xfe);
+    __m128i err = _mm_setzero_si128();
+
+    while (end - p >= 16) {
+        __m128i cur = _mm_loadu_si128((const __m128i*)p);
+        if (_mm_movemask_epi8(GE_U8_SSE2(cur, xf0))) {
+            p = utf8_skip_valid(last_char_start(s, p), p+16, end);
+            if (p == NULL) return FALSE;
+            continue;
+        }
+        __m128i prev1 = _mm_loadu_si128((const __m128i*)(p-1));
+        __m128i prev2 = _mm_loadu_si128((const __m128i*)(p-2));
+        __m128i cont = _mm_cmpeq_epi8(_mm_and_si128(cur, xc0), x80);
+        __m128i want = _mm_or_si128(GE_U8_SSE2(prev1, xc0),
+                                    GE_U8_SSE2(prev2, xe0));
+        err = _mm_or_si128(err, _mm_xor_si128(cont, want));
+        err = _mm_or_si128(err, _mm_cmpeq_epi8(_mm_and_si128(cur, xfe), xc0));
+        err = _mm_or_si128(err, _mm_andnot_si128(GE_U8_SSE2(cur, xa0),
+                                                 _mm_cmpeq_epi8(prev1, xe0)));
+        p += 16;
+    }
+    if (_mm_movemask_epi8(err)) return FALSE;
+    return utf8_skip_valid(last_char_start(s, p), end, end) != NULL;
+}
+#endif /*USE_SSE2*/
+
+#if defined(USE_AVX2)
+#define GE_U8_AVX2(x, y)  _mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x)
+
+static AVX2_FN int utf8_valid_avx2(const char *str, ScmSmallInt siz)
+{
+    const unsigned char *s = (const unsigned char*)str, *end = s + siz;
+    const unsigned char *p = utf8_skip_valid(s, s+2, end);
+    if (p == NULL) return FALSE;
+
+    const __m256i x80 = _mm256_set1_epi8((char)0x80), xa0 = _mm256_set1_epi8((char)0xa0);
+    const __m256i xc0 = _mm256_set1_epi8((char)0xc0), xe0 = _mm256_set1_epi8((char)0xe0);
+    const __m256i xf0 = _mm256_set1_epi8((char)0xf0), xfe = _mm256_set1_epi8((char)0xfe);
+    __m256i err = _mm256_setzero_si256();
+
+    while (end - p >= 32) {
+        __m256i cur = _mm256_loadu_si256((const __m256i*)p);
+        if (_mm256_movemask_epi8(GE_U8_AVX2(cur, xf0))) {
+            p = utf8_skip_valid(last_char_start(s, p), p+32, end);
+            if (p == NULL) return FALSE;
+            continue;
+        }
+        __m256i prev1 = _mm256_loadu_si256((const __m256i*)(p-1));
+        __m256i prev2 = _mm256_loadu_si256((const __m256i*)(p-2));
+        __m256i cont = _mm256_cmpeq_epi8(_mm256_and_si256(cur, xc0), x80);
+        __m256i want = _mm256_or_si256(GE_U8_AVX2(prev1, xc0),
+                                       GE_U8_AVX2(prev2, xe0));
+        err = _mm256_or_si256(err, _mm256_xor_si256(cont, want));
+        err = _mm256_or_si256(err, _mm256_cmpeq_epi8(_mm256_and_si256(cur, xfe), xc0));
+        err = _mm256_or_si256(err, _mm256_andnot_si256(GE_U8_AVX2(cur, xa0),
+                                                       _mm256_cmpeq_epi8(prev1, xe0)));
+        p += 32;
+    }
+    if (_mm256_movemask_epi8(err)) return FALSE;
+    return utf8_skip_valid(last_char_start(s, p), end, end) != NULL;
+}
+#endif /*USE_AVX2*/
+
+/* Below this size, a single scalar pass is faster than two vector
+   passes. */
+#define UTF8_VECTOR_MIN  64
+
+ScmSmallInt Scm__Utf8Length(const char *s, ScmSmallInt siz)
+{
+    if (siz >= UTF8_VECTOR_MIN) {
+        switch (current_level()) {
+#if defined(USE_AVX2)
+        case SCM_STRING_SIMD_AVX2:
+            return utf8_valid_avx2(s, siz) ? count_chars_avx2(s, siz) : -1;
+#endif
+#if defined(USE_SSE2)
+        case SCM_STRING_SIMD_SSE2:
+            return utf8_valid_sse2(s, siz) ? count_chars_sse2(s, siz) : -1;
+#endif
+        default: break;
+        }
+    }
+    return utf8_length_scalar((const unsigned char*)s,
+                              (const unsigned char*)s + siz, 0);
+}
@@ -36,6 +36,7 @@
 #include "gauche/priv/configP.h"
 #include "gauche/exception.h"
 #include "gauche/priv/builtin-syms.h"
+#include "gauche/priv/classP.h"
 #include "gauche/priv/codeP.h"
 #include "gauche/priv/vmP.h"
 #include "gauche/priv/glocP.h"
@@ -322,6 +323,8 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
     v->stat.sovCount = 0;
     v->stat.sovTime = 0;
     v->stat.loadStat = SCM_NIL;
+    v->cells = NULL;
+    v->allocBytes = 0;
     v->profilerRunning = FALSE;
     v->prof = NULL;
 
@@ -433,6 +436,8 @@ ScmVM *Scm_VMTakeSnapshot(ScmVM *master)
     v->stat.sovCount = master->stat.sovCount;
     v->stat.sovTime = master->stat.sovTime;
     v->stat.loadStat = master->stat.loadStat;
+    v->cells = NULL;            /* must not share the cache */
+    v->allocBytes = master->allocBytes;
     v->profilerRunning = master->profilerRunning;
     v->prof = master->prof;     /* TODO: Should we copy this? */
 
@@ -729,7 +734,7 @@ static void vm_unregister(ScmVM *vm)
             BASE = cont->base;                                          \
             CONT = cont->prev;                                          \
             vm->ccont = cont->cpc;                                      \
-            SCM_FLONUM_ENSURE_MEM(v);                                   \
+            SCM_VM_FLONUM_ENSURE_MEM(v);                                \
             vm->trampoline = -1;                                        \
             ScmPContinuationProc *cproc = (ScmPContinuationProc*)cont->pc; \
             ScmObj *data = (ScmObj*)cont - cont->size;                  \
@@ -1040,6 +1045,40 @@ static void local_env_shift(ScmVM *vm, int env_depth)
 }
 
 
+/*===================================================================
+ * Allocation cache (see priv/vmP.h)
+ */
+
+/* If FALSE, the cache is bypassed; every cell is allocated by GC_malloc.
+   Only for benchmarking (%vm-alloc-cache). */
+static int use_alloc_cache = TRUE;
+
+void *Scm__VMRefillCells(ScmVM *vm)
+{
+    void *p = NULL;
+    if (use_alloc_cache) p = GC_malloc_many(SCM_VM_CELL_SIZE);
+    if (p == NULL) {
+        /* GC_malloc_many returns NULL if it runs out of memory.  We let
+           GC_malloc call the OOM handler. */
+        p = SCM_MALLOC(SCM_VM_CELL_SIZE);
+        *(void**)p = NULL;
+    }
+    vm->cells = p;
+    return p;
+}
+
+int Scm__VMAllocCacheEnabled(int flag)
+{
+    int prev = use_alloc_cache;
+    if (flag >= 0) use_alloc_cache = flag;
+    return prev;
+}
+
+/*===================================================================
+ * Baseline JIT (see vmjit.c)
+ */
+#include "vmjit.c"
+
 /*===================================================================
  * Main loop of VM
  */
@@ -1430,12 +1469,12 @@ void Scm_VMFlushFPStack(ScmVM *vm)
 #endif
 
     /* first, scan value registers and incomplete frames */
-    SCM_FLONUM_ENSURE_MEM(VAL0);
+    SCM_VM_FLONUM_ENSURE_MEM(VAL0);
     for (int i=0; i<SCM_VM_MAX_VALUES; i++) {
-        SCM_FLONUM_ENSURE_MEM(vm->vals[i]);
+        SCM_VM_FLONUM_ENSURE_MEM(vm->vals[i]);
     }
     if (IN_FULL_STACK_P(ARGP)) {
-        for (ScmObj *p = ARGP; p < SP; p++) SCM_FLONUM_ENSURE_MEM(*p);
+        for (ScmObj *p = ARGP; p < SP; p++) SCM_VM_FLONUM_ENSURE_MEM(*p);
     }
 
     /* scan the main environment chain */
@@ -1450,7 +1489,7 @@ void Scm_VMFlushFPStack(ScmVM *vm)
 
         for (int i = 0; i < e->size; i++) {
             ScmObj *p = &ENV_DATA(e, i);
-            SCM_FLONUM_ENSURE_MEM(*p);
+            SCM_VM_FLONUM_ENSURE_MEM(*p);
         }
       next:
         e = e->up;
@@ -1469,14 +1508,14 @@ void Scm_VMFlushFPStack(ScmVM *vm)
             }
             for (int i = 0; i < e->size; i++) {
                 ScmObj *p = &ENV_DATA(e, i);
-                SCM_FLONUM_ENSURE_MEM(*p);
+                SCM_VM_FLONUM_ENSURE_MEM(*p);
             }
           next2:
             e = e->up;
         }
         if (IN_FULL_STACK_P((ScmObj*)c) && c->size > 0) {
             ScmObj *p = (ScmObj*)c - c->size;
-            for (int i=0; i<c->size; i++, p++) SCM_FLONUM_ENSURE_MEM(*p);
+            for (int i=0; i<c->size; i++, p++) SCM_VM_FLONUM_ENSURE_MEM(*p);
         }
         c = c->prev;
     }
@@ -1493,14 +1532,14 @@ void Scm_VMFlushFPStack(ScmVM *vm)
                 }
                 for (int i = 0; i < e->size; i++) {
                     ScmObj *p = &ENV_DATA(e, i);
-                    SCM_FLONUM_ENSURE_MEM(*p);
+                    SCM_VM_FLONUM_ENSURE_MEM(*p);
                 }
             next3:
                 e = e->up;
             }
             if (IN_FULL_STACK_P((ScmObj*)c) && c->size > 0) {
                 ScmObj *p = (ScmObj*)c - c->size;
-                for (int i=0; i<c->size; i++, p++) SCM_FLONUM_ENSURE_MEM(*p);
+                for (int i=0; i<c->size; i++, p++) SCM_VM_FLONUM_ENSURE_MEM(*p);
             }
             c = c->prev;
         }
@@ -4339,6 +4378,10 @@ void Scm__InitVM(void)
     } else {
         SCM_VM_RUNTIME_FLAG_SET(rootVM, SCM_CHECK_UNDEFINED_TEST); /* default */
     }
+    {
+        const char *t = Scm_GetEnv("GAUCHE_JIT_THRESHOLD");
+        if (t != NULL) Scm__VMJitThreshold(strtol(t, NULL, 10));
+    }
     if (Scm_GetEnv("GAUCHE_LEGACY_DEFINE") != NULL) {
         SCM_VM_COMPILER_FLAG_SET(rootVM, SCM_COMPILE_LEGACY_DEFINE);
     }
@@ -212,6 +212,14 @@
         CHECK_STACK(vm->base->maxstack);
         SCM_PROF_COUNT_CALL(vm, SCM_OBJ(vm->base));
         VAL0 = SCM_MAKE_INT(argc); /* keep argc to VAL0. */
+#if GAUCHE_BASELINE_JIT
+        if (jit_threshold > 0) {
+            /* See vmjit.c.  The native code leaves PC where the
+               interpreter should continue. */
+            void *native = jit_count_call(vm->base);
+            if (native != NULL) ((void (*)(ScmVM*))native)(vm);
+        }
+#endif
         NEXT;
     }
 
@@ -255,8 +263,15 @@
             VAL0 = SCM_OBJ(&Scm_GenericApplyGeneric);
         }
       GENERIC_ENTRY:
-        /* pure generic application.  we implement MOP in C. */
-        mm = Scm_ComputeApplicableMethods(SCM_GENERIC(VAL0), ARGP, argc, APP);
+        /* pure generic application.  we implement MOP in C.
+           For the ordinary call, we get the methods already sorted,
+           possibly from the method cache of the gf. */
+        if (!APP) {
+            mm = Scm__ComputeSortedMethods(SCM_GENERIC(VAL0), ARGP, argc);
+        } else {
+            mm = Scm_ComputeApplicableMethods(SCM_GENERIC(VAL0), ARGP, argc,
+                                              APP);
+        }
         if (!SCM_NULLP(mm)) {
             /* sort methods.  we only need as many args as
                gf->maxReqargs to order methods, so we only unfold that
@@ -282,7 +297,7 @@
                 for (int i=0;i<argc; i++, ap++) SCM_FLONUM_ENSURE_MEM(*ap);
             }
 #endif /*GAUCHE_FFX*/
-            if (SCM_PAIRP(SCM_CDR(mm))) {
+            if (APP && SCM_PAIRP(SCM_CDR(mm))) {
                 mm = Scm_SortMethods(mm, ARGP, argc);
             }
             if (SCM_METHOD_LEAF_P(SCM_CAR(mm))) {
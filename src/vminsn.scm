@@ -339,7 +339,7 @@
           (set! ,e (-> ,e up)))
         (VM-ASSERT (!= ,e NULL))
         (VM-ASSERT (> (-> ,e size) ,off))
-        (SCM_FLONUM_ENSURE_MEM VAL0)
+        (SCM_VM_FLONUM_ENSURE_MEM VAL0)
         (let* ([,box (ENV-DATA ,e ,off)])
           (VM_ASSERT (SCM_BOXP ,box))
           (SCM_BOX_SET ,box VAL0))
@@ -499,7 +499,7 @@
   (let* ([var] [val VAL0])
     (FETCH-OPERAND var)
     (VM_ASSERT (SCM_IDENTIFIERP var))
-    (SCM_FLONUM_ENSURE_MEM val)
+    (SCM_VM_FLONUM_ENSURE_MEM val)
     INCR-PC
     (let* ([id::ScmIdentifier* (Scm_OutermostIdentifier (SCM_IDENTIFIER var))]
            [mod::ScmModule* (-> id module)]
@@ -813,7 +813,7 @@
 (define-insn ENV-SET 1 none #f
   (let* ([off::int (SCM_VM_INSN_ARG code)])
     (VM-ASSERT (> (-> ENV size) off))
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     (set! (ENV-DATA ENV off) VAL0)
     NEXT))
 
@@ -823,7 +823,7 @@
 (define-insn GSET        0 obj #f
   (let* ((loc))
     (FETCH-OPERAND loc)
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     (cond
      [(SCM_GLOCP loc) (SCM_GLOC_SET (SCM_GLOC loc) VAL0)]
      [(SCM_IDENTIFIERP loc)
@@ -954,7 +954,7 @@
 ;;  as well.
 ;;
 (define-insn CONS        0 none #f
-  (let* ([ca]) (POP-ARG ca) ($result (Scm_Cons ca VAL0))))
+  (let* ([ca]) (POP-ARG ca) ($result (Scm__VMCons vm ca VAL0))))
 (define-insn CONS-PUSH   0 none   (CONS PUSH))
 
 (define-insn CAR         0 none #f
@@ -987,21 +987,21 @@
 (define-insn LIST        1 none #f
   (let* ([nargs::int (SCM_VM_INSN_ARG code)] [cp SCM_NIL] [arg])
     (when (> nargs 0)
-      (SCM_FLONUM_ENSURE_MEM VAL0)
-      (set! cp (Scm_Cons VAL0 cp))
+      (SCM_VM_FLONUM_ENSURE_MEM VAL0)
+      (set! cp (Scm__VMCons vm VAL0 cp))
       (while (> (pre-- nargs) 0)
         (POP-ARG arg)
-        (set! cp (Scm_Cons arg cp))))
+        (set! cp (Scm__VMCons vm arg cp))))
     ($result cp)))
 
 (define-insn LIST-STAR   1 none #f      ; list*
   (let* ([nargs::int (SCM_VM_INSN_ARG code)] [cp SCM_NIL] [arg])
     (VM-ASSERT (>= nargs 1))
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     (set! cp VAL0)
     (while (> (pre-- nargs) 0)
       (POP-ARG arg)
-      (set! cp (Scm_Cons arg cp)))
+      (set! cp (Scm__VMCons vm arg cp)))
     ($result cp)))
 
 (define-insn LENGTH      0 none #f      ; length
@@ -1023,17 +1023,17 @@
     (case nargs
       [(0) (break)]
       [(1) (set! cp VAL0) (break)]
-      [(2) (SCM_FLONUM_ENSURE_MEM VAL0)
+      [(2) (SCM_VM_FLONUM_ENSURE_MEM VAL0)
        (POP-ARG a)
        (set! cp (Scm_Append2 a VAL0))
        (break)]
       [else
-       (set! args (Scm_Cons VAL0 SCM_NIL))
+       (set! args (Scm__VMCons vm VAL0 SCM_NIL))
        ;; We want to pop all args before doing works, for Scm_Append may cause
        ;; forcing lazy-pair.
        (while (> (pre-- nargs) 0)
          (POP-ARG a)
-         (set! args (Scm_Cons a args)))
+         (set! args (Scm__VMCons vm a args)))
        (set! cp (Scm_Append args))])
     ($result cp)))
 
@@ -1044,10 +1044,10 @@
   ;; this instruction will go away soon.  for now it only appears
   ;; as the result of 'cond' with SRFI-61 extension.
   (let* ([nargs::int (SCM_VM_INSN_ARG code)] [cp])
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     (while (> (pre-- nargs) 1)
       (POP-ARG cp)
-      (set! VAL0 (Scm_Cons cp VAL0)))
+      (set! VAL0 (Scm__VMCons vm cp VAL0)))
     (set! cp VAL0)                      ; now cp has arg list
     (POP-ARG VAL0)                      ; get proc
     (TAIL-CALL-INSTRUCTION)
@@ -1136,10 +1136,10 @@
     (when (> nargs 0)
       (let* ([arg VAL0])
         (for [() (> i 0) (post-- i)]
-             (SCM_FLONUM_ENSURE_MEM arg)
+             (SCM_VM_FLONUM_ENSURE_MEM arg)
              (set! (SCM_VECTOR_ELEMENT vec i) arg)
              (POP-ARG arg))
-        (SCM_FLONUM_ENSURE_MEM arg)
+        (SCM_VM_FLONUM_ENSURE_MEM arg)
         (set! (SCM_VECTOR_ELEMENT vec 0) arg)))
     ($result vec)))
 
@@ -1149,11 +1149,11 @@
 (define-insn APP-VEC     1 none #f      ; (compose list->vector append)
   (let* ([nargs::int (SCM_VM_INSN_ARG code)] [cp SCM_NIL] [args SCM_NIL] [a])
     (when (> nargs 0)
-      (SCM_FLONUM_ENSURE_MEM VAL0)
+      (SCM_VM_FLONUM_ENSURE_MEM VAL0)
       (set! cp VAL0)
       (while (> (pre-- nargs) 0)
         (POP-ARG a)
-        (set! args (Scm_Cons a args)))
+        (set! args (Scm__VMCons vm a args)))
       (dolist [a (Scm_ReverseX args)]
         (when (< (Scm_Length a) 0) ($vm-err "list required, but got %S" a))
         (set! cp (Scm_Append2 a cp))))
@@ -1185,7 +1185,7 @@
     (let* ([k::int (SCM_INT_VALUE ind)] [v VAL0])
       (when (or (< k 0) (>= k (SCM_VECTOR_SIZE vec)))
         ($vm-err "vector-set! index out of range: %d" k))
-      (SCM_FLONUM_ENSURE_MEM v)
+      (SCM_VM_FLONUM_ENSURE_MEM v)
       (set! (SCM_VECTOR_ELEMENT vec k) v)
       ($result SCM_UNDEFINED))))
 
@@ -1206,7 +1206,7 @@
     (let* ([k::int (SCM_VM_INSN_ARG code)] [v VAL0])
       (when (or (< k 0) (>= k (SCM_VECTOR_SIZE vec)))
         ($vm-err "vector-set! index out of range: %d" k))
-      (SCM_FLONUM_ENSURE_MEM v)
+      (SCM_VM_FLONUM_ENSURE_MEM v)
       (set! (SCM_VECTOR_ELEMENT vec k) v)
       ($result SCM_UNDEFINED))))
 
@@ -1329,6 +1329,25 @@
       ($result:f (/ (Scm_GetDouble arg) (Scm_GetDouble VAL0)))
       ($result (Scm_VMDivInexact arg VAL0)))))
 
+;; Flonum-only arithmetic.  The compiler emits these only when it has
+;; proven that both operands are flonums (see pass3/specialize in
+;; compile-3.scm), so no type dispatch is done.
+(define-insn FLADD2      0 none #f
+  ($w/argp arg
+    ($result:f (+ (SCM_FLONUM_VALUE arg) (SCM_FLONUM_VALUE VAL0)))))
+
+(define-insn FLSUB2      0 none #f
+  ($w/argp arg
+    ($result:f (- (SCM_FLONUM_VALUE arg) (SCM_FLONUM_VALUE VAL0)))))
+
+(define-insn FLMUL2      0 none #f
+  ($w/argp arg
+    ($result:f (* (SCM_FLONUM_VALUE arg) (SCM_FLONUM_VALUE VAL0)))))
+
+(define-insn FLDIV2      0 none #f
+  ($w/argp arg
+    ($result:f (/ (SCM_FLONUM_VALUE arg) (SCM_FLONUM_VALUE VAL0)))))
+
 (define-insn NUMADDI     1 none #f      ; +, if one of op is small int
   (let* ([imm::long (SCM_VM_INSN_ARG code)])
     ($w/argr arg
@@ -1417,7 +1436,7 @@
 (define-insn SLOT-REF    0 none #f      ; slot-ref
   ($w/argp obj
     (TAIL-CALL-INSTRUCTION)
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     ($result (Scm_VMSlotRef obj VAL0 FALSE))))
 
 (define-insn SLOT-SET    0 none #f      ; slot-set!
@@ -1425,8 +1444,8 @@
     (POP-ARG slot)
     ($w/argp obj
       (TAIL-CALL-INSTRUCTION)
-      (SCM_FLONUM_ENSURE_MEM slot)
-      (SCM_FLONUM_ENSURE_MEM VAL0)
+      (SCM_VM_FLONUM_ENSURE_MEM slot)
+      (SCM_VM_FLONUM_ENSURE_MEM VAL0)
       ($result (Scm_VMSlotSet obj slot VAL0)))))
 
 (define-insn SLOT-REFC   0 obj #f       ; slot-ref with constant slot name
@@ -1434,7 +1453,7 @@
     (FETCH-OPERAND slot)
     INCR-PC
     (TAIL-CALL-INSTRUCTION)
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     ($result (Scm_VMSlotRef VAL0 slot FALSE))))
 
 (define-insn SLOT-SETC   0 obj #f       ; slot-set! with constant slot name
@@ -1443,7 +1462,7 @@
     INCR-PC
     ($w/argp obj
       (TAIL-CALL-INSTRUCTION)
-      (SCM_FLONUM_ENSURE_MEM VAL0)
+      (SCM_VM_FLONUM_ENSURE_MEM VAL0)
       ($result (Scm_VMSlotSet obj slot VAL0)))))
 
 ;;
@@ -1464,17 +1483,17 @@
          [args SCM_NIL])
     (VM-ASSERT (>= (- SP (-> vm stackBase)) (+ 1 nargs)))
     (when (> nargs 0)
-      (SCM_FLONUM_ENSURE_MEM VAL0)
-      (set! args (Scm_Cons VAL0 SCM_NIL))
+      (SCM_VM_FLONUM_ENSURE_MEM VAL0)
+      (set! args (Scm__VMCons vm VAL0 SCM_NIL))
       (while (> (pre-- nargs) 0)
         (let* ([v])
           (POP-ARG v)
-          (SCM_FLONUM_ENSURE_MEM v)
-          (set! args (Scm_Cons v args))))
+          (SCM_VM_FLONUM_ENSURE_MEM v)
+          (set! args (Scm__VMCons vm v args))))
       (POP-ARG after))
     (POP-ARG before)
-    (SCM_FLONUM_ENSURE_MEM before)
-    (SCM_FLONUM_ENSURE_MEM after)
+    (SCM_VM_FLONUM_ENSURE_MEM before)
+    (SCM_VM_FLONUM_ENSURE_MEM after)
     (push_dynamic_handlers vm before after args)
     NEXT))
 
@@ -1493,14 +1512,14 @@
 (define-insn BOX 1 none #f
   (let* ([param::int (SCM_VM_INSN_ARG code)])
     (cond [(== param 0)
-           (SCM_FLONUM_ENSURE_MEM VAL0)
+           (SCM_VM_FLONUM_ENSURE_MEM VAL0)
            (let* ([b::ScmBox* (Scm_MakeBox VAL0)])
              (set! VAL0 (SCM_OBJ b)))]
           [(> param 0)
            (let* ([off::int (- param 1)])
              (VM-ASSERT (> (-> ENV size) off))
              (let* ([v (ENV-DATA ENV off)])
-               (SCM_FLONUM_ENSURE_MEM v)
+               (SCM_VM_FLONUM_ENSURE_MEM v)
                (let* ([b::ScmBox* (Scm_MakeBox v)])
                  (set! (ENV-DATA ENV off) (SCM_OBJ b)))))])
     NEXT))
@@ -1538,24 +1557,24 @@
 (define-insn EXTEND-DENV (1 0) label #f
   (let* ([op::int (SCM_VM_INSN_ARG code)]
          [key] [next::ScmWord*])
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     (POP-ARG key)
     (FETCH-LOCATION next)
     INCR_PC
     (PUSH-CONT next)
     (if (== op 0)
       (Scm_VMPushDynamicEnv key VAL0)
-      (Scm_VMPushDynamicEnv key (Scm_Cons VAL0
+      (Scm_VMPushDynamicEnv key (Scm__VMCons vm VAL0
                                           (Scm_VMFindDynamicEnv key SCM_NIL))))
     NEXT))
 
 (define-insn TAIL-EXTEND-DENV (1 0) none #f
   (let* ([op::int (SCM_VM_INSN_ARG code)] [key])
-    (SCM_FLONUM_ENSURE_MEM VAL0)
+    (SCM_VM_FLONUM_ENSURE_MEM VAL0)
     (POP-ARG key)
     (if (== op 0)
       (Scm_VMPushDynamicEnv key VAL0)
-      (Scm_VMPushDynamicEnv key (Scm_Cons VAL0
+      (Scm_VMPushDynamicEnv key (Scm__VMCons vm VAL0
                                           (Scm_VMFindDynamicEnv key SCM_NIL))))
     NEXT))
 
@@ -0,0 +1,1062 @@
+/*
+ * vmjit.c - baseline JIT for vm.c
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* This file is included from vm.c */
+
+/* EXPERIMENTAL */
+
+/*
+ * Baseline JIT
+ *
+ *   When the body of closures has been called jit_threshold times, its
+ *   code vector is translated to x86_64 machine code, and subsequent
+ *   calls run the machine code (see vmcall.c).  Calls are counted per
+ *   compiled code, not per closure, so an inner lambda created anew on
+ *   each call of its outer procedure still gets hot.
+ *
+ *   The translation is deliberately simple.  The machine code keeps all
+ *   VM registers in ScmVM, as the interpreter does.  Each VM instruction
+ *   becomes either a short inline sequence (constants, local variable
+ *   references, pushes and jumps), or a direct call to one of the small
+ *   helper functions below.  What we save is the instruction fetch and
+ *   dispatch, which dominates tight numeric and list loops.
+ *
+ *   The helpers only handle the common cases: fixnum and flonum
+ *   arithmetic, pair access on pairs, etc.  When a helper sees anything
+ *   else, it returns JIT_BAIL without touching the VM state.  The machine
+ *   code then returns to the interpreter with PC pointing to the
+ *   instruction, and the interpreter executes it, taking care of generic
+ *   arithmetic, errors and everything else.  Instructions we don't
+ *   translate (calls, returns, global variable access, ...) exit in the
+ *   same way.  Once exited, the rest of the invocation is interpreted.
+ *
+ *   A backward jump checks vm->attentionRequest, and exits to the
+ *   interpreter at the jump target if it is set, so that signals and
+ *   other requests are handled as usual.
+ *
+ *   The call counts and the entries are kept in jit_slots, a direct-mapped
+ *   table indexed by the address of the compiled code, so that neither
+ *   ScmClosure nor ScmCompiledCode needs extra fields.  When two compiled
+ *   codes compete for a slot, the one called more often keeps it, and
+ *   a translated one keeps it for good.  The
+ *   translation itself is cached per compiled code in a weak hash table,
+ *   so a code evicted from its slot isn't translated again.  Machine
+ *   code is never freed.
+ *
+ *   The JIT is off unless jit_threshold is set to a positive number,
+ *   either by the environment variable GAUCHE_JIT_THRESHOLD or by
+ *   gauche.internal#%vm-jit-threshold.
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(GAUCHE_WINDOWS) \
+    && defined(HAVE_SYS_MMAN_H)
+#define GAUCHE_BASELINE_JIT 1
+#else
+#define GAUCHE_BASELINE_JIT 0
+#endif
+
+/* # of calls of a closure before translation.  0 disables JIT. */
+static u_long jit_threshold = 0;
+
+u_long Scm__VMJitThreshold(long threshold)
+{
+    u_long prev = jit_threshold;
+#if GAUCHE_BASELINE_JIT
+    if (threshold >= 0) jit_threshold = (u_long)threshold;
+#endif
+    return prev;
+}
+
+#if GAUCHE_BASELINE_JIT
+
+#include "gauche/priv/nativeP.h"
+
+/* Code vectors larger than this are left to the interpreter. */
+#define JIT_MAX_CODE_SIZE 4096
+
+/*
+ * Helpers
+ *
+ *   Each helper takes the VM and the address of the instruction word,
+ *   and returns one of the following.
+ */
+enum {
+    JIT_NEXT,                   /* continue to the next instruction */
+    JIT_TAKEN,                  /* branch is taken */
+    JIT_BAIL                    /* nothing is done; let the interpreter
+                                   execute the instruction */
+};
+
+typedef int (*jit_helper)(ScmVM *vm, ScmWord *pc);
+
+static int jit_local_env(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    FINISH_ENV(SCM_FALSE, ENV);
+    return JIT_NEXT;
+}
+
+static int jit_pop_local_env(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ENV = ENV->up;
+    return JIT_NEXT;
+}
+
+static int jit_local_env_jump(ScmVM *vm, ScmWord *pc)
+{
+    local_env_shift(vm, (int)SCM_VM_INSN_ARG(*pc));
+    return JIT_TAKEN;
+}
+
+static int jit_lset(ScmVM *vm, ScmWord *pc)
+{
+    int dep = SCM_VM_INSN_ARG0(*pc);
+    int off = SCM_VM_INSN_ARG1(*pc);
+    ScmEnvFrame *e = ENV;
+    for (; dep > 0; dep--) e = e->up;
+    SCM_VM_FLONUM_ENSURE_MEM(VAL0);
+    SCM_BOX_SET(ENV_DATA(e, off), VAL0);
+    vm->numVals = 1;
+    return JIT_NEXT;
+}
+
+static int jit_cons(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj ca;
+    POP_ARG(ca);
+    VAL0 = Scm__VMCons(vm, ca, VAL0);
+    vm->numVals = 1;
+    return JIT_NEXT;
+}
+
+#define JIT_CXR(name, expr)                                     \
+    static int name(ScmVM *vm, ScmWord *pc SCM_UNUSED)          \
+    {                                                           \
+        ScmObj v = VAL0;                                        \
+        expr;                                                   \
+        VAL0 = v;                                               \
+        vm->numVals = 1;                                        \
+        return JIT_NEXT;                                        \
+    }
+#define JIT_CXR1(acc) \
+    do { if (!SCM_PAIRP(v)) return JIT_BAIL; v = acc(v); } while (0)
+
+JIT_CXR(jit_car,  JIT_CXR1(SCM_CAR))
+JIT_CXR(jit_cdr,  JIT_CXR1(SCM_CDR))
+JIT_CXR(jit_caar, JIT_CXR1(SCM_CAR); JIT_CXR1(SCM_CAR))
+JIT_CXR(jit_cadr, JIT_CXR1(SCM_CDR); JIT_CXR1(SCM_CAR))
+JIT_CXR(jit_cdar, JIT_CXR1(SCM_CAR); JIT_CXR1(SCM_CDR))
+JIT_CXR(jit_cddr, JIT_CXR1(SCM_CDR); JIT_CXR1(SCM_CDR))
+
+#define JIT_PRED(name, expr)                                    \
+    static int name(ScmVM *vm, ScmWord *pc SCM_UNUSED)          \
+    {                                                           \
+        ScmObj v = VAL0;                                        \
+        VAL0 = SCM_MAKE_BOOL(expr);                             \
+        vm->numVals = 1;                                        \
+        return JIT_NEXT;                                        \
+    }
+
+JIT_PRED(jit_nullp, SCM_NULLP(v))
+JIT_PRED(jit_pairp, SCM_PAIRP(v))
+
+/* The interpreter may warn or raise an error on testing #<undef> (see
+   SCM_CHECKED_FALSEP), so we leave the case to it. */
+static int jit_not(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    if (SCM_UNDEFINEDP(VAL0)) return JIT_BAIL;
+    VAL0 = SCM_MAKE_BOOL(SCM_FALSEP(VAL0));
+    vm->numVals = 1;
+    return JIT_NEXT;
+}
+
+static int jit_eq(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj v;
+    POP_ARG(v);
+    VAL0 = SCM_MAKE_BOOL(SCM_EQ(v, VAL0));
+    vm->numVals = 1;
+    return JIT_NEXT;
+}
+
+static int jit_eqv(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj v;
+    POP_ARG(v);
+    VAL0 = SCM_MAKE_BOOL(Scm_EqvP(v, VAL0));
+    vm->numVals = 1;
+    return JIT_NEXT;
+}
+
+/* Numeric comparison of fixnums or flonums.  Returns -1 if the
+   arguments are of other types. */
+enum { JIT_EQ, JIT_LT, JIT_LE, JIT_GT, JIT_GE };
+
+static inline int jit_numcmp(ScmObj x, ScmObj y, int op)
+{
+    if (SCM_INTP(x) && SCM_INTP(y)) {
+        long a = SCM_INT_VALUE(x), b = SCM_INT_VALUE(y);
+        switch (op) {
+        case JIT_EQ: return a == b;
+        case JIT_LT: return a < b;
+        case JIT_LE: return a <= b;
+        case JIT_GT: return a > b;
+        default:     return a >= b;
+        }
+    }
+    if (SCM_FLONUMP(x) && SCM_FLONUMP(y)) {
+        double a = SCM_FLONUM_VALUE(x), b = SCM_FLONUM_VALUE(y);
+        switch (op) {
+        case JIT_EQ: return a == b;
+        case JIT_LT: return a < b;
+        case JIT_LE: return a <= b;
+        case JIT_GT: return a > b;
+        default:     return a >= b;
+        }
+    }
+    return -1;
+}
+
+static inline ScmObj jit_lref_arg(ScmVM *vm, ScmWord code)
+{
+    int dep = SCM_VM_INSN_ARG0(code);
+    ScmEnvFrame *e = ENV;
+    for (; dep > 0; dep--) e = e->up;
+    return ENV_DATA(e, SCM_VM_INSN_ARG1(code));
+}
+
+/* NUMxx2: compare stack top and VAL0, and leave the result in VAL0. */
+#define JIT_NUMCMP2(name, op)                                   \
+    static int name(ScmVM *vm, ScmWord *pc SCM_UNUSED)          \
+    {                                                           \
+        int r = jit_numcmp(SP[-1], VAL0, op);                   \
+        if (r < 0) return JIT_BAIL;                             \
+        SP--;                                                   \
+        VAL0 = SCM_MAKE_BOOL(r);                                \
+        vm->numVals = 1;                                        \
+        return JIT_NEXT;                                        \
+    }
+
+JIT_NUMCMP2(jit_numeq2, JIT_EQ)
+JIT_NUMCMP2(jit_numlt2, JIT_LT)
+JIT_NUMCMP2(jit_numle2, JIT_LE)
+JIT_NUMCMP2(jit_numgt2, JIT_GT)
+JIT_NUMCMP2(jit_numge2, JIT_GE)
+
+/* BNxx: compare stack top and VAL0, and branch if the result is false.
+   Like the interpreter, VAL0 gets the boolean result. */
+#define JIT_BNUMCMP(name, op)                                   \
+    static int name(ScmVM *vm, ScmWord *pc SCM_UNUSED)          \
+    {                                                           \
+        int r = jit_numcmp(SP[-1], VAL0, op);                   \
+        if (r < 0) return JIT_BAIL;                             \
+        SP--;                                                   \
+        VAL0 = SCM_MAKE_BOOL(r);                                \
+        return r? JIT_NEXT : JIT_TAKEN;                         \
+    }
+
+JIT_BNUMCMP(jit_bnumne, JIT_EQ)
+JIT_BNUMCMP(jit_bnlt, JIT_LT)
+JIT_BNUMCMP(jit_bnle, JIT_LE)
+JIT_BNUMCMP(jit_bngt, JIT_GT)
+JIT_BNUMCMP(jit_bnge, JIT_GE)
+
+/* LREF-VAL0-BNxx: compare a local variable and VAL0. */
+#define JIT_LBNUMCMP(name, op)                                  \
+    static int name(ScmVM *vm, ScmWord *pc)                     \
+    {                                                           \
+        int r = jit_numcmp(jit_lref_arg(vm, *pc), VAL0, op);    \
+        if (r < 0) return JIT_BAIL;                             \
+        VAL0 = SCM_MAKE_BOOL(r);                                \
+        return r? JIT_NEXT : JIT_TAKEN;                         \
+    }
+
+JIT_LBNUMCMP(jit_lref_val0_bnumne, JIT_EQ)
+JIT_LBNUMCMP(jit_lref_val0_bnlt, JIT_LT)
+JIT_LBNUMCMP(jit_lref_val0_bnle, JIT_LE)
+JIT_LBNUMCMP(jit_lref_val0_bngt, JIT_GT)
+JIT_LBNUMCMP(jit_lref_val0_bnge, JIT_GE)
+
+static int jit_bnumnei(ScmVM *vm, ScmWord *pc)
+{
+    long imm = SCM_VM_INSN_ARG(*pc);
+    ScmObj v = VAL0;
+    int r;
+    if (SCM_INTP(v))         r = (SCM_INT_VALUE(v) == imm);
+    else if (SCM_FLONUMP(v)) r = (SCM_FLONUM_VALUE(v) == imm);
+    else return JIT_BAIL;
+    VAL0 = SCM_MAKE_BOOL(r);
+    return r? JIT_NEXT : JIT_TAKEN;
+}
+
+static int jit_bf(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    if (SCM_UNDEFINEDP(VAL0)) return JIT_BAIL;
+    return SCM_FALSEP(VAL0)? JIT_TAKEN : JIT_NEXT;
+}
+
+static int jit_bt(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    if (SCM_UNDEFINEDP(VAL0)) return JIT_BAIL;
+    return SCM_FALSEP(VAL0)? JIT_NEXT : JIT_TAKEN;
+}
+
+/* Common tail of BNxx that leaves the test result in VAL0. */
+static inline int jit_branch_unless(ScmVM *vm, int r)
+{
+    VAL0 = SCM_MAKE_BOOL(r);
+    return r? JIT_NEXT : JIT_TAKEN;
+}
+
+static int jit_bnnull(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    return jit_branch_unless(vm, SCM_NULLP(VAL0));
+}
+
+static int jit_bneq(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj z;
+    POP_ARG(z);
+    return jit_branch_unless(vm, SCM_EQ(VAL0, z));
+}
+
+static int jit_bneqv(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj z;
+    POP_ARG(z);
+    return jit_branch_unless(vm, Scm_EqvP(VAL0, z));
+}
+
+static int jit_bneqc(ScmVM *vm, ScmWord *pc)
+{
+    return jit_branch_unless(vm, SCM_EQ(VAL0, SCM_OBJ(pc[1])));
+}
+
+static int jit_bneqvc(ScmVM *vm, ScmWord *pc)
+{
+    return jit_branch_unless(vm, Scm_EqvP(VAL0, SCM_OBJ(pc[1])));
+}
+
+/* Arithmetic.  Fixnum results that overflow become bignums, as in
+   the interpreter; it doesn't call back to Scheme. */
+static inline void jit_result_long(ScmVM *vm, long r)
+{
+    VAL0 = SCM_SMALL_INT_FITS(r)? SCM_MAKE_INT(r) : Scm_MakeInteger(r);
+    vm->numVals = 1;
+}
+
+static inline void jit_result_double(ScmVM *vm, double r)
+{
+    VAL0 = Scm_VMReturnFlonum(r);
+    vm->numVals = 1;
+}
+
+static inline int jit_add(ScmVM *vm, ScmObj x, ScmObj y)
+{
+    if (SCM_INTP(x) && SCM_INTP(y)) {
+        jit_result_long(vm, SCM_INT_VALUE(x) + SCM_INT_VALUE(y));
+    } else if (SCM_FLONUMP(x) && SCM_FLONUMP(y)) {
+        jit_result_double(vm, SCM_FLONUM_VALUE(x) + SCM_FLONUM_VALUE(y));
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int jit_numadd2(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    if (!jit_add(vm, SP[-1], VAL0)) return JIT_BAIL;
+    SP--;
+    return JIT_NEXT;
+}
+
+static int jit_lref_val0_numadd2(ScmVM *vm, ScmWord *pc)
+{
+    return jit_add(vm, jit_lref_arg(vm, *pc), VAL0)? JIT_NEXT : JIT_BAIL;
+}
+
+static int jit_numsub2(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj x = SP[-1], y = VAL0;
+    if (SCM_INTP(x) && SCM_INTP(y)) {
+        jit_result_long(vm, SCM_INT_VALUE(x) - SCM_INT_VALUE(y));
+    } else if (SCM_FLONUMP(x) && SCM_FLONUMP(y)) {
+        jit_result_double(vm, SCM_FLONUM_VALUE(x) - SCM_FLONUM_VALUE(y));
+    } else {
+        return JIT_BAIL;
+    }
+    SP--;
+    return JIT_NEXT;
+}
+
+static int jit_nummul2(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj x = SP[-1], y = VAL0;
+    if (SCM_INTP(x) && SCM_INTP(y)) {
+        long r;
+        if (__builtin_mul_overflow(SCM_INT_VALUE(x), SCM_INT_VALUE(y), &r)
+            || !SCM_SMALL_INT_FITS(r)) {
+            return JIT_BAIL;
+        }
+        VAL0 = SCM_MAKE_INT(r);
+        vm->numVals = 1;
+    } else if (SCM_FLONUMP(x) && SCM_FLONUMP(y)) {
+        jit_result_double(vm, SCM_FLONUM_VALUE(x) * SCM_FLONUM_VALUE(y));
+    } else {
+        return JIT_BAIL;
+    }
+    SP--;
+    return JIT_NEXT;
+}
+
+static int jit_numdiv2(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj x = SP[-1], y = VAL0;
+    if (!(SCM_FLONUMP(x) && SCM_FLONUMP(y))) return JIT_BAIL;
+    jit_result_double(vm, SCM_FLONUM_VALUE(x) / SCM_FLONUM_VALUE(y));
+    SP--;
+    return JIT_NEXT;
+}
+
+#define JIT_FLOP2(name, op)                                             \
+    static int name(ScmVM *vm, ScmWord *pc SCM_UNUSED)                  \
+    {                                                                   \
+        ScmObj x;                                                       \
+        POP_ARG(x);                                                     \
+        jit_result_double(vm, SCM_FLONUM_VALUE(x) op SCM_FLONUM_VALUE(VAL0)); \
+        return JIT_NEXT;                                                \
+    }
+
+JIT_FLOP2(jit_fladd2, +)
+JIT_FLOP2(jit_flsub2, -)
+JIT_FLOP2(jit_flmul2, *)
+JIT_FLOP2(jit_fldiv2, /)
+
+static int jit_negate(ScmVM *vm, ScmWord *pc SCM_UNUSED)
+{
+    ScmObj v = VAL0;
+    if (SCM_INTP(v))         jit_result_long(vm, -SCM_INT_VALUE(v));
+    else if (SCM_FLONUMP(v)) jit_result_double(vm, -SCM_FLONUM_VALUE(v));
+    else return JIT_BAIL;
+    return JIT_NEXT;
+}
+
+static int jit_numaddi(ScmVM *vm, ScmWord *pc)
+{
+    long imm = SCM_VM_INSN_ARG(*pc);
+    ScmObj v = VAL0;
+    if (SCM_INTP(v))         jit_result_long(vm, imm + SCM_INT_VALUE(v));
+    else if (SCM_FLONUMP(v)) jit_result_double(vm, SCM_FLONUM_VALUE(v) + (double)imm);
+    else return JIT_BAIL;
+    return JIT_NEXT;
+}
+
+static int jit_numsubi(ScmVM *vm, ScmWord *pc)
+{
+    long imm = SCM_VM_INSN_ARG(*pc);
+    ScmObj v = VAL0;
+    if (SCM_INTP(v))         jit_result_long(vm, imm - SCM_INT_VALUE(v));
+    else if (SCM_FLONUMP(v)) jit_result_double(vm, (double)imm - SCM_FLONUM_VALUE(v));
+    else return JIT_BAIL;
+    return JIT_NEXT;
+}
+
+/*
+ * Code generation
+ *
+ *   The generated function takes ScmVM* and returns nothing; it leaves
+ *   PC pointing to the instruction the interpreter should continue from.
+ *   RBX holds the VM during execution.
+ */
+
+typedef struct jit_fixup {
+    size_t pos;                 /* position of rel32 field */
+    long target;                /* index in the code vector */
+    int exitp;                  /* TRUE to jump to the exit stub of target */
+} jit_fixup;
+
+typedef struct jit_state {
+    ScmCompiledCode *cc;
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+    long *native;               /* offset of the translation of each insn,
+                                   or -1 if the index isn't an insn */
+    long *exits;                /* offset of the exit stub for each index,
+                                   or -1 if not emitted */
+    jit_fixup *fixups;
+    size_t nfixups;
+    size_t fixupsize;
+} jit_state;
+
+#define JIT_VMOFF(field)  ((int32_t)offsetof(ScmVM, field))
+
+static void jit_ensure(jit_state *s, size_t n)
+{
+    if (s->len + n <= s->size) return;
+    size_t nsize = s->size * 2;
+    while (s->len + n > nsize) nsize *= 2;
+    uint8_t *nbuf = SCM_NEW_ATOMIC_ARRAY(uint8_t, nsize);
+    memcpy(nbuf, s->buf, s->len);
+    s->buf = nbuf;
+    s->size = nsize;
+}
+
+static void jit_bytes(jit_state *s, const uint8_t *bytes, size_t n)
+{
+    jit_ensure(s, n);
+    memcpy(s->buf + s->len, bytes, n);
+    s->len += n;
+}
+
+static void jit_imm32(jit_state *s, int32_t v)
+{
+    jit_bytes(s, (const uint8_t*)&v, 4);
+}
+
+static void jit_imm64(jit_state *s, uint64_t v)
+{
+    jit_bytes(s, (const uint8_t*)&v, 8);
+}
+
+#define JIT_EMIT(s, ...)                                        \
+    do {                                                        \
+        static const uint8_t b__[] = { __VA_ARGS__ };           \
+        jit_bytes(s, b__, sizeof(b__));                         \
+    } while (0)
+
+/* mov rax, [rbx+off] */
+static void jit_load_vm(jit_state *s, int32_t off)
+{
+    JIT_EMIT(s, 0x48, 0x8b, 0x83);
+    jit_imm32(s, off);
+}
+
+/* mov [rbx+off], rax */
+static void jit_store_vm(jit_state *s, int32_t off)
+{
+    JIT_EMIT(s, 0x48, 0x89, 0x83);
+    jit_imm32(s, off);
+}
+
+/* mov rax, imm64 */
+static void jit_load_imm(jit_state *s, uint64_t v)
+{
+    JIT_EMIT(s, 0x48, 0xb8);
+    jit_imm64(s, v);
+}
+
+/* VAL0 = rax; numVals = 1 */
+static void jit_result(jit_state *s)
+{
+    jit_store_vm(s, JIT_VMOFF(val0));
+    JIT_EMIT(s, 0xc7, 0x83);             /* mov dword [rbx+off], 1 */
+    jit_imm32(s, JIT_VMOFF(numVals));
+    jit_imm32(s, 1);
+}
+
+/* *SP++ = rax */
+static void jit_push(jit_state *s)
+{
+    JIT_EMIT(s, 0x48, 0x8b, 0x8b);       /* mov rcx, [rbx+sp] */
+    jit_imm32(s, JIT_VMOFF(sp));
+    JIT_EMIT(s, 0x48, 0x89, 0x01,        /* mov [rcx], rax */
+                0x48, 0x83, 0xc1, 0x08,  /* add rcx, 8 */
+                0x48, 0x89, 0x8b);       /* mov [rbx+sp], rcx */
+    jit_imm32(s, JIT_VMOFF(sp));
+}
+
+/* rax = local variable */
+static void jit_lref(jit_state *s, int depth, int offset)
+{
+    jit_load_vm(s, JIT_VMOFF(env));
+    for (; depth > 0; depth--) {
+        JIT_EMIT(s, 0x48, 0x8b, 0x80);   /* mov rax, [rax+off] */
+        jit_imm32(s, (int32_t)offsetof(ScmEnvFrame, up));
+    }
+    JIT_EMIT(s, 0x48, 0x8b, 0x80);
+    jit_imm32(s, -(int32_t)((offset+1) * sizeof(ScmObj)));
+}
+
+/* Call helper FN with the instruction at index I. */
+static void jit_call(jit_state *s, jit_helper fn, long i)
+{
+    JIT_EMIT(s, 0x48, 0x89, 0xdf,        /* mov rdi, rbx */
+                0x48, 0xbe);             /* mov rsi, imm64 */
+    jit_imm64(s, (uint64_t)(uintptr_t)(s->cc->code + i));
+    jit_load_imm(s, (uint64_t)(uintptr_t)fn);
+    JIT_EMIT(s, 0xff, 0xd0);             /* call rax */
+}
+
+/* jmp (OP == 0) or jcc (OP is the second byte of 0f 8x) to the
+   translation of TARGET, or its exit stub if EXITP. */
+static void jit_jump(jit_state *s, uint8_t op, long target, int exitp)
+{
+    if (op == 0) {
+        JIT_EMIT(s, 0xe9);
+    } else {
+        uint8_t b[2] = { 0x0f, op };
+        jit_bytes(s, b, 2);
+    }
+    if (s->nfixups == s->fixupsize) {
+        jit_fixup *nf = SCM_NEW_ATOMIC_ARRAY(jit_fixup, s->fixupsize*2);
+        memcpy(nf, s->fixups, sizeof(jit_fixup)*s->nfixups);
+        s->fixups = nf;
+        s->fixupsize *= 2;
+    }
+    s->fixups[s->nfixups].pos = s->len;
+    s->fixups[s->nfixups].target = target;
+    s->fixups[s->nfixups].exitp = exitp;
+    s->nfixups++;
+    jit_imm32(s, 0);
+}
+
+#define JIT_JE  0x84
+#define JIT_JNE 0x85
+#define JIT_JA  0x87
+
+/* Transfer control from the insn at I to TARGET.  A backward jump
+   checks the attention request. */
+static void jit_goto(jit_state *s, long i, long target)
+{
+    if (target <= i) {
+        JIT_EMIT(s, 0x48, 0x83, 0xbb);   /* cmp qword [rbx+off], 0 */
+        jit_imm32(s, JIT_VMOFF(attentionRequest));
+        JIT_EMIT(s, 0x00);
+        jit_jump(s, JIT_JNE, target, TRUE);
+    }
+    jit_jump(s, 0, target, FALSE);
+}
+
+/* Return to the interpreter, which continues from index I. */
+static void jit_exit(jit_state *s, long i)
+{
+    jit_load_imm(s, (uint64_t)(uintptr_t)(s->cc->code + i));
+    jit_store_vm(s, JIT_VMOFF(pc));
+    JIT_EMIT(s, 0x5b, 0xc3);             /* pop rbx; ret */
+}
+
+/* Call a helper that may bail out. */
+static void jit_call_bail(jit_state *s, jit_helper fn, long i)
+{
+    jit_call(s, fn, i);
+    JIT_EMIT(s, 0x85, 0xc0);             /* test eax, eax */
+    jit_jump(s, JIT_JNE, i, TRUE);
+}
+
+/* Call a conditional branch helper. */
+static void jit_call_branch(jit_state *s, jit_helper fn, long i, long target)
+{
+    jit_call(s, fn, i);
+    JIT_EMIT(s, 0x83, 0xf8, JIT_TAKEN);  /* cmp eax, JIT_TAKEN */
+    jit_jump(s, JIT_JA, i, TRUE);
+    if (target > i) {
+        jit_jump(s, JIT_JE, target, FALSE);
+    } else {
+        JIT_EMIT(s, 0x75, 0x00);         /* jne over the backward jump */
+        size_t skip = s->len;
+        jit_goto(s, i, target);
+        s->buf[skip-1] = (uint8_t)(s->len - skip);
+    }
+}
+
+/* Index of the label operand of the insn at I. */
+static long jit_label(jit_state *s, long i, int opos)
+{
+    return (ScmWord*)s->cc->code[i+opos] - s->cc->code;
+}
+
+/* Number of words the insn occupies. */
+static int jit_insn_size(ScmWord code)
+{
+    switch (Scm_VMInsnOperandType(SCM_VM_INSN_CODE(code))) {
+    case SCM_VM_OPERAND_NONE: return 1;
+    case SCM_VM_OPERAND_OBJ_LABEL:
+    case SCM_VM_OPERAND_OBJ_NATIVE: return 3;
+    default: return 2;
+    }
+}
+
+/* Depth and offset of LREFnn and its combinations.  Returns FALSE if
+   CODE isn't one of them. */
+static int jit_lrefnn(ScmWord code, int *depth, int *offset)
+{
+#define LREFNN(nn, d, o)                                              \
+    case SCM_CPP_CAT(SCM_VM_LREF, nn):                                \
+    case SCM_CPP_CAT3(SCM_VM_LREF, nn, _PUSH):                        \
+    case SCM_CPP_CAT3(SCM_VM_LREF, nn, _CAR):                         \
+    case SCM_CPP_CAT3(SCM_VM_LREF, nn, _CDR):                         \
+    case SCM_CPP_CAT3(SCM_VM_LREF, nn, _NUMADDI):                     \
+    case SCM_CPP_CAT3(SCM_VM_LREF, nn, _NUMADDI_PUSH):                \
+        *depth = d; *offset = o; return TRUE
+
+    switch (SCM_VM_INSN_CODE(code)) {
+    case SCM_VM_LREF:
+    case SCM_VM_LREF_PUSH:
+        *depth = SCM_VM_INSN_ARG0(code);
+        *offset = SCM_VM_INSN_ARG1(code);
+        return TRUE;
+    LREFNN(0, 0, 0);
+    LREFNN(1, 0, 1);
+    LREFNN(2, 0, 2);
+    LREFNN(3, 0, 3);
+    LREFNN(10, 1, 0);
+    LREFNN(11, 1, 1);
+    LREFNN(12, 1, 2);
+    LREFNN(20, 2, 0);
+    LREFNN(21, 2, 1);
+    LREFNN(30, 3, 0);
+    default:
+        return FALSE;
+    }
+#undef LREFNN
+}
+
+/* Translate one insn at index I.  Returns FALSE if it isn't supported. */
+static int jit_insn(jit_state *s, long i)
+{
+    ScmWord code = s->cc->code[i];
+    int depth = 0, offset = 0;
+    jit_helper fn = NULL;
+
+    if (jit_lrefnn(code, &depth, &offset)) {
+        jit_lref(s, depth, offset);
+        switch (SCM_VM_INSN_CODE(code)) {
+        case SCM_VM_LREF_PUSH:
+        case SCM_VM_LREF0_PUSH: case SCM_VM_LREF1_PUSH:
+        case SCM_VM_LREF2_PUSH: case SCM_VM_LREF3_PUSH:
+        case SCM_VM_LREF10_PUSH: case SCM_VM_LREF11_PUSH:
+        case SCM_VM_LREF12_PUSH: case SCM_VM_LREF20_PUSH:
+        case SCM_VM_LREF21_PUSH: case SCM_VM_LREF30_PUSH:
+            jit_push(s);
+            return TRUE;
+        }
+        jit_result(s);
+        switch (SCM_VM_INSN_CODE(code)) {
+        case SCM_VM_LREF0_CAR: case SCM_VM_LREF1_CAR:
+        case SCM_VM_LREF2_CAR: case SCM_VM_LREF3_CAR:
+        case SCM_VM_LREF10_CAR: case SCM_VM_LREF11_CAR:
+        case SCM_VM_LREF12_CAR: case SCM_VM_LREF20_CAR:
+        case SCM_VM_LREF21_CAR: case SCM_VM_LREF30_CAR:
+            jit_call_bail(s, jit_car, i);
+            break;
+        case SCM_VM_LREF0_CDR: case SCM_VM_LREF1_CDR:
+        case SCM_VM_LREF2_CDR: case SCM_VM_LREF3_CDR:
+        case SCM_VM_LREF10_CDR: case SCM_VM_LREF11_CDR:
+        case SCM_VM_LREF12_CDR: case SCM_VM_LREF20_CDR:
+        case SCM_VM_LREF21_CDR: case SCM_VM_LREF30_CDR:
+            jit_call_bail(s, jit_cdr, i);
+            break;
+        case SCM_VM_LREF0_NUMADDI: case SCM_VM_LREF1_NUMADDI:
+        case SCM_VM_LREF2_NUMADDI: case SCM_VM_LREF3_NUMADDI:
+        case SCM_VM_LREF10_NUMADDI: case SCM_VM_LREF11_NUMADDI:
+        case SCM_VM_LREF12_NUMADDI: case SCM_VM_LREF20_NUMADDI:
+        case SCM_VM_LREF21_NUMADDI: case SCM_VM_LREF30_NUMADDI:
+            jit_call_bail(s, jit_numaddi, i);
+            break;
+        case SCM_VM_LREF0_NUMADDI_PUSH: case SCM_VM_LREF1_NUMADDI_PUSH:
+        case SCM_VM_LREF2_NUMADDI_PUSH: case SCM_VM_LREF3_NUMADDI_PUSH:
+        case SCM_VM_LREF10_NUMADDI_PUSH: case SCM_VM_LREF11_NUMADDI_PUSH:
+        case SCM_VM_LREF12_NUMADDI_PUSH: case SCM_VM_LREF20_NUMADDI_PUSH:
+        case SCM_VM_LREF21_NUMADDI_PUSH: case SCM_VM_LREF30_NUMADDI_PUSH:
+            jit_call_bail(s, jit_numaddi, i);
+            jit_load_vm(s, JIT_VMOFF(val0));
+            jit_push(s);
+            break;
+        }
+        return TRUE;
+    }
+
+    switch (SCM_VM_INSN_CODE(code)) {
+    /* constants */
+    case SCM_VM_CONST:
+        jit_load_imm(s, s->cc->code[i+1]); jit_result(s); return TRUE;
+    case SCM_VM_CONST_PUSH:
+        jit_load_imm(s, s->cc->code[i+1]); jit_push(s); return TRUE;
+    case SCM_VM_CONSTI:
+        jit_load_imm(s, SCM_WORD(SCM_MAKE_INT(SCM_VM_INSN_ARG(code))));
+        jit_result(s);
+        return TRUE;
+    case SCM_VM_CONSTI_PUSH:
+        jit_load_imm(s, SCM_WORD(SCM_MAKE_INT(SCM_VM_INSN_ARG(code))));
+        jit_push(s);
+        return TRUE;
+    case SCM_VM_CONSTN:
+        jit_load_imm(s, SCM_WORD(SCM_NIL)); jit_result(s); return TRUE;
+    case SCM_VM_CONSTN_PUSH:
+        jit_load_imm(s, SCM_WORD(SCM_NIL)); jit_push(s); return TRUE;
+    case SCM_VM_CONSTF:
+        jit_load_imm(s, SCM_WORD(SCM_FALSE)); jit_result(s); return TRUE;
+    case SCM_VM_CONSTF_PUSH:
+        jit_load_imm(s, SCM_WORD(SCM_FALSE)); jit_push(s); return TRUE;
+    case SCM_VM_CONSTU:
+        jit_load_imm(s, SCM_WORD(SCM_UNDEFINED)); jit_result(s); return TRUE;
+    case SCM_VM_PUSH:
+        jit_load_vm(s, JIT_VMOFF(val0)); jit_push(s); return TRUE;
+
+    /* control */
+    case SCM_VM_JUMP:
+        jit_goto(s, i, jit_label(s, i, 1));
+        return TRUE;
+    case SCM_VM_LOCAL_ENV_JUMP:
+        jit_call(s, jit_local_env_jump, i);
+        jit_goto(s, i, jit_label(s, i, 1));
+        return TRUE;
+    case SCM_VM_LOCAL_ENV:
+        jit_call(s, jit_local_env, i);
+        return TRUE;
+    case SCM_VM_PUSH_LOCAL_ENV:
+        jit_load_vm(s, JIT_VMOFF(val0));
+        jit_push(s);
+        jit_call(s, jit_local_env, i);
+        return TRUE;
+    case SCM_VM_POP_LOCAL_ENV:
+        jit_call(s, jit_pop_local_env, i);
+        return TRUE;
+    case SCM_VM_LSET:
+        jit_call(s, jit_lset, i);
+        return TRUE;
+
+    /* conditional branches */
+    case SCM_VM_BF:      fn = jit_bf; break;
+    case SCM_VM_BT:      fn = jit_bt; break;
+    case SCM_VM_BNNULL:  fn = jit_bnnull; break;
+    case SCM_VM_BNEQ:    fn = jit_bneq; break;
+    case SCM_VM_BNEQV:   fn = jit_bneqv; break;
+    case SCM_VM_BNUMNE:  fn = jit_bnumne; break;
+    case SCM_VM_BNLT:    fn = jit_bnlt; break;
+    case SCM_VM_BNLE:    fn = jit_bnle; break;
+    case SCM_VM_BNGT:    fn = jit_bngt; break;
+    case SCM_VM_BNGE:    fn = jit_bnge; break;
+    case SCM_VM_LREF_VAL0_BNUMNE: fn = jit_lref_val0_bnumne; break;
+    case SCM_VM_LREF_VAL0_BNLT:   fn = jit_lref_val0_bnlt; break;
+    case SCM_VM_LREF_VAL0_BNLE:   fn = jit_lref_val0_bnle; break;
+    case SCM_VM_LREF_VAL0_BNGT:   fn = jit_lref_val0_bngt; break;
+    case SCM_VM_LREF_VAL0_BNGE:   fn = jit_lref_val0_bnge; break;
+    case SCM_VM_BNUMNEI: fn = jit_bnumnei; break;
+    case SCM_VM_BNEQC:
+        jit_call_branch(s, jit_bneqc, i, jit_label(s, i, 2));
+        return TRUE;
+    case SCM_VM_BNEQVC:
+        jit_call_branch(s, jit_bneqvc, i, jit_label(s, i, 2));
+        return TRUE;
+
+    /* operations that never bail out */
+    case SCM_VM_CONS: case SCM_VM_CONS_PUSH:
+        jit_call(s, jit_cons, i);
+        break;
+    case SCM_VM_NULLP:   jit_call(s, jit_nullp, i); return TRUE;
+    case SCM_VM_PAIRP:   jit_call(s, jit_pairp, i); return TRUE;
+    case SCM_VM_EQ:      jit_call(s, jit_eq, i); return TRUE;
+    case SCM_VM_EQV:     jit_call(s, jit_eqv, i); return TRUE;
+    case SCM_VM_FLADD2:  jit_call(s, jit_fladd2, i); return TRUE;
+    case SCM_VM_FLSUB2:  jit_call(s, jit_flsub2, i); return TRUE;
+    case SCM_VM_FLMUL2:  jit_call(s, jit_flmul2, i); return TRUE;
+    case SCM_VM_FLDIV2:  jit_call(s, jit_fldiv2, i); return TRUE;
+
+    /* operations that may bail out */
+    case SCM_VM_CAR:  case SCM_VM_CAR_PUSH:  jit_call_bail(s, jit_car, i); break;
+    case SCM_VM_CDR:  case SCM_VM_CDR_PUSH:  jit_call_bail(s, jit_cdr, i); break;
+    case SCM_VM_CAAR: case SCM_VM_CAAR_PUSH: jit_call_bail(s, jit_caar, i); break;
+    case SCM_VM_CADR: case SCM_VM_CADR_PUSH: jit_call_bail(s, jit_cadr, i); break;
+    case SCM_VM_CDAR: case SCM_VM_CDAR_PUSH: jit_call_bail(s, jit_cdar, i); break;
+    case SCM_VM_CDDR: case SCM_VM_CDDR_PUSH: jit_call_bail(s, jit_cddr, i); break;
+    case SCM_VM_NUMEQ2:  jit_call_bail(s, jit_numeq2, i); return TRUE;
+    case SCM_VM_NUMLT2:  jit_call_bail(s, jit_numlt2, i); return TRUE;
+    case SCM_VM_NUMLE2:  jit_call_bail(s, jit_numle2, i); return TRUE;
+    case SCM_VM_NUMGT2:  jit_call_bail(s, jit_numgt2, i); return TRUE;
+    case SCM_VM_NUMGE2:  jit_call_bail(s, jit_numge2, i); return TRUE;
+    case SCM_VM_NUMADD2: jit_call_bail(s, jit_numadd2, i); return TRUE;
+    case SCM_VM_NUMSUB2: jit_call_bail(s, jit_numsub2, i); return TRUE;
+    case SCM_VM_NUMMUL2: jit_call_bail(s, jit_nummul2, i); return TRUE;
+    case SCM_VM_NUMDIV2: jit_call_bail(s, jit_numdiv2, i); return TRUE;
+    case SCM_VM_LREF_VAL0_NUMADD2:
+        jit_call_bail(s, jit_lref_val0_numadd2, i);
+        return TRUE;
+    case SCM_VM_NEGATE:  jit_call_bail(s, jit_negate, i); return TRUE;
+    case SCM_VM_NOT:     jit_call_bail(s, jit_not, i); return TRUE;
+    case SCM_VM_NUMADDI: jit_call_bail(s, jit_numaddi, i); return TRUE;
+    case SCM_VM_NUMSUBI: jit_call_bail(s, jit_numsubi, i); return TRUE;
+
+    default:
+        return FALSE;
+    }
+
+    if (fn != NULL) {
+        /* conditional branch with a label operand */
+        jit_call_branch(s, fn, i, jit_label(s, i, 1));
+        return TRUE;
+    }
+
+    /* xxx-PUSH combinations; the helper left the result in VAL0. */
+    switch (SCM_VM_INSN_CODE(code)) {
+    case SCM_VM_CONS_PUSH:
+    case SCM_VM_CAR_PUSH: case SCM_VM_CDR_PUSH:
+    case SCM_VM_CAAR_PUSH: case SCM_VM_CADR_PUSH:
+    case SCM_VM_CDAR_PUSH: case SCM_VM_CDDR_PUSH:
+        jit_load_vm(s, JIT_VMOFF(val0));
+        jit_push(s);
+        break;
+    }
+    return TRUE;
+}
+
+/* Translate CC.  Returns the executable entry, or NULL if we don't
+   translate it. */
+static void *jit_translate(ScmCompiledCode *cc)
+{
+    long n = cc->codeSize;
+    if (n <= 0 || n > JIT_MAX_CODE_SIZE) return NULL;
+
+    jit_state s;
+    s.cc = cc;
+    s.size = 256;
+    s.len = 0;
+    s.buf = SCM_NEW_ATOMIC_ARRAY(uint8_t, s.size);
+    s.native = SCM_NEW_ATOMIC_ARRAY(long, n+1);
+    s.exits = SCM_NEW_ATOMIC_ARRAY(long, n+1);
+    s.fixupsize = 16;
+    s.nfixups = 0;
+    s.fixups = SCM_NEW_ATOMIC_ARRAY(jit_fixup, s.fixupsize);
+    for (long i = 0; i <= n; i++) s.native[i] = s.exits[i] = -1;
+
+    JIT_EMIT(&s, 0x53,                   /* push rbx */
+                 0x48, 0x89, 0xfb);      /* mov rbx, rdi */
+
+    for (long i = 0; i < n; i += jit_insn_size(cc->code[i])) {
+        s.native[i] = (long)s.len;
+        if (!jit_insn(&s, i)) {
+            /* It's no use to enter native code just to exit. */
+            if (i == 0) return NULL;
+            jit_exit(&s, i);
+        }
+    }
+
+    for (size_t k = 0; k < s.nfixups; k++) {
+        jit_fixup *f = &s.fixups[k];
+        long dest;
+        if (f->target < 0 || f->target >= n) return NULL;
+        if (f->exitp) {
+            if (s.exits[f->target] < 0) {
+                s.exits[f->target] = (long)s.len;
+                jit_exit(&s, f->target);
+            }
+            dest = s.exits[f->target];
+        } else {
+            dest = s.native[f->target];
+            if (dest < 0) return NULL;
+        }
+        int32_t rel = (int32_t)(dest - (long)(f->pos + 4));
+        memcpy(s.buf + f->pos, &rel, 4);
+    }
+
+    return Scm__AllocateJitCode(s.buf, s.len);
+}
+
+static ScmInternalMutex jit_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
+static ScmObj jit_cache = SCM_FALSE; /* compiled code -> entry or #f */
+
+/* Returns the native entry of CC, translating it if we haven't tried.
+   Called from vmcall.c when a closure reaches the threshold. */
+static void *jit_entry(ScmCompiledCode *cc)
+{
+    void *entry = NULL;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(jit_mutex);
+    if (SCM_FALSEP(jit_cache)) {
+        jit_cache = Scm_MakeWeakHashTableSimple(SCM_HASH_EQ, SCM_WEAK_KEY,
+                                                64, SCM_FALSE);
+    }
+    ScmObj e = Scm_WeakHashTableRef(SCM_WEAK_HASH_TABLE(jit_cache),
+                                    SCM_OBJ(cc), SCM_UNBOUND);
+    if (SCM_UNBOUNDP(e)) {
+        entry = jit_translate(cc);
+        e = entry? Scm_MakeIntegerU((u_long)(uintptr_t)entry) : SCM_FALSE;
+        Scm_WeakHashTableSet(SCM_WEAK_HASH_TABLE(jit_cache), SCM_OBJ(cc), e, 0);
+    } else if (!SCM_FALSEP(e)) {
+        entry = (void*)(uintptr_t)Scm_GetIntegerU(e);
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    return entry;
+}
+
+/* A slot is replaced as a whole, so a reader never pairs a compiled code
+   with the entry of another.  COUNT and NATIVE are only written by the
+   thread that finds them in the slot; a lost count is harmless. */
+typedef struct jit_info_rec {
+    ScmCompiledCode *cc;
+    u_long count;
+    void *native;               /* machine code, or NULL */
+    int translated;             /* TRUE if we've tried to translate CC */
+} jit_info;
+
+#define JIT_SLOTS_LOG2  12
+#define JIT_SLOTS       (1UL<<JIT_SLOTS_LOG2)
+
+/* Scanned by GC, so the compiled code in a slot isn't collected and
+   its address isn't reused while it is there. */
+static jit_info *jit_slots[JIT_SLOTS];
+
+/* Called for each closure call while JIT is on.  Counts the call of CC,
+   and returns its native entry if it's hot and translated, or NULL. */
+static inline void *jit_count_call(ScmCompiledCode *cc)
+{
+    u_long h = ((u_long)(uintptr_t)cc >> 4) * 2654435761UL;
+    jit_info **slot = &jit_slots[(h >> 8) & (JIT_SLOTS-1)];
+    jit_info *p = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+    if (p != NULL && p->cc == cc) {
+        if (__atomic_load_n(&p->translated, __ATOMIC_ACQUIRE)) {
+            return p->native;
+        }
+        /* We test with >=, so that lowering the threshold below the
+           current count takes effect. */
+        if (++p->count >= jit_threshold) {
+            p->native = jit_entry(cc);
+            __atomic_store_n(&p->translated, TRUE, __ATOMIC_RELEASE);
+            return p->native;
+        }
+        return NULL;
+    }
+    /* The slot holds another code.  Take over the slot when that code
+       has been called less often than CC since it came in. */
+    if (p == NULL || (!p->translated && p->count-- <= 1)) {
+        jit_info *q = SCM_NEW(jit_info);
+        q->cc = cc;
+        q->count = 1;
+        q->native = NULL;
+        q->translated = FALSE;
+        __atomic_store_n(slot, q, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+#endif /*GAUCHE_BASELINE_JIT*/
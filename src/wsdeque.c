@@ -0,0 +1,190 @@
+/*
+ * wsdeque.c - work-stealing deque
+ *
+ *   Copyright (c) 2025  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LIBGAUCHE_BODY
+#include "gauche.h"
+#include "gauche/priv/configP.h"
+#include "gauche/priv/wsdequeP.h"
+
+/* See wsdequeP.h for the design. */
+
+#define INITIAL_SIZE  32
+
+static void wsdeque_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx);
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_WorkDequeClass, wsdeque_print);
+
+static ScmWorkDequeBuffer *new_buffer(u_long size)
+{
+    ScmWorkDequeBuffer *b =
+        SCM_NEW2(ScmWorkDequeBuffer*,
+                 sizeof(ScmWorkDequeBuffer)+sizeof(ScmAtomicVar)*(size-1));
+    b->size = size;
+    for (u_long i=0; i<size; i++) b->items[i] = (ScmAtomicWord)SCM_FALSE;
+    return b;
+}
+
+static inline ScmObj buffer_get(ScmWorkDequeBuffer *b, long i)
+{
+    return SCM_OBJ(Scm_AtomicLoad(&b->items[i & (b->size-1)]));
+}
+
+static inline void buffer_put(ScmWorkDequeBuffer *b, long i, ScmObj item)
+{
+    Scm_AtomicStore(&b->items[i & (b->size-1)], (ScmAtomicWord)item);
+}
+
+/* Called by the owner when the buffer is full. */
+static ScmWorkDequeBuffer *grow_buffer(ScmWorkDequeBuffer *b,
+                                       long top, long bottom)
+{
+    ScmWorkDequeBuffer *nb = new_buffer(b->size*2);
+    for (long i=top; i<bottom; i++) buffer_put(nb, i, buffer_get(b, i));
+    return nb;
+}
+
+ScmObj Scm_MakeWorkDeque(ScmObj name)
+{
+    ScmWorkDeque *dq = SCM_NEW(ScmWorkDeque);
+    SCM_SET_CLASS(dq, SCM_CLASS_WORK_DEQUE);
+    dq->name = name;
+    dq->top = 0;
+    dq->bottom = 0;
+    dq->buffer = (ScmAtomicWord)new_buffer(INITIAL_SIZE);
+    dq->owner = 0;
+    return SCM_OBJ(dq);
+}
+
+static void check_owner(ScmWorkDeque *dq, const char *op)
+{
+    ScmVM *vm = Scm_VM();
+    ScmAtomicWord owner = Scm_AtomicLoad(&dq->owner);
+    if (owner == (ScmAtomicWord)vm) return;
+    if (owner == 0) {
+        ScmAtomicWord expected = 0;
+        if (Scm_AtomicCompareExchange(&dq->owner, &expected,
+                                      (ScmAtomicWord)vm)) {
+            return;
+        }
+        owner = expected;
+    }
+    Scm_Error("%s: work deque %S is owned by %S, but called from %S",
+              op, SCM_OBJ(dq), SCM_OBJ(owner), SCM_OBJ(vm));
+}
+
+void Scm_WorkDequePush(ScmWorkDeque *dq, ScmObj item)
+{
+    check_owner(dq, "work-deque-push!");
+    long b = (long)Scm_AtomicLoad(&dq->bottom);
+    long t = (long)Scm_AtomicLoad(&dq->top);
+    ScmWorkDequeBuffer *buf =
+        (ScmWorkDequeBuffer*)Scm_AtomicLoad(&dq->buffer);
+    if (b - t >= (long)buf->size - 1) {
+        buf = grow_buffer(buf, t, b);
+        Scm_AtomicStore(&dq->buffer, (ScmAtomicWord)buf);
+    }
+    buffer_put(buf, b, item);
+    Scm_AtomicStoreFull(&dq->bottom, (ScmAtomicWord)(b+1));
+}
+
+ScmObj Scm_WorkDequePop(ScmWorkDeque *dq)
+{
+    check_owner(dq, "work-deque-pop!");
+    long b = (long)Scm_AtomicLoad(&dq->bottom) - 1;
+    ScmWorkDequeBuffer *buf =
+        (ScmWorkDequeBuffer*)Scm_AtomicLoad(&dq->buffer);
+    /* Reserve the bottom item first, then see if a thief is competing.
+       This store must be visible before we read TOP. */
+    Scm_AtomicStoreFull(&dq->bottom, (ScmAtomicWord)b);
+    long t = (long)Scm_AtomicLoad(&dq->top);
+    if (t > b) {
+        /* empty */
+        Scm_AtomicStoreFull(&dq->bottom, (ScmAtomicWord)(b+1));
+        return SCM_UNBOUND;
+    }
+    ScmObj item = buffer_get(buf, b);
+    if (t == b) {
+        /* The last item.  Race with thieves for it. */
+        ScmAtomicWord expected = (ScmAtomicWord)t;
+        if (!Scm_AtomicCompareExchange(&dq->top, &expected,
+                                       (ScmAtomicWord)(t+1))) {
+            item = SCM_UNBOUND; /* a thief took it */
+        }
+        Scm_AtomicStoreFull(&dq->bottom, (ScmAtomicWord)(b+1));
+    }
+    return item;
+}
+
+ScmObj Scm_WorkDequeSteal(ScmWorkDeque *dq)
+{
+    for (;;) {
+        long t = (long)Scm_AtomicLoad(&dq->top);
+        long b = (long)Scm_AtomicLoad(&dq->bottom);
+        if (t >= b) return SCM_UNBOUND;
+        ScmWorkDequeBuffer *buf =
+            (ScmWorkDequeBuffer*)Scm_AtomicLoad(&dq->buffer);
+        ScmObj item = buffer_get(buf, t);
+        ScmAtomicWord expected = (ScmAtomicWord)t;
+        if (Scm_AtomicCompareExchange(&dq->top, &expected,
+                                      (ScmAtomicWord)(t+1))) {
+            return item;
+        }
+        /* Lost the race with another thief or the owner.  Retry. */
+    }
+}
+
+ScmSmallInt Scm_WorkDequeLength(ScmWorkDeque *dq)
+{
+    long b = (long)Scm_AtomicLoad(&dq->bottom);
+    long t = (long)Scm_AtomicLoad(&dq->top);
+    return (b > t)? (ScmSmallInt)(b - t) : 0;
+}
+
+static void wsdeque_print(ScmObj obj, ScmPort *port,
+                          ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmWorkDeque *dq = SCM_WORK_DEQUE(obj);
+    if (SCM_FALSEP(dq->name)) {
+        Scm_Printf(port, "#<work-deque (%ld) @%p>",
+                   Scm_WorkDequeLength(dq), dq);
+    } else {
+        Scm_Printf(port, "#<work-deque %S (%ld)>",
+                   dq->name, Scm_WorkDequeLength(dq));
+    }
+}
+
+void Scm__InitWorkDeque(void)
+{
+    ScmModule *mod = SCM_FIND_MODULE("gauche.threads", SCM_FIND_MODULE_CREATE);
+    Scm_InitStaticClass(&Scm_WorkDequeClass, "<work-deque>", mod, NULL, 0);
+}
@@ -0,0 +1,186 @@
+;;
+;; testing gauche.aio
+;;
+
+(use gauche.test)
+
+(test-start "aio")
+
+(use gauche.net)
+(use gauche.threads)
+(use gauche.aio)
+(test-module 'gauche.aio)
+
+(define (supported?)
+  (guard (e [else #f])
+    (aio-context-close (make-aio-context))
+    #t))
+
+;; Waits until all REQS complete, but no longer than a few seconds.
+(define (wait-all ctx reqs)
+  (let loop ([n 0])
+    (cond [(every aio-request-done? reqs) #t]
+          [(> n 50) #f]
+          [else (aio-wait ctx 100000) (loop (+ n 1))])))
+
+(define (run-tests backend)
+  (define ctx #f)
+
+  (test-section #"backend ~backend")
+
+  (test* "make-aio-context" backend
+         (begin
+           (set! ctx (make-aio-context :backend backend :size 8))
+           (and (aio-context? ctx)
+                (aio-context-backend ctx))))
+
+  (test* "wait with nothing" '() (aio-wait ctx))
+  (test* "wait with timeout" '() (aio-wait ctx 1000))
+
+  (test* "file write and read" '(8 3 "cde")
+         (begin
+           (call-with-output-file "test.o"
+             (^[out]
+               (call-with-input-file "test.o"
+                 (^[in]
+                   (let* ([w (aio-write ctx out (string->u8vector "abcdefgh")
+                                        :offset 0)]
+                          [_ (wait-all ctx (list w))]
+                          [buf (make-u8vector 3 0)]
+                          [r (aio-read ctx in buf :offset 2)])
+                     (wait-all ctx (list r))
+                     (list (aio-request-result w)
+                           (aio-request-result r)
+                           (u8vector->string buf)))))))))
+  (sys-unlink "test.o")
+
+  (test* "pipe" '(#f () 5 5 "hello")
+         (receive (in out) (sys-pipe)
+           (let* ([buf (make-u8vector 16 0)]
+                  [r (aio-read ctx in buf :data 'r)]
+                  [before (aio-request-done? r)]
+                  [waited (aio-wait ctx 10000)]
+                  [w (aio-write ctx out (string->u8vector "hello"))])
+             (wait-all ctx (list r w))
+             (close-port in)
+             (close-port out)
+             (list before waited
+                   (aio-request-result w)
+                   (aio-request-result r)
+                   (u8vector->string buf 0 (aio-request-result r))))))
+
+  (test* "request accessors" '(read #t data #t 0)
+         (receive (in out) (sys-pipe)
+           (let* ([buf (make-u8vector 4 0)]
+                  [r (aio-read ctx in buf :data 'data)])
+             (aio-wait ctx 1000)
+             (aio-write ctx out (string->u8vector "x"))
+             (wait-all ctx (list r))
+             (close-port in)
+             (close-port out)
+             (list (aio-request-op r)
+                   (eq? (aio-request-buffer r) buf)
+                   (aio-request-data r)
+                   (eq? (aio-request-target r) in)
+                   (aio-request-errno r)))))
+
+  (test* "accept and connect" '(#t #t "ping" "pong")
+         (let* ([server (make-server-socket
+                         (make <sockaddr-in> :host :loopback :port 0)
+                         :reuse-addr? #t)]
+                [client (make-socket PF_INET SOCK_STREAM)]
+                [a (aio-accept ctx server)]
+                [c (aio-connect ctx client (socket-getsockname server))])
+           (wait-all ctx (list a c))
+           (let* ([conn (aio-request-result a)]
+                  [buf1 (make-u8vector 4 0)]
+                  [buf2 (make-u8vector 4 0)]
+                  [rs (list (aio-read ctx conn buf1)
+                            (aio-write ctx client (string->u8vector "ping"))
+                            (aio-read ctx client buf2)
+                            (aio-write ctx conn (string->u8vector "pong")))])
+             (wait-all ctx rs)
+             (begin0 (list (is-a? conn <socket>)
+                           (eq? (aio-request-result c) client)
+                           (u8vector->string buf1)
+                           (u8vector->string buf2))
+               (socket-close conn)
+               (socket-close client)
+               (socket-close server)))))
+
+  (test* "connect refused" (list #f ECONNREFUSED)
+         (let* ([server (make-server-socket
+                         (make <sockaddr-in> :host :loopback :port 0)
+                         :reuse-addr? #t)]
+                [addr (socket-getsockname server)]
+                [client (make-socket PF_INET SOCK_STREAM)])
+           (socket-close server)
+           (let1 c (aio-connect ctx client addr)
+             (wait-all ctx (list c))
+             (socket-close client)
+             (list (aio-request-result c) (aio-request-errno c)))))
+
+  (test* "many requests" '(#t 0)
+         (let* ([pipes (list-tabulate 20 (^_ (values->list (sys-pipe))))]
+                [bufs (map (^_ (make-u8vector 1 0)) pipes)]
+                [reads (map (^[p b] (aio-read ctx (car p) b)) pipes bufs)]
+                [writes (map (^[i p] (aio-write ctx (cadr p) (make-u8vector 1 i)))
+                             (iota 20) pipes)])
+           (wait-all ctx (append reads writes))
+           (dolist [p pipes] (close-port (car p)) (close-port (cadr p)))
+           (list (equal? (map (cut u8vector-ref <> 0) bufs) (iota 20))
+                 (aio-pending-count ctx))))
+
+  (test* "dispatch" '(2 (a b))
+         (receive (in out) (sys-pipe)
+           (let* ([log '()]
+                  [buf (make-u8vector 1 0)]
+                  [_ (aio-read ctx in buf :data (^_ (push! log 'a)))]
+                  [_ (aio-write ctx out (make-u8vector 1 1)
+                                :data (^_ (push! log 'b)))])
+             (let loop ([n 0])
+               (if (>= n 2)
+                 (begin (close-port in) (close-port out)
+                        (list n (sort log)))
+                 (loop (+ n (aio-dispatch ctx 100000))))))))
+
+  (test* "close with in-flight requests" '(#t 0 0 7)
+         (receive (in out) (sys-pipe)
+           (let* ([ctx2 (make-aio-context :backend backend :size 2)]
+                  [bufs (map (^_ (make-u8vector 1 0)) (iota 4))]
+                  [reqs (map (cut aio-read ctx2 in <>) bufs)])
+             (aio-submit ctx2)
+             (aio-context-close ctx2)
+             ;; The canceled reads shouldn't consume what we write now.
+             (write-u8 7 out)
+             (flush out)
+             (begin0 (list (every aio-request-done? reqs)
+                           (aio-pending-count ctx2)
+                           (fold + 0 (map (cut u8vector-ref <> 0) bufs))
+                           (read-u8 in))
+               (close-port in)
+               (close-port out)))))
+
+  (test* "used by another thread" #t
+         (thread-join!
+          (thread-start!
+           (make-thread (^[] (guard (e [(<error> e) #t])
+                               (aio-wait ctx 0)
+                               #f))))))
+
+  (test* "close" (test-error)
+         (begin
+           (aio-context-close ctx)
+           (aio-wait ctx 0)))
+  )
+
+(cond
+ [(supported?)
+  (run-tests 'epoll)
+  (if (guard (e [else #f]) (make-aio-context :backend 'io-uring))
+    (run-tests 'io-uring)
+    (test-section "io_uring isn't available"))]
+ [else
+  (test-section "aio isn't supported")])
+
+(test-end)
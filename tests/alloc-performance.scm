@@ -0,0 +1,58 @@
+;;
+;; Measure performance of allocating pairs and flonums.
+;;
+;;   gosh alloc-performance.scm [threads]
+;;
+;; Runs each benchmark on 1 to THREADS threads concurrently, with and
+;; without the per-VM allocation cache (see priv/vmP.h).  Each run
+;; allocates the same number of cells per thread, so the real time is
+;; compared.
+;;
+
+(use gauche.time)
+(use gauche.threads)
+
+(define alloc-cache (with-module gauche.internal %vm-alloc-cache))
+
+(define-constant *count* 1000000)
+
+(define (cons-loop n)
+  (let loop ([i 0] [r '()])
+    (if (< i n)
+      (loop (+ i 1) (if (= (modulo i 1000) 0) '() (cons i r)))
+      r)))
+
+(define (flonum-loop n)
+  (let loop ([i 0] [x 0.0])
+    (if (< i n)
+      (loop (+ i 1) (+ x 0.5))
+      x)))
+
+(define (list-loop n)
+  (let loop ([i 0] [r #f])
+    (if (< i n)
+      (loop (+ i 10) (list i i i i i i i i i i))
+      r)))
+
+(define (in-threads nthreads proc)
+  (for-each thread-join!
+            (map (^_ (thread-start! (make-thread (^[] (proc *count*)))))
+                 (iota nthreads))))
+
+(define (bench name proc nthreads)
+  (print #"~name on ~nthreads thread(s)")
+  ($ time-these/report '(real 2)
+     `((cache-off . ,(^[] (alloc-cache #f) (in-threads nthreads proc)))
+       (cache-on  . ,(^[] (alloc-cache #t) (in-threads nthreads proc))))))
+
+(define (main args)
+  (let ([nthreads (if (> (length args) 1) (x->integer (cadr args)) 4)]
+        [orig (alloc-cache)])
+    (dolist [b `(("cons" ,cons-loop)
+                 ("flonum" ,flonum-loop)
+                 ("list" ,list-loop))]
+      (do ([n 1 (* n 2)])
+          [(> n nthreads)]
+        (bench (car b) (cadr b) n)))
+    (alloc-cache orig)
+    0))
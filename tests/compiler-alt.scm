@@ -80,4 +80,14 @@
                   [xs (length xs)]))
       (list (f) (f 1) (f 1 2) (f 1 2 3) (f 1 2 3 4))))
 
+(t "vector ops and apply" #f '(#(1 2 3) #(1 2) (1 2 . 3) 6 (1 2 1 2))
+   '(begin
+      (define (f x y)
+        (list (vector x y 3)
+              (list->vector (list x y))
+              (list* x y 3)
+              (apply + x y '(3))
+              (append (list x y) (list x y))))
+      (f 1 2)))
+
 (test-end)
@@ -191,6 +191,42 @@
          (thread-terminate! t)
          (thread-state t)))
 
+;; work-stealing pool
+(let ([pool (make-work-stealing-pool 4)]
+      [rs (atom '())])
+  (test* "work-stealing pool" #t (work-stealing-pool? pool))
+  (test* "add-job! and wait-all" (iota 100)
+         (begin
+           (dotimes [i 100]
+             (add-job! pool (^[] (atomic-update! rs (cut cons i <>)))))
+           (wait-all pool)
+           (sort (atomic rs identity))))
+  (test* "add-job! with result" '(done 6)
+         (let1 job (dequeue/wait!
+                    (thread-pool-results
+                     (begin (add-job! pool (^[] (* 2 3)) #t) pool)))
+           (list (job-status job) (job-result job))))
+  (test* "fork/join" 6765
+         (let ()
+           (define (pfib n)
+             (if (< n 10)
+               (let loop ([n n]) (if (< n 2) n (+ (loop (- n 1)) (loop (- n 2)))))
+               (let1 j (fork-job! pool (^[] (pfib (- n 1))))
+                 (let1 r (pfib (- n 2))
+                   (+ r (join-job! j))))))
+           (join-job! (fork-job! pool (^[] (pfib 20))))))
+  (test* "fork/join error" (test-error <error> "oops")
+         (join-job! (fork-job! pool (^[] (error "oops")))))
+  (test* "join-job! timeout" 'timeout
+         (join-job! (fork-job! pool (^[] (sys-sleep 1))) 0.01 'timeout))
+  (test* "current-work-stealing-pool" (list #f pool)
+         (list (current-work-stealing-pool)
+               (join-job! (fork-job! pool current-work-stealing-pool))))
+  (terminate-all! pool)
+  (test* "work-stealing pool shutdown" '(terminated terminated
+                                         terminated terminated)
+         (map thread-state (~ pool'pool))))
+
 ;;--------------------------------------------------------------------
 ;; control.cseq
 ;;
@@ -269,6 +305,24 @@
             (list (future (sys-sleep 10)) (future (sys-sleep 10)))
             '(a b)))
 
+(let1 pool (make-work-stealing-pool 2)
+  (test* "future on work-stealing pool" 55
+         (future-get (make-future (^[] (apply + (iota 11))) pool)))
+  (test* "nested futures on work-stealing pool" 6765
+         (let ()
+           (define (fib n)
+             (if (< n 2)
+               n
+               (let ([a (make-future (^[] (fib (- n 1))) pool)]
+                     [b (fib (- n 2))])
+                 (+ (future-get a) b))))
+           (future-get (make-future (^[] (fib 20)) pool))))
+  (test* "future on work-stealing pool (error)" (test-error <error> "oops")
+         (future-get (make-future (^[] (error "oops")) pool)))
+  (test* "future on work-stealing pool (timeout)" 'timeout
+         (future-get (make-future (^[] (sys-sleep 1)) pool) 0.01 'timeout))
+  (terminate-all! pool))
+
 ;;--------------------------------------------------------------------
 ;; control.pmap
 ;;
@@ -301,6 +355,20 @@
                (iota 5)
                :mapper (make-fully-concurrent-mapper 0.2 'timeout))))
 
+(test* "pmap (work-stealing)"
+       (map (cut * <> 2) (iota 100))
+       (pmap (cut * <> 2) (iota 100) :mapper (make-stealing-mapper)))
+(test* "pmap (work-stealing, grain)"
+       (map (cut * <> 2) (iota 100))
+       (let1 pool (make-work-stealing-pool 3)
+         (unwind-protect
+             (pmap (cut * <> 2) (iota 100)
+                   :mapper (make-stealing-mapper pool 8))
+           (terminate-all! pool))))
+(test* "pmap (work-stealing, empty)"
+       '()
+       (pmap (cut * <> 2) '() :mapper (make-stealing-mapper)))
+
 (test* "pfind (single)"
        (find (cut = <> 7) (iota 10))
        (pfind (cut = <> 7) (iota 10) :mapper (sequential-mapper)))
@@ -349,6 +417,20 @@
              (iota 20)
              :mapper (make-fully-concurrent-mapper)))
 
+(test* "pfind (work-stealing)"
+       (find (cut = <> 1) (iota 20))
+       (pfind (^x (and (sys-sleep (quotient x 2))
+                       (= x 1)))
+              (iota 20)
+              :mapper (make-stealing-mapper)))
+(test* "pany (work-stealing)"
+       (any (^x (and (= x 1) 42)) (iota 10))
+       (pany (^x (and (sys-sleep (quotient x 2))
+                      (= x 1)
+                      42))
+             (iota 20)
+             :mapper (make-stealing-mapper)))
+
 ;;--------------------------------------------------------------------
 ;; control.scheduler
 ;;
@@ -744,4 +826,132 @@
                     'oops)
                    (sys-sleep 1) 'ok))
 
+;;--------------------------------------------------------------------
+(test-section "control.fiber")
+(use control.fiber)
+(use gauche.aio)
+(use gauche.net)
+(test-module 'control.fiber)
+
+(define (aio-supported?)
+  (guard (e [else #f])
+    (aio-context-close (make-aio-context))
+    #t))
+
+(when (aio-supported?)
+  (test* "run-fibers" '(1 2)
+         (values->list (run-fibers (^[] (values 1 2)) :threads 2)))
+
+  (test* "spawn and join" (iota 100)
+         (run-fibers (^[] (map fiber-join
+                               (map (^i (spawn-fiber (^[] (fiber-yield) i)))
+                                    (iota 100))))
+                     :threads 3))
+
+  (test* "error propagates to join" (test-error <error> "boom")
+         (run-fibers (^[] (fiber-join (spawn-fiber (^[] (error "boom")))))))
+
+  (test* "current-fiber" '(#f #t #t)
+         (list (current-fiber)
+               (run-fibers (^[] (fiber? (current-fiber))))
+               (run-fibers (^[] (fiber-scheduler? (current-fiber-scheduler))))))
+
+  (test* "rendezvous channel" '(0 1 2 3 4 5 6 7 8 9)
+         (run-fibers
+          (^[] (let1 ch (make-channel)
+                 (spawn-fiber (^[] (dotimes [i 10] (channel-put! ch i))
+                                   (channel-close! ch)))
+                 (let loop ([r '()])
+                   (let1 v (channel-get ch)
+                     (if (eof-object? v)
+                       (reverse r)
+                       (loop (cons v r)))))))))
+
+  (test* "buffered channel" '(3 (a b c))
+         (run-fibers
+          (^[] (let1 ch (make-channel 3)
+                 ;; doesn't block
+                 (channel-put! ch 'a)
+                 (channel-put! ch 'b)
+                 (channel-put! ch 'c)
+                 (let1 f (spawn-fiber (^[] (channel-put! ch 'd) 3))
+                   (let1 vs (list (channel-get ch) (channel-get ch)
+                                  (channel-get ch))
+                     (list (fiber-join f) vs)))))))
+
+  (test* "put to closed channel" (test-error <error> #/closed/)
+         (let1 ch (make-channel 1)
+           (channel-close! ch)
+           (channel-put! ch 1)))
+
+  (test* "channel between fibers and a thread" 4950
+         (let* ([s (make-fiber-scheduler 2)]
+                [ch (make-channel)])
+           (dotimes [i 100]
+             (spawn-fiber (^[] (channel-put! ch i)) :scheduler s))
+           (begin0 (let loop ([n 0] [sum 0])
+                     (if (= n 100) sum (loop (+ n 1) (+ sum (channel-get ch)))))
+             (fiber-scheduler-shutdown! s))))
+
+  (test* "many parked fibers" 10000
+         (run-fibers
+          (^[] (let* ([ch (make-channel)]
+                      [fs (list-tabulate 10000
+                                         (^_ (spawn-fiber (^[] (channel-get ch)))))])
+                 (fiber-sleep 0.01)
+                 (dotimes [i 10000] (channel-put! ch 1))
+                 (fold + 0 (map fiber-join fs))))
+          :threads 4))
+
+  (test* "fiber-sleep" '(b a)
+         (run-fibers
+          (^[] (let* ([ch (make-channel 2)]
+                      [a (spawn-fiber (^[] (fiber-sleep 0.05) (channel-put! ch 'a)))]
+                      [b (spawn-fiber (^[] (fiber-sleep 0.01) (channel-put! ch 'b)))])
+                 (fiber-join a) (fiber-join b)
+                 (list (channel-get ch) (channel-get ch))))))
+
+  (test* "fiber I/O" '("ping" "pong")
+         (run-fibers
+          (^[] (let* ([server (make-server-socket
+                               (make <sockaddr-in> :host :loopback :port 0)
+                               :reuse-addr? #t)]
+                      [addr (socket-getsockname server)]
+                      [sf (spawn-fiber
+                           (^[] (let* ([conn (fiber-accept server)]
+                                       [buf (make-u8vector 4)])
+                                  (fiber-read! conn buf)
+                                  (fiber-write conn "pong")
+                                  (socket-close conn)
+                                  (u8vector->string buf))))]
+                      [client (fiber-connect (make-socket PF_INET SOCK_STREAM)
+                                             addr)]
+                      [buf (make-u8vector 4)])
+                 (fiber-write client "ping")
+                 (fiber-read! client buf)
+                 (socket-close client)
+                 (begin0 (list (fiber-join sf) (u8vector->string buf))
+                   (socket-close server))))))
+
+  (test* "fiber I/O error is delivered to the fiber" '(caught ok)
+         (run-fibers
+          (^[] (receive (in out) (sys-pipe)
+                 (close-port in)
+                 (close-port out)
+                 (list (guard (e [(<error> e) 'caught])
+                         (fiber-read! in (make-u8vector 4)))
+                       ;; the worker is still alive
+                       (fiber-join (spawn-fiber (^[] (fiber-yield) 'ok))))))
+          :threads 1))
+
+  (test* "fiber I/O outside of fibers" '(5 "hello")
+         (receive (in out) (sys-pipe)
+           (fiber-write out "hello")
+           (let* ([buf (make-u8vector 8 0)]
+                  [n (fiber-read! in buf)])
+             (close-port in)
+             (close-port out)
+             (list n (u8vector->string buf 0 n)))))
+  )
+
 (test-end)
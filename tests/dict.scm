@@ -36,6 +36,10 @@
 
 (test-basics (make-hash-table 'eq?))
 
+(test-section "concurrent-hash-table as dictionary")
+
+(test-basics (make-concurrent-hash-table 'eq?))
+
 (test-section "tree-map as dictionary")
 
 (test-basics
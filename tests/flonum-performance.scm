@@ -0,0 +1,56 @@
+;;
+;; Measure performance of flonum arithmetic in loops.
+;;
+;;   gosh flonum-performance.scm
+;;
+;; Compiles each benchmark with and without the flonum specialization
+;; pass (see pass3/specialize in src/compile-3.scm), and compares them.
+;;
+
+(use gauche.time)
+
+(define-constant *count* 1000000)
+
+(define no-specialize (with-module gauche.internal SCM_COMPILE_NO_SPECIALIZE))
+(define flag-set! (with-module gauche.internal vm-compiler-flag-set!))
+(define flag-clear! (with-module gauche.internal vm-compiler-flag-clear!))
+
+(define benchmarks
+  '(("sum"
+     (^[n]
+       (let loop ([i 0] [x 0.0])
+         (if (< i n) (loop (+ i 1) (+ x 0.5)) x))))
+    ("polynomial"
+     (^[n]
+       (let loop ([i 0] [x 0.0] [y 0.0])
+         (if (< i n)
+           (loop (+ i 1) (+ x 1e-6) (+ y (* x (- (* 3 x) 2.0))))
+           y))))
+    ("harmonic"
+     (^[n]
+       (let loop ([i 0] [k 1.0] [s 0.0])
+         (if (< i n) (loop (+ i 1) (+ k 1.0) (+ s (/ 1.0 k))) s))))
+    ("euler"
+     ;; integrate dv/dt = -x, dx/dt = v
+     (^[n]
+       (let loop ([i 0] [x 1.0] [v 0.0])
+         (if (< i n)
+           (let1 dt 1e-4
+             (loop (+ i 1) (+ x (* v dt)) (- v (* x dt))))
+           x))))))
+
+(define (compile-benchmark expr specialize?)
+  (dynamic-wind
+    (^[] (unless specialize? (flag-set! no-specialize)))
+    (^[] (eval expr (current-module)))
+    (^[] (flag-clear! no-specialize))))
+
+(define (main args)
+  (dolist [b benchmarks]
+    (let ([off (compile-benchmark (cadr b) #f)]
+          [on  (compile-benchmark (cadr b) #t)])
+      (print (car b))
+      ($ time-these/report '(cpu 3)
+         `((specialize-off . ,(^[] (off *count*)))
+           (specialize-on  . ,(^[] (on *count*)))))))
+  0)
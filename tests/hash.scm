@@ -466,6 +466,26 @@
                 (iota 20))
     (every (cut hash-table-contains? h <> ) (iota 20))))
 
+;; Repeated deletion and insertion leaves many deleted buckets, which
+;; must be swept out on rehash without losing live entries.
+(test* "deletion and reinsertion" '(1000 #t #f)
+       (let1 h (make-hash-table 'eqv?)
+         (dotimes [i 1000] (hash-table-put! h i i))
+         (dotimes [j 20]
+           (dotimes [i 1000]
+             (hash-table-delete! h (+ i (* j 1000)))
+             (hash-table-put! h (+ i (* (+ j 1) 1000)) i)))
+         (list (hash-table-num-entries h)
+               (every (^i (eqv? (hash-table-get h (+ i 20000) #f) i))
+                      (iota 1000))
+               (hash-table-exists? h 19999))))
+
+(test* "deletion during iteration" '(0 ())
+       (let1 h (make-hash-table 'string=?)
+         (dotimes [i 300] (hash-table-put! h (number->string i) i))
+         (hash-table-for-each h (^[k v] (hash-table-delete! h k)))
+         (list (hash-table-num-entries h) (hash-table-keys h))))
+
 ;;------------------------------------------------------------------
 (test-section "iterators")
 
@@ -562,4 +582,96 @@
                                         #f #f)
                        c d)))
 
+;;------------------------------------------------------------------
+(test-section "concurrent hash tables")
+
+(let ()
+  (define (basic-tests type key1 key2 key3)
+    (let1 h (make-concurrent-hash-table type)
+      (test* #"concurrent-hash-table(~type)" #t
+             (concurrent-hash-table? h))
+      (test* #"concurrent-hash-table(~type) type" type
+             (concurrent-hash-table-type h))
+      (test* #"concurrent-hash-table(~type) get (empty)" 'none
+             (concurrent-hash-table-get h key1 'none))
+      (test* #"concurrent-hash-table(~type) get (error)" (test-error)
+             (concurrent-hash-table-get h key1))
+      (concurrent-hash-table-put! h key1 1)
+      (concurrent-hash-table-put! h key2 2)
+      (test* #"concurrent-hash-table(~type) get" '(1 2 none)
+             (list (concurrent-hash-table-get h key1 'none)
+                   (concurrent-hash-table-get h key2 'none)
+                   (concurrent-hash-table-get h key3 'none)))
+      (test* #"concurrent-hash-table(~type) num-entries" 2
+             (concurrent-hash-table-num-entries h))
+      (concurrent-hash-table-put! h key1 'one)
+      (concurrent-hash-table-adjoin! h key2 'two)
+      (concurrent-hash-table-replace! h key3 'three)
+      (test* #"concurrent-hash-table(~type) overwrite" '(one 2 none)
+             (list (concurrent-hash-table-get h key1 'none)
+                   (concurrent-hash-table-get h key2 'none)
+                   (concurrent-hash-table-get h key3 'none)))
+      (test* #"concurrent-hash-table(~type) delete!" '(#t #f 1)
+             (list (concurrent-hash-table-delete! h key1)
+                   (concurrent-hash-table-delete! h key1)
+                   (concurrent-hash-table-num-entries h)))
+      (test* #"concurrent-hash-table(~type) exists?" '(#f #t)
+             (list (concurrent-hash-table-exists? h key1)
+                   (concurrent-hash-table-exists? h key2)))
+      (concurrent-hash-table-put! h key1 10)
+      (test* #"concurrent-hash-table(~type) reinsert" 10
+             (concurrent-hash-table-get h key1))
+      (concurrent-hash-table-clear! h)
+      (test* #"concurrent-hash-table(~type) clear!" '(0 ())
+             (list (concurrent-hash-table-num-entries h)
+                   (concurrent-hash-table-keys h)))))
+
+  (basic-tests 'eq? 'a 'b 'c)
+  (basic-tests 'eqv? 1.0 (expt 3 100) #\c)
+  (basic-tests 'equal? '(a b) "b" #(c))
+  (basic-tests 'string=? "a" "b" "c")
+
+  (test* "concurrent-hash-table(string=?) non-string key" (test-error)
+         (concurrent-hash-table-put! (make-concurrent-hash-table 'string=?)
+                                     'a 1))
+  (test* "make-concurrent-hash-table with comparator" 'equal?
+         (concurrent-hash-table-type
+          (make-concurrent-hash-table equal-comparator)))
+  (test* "make-concurrent-hash-table with unsupported comparator"
+         (test-error)
+         (make-concurrent-hash-table default-comparator))
+
+  ;; grow, shrink and iterate
+  (let1 h (make-concurrent-hash-table 'eqv?)
+    (dotimes [i 10000] (concurrent-hash-table-put! h i (* i i)))
+    (test* "concurrent-hash-table expand" '(10000 99980001)
+           (list (concurrent-hash-table-num-entries h)
+                 (concurrent-hash-table-get h 9999)))
+    (dotimes [i 10000] (when (odd? i) (concurrent-hash-table-delete! h i)))
+    (test* "concurrent-hash-table delete many" '(5000 #f 99960004)
+           (list (concurrent-hash-table-num-entries h)
+                 (concurrent-hash-table-exists? h 9999)
+                 (concurrent-hash-table-get h 9998)))
+    (test* "concurrent-hash-table-keys" (iota 5000 0 2)
+           (sort (concurrent-hash-table-keys h)))
+    (test* "concurrent-hash-table-fold" (* 2 (apply + (iota 5000 0 2)))
+           (concurrent-hash-table-fold h (^[k v r] (+ k k r)) 0)))
+
+  (let1 h (make-concurrent-hash-table 'eq?)
+    (concurrent-hash-table-put! h 'a 1)
+    (concurrent-hash-table-update! h 'a (cut + <> 10))
+    (concurrent-hash-table-update! h 'b (cut + <> 10) 100)
+    (concurrent-hash-table-push! h 'c 'x)
+    (concurrent-hash-table-push! h 'c 'y)
+    (test* "concurrent-hash-table-update!" '((a . 11) (b . 110) (c y x))
+           (sort (concurrent-hash-table->alist h)
+                 (^[x y] (string<? (symbol->string (car x))
+                                   (symbol->string (car y))))))
+    (test* "concurrent-hash-table-update! (error)" (test-error)
+           (concurrent-hash-table-update! h 'z identity))
+    (test* "concurrent-hash-table-pop!" '(y x none)
+           (list (concurrent-hash-table-pop! h 'c)
+                 (concurrent-hash-table-pop! h 'c)
+                 (concurrent-hash-table-pop! h 'c 'none)))))
+
 (test-end)
@@ -103,6 +103,128 @@
              :if-exists #f)
            (call-with-input-file "tmp2.o" read)))
 
+(call-with-output-file "tmp2.o"
+  (^p (display "abc\r\ndef\rghi\n\u3042\u3044\n\nlast" p)))
+
+(test* "open-input-file :mmap #t" '(#\a 98 "bc" "def" "ghi" "\u3042\u3044" ""
+                                    "last" #t)
+       (call-with-input-file "tmp2.o"
+         (^p (let* ([c (read-char p)]
+                    [b (peek-byte p)]
+                    [ls (port->string-list p)])
+               `(,c ,b ,@ls ,(eof-object? (read-line p)))))
+         :mmap #t))
+
+(test* "open-input-file :mmap #t (read-string, seek)"
+       '("abc" 5 "def" 0 "abc\r\ndef" "last")
+       (call-with-input-file "tmp2.o"
+         (^p (let* ([s0 (read-string 3 p)]
+                    [_ (port-seek p 2 SEEK_CUR)]
+                    [t0 (port-tell p)]
+                    [s1 (read-string 3 p)]
+                    [_ (port-seek p 0)]
+                    [t1 (port-tell p)]
+                    [s2 (read-line p)]
+                    [s3 (read-line p)]
+                    [_ (port-seek p -4 SEEK_END)])
+               (list s0 t0 s1 t1 (string-append s2 "\r\n" s3)
+                     (read-line p))))
+         :mmap #t))
+
+(test* "open-input-file :mmap #t (remaining string)" "ghi\n"
+       (let* ([p (open-input-file "tmp2.o" :mmap #t)]
+              [_ (read-line p)]
+              [_ (read-line p)]
+              [s (get-remaining-input-string p)])
+         (close-input-port p)
+         (string-copy s 0 4)))
+
+(test* "open-input-file :mmap #t (closed)" (test-error)
+       (let1 p (open-input-file "tmp2.o" :mmap #t)
+         (close-input-port p)
+         (read-char p)))
+
+(call-with-output-file "tmp2.o" (^p #f))
+
+(test* "open-input-file :mmap #t (empty)" '(#t #t)
+       (call-with-input-file "tmp2.o"
+         (^p (list (eof-object? (read-line p)) (eof-object? (read-byte p))))
+         :mmap #t))
+
+(test* "open-input-file :mmap #t (not exist)" #f
+       (open-input-file "tmp3.o" :mmap #t :if-does-not-exist #f))
+
+(test* "port-writev (file port)" '(7 "abc\x01;\x02;\u3042de")
+       (begin
+         (sys-unlink "tmp2.o")
+         (let* ([n (call-with-output-file "tmp2.o"
+                     (^p (display "a" p)
+                         (begin0
+                           (port-writev p '("bc" #u8(1 2) ""
+                                            "\u3042" #u8()))
+                           (display "d" p)
+                           (port-writev p '("e")))))]
+                [s (call-with-input-file "tmp2.o" port->string)])
+           (list n s))))
+
+(test* "port-writev (string port)" '(6 "xabc\x01;\x02;")
+       (let* ([p (open-output-string)]
+              [_ (write-char #\x p)]
+              [n (port-writev p '("abc" #u8(1 2) ""))])
+         (list (+ n 1) (get-output-string p))))
+
+(test* "port-writev (bad buffer)" (test-error)
+       (port-writev (open-output-string) '("abc" abc)))
+
+(let ()
+  (define data
+    (with-output-to-string
+      (^() (dotimes [i 3000] (display i) (newline)))))
+  (call-with-output-file "tmp2.o" (^p (display data p)))
+
+  (test* "port-sendfile" (list (string-length data) data)
+         (begin
+           (sys-unlink "tmp3.o")
+           (let1 n (call-with-input-file "tmp2.o"
+                     (^[in] (call-with-output-file "tmp3.o"
+                              (^[out] (port-sendfile in out)))))
+             (list n (call-with-input-file "tmp3.o" port->string)))))
+
+  (test* "port-sendfile (buffered, size)"
+         (list 5000 (string-append "!" (substring data 2 5001)))
+         (begin
+           (sys-unlink "tmp3.o")
+           (let1 n (call-with-input-file "tmp2.o"
+                     (^[in]
+                       (read-char in) (read-char in) (peek-char in)
+                       (call-with-output-file "tmp3.o"
+                         (^[out] (write-char #\! out)
+                                 (+ 1 (port-sendfile in out 4999))))))
+             (list n (call-with-input-file "tmp3.o" port->string)))))
+
+  (test* "port-sendfile (string ports)" '(7 "abcdefg" "hi")
+         (let* ([in (open-input-string "abcdefghi")]
+                [out (open-output-string)]
+                [n (port-sendfile in out 7)])
+           (list n (get-output-string out) (read-line in))))
+
+  (test* "copy-port (file ports)" (string-length data)
+         (begin
+           (sys-unlink "tmp3.o")
+           (call-with-input-file "tmp2.o"
+             (^[in] (call-with-output-file "tmp3.o"
+                      (^[out] (copy-port in out)))))))
+
+  (test* "copy-port (file ports, append)" (* 2 (string-length data))
+         (begin
+           (call-with-input-file "tmp2.o"
+             (^[in] (call-with-output-file "tmp3.o"
+                      (^[out] (copy-port in out))
+                      :if-exists :append)))
+           (string-length (call-with-input-file "tmp3.o" port->string))))
+  )
+(sys-unlink "tmp3.o")
+
 ;;-------------------------------------------------------------------
 (test-section "port-attributes")
 
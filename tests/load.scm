@@ -399,6 +399,57 @@
 
 (rmrf "test.o")
 
+;; Compile cache -----------------------------------
+
+(test-section "compile cache")
+
+(rmrf "test.o")
+(sys-mkdir "test.o" #o777)
+(with-output-to-file "test.o/cc-inc.scm"
+  (^[] (write '(define (cc-inc) 'inc1))))
+(with-output-to-file "test.o/cc.scm"
+  (^[]
+    (write '(define-module load.cc (export cc-run)))
+    (write '(select-module load.cc))
+    (write '(define-syntax twice (syntax-rules () [(_ x) (list x x)])))
+    (write '(define (cc-run n) (twice (* n cc-k))))
+    (write '(define cc-k 3))
+    (write '(include "cc-inc.scm"))))
+
+(define (load-with-cache)
+  (let1 prev (compile-cache-directory)
+    (unwind-protect
+        (begin
+          (compile-cache-directory "test.o/cache")
+          (load "test.o/cc.scm")
+          (list ((with-module load.cc cc-run) 2)
+                ((with-module load.cc cc-inc))))
+      (compile-cache-directory prev))))
+
+(define (cache-files)
+  (if (file-exists? "test.o/cache")
+    (map (cut string-append "test.o/cache/" <>)
+         (filter #/\.gosh-cache$/ (sys-readdir "test.o/cache")))
+    '()))
+
+(define (cache-file-id)
+  (map (^f (let1 st (sys-stat f)
+             (list (slot-ref st 'ino) (slot-ref st 'mtime))))
+       (cache-files)))
+
+(test* "first load" '((6 6) inc1) (load-with-cache))
+(test* "cache file created" 1 (length (cache-files)))
+(let1 id (cache-file-id)
+  (test* "load from cache" '((6 6) inc1) (load-with-cache))
+  (test* "cache file reused" id (cache-file-id)))
+
+(with-output-to-file "test.o/cc-inc.scm"
+  (^[] (write '(define (cc-inc) 'included2))))
+(test* "included file changed" '((6 6) included2) (load-with-cache))
+(test* "load from cache again" '((6 6) included2) (load-with-cache))
+
+(rmrf "test.o")
+
 ;; Load-path hook -----------------------------------
 
 (test-section "load-path hook")
@@ -533,6 +533,15 @@
                 (list (eq? f-addr from)
                       (equal? buf data))))))))
 
+(with-sr-udp
+ (^[s-sock s-addr r-sock r-addr]
+   (test* "udp socket-sendv" '(8 "abc\x01;\x02;def")
+          (begin
+            (socket-connect s-sock s-addr)
+            (let1 n (socket-sendv s-sock '("abc" #u8(1 2) "" "def"))
+              (list n (string-incomplete->complete
+                       (socket-recv r-sock 1024))))))))
+
 (cond-expand
  [gauche.os.windows
   ;; buildmsg is not supported on MinGW
@@ -649,6 +649,28 @@
 (test* "number->string radix error 2" (test-error) (number->string 42 1))
 (test* "number->string radix error 3" (test-error) (number->string 42 37))
 
+;; Large integers are converted by divide-and-conquer, so check
+;; zero padding of intermediate chunks and round trip.
+(test* "number->string 10^3000" (string-append "1" (make-string 3000 #\0))
+       (number->string (expt 10 3000)))
+(test* "number->string 10^3000-1" (make-string 3000 #\9)
+       (number->string (- (expt 10 3000) 1)))
+(test* "number->string -(10^3000+1)"
+       (string-append "-1" (make-string 2999 #\0) "1")
+       (number->string (- (+ (expt 10 3000) 1))))
+(test* "number->string 2^10000 radix 2"
+       (string-append "1" (make-string 10000 #\0))
+       (number->string (expt 2 10000) 2))
+(let ([x (+ (expt 7 20000) (expt 3 5000))])
+  (dolist [radix '(2 3 10 16 36)]
+    (test* (format "string->number/number->string roundtrip radix ~a" radix)
+           x
+           (string->number (number->string x radix) radix))
+    (test* (format "string->number/number->string roundtrip radix ~a (neg)"
+                   radix)
+           (- x)
+           (string->number (number->string (- x) radix) radix))))
+
 ;;------------------------------------------------------------------
 (test-section "number->string customization")
 
@@ -1551,6 +1573,42 @@
            173462447179147555430258970864309778377421844723664084649347019061363579192879108857591038330408837177983810868451546421940712978306134189864280826014542758708589243873685563973118948869399158545506611147420216132557017260564139394366945793220968665108959685482705388072645828554151936401912464931182546092879815733057795573358504982279280090942872567591518912118622751714319229788100979251036035496917279912663527358783236647193154777091427745377038294584918917590325110939381322486044298573971650711059244462177542540706913047034664643603491382441723306598834177
            ))
 
+;;------------------------------------------------------------------
+(test-section "large multiplication")
+
+;; Multiplication of large bignums switches algorithms (Karatsuba, Toom-3
+;; and NTT) by the size of operands.  We check the results against the
+;; ones calculated with bignum * fixnum, which is always simple.
+(let ()
+  ;; A bignum of BITS bits with irregular bit pattern
+  (define (make-big bits seed)
+    (let loop ([n 0] [r seed])
+      (if (>= n bits)
+        (bit-field r 0 bits)
+        (loop (+ n 24)
+              (logior (ash r 24)
+                      (logand (* (+ n seed) 2654435761) #xffffff))))))
+  ;; x * y, by adding x * (24-bit chunk of y)
+  (define (slow-mul x y)
+    (let loop ([v (abs y)] [s 0] [r 0])
+      (if (zero? v)
+        (if (negative? y) (- r) r)
+        (loop (ash v -24) (+ s 24)
+              (+ r (ash (* x (logand v #xffffff)) s))))))
+  (dolist [bits '(1000 2600 3000 10000 12000 30000 100000 300000)]
+    (let ([x (make-big bits 17)]
+          [y (make-big bits 123)]
+          [z (make-big (quotient bits 3) 55)])
+      (test* (format "~a bits * ~a bits" bits bits) #t
+             (= (* x y) (slow-mul x y)))
+      (test* (format "~a bits * -~a bits" bits (quotient bits 3)) #t
+             (= (* x (- z)) (- (slow-mul x z))))
+      (test* (format "(2^~a-1)^2" bits)
+             (+ (- (ash 1 (* 2 bits)) (ash 1 (+ bits 1))) 1)
+             (let1 m (- (ash 1 bits) 1) (* m m)))
+      (test* (format "square of ~a bits" bits) #t
+             (= (* x x) (slow-mul x x))))))
+
 ;;------------------------------------------------------------------
 (test-section "multiplication short cuts")
 
@@ -1891,6 +1949,26 @@
   (do-exactness 7 9)
   )
 
+;; Large operands use recursive division.
+(let ()
+  (define (check q y r)
+    (let1 x (+ (* q y) r)
+      (test* (format "quotient&remainder ~a bits / ~a bits"
+                     (integer-length x) (integer-length y))
+             (list q r)
+             (receive (qq rr) (quotient&remainder x y) (list qq rr)))
+      (test* (format "quotient&remainder ~a bits / ~a bits (neg)"
+                     (integer-length x) (integer-length y))
+             (list (- q) r)
+             (receive (qq rr) (quotient&remainder x (- y)) (list qq rr)))))
+  (dolist [ybits '(200 3000 8000 20000)]
+    (dolist [qbits '(100 3000 8000 40000)]
+      (let ([y (+ (expt 3 (quotient (* ybits 10) 16)) 12345)]
+            [q (- (expt 5 (quotient (* qbits 10) 23)) 1)])
+        (check q y (quotient y 7))
+        (check q y (- y 1))
+        (check q y 0)))))
+
 ;;------------------------------------------------------------------
 (test-section "div and mod")
 
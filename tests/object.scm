@@ -447,6 +447,76 @@
              (acc-dis-1 (make <acc-dis-1>) 2)))
 
 
+;;----------------------------------------------------------------
+(test-section "method cache")
+
+;; Sorted applicable methods are cached per generic function, keyed
+;; by argument classes.  Make sure the cache follows modifications.
+
+(define-class <mc-a> () ())
+(define-class <mc-b> (<mc-a>) ())
+(define-class <mc-c> (<mc-b>) ())
+
+(define-generic mc-1)
+(define-method mc-1 ((x <mc-a>)) '(a))
+(define-method mc-1 ((x <mc-a>) y) '(a y))
+
+(define (mc-1-all)
+  (map (^o (list (mc-1 o) (mc-1 o #f)))
+       (list (make <mc-a>) (make <mc-b>) (make <mc-c>))))
+
+(test* "method cache (initial)" '(((a) (a y)) ((a) (a y)) ((a) (a y)))
+       (begin (mc-1-all) (mc-1-all)))
+
+(define-method mc-1 ((x <mc-b>)) (cons 'b (next-method)))
+(test* "method cache (method added)" '(((a) (a y)) ((b a) (a y)) ((b a) (a y)))
+       (begin (mc-1-all) (mc-1-all)))
+
+(define-method mc-1 ((x <mc-c>) y) (cons 'c (next-method)))
+(test* "method cache (method added)" '(((a) (a y)) ((b a) (a y)) ((b a) (c a y)))
+       (begin (mc-1-all) (mc-1-all)))
+
+(define-method mc-1 ((x <mc-b>)) '(b2))
+(test* "method cache (method replaced)" '(((a) (a y)) ((b2) (a y)) ((b2) (c a y)))
+       (begin (mc-1-all) (mc-1-all)))
+
+(delete-method! mc-1 (find (^m (equal? (~ m'specializers) (list <mc-b>)))
+                           (~ mc-1'methods)))
+(test* "method cache (method deleted)" '(((a) (a y)) ((a) (a y)) ((a) (c a y)))
+       (begin (mc-1-all) (mc-1-all)))
+
+(test* "method cache (no applicable method)" (test-error)
+       (begin (mc-1 'foo) (mc-1 'foo)))
+(define-method mc-1 ((x <symbol>)) 'sym)
+(test* "method cache (no applicable method -> added)" 'sym
+       (mc-1 'foo))
+
+;; Megamorphic call site; more classes than the cache entries
+(define-generic mc-2)
+(define-method mc-2 (x y) 'top)
+(define-method mc-2 ((x <integer>) y) 'int)
+(define-method mc-2 ((x <string>) (y <string>)) 'strs)
+(define-method mc-2 ((x <string>) y) (list 'str (next-method)))
+(define-method mc-2 ((x <symbol>) (y <pair>)) 'sym+pair)
+
+(test* "method cache (megamorphic)"
+       (make-list 5 '(int top (str top) strs sym+pair top top int))
+       (map (^_ (map mc-2
+                     '(1 #\a "a" "a" a a #f 10)
+                     '(1 #\a 1   "b" (b) b (c) "c")))
+            (iota 5)))
+
+;; Class redefinition updates specializers of methods
+(define-class <mc-r> () ())
+(define-method mc-3 ((x <mc-r>)) 'r)
+(define-method mc-3 (x) 'top)
+(define mc-3-old (make <mc-r>))
+(test* "method cache (before class redefinition)" '(r r)
+       (list (mc-3 mc-3-old) (mc-3 mc-3-old)))
+(define-class <mc-r> () ((z :init-value 1)))
+(test* "method cache (after class redefinition)" '(r r)
+       (list (mc-3 (make <mc-r>)) (mc-3 (make <mc-r>))))
+
 ;;----------------------------------------------------------------
 (test-section "module and accessor")
 
@@ -872,6 +942,31 @@
          (map (cut hash-table-get eqvtab <>) (list x0 x1)))
   )
 
+;; Concurrent hash table calls object-equal? without locking the table,
+;; so the method can even modify the table.
+(define-class <chash-key> ()
+  ((x :init-keyword :x)))
+(define chash-key-hook #f)
+
+(define-method object-hash ((k <chash-key>)) 0)
+(define-method object-equal? ((a <chash-key>) (b <chash-key>))
+  (and-let1 hook chash-key-hook
+    (set! chash-key-hook #f)
+    (hook))
+  (eqv? (slot-ref a 'x) (slot-ref b 'x)))
+
+(let1 ch (make-concurrent-hash-table 'equal?)
+  (concurrent-hash-table-put! ch (make <chash-key> :x 1) 'one)
+  (set! chash-key-hook
+        (^[] (concurrent-hash-table-put! ch (make <chash-key> :x 2) 'two)))
+  (concurrent-hash-table-put! ch (make <chash-key> :x 3) 'three)
+  (test* "concurrent hash table modified in object-equal?"
+         '(one two three 3)
+         (list (concurrent-hash-table-get ch (make <chash-key> :x 1) #f)
+               (concurrent-hash-table-get ch (make <chash-key> :x 2) #f)
+               (concurrent-hash-table-get ch (make <chash-key> :x 3) #f)
+               (concurrent-hash-table-num-entries ch))))
+
 ;;----------------------------------------------------------------
 (test-section "object-apply protocol")
 
@@ -316,6 +316,50 @@
 (test* "constant closure identity" #t
        (eq? (make-constant-closure) (make-constant-closure)))
 
+(test-section "flonum specialization")
+
+(define (flsum n)
+  (let loop ([i 0] [x 0.0])
+    (if (< i n) (loop (+ i 1) (+ x 0.5)) x)))
+(define (flpow2 n)
+  (let loop ([i 0] [x 1.0])
+    (if (< i n) (loop (+ i 1) (* x 2)) x)))
+(define (flzero n)
+  (let loop ([i 0] [x 1.5])
+    (if (< i n) (loop (+ i 1) (- x 1)) (* x 0))))
+(define (mixed-sum n)
+  (let loop ([i 0] [x 0])
+    (if (< i n) (loop (+ i 1) (+ x 0.5)) x)))
+
+(test* "flonum loop variable" '(((FLADD2)))
+       (filter-insn flsum 'FLADD2))
+(test* "flonum loop variable" 5.0 (flsum 10))
+(test* "flonum and fixnum constant" '(((FLMUL2)))
+       (filter-insn flpow2 'FLMUL2))
+(test* "flonum and fixnum constant" 1024.0 (flpow2 10))
+(test* "exact zero isn't converted" '()
+       (filter-insn flzero 'FLMUL2))
+(test* "exact zero isn't converted" 0 (flzero 3) eqv?)
+(test* "loop variable starting with exact zero" '()
+       (filter-insn mixed-sum 'FLADD2))
+(test* "loop variable starting with exact zero" 0 (mixed-sum 0) eqv?)
+(test* "loop variable starting with exact zero" 1.5 (mixed-sum 3))
+(test* "unknown argument" '()
+       (filter-insn (^[x] (+ x 1.0)) 'FLADD2))
+
+(test* "no-specialization-pass" '()
+       (let ([flag (with-module gauche.internal SCM_COMPILE_NO_SPECIALIZE)])
+         (dynamic-wind
+           (^[] ((with-module gauche.internal vm-compiler-flag-set!) flag))
+           (^[] (filter-insn (eval '(^[n]
+                                      (let loop ([i 0] [x 0.0])
+                                        (if (< i n)
+                                          (loop (+ i 1) (+ x 0.5))
+                                          x)))
+                                   (current-module))
+                             'FLADD2))
+           (^[] ((with-module gauche.internal vm-compiler-flag-clear!) flag)))))
+
 (test-section "transformation")
 
 ;; pass2 intermediate lref elimination
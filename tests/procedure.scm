@@ -718,4 +718,60 @@
 (test* "bigcond= 1028" 1027
        (apply bigcond=-proc 1027 (iota 1028)))
 
+;;-----------------------------------------------------------------
+(test-section "baseline JIT")
+
+;; The JIT is a no-op on unsupported platforms; these tests are valid
+;; regardless.  With threshold 2, the second call of each closure body
+;; runs native code.
+(define jit-threshold (with-module gauche.internal %vm-jit-threshold))
+(define orig-jit-threshold (jit-threshold 2))
+
+(define (jit-sum n)
+  (let loop ([i 0] [s 0])
+    (if (< i n) (loop (+ i 1) (+ s i)) s)))
+(define (jit-fsum n)
+  (let loop ([i 0] [x 0.0])
+    (if (< i n) (loop (+ i 1) (+ x 0.5)) x)))
+(define (jit-lsum xs)
+  (let loop ([xs xs] [s 0])
+    (if (null? xs) s (loop (cdr xs) (+ s (car xs))))))
+(define (jit-count-down n)
+  (let loop ([n n])
+    (if (= n 0) 'done (loop (- n 1)))))
+
+(define (jit-repeat thunk)
+  (let loop ([k 0] [r #f])
+    (if (= k 5) r (loop (+ k 1) (thunk)))))
+
+(test* "fixnum loop" 4999950000 (jit-repeat (^[] (jit-sum 100000))))
+(test* "fixnum loop overflows to bignum"
+       (* (greatest-fixnum) 2)
+       (jit-repeat (^[] (jit-lsum (list (greatest-fixnum) (greatest-fixnum))))))
+(test* "flonum loop" 5000.0 (jit-repeat (^[] (jit-fsum 10000))))
+(test* "list loop" 4950 (jit-repeat (^[] (jit-lsum (iota 100)))))
+(test* "generic arithmetic fallback" 5/2
+       (jit-repeat (^[] (jit-lsum '(1/2 1 1)))))
+(test* "mixed exactness fallback" 2.5
+       (jit-repeat (^[] (jit-lsum '(0.5 1 1)))))
+(test* "count down" 'done (jit-repeat (^[] (jit-count-down 100000))))
+(test* "error in native code" (test-error)
+       (jit-repeat (^[] (jit-lsum '(1 2 . 3)))))
+(test* "error in native code" (test-error)
+       (jit-repeat (^[] (jit-lsum '(1 a 2)))))
+(test* "closures sharing code"
+       '(10 20 30)
+       (map (^k (let1 f (^[n] (let loop ([i 0] [s 0])
+                                (if (< i n) (loop (+ i 1) (+ s k)) s)))
+                  (jit-repeat (^[] (f 10)))))
+            '(1 2 3)))
+;; A fresh closure each time; the count is shared by its body.
+(define (jit-adder k)
+  (^[n] (let loop ([i 0] [s 0])
+          (if (< i n) (loop (+ i 1) (+ s k)) s))))
+(test* "closure created per call" 20
+       (jit-repeat (^[] ((jit-adder 2) 10))))
+
+(jit-threshold orig-jit-threshold)
+
 (test-end)
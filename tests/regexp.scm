@@ -705,6 +705,65 @@
 (test* "abc" '(2 5 "abc") (rxmatch->full-match "^abc" "zzabczz" 2 6))
 (test* "abc" '(3 6 "abc") (rxmatch->full-match "abc$" "zzzabczz" 2 6))
 (test* "abc" '(5 8 "abc") (rxmatch->full-match "abc" "abczzabczz" 4))
+;;-------------------------------------------------------------------------
+(test-section "linear-time matching")
+
+;; Regexps with choice points and without backreferences or lookaround
+;; run on the Pike VM.  The results must be the same as the backtracking
+;; matcher.
+(test-re #/(a|ab)(c|bcd)(d*)/ "abcd"     '("abcd" "a" "bcd" ""))
+(test-re #/((a)|b)+/          "ab"       '("ab" "b" "a"))
+(test-re #/(a*?)(a*)/         "aaa"      '("aaa" "" "aaa"))
+(test-re #/(a|b)*?c/          "abac"     '("abac" "a"))
+(test-re #/(?i:(a|b)+)c/      "xABac"    '("ABac" "a"))
+(test-re #/\b(foo|foobar)\b/  "a foobar" '("foobar" "foobar"))
+(test-re (string->regexp "(\u3042|\u3044)+\u3046") "\u3042\u3042\u3044\u3046"
+         '("\u3042\u3042\u3044\u3046" "\u3044"))
+(test-re #/^(a|b)$/           "a\nb"     '())
+(test-re #/(?:x|y)\s*z/       "xy z"     '("y z"))
+(test* "start/end" '(4 6 "ab")
+       (rxmatch->full-match "(a|b)+" "abczabcz" 3 6))
+
+;; These exhaust the C stack or take exponential time with the
+;; backtracking matcher.
+(let1 s (make-string 100000 #\a)
+  (test* "long repetition" 100000
+         (rxmatch-end (#/(?:a|b)*/ s)))
+  (test* "long repetition (no match)" #f
+         (rxmatch #/(..)*c/ s))
+  (test* "long repetition (captures)" '("aa" 99998 100000)
+         (let1 m (#/^(..)*$/ s)
+           (list (m 1) (rxmatch-start m 1) (rxmatch-end m 1)))))
+(test* "exponential backtracking" #f
+       (rxmatch #/^(x+x+)+y$/ (make-string 40 #\x)))
+(test* "nested alternatives" #f
+       (rxmatch #/(a|aa)+$/ (string-append (make-string 5000 #\a) "b")))
+
+;; The matcher skips the input using the literal a match must contain
+;; and the set of bytes a match can begin with.
+(test-section "prefilter")
+
+(test-re #/foo\d+/           "xxfoo fooo foo42"  '("foo42"))
+(test-re #/[a-c]x\wyz/       "\u00e9xayz bxqyz" '("bxqyz"))
+(test-re #/.xyz/              "\u00e9xyz"        '("\u00e9xyz"))
+(test-re #/(?:ab|cd)+efg/     "abcdab efg cdefg"  '("cdefg"))
+(test-re #/a.*needle/         "a haystack needle" '("a haystack needle"))
+(test-re #/(?i:hello) world/  "HeLLo world"       '("HeLLo world"))
+(test-re #/(?<=\d)px/         "px 12px"           '("px"))
+(test-re #/\bcat\b/           "concat cat"        '("cat"))
+(test-re (string->regexp "[\u00e9a]b") "xx\u00e9b"   '("\u00e9b"))
+(test-re #/[^x]yz/            "xyz ayz"           '("ayz"))
+(test-re #/x$y/               "xy x$y"            '("x$y"))
+(test* "prefilter with start/end" '(#f "foo")
+       (list (rxmatch-substring (rxmatch #/foo/ "abcfoo" 0 5))
+             (rxmatch-substring (rxmatch #/foo/ "abcfoo" 1 6))))
+(let1 s (string-append (make-string 100000 #\a) "needle")
+  (test* "prefilter (long input)" '(#f #f "needle" "aneedle")
+         (list (rxmatch #/needlx/ s)
+               (rxmatch #/a.*needlx/ s)
+               (rxmatch-substring (#/ne+dle/ s))
+               (rxmatch-substring (#/[^a]*.needle/ s)))))
+
 
 ;;-------------------------------------------------------------------------
 (test-section "regexp macros")
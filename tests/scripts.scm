@@ -120,6 +120,68 @@
              (process-output->string '("./gosh" "-ftest" "test.o")))
          (delete-files "test.o")))
 
+;; Heap image
+(let ()
+  (define (run-with-image)
+    (process-output->string
+     '("./gosh" "--image=test.o.img" "-ftest" "-fload-verbose" "-Itest.o.d"
+       "-uimg.lib" "-e" "(begin (write (img-twice (img-f 2))) (exit 0))")
+     :error :merge))
+
+  (delete-files "test.o.d" "test.o.img")
+  (make-directory* "test.o.d/img")
+  (with-output-to-file "test.o.d/img/lib.scm"
+    (^[]
+      (write '(define-module img.lib (export img-twice img-f)))
+      (write '(select-module img.lib))
+      (write '(define-syntax img-twice (syntax-rules () [(_ x) (list x x)])))
+      (write '(define img-k 3))
+      (write '(define (img-f n) (* n img-k)))))
+
+  (unwind-protect
+      (begin
+        (test* "dump heap image" #t
+               (begin
+                 (do-process '("./gosh" "--dump-image=test.o.img" "-ftest"
+                               "-Itest.o.d" "-uimg.lib"))
+                 (file-exists? "test.o.img")))
+        ;; With the image, img/lib.scm isn't loaded, so -fload-verbose
+        ;; doesn't report it.
+        (test* "run with heap image" "(6 6)" (run-with-image))
+        (test* "heap image with other load paths" '(#t #t)
+               (let1 out (process-output->string
+                          '("./gosh" "--image=test.o.img" "-ftest"
+                            "-Itest.o.d/img" "-Itest.o.d" "-uimg.lib"
+                            "-e" "(begin (write (img-f 2)) (exit 0))")
+                          :error :merge)
+                 (list (boolean (string-scan out "different load paths"))
+                       (boolean (string-scan out "6")))))
+        (with-output-to-file "test.o.d/img/lib.scm"
+          (^[] (write '(define img-k 4)))
+          :if-exists :append)
+        (test* "out of date heap image" '(#t #t)
+               (let1 out (run-with-image)
+                 (list (boolean (string-scan out "is ignored"))
+                       (boolean (string-scan out "(8 8)")))))
+        ;; A file reading its own source can't be saved.  It is left
+        ;; out of the image and loaded as usual.
+        (with-output-to-file "test.o.d/img/raw.scm"
+          (^[] (display "(define-module img.raw (export img-raw))\n\
+                         (select-module img.raw)\n\
+                         (define img-raw (read (current-load-port)))\n\
+                         42\n")))
+        (test* "heap image with a file that can't be saved" '(#t "42")
+               (let1 out (process-output->string
+                          '("./gosh" "--dump-image=test.o.img" "-ftest"
+                            "-Itest.o.d" "-uimg.raw")
+                          :error :merge)
+                 (list (boolean (string-scan out "Can't save"))
+                       (process-output->string
+                        '("./gosh" "--image=test.o.img" "-ftest"
+                          "-Itest.o.d" "-uimg.raw"
+                          "-e" "(begin (write img-raw) (exit 0))"))))))
+    (delete-files "test.o.d" "test.o.img")))
+
 ;;=======================================================================
 (test-section "gauche-config")
 
@@ -971,11 +1033,107 @@
                ,(im-state-test))))))
   )
 
+;; Parallel and incremental precompilation.  We work on a copy of the
+;; sources, since we modify them.
+(define (precomp-test-6)
+  (define srcs '("foo.scm" "foo/bar1.scm" "foo/bar2.scm" "foo/bar3.scm"))
+  (define (run-precomp! . opts)
+    (process-output->string-list
+     `("../../src/gosh" "-ftest"
+       ,(build-path *top-srcdir* "lib/tools/precomp")
+       "--gosh=../../src/gosh -ftest" "--state=precomp.state"
+       "-I" "src" "--strip-prefix" "src"
+       ,@opts
+       ,@(map (cut build-path "src" <>) srcs))
+     :directory "test.o"))
+  (define (would-compile . opts)
+    (sort (filter-map (^l (rxmatch->string #/^precomp: would compile (.*)/
+                                           l 1))
+                      (apply run-precomp! "--dry-run" opts))))
+  (define (append-line! file line)
+    (with-output-to-file (build-path "test.o/src" file)
+      (cut print line) :if-exists :append))
+
+  (copy-directory* (build-path *top-srcdir* "tests/test-precomp") "test.o/src")
+
+  (test* "running parallel precomp" #t
+         (boolean (member "precomp: 4 file(s) compiled, 0 up to date"
+                          (run-precomp! "-j" "2" "--timing"))))
+  (test* "parallel precomp generated files"
+         '("test.o/foo--bar1.c"
+           "test.o/foo--bar2.c"
+           "test.o/foo--bar3.c"
+           "test.o/foo.c")
+         (sort (filter #/\.c$/ (map fix-path (directory-fold "test.o" cons '())))))
+  (test* "nothing to recompile" '() (would-compile))
+  (test* "touching a source" '()
+         (begin
+           (touch-file "test.o/src/foo/bar2.scm"
+                       :time (+ (sys-time) 10))
+           (would-compile)))
+  (test* "modifying a used module" '("src/foo.scm" "src/foo/bar3.scm")
+         (begin
+           (append-line! "foo/bar3.scm" ";; modified")
+           (would-compile)))
+  (test* "modifying an included file" '("src/foo.scm" "src/foo/bar3.scm")
+         (begin
+           (append-line! "include/inc1.scm" ";; modified")
+           (would-compile)))
+  (test* "modifying a module used indirectly" srcs
+         (begin
+           (append-line! "foo/bar2.scm" ";; modified")
+           (map (cut string-drop <> 4) (would-compile))))
+  (test* "incremental precomp" #t
+         (boolean (member "precomp: 4 file(s) compiled, 0 up to date"
+                          (run-precomp! "-j" "0"))))
+  (test* "nothing to recompile" '() (would-compile))
+  (test* "changing options" srcs
+         (map (cut string-drop <> 4)
+              (would-compile "--omit-debug-source-info")))
+
+  (test* "compile 6" #t
+         (do-compile! "foo"
+                      '("foo.c" "foo--bar1.c" "foo--bar2.c" "foo--bar3.c")))
+  (test* "dynload parallel precompiled code" '(begin1 begin2)
+         (dynload-and-eval
+          "foo"
+          (list ((module-binding-ref 'foo 'foo-begin1))
+                ((module-binding-ref 'foo 'foo-begin2)))))
+  )
+
+;; Compiling procedures into C with the C backend.
+(define (precomp-test-7)
+  (test* "running precomp 7" #t
+         (do-precomp! '("native-test.scm")
+                      '("-e" "--native=fib,sum-list,make-adder")))
+  (test* "compile 7" #t (do-compile! "native-test" '("native-test.c")))
+
+  (test* "natively compiled procedures" '(#f #f #t #t)
+         (dynload-and-eval
+          "native-test"
+          (map (^[name] (closure? (module-binding-ref 'native-test name)))
+               '(fib sum-list make-adder vm-fib))))
+  (test* "calling natively compiled procedures" '(6765 6765 55 10)
+         (dynload-and-eval
+          "native-test"
+          (list ((module-binding-ref 'native-test 'fib) 20)
+                ((module-binding-ref 'native-test 'vm-fib) 20)
+                ((module-binding-ref 'native-test 'sum-list) (iota 11))
+                (((module-binding-ref 'native-test 'make-adder) 3) 7))))
+  (test* "error from natively compiled procedure" 'error
+         (dynload-and-eval
+          "native-test"
+          (guard (e [(<error> e) 'error])
+            ((module-binding-ref 'native-test 'sum-list) '(1 a)))))
+  )
+
 (wrap-with-test-directory precomp-test-1 '("test.o"))
 (wrap-with-test-directory precomp-test-2 '("test.o"))
 (wrap-with-test-directory precomp-test-3 '("test.o"))
 (wrap-with-test-directory precomp-test-4 '("test.o"))
 (wrap-with-test-directory precomp-test-5 '("test.o"))
+(wrap-with-test-directory precomp-test-6 '("test.o"))
+(wrap-with-test-directory precomp-test-7 '("test.o"))
 
 ;;=======================================================================
 (test-section "build-standalone")
@@ -0,0 +1,86 @@
+;;
+;; Measure gauche.selector performance with many idle connections.
+;;
+;;   gosh selector-performance.scm [idle-connections [active-connections]]
+;;
+;; Makes IDLE + ACTIVE TCP connections over loopback, and registers the
+;; server side of all of them to a selector of each backend.  Then ACTIVE
+;; connections play ping-pong, while IDLE ones stay silent.  Each sample
+;; exchanges a fixed number of messages.  The select backend is skipped
+;; if the fds don't fit in FD_SETSIZE.
+;;
+;; Each connection uses two fds; the fd limit is raised if possible.
+;;
+
+(use gauche.net)
+(use gauche.selector)
+(use gauche.time)
+
+(define *messages* 10000)
+
+(define (raise-fd-limit! n)
+  (guard (e [else #f])
+    (receive (cur max) (sys-getrlimit RLIMIT_NOFILE)
+      (when (< cur n)
+        (sys-setrlimit RLIMIT_NOFILE (if (< max n) max n) max)))))
+
+;; Returns a list of (client-socket . server-socket).
+(define (make-connections n)
+  (let* ([server (make-server-socket
+                  (make <sockaddr-in> :host :loopback :port 0)
+                  :reuse-addr? #t)]
+         [addr (socket-getsockname server)])
+    (begin0 (list-tabulate n
+                           (^_ (let1 c (make-client-socket addr)
+                                 (cons c (socket-accept server)))))
+      (socket-close server))))
+
+(define (close-connections conns)
+  (dolist [c conns]
+    (socket-close (car c))
+    (socket-close (cdr c))))
+
+(define *count* 0)
+
+;; Returns a thunk that exchanges *messages* messages with a selector
+;; of BACKEND.  Selectors of different backends can watch the same fds,
+;; since only the one that is selecting handles the messages.
+(define (ping-pong-thunk backend idle active)
+  (let1 sel (make <selector> :backend backend)
+    ;; Echo back whatever received
+    (define (ping-pong sock)
+      (^[fd flag]
+        (socket-recv sock 16)
+        (inc! *count*)
+        (socket-send sock "x")))
+    (dolist [c idle]
+      (selector-add! sel (socket-fd (cdr c)) (^ _ (error "unexpected")) '(r)))
+    (dolist [c active]
+      (selector-add! sel (socket-fd (cdr c)) (ping-pong (cdr c)) '(r))
+      (selector-add! sel (socket-fd (car c)) (ping-pong (car c)) '(r)))
+    (^[] (let1 end (+ *count* *messages*)
+           (while (< *count* end)
+             (selector-select sel))))))
+
+(define (main args)
+  (let* ([nidle   (if (> (length args) 1) (x->integer (cadr args)) 10000)]
+         [nactive (if (> (length args) 2) (x->integer (caddr args)) 100)]
+         [_ (raise-fd-limit! (+ (* 2 (+ nidle nactive)) 64))]
+         [idle (make-connections nidle)]
+         [active (make-connections nactive)]
+         [backends (cond-expand
+                    [gauche.sys.epoll '(epoll)]
+                    [else (print "epoll: not supported") '()])]
+         [backends (if (< (socket-fd (cdr (last active))) 1024) ; FD_SETSIZE
+                     `(,@backends select)
+                     (begin (print "select: skipped (fds exceed FD_SETSIZE)")
+                            backends))]
+         [samples (map (^b (cons b (ping-pong-thunk b idle active)))
+                       backends)])
+    (format #t "~d idle and ~d active connections, ~d messages per run\n"
+            nidle nactive *messages*)
+    (dolist [c active] (socket-send (car c) "x"))
+    (time-these/report '(real 3) samples)
+    (close-connections idle)
+    (close-connections active)
+    0))
@@ -97,4 +97,151 @@
          (selector-select *sel* 0)
          (list *x* *y*)))
 
+;; The default backend is select, which accepts regular files.
+(test* "selector-add! (regular file)" #t
+       (let ([sel (make <selector>)]
+             [r #f])
+         (with-output-to-file "test.o" (cut display "abc"))
+         (call-with-input-file "test.o"
+           (^[in]
+             (selector-add! sel in (^[p f] (set! r #t)) '(r))
+             (selector-select sel 0)))
+         (sys-unlink "test.o")
+         r))
+
+;; Features added along with the epoll backend, tested with both.
+(define (backend-tests backend)
+  (test* #"selector-select (~backend)" '(foo #f)
+         (let ([sel (make <selector> :backend backend)]
+               [r '()])
+           (receive (in out) (sys-pipe)
+             (selector-add! sel in (^[p f] (push! r (read p))) '(r))
+             (write 'foo out) (newline out) (flush out)
+             (selector-select sel 0)
+             (selector-delete! sel in #f #f)
+             (write 'bar out) (newline out) (flush out)
+             (selector-select sel 0)
+             (close-port in) (close-port out)
+             (list (car r) (null? (cdr r))))))
+
+  (test* #"oneshot (~backend)" 1
+         (let ([sel (make <selector> :backend backend)]
+               [count 0])
+           (receive (in out) (sys-pipe)
+             (selector-add! sel in (^[p f] (inc! count)) '(r oneshot))
+             (display "a" out) (flush out)
+             (selector-select sel 0)
+             (selector-select sel 0)
+             (close-port in) (close-port out)
+             count)))
+
+  (test* #"replace handler (~backend)" '(0 1)
+         (let ([sel (make <selector> :backend backend)]
+               [a 0] [b 0])
+           (receive (in out) (sys-pipe)
+             (selector-add! sel in (^[p f] (inc! a)) '(r))
+             (selector-add! sel in (^[p f] (inc! b)) '(r))
+             (display "a" out) (flush out)
+             (selector-select sel 0)
+             (close-port in) (close-port out)
+             (list a b))))
+
+  (test* #"timer (~backend)" '(1 #t)
+         (let ([sel (make <selector> :backend backend)]
+               [count 0])
+           (selector-add-timer! sel 10000 (^[] (inc! count)))
+           ;; No fds to wait; selector-select returns when the timer fires.
+           (let1 n (selector-select sel 2000000)
+             (selector-select sel 0)
+             (list count (zero? n)))))
+
+  (test* #"repeating timer (~backend)" 3
+         (let* ([sel (make <selector> :backend backend)]
+                [count 0]
+                [timer #f])
+           (set! timer
+                 (selector-add-timer! sel 1000
+                                      (^[] (inc! count)
+                                        (when (= count 3)
+                                          (selector-delete-timer! sel timer)))
+                                      #t))
+           (dotimes [i 5] (selector-select sel 100000))
+           count))
+
+  (test* #"timer and fd (~backend)" '(in timer)
+         (let ([sel (make <selector> :backend backend)]
+               [r '()])
+           (receive (in out) (sys-pipe)
+             (selector-add! sel in (^[p f] (read-char p) (push! r 'in)) '(r))
+             (selector-add-timer! sel 50000 (^[] (push! r 'timer)))
+             (display "a" out) (flush out)
+             (selector-select sel)
+             (selector-select sel)
+             (close-port in) (close-port out)
+             (reverse r))))
+  )
+
+(backend-tests 'select)
+
+(cond-expand
+ [gauche.sys.epoll
+  (backend-tests 'epoll)
+
+  (test* "edge-triggered (epoll)" '(1 1 2)
+         (let ([sel (make <selector> :backend 'epoll)]
+               [count 0])
+           (receive (in out) (sys-pipe)
+             ;; The handler doesn't read, so the fd stays readable.
+             (selector-add! sel in (^[p f] (inc! count)) '(r edge))
+             (display "a" out) (flush out)
+             (selector-select sel 0)
+             (let1 c1 count
+               (selector-select sel 0)
+               (let1 c2 count
+                 (display "b" out) (flush out)
+                 (selector-select sel 0)
+                 (close-port in) (close-port out)
+                 (list c1 c2 count))))))
+
+  (test* "many fds (epoll)" 100
+         (let ([sel (make <selector> :backend 'epoll)]
+               [count 0])
+           (let1 pipes (list-tabulate 100 (^_ (values->list (sys-pipe))))
+             (dolist [p pipes]
+               (selector-add! sel (car p) (^[p f] (read-char p) (inc! count))
+                              '(r)))
+             (dolist [p pipes] (display "a" (cadr p)) (flush (cadr p)))
+             (let loop ([i 0])
+               (when (and (< count 100) (< i 100))
+                 (selector-select sel 0)
+                 (loop (+ i 1))))
+             (dolist [p pipes] (close-port (car p)) (close-port (cadr p)))
+             count)))
+
+  ;; The kernel drops a closed fd from the epoll set.  When the fd number
+  ;; is reused, the selector still has handlers for it, and must add the
+  ;; fd to the set again.
+  (test* "reused fd (epoll)" 1
+         (let ([sel (make <selector> :backend 'epoll)]
+               [count 0])
+           (receive (in out) (sys-pipe)
+             (selector-add! sel (port-file-number in) (^[p f] #f) '(r))
+             (close-port in) (close-port out))
+           (receive (in out) (sys-pipe)
+             (selector-add! sel in (^[p f] (read-char p) (inc! count)) '(r))
+             (display "a" out) (flush out)
+             (selector-select sel 0)
+             (close-port in) (close-port out)
+             count)))
+
+  (test* "regular file (epoll)" (test-error <system-error>)
+         (let1 sel (make <selector> :backend 'epoll)
+           (with-output-to-file "test.o" (cut display "abc"))
+           (unwind-protect
+               (call-with-input-file "test.o"
+                 (^[in] (selector-add! sel in (^[p f] #f) '(r))))
+             (sys-unlink "test.o"))))
+  ]
+ [else])
+
 (test-end)
@@ -0,0 +1,75 @@
+;;
+;; Measure performance of the binary serializer.
+;;
+;;   gosh serial-performance.scm [size-in-megabytes]
+;;
+;; Builds nested data of roughly SIZE megabytes when written (lists,
+;; vectors, strings, symbols, flonums, hash tables and uvectors), then
+;; compares writing and reading it by write-shared/read (write-shared
+;; is needed to keep the sharing) and by <bserializer>, with and
+;; without sharing.
+;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use gauche.serializer)
+(use gauche.serializer.bserializer)
+
+(define (make-record i)
+  (let1 h (make-hash-table 'eq?)
+    (hash-table-put! h 'id i)
+    (hash-table-put! h 'name (format "item-~d" i))
+    `(item ,i ,(* i 1.5) ,(vector 'a 'b (number->string i 16))
+           ,(list "lorem ipsum dolor sit amet" 'tag-foo 'tag-bar)
+           ,h)))
+
+;; Each item is about 200 octets when written, plus a u8vector per 1000.
+(define (make-data size)
+  (let1 n (quotient size 200)
+    (list-tabulate n (^i (if (zero? (modulo i 1000))
+                           (make-u8vector 4096 (modulo i 256))
+                           (make-record i))))))
+
+;; Hash tables can't be read back by read, so we write them as alists.
+;; The conversion is done beforehand, for it isn't the cost of write.
+(define (readable-data data)
+  (map (^x (if (pair? x)
+             (append (drop-right x 1) (list (hash-table->alist (last x))))
+             x))
+       data))
+
+(define (bserializer-writer shared)
+  (^[data out]
+    (write-to-serializer (make <bserializer> :port out :shared shared) data)))
+
+(define (bserializer-reader in)
+  (read-from-serializer (make <bserializer> :port in)))
+
+(define (main args)
+  (let* ([mb (if (> (length args) 1) (x->integer (cadr args)) 10)]
+         [data (make-data (* mb 1024 1024))]
+         [rdata (readable-data data)]
+         ;; (name writer reader data)
+         [methods `((write/read ,write-shared ,read ,rdata)
+                    (bserializer ,(bserializer-writer #t)
+                                 ,bserializer-reader ,data)
+                    (bserializer-unshared ,(bserializer-writer #f)
+                                          ,bserializer-reader ,data))]
+         [outputs (map (^m (call-with-output-string
+                             (cut (cadr m) (cadddr m) <>)))
+                       methods)])
+    (format #t "~d items\n" (length data))
+    (for-each (^[m s] (format #t "~20a ~10d octets\n" (car m) (string-size s)))
+              methods outputs)
+    (print "write")
+    ($ time-these/report '(cpu 5)
+       (map (^m (cons (car m)
+                      (^[] (call-with-output-string
+                             (cut (cadr m) (cadddr m) <>)))))
+            methods))
+    (print "read")
+    ($ time-these/report '(cpu 5)
+       (map (^[m s] (cons (car m)
+                          (^[] (call-with-input-string s (caddr m)))))
+            methods outputs))
+    0))
@@ -4,6 +4,9 @@
 
 (use gauche.serializer)
 (use gauche.serializer.aserializer)
+(use gauche.serializer.bserializer)
+(use gauche.uvector)
+(use gauche.record)
 (use gauche.test)
 
 (test-start "serializer")
@@ -173,6 +176,142 @@
          (lambda () (sys-remove "test.s"))
          )))
 
+;;----------------------------------------------------------------------
+(test-section "bserializer")
+
+(define (b-roundtrip obj)
+  (read-from-string-with-serializer
+   <bserializer>
+   (write-to-string-with-serializer <bserializer> obj)))
+
+(define *binary-types*
+  `(,(expt 3 100) ,(- (expt 2 70)) 2/3 -1/7 1.5+2.0i +inf.0 -0.0
+    #\x3042 "日本語の文字列" ,(string->u8vector "abc") :key
+    ,(s16vector -1 0 1) ,(f64vector 1.0 -2.5) ,(u8vector)
+    #u8(255 0) #*"ab\xff;"
+    ,(make-string 10 #\a) ,(list 'a (vector 1 "x" '(b . c)))))
+
+(test* "primitives" *primitive-types* (b-roundtrip *primitive-types*))
+(test* "more types" *binary-types* (b-roundtrip *binary-types*))
+
+(test* "shared/circular component" #t
+       (topological-equal? *shared-substructure*
+                           (b-roundtrip *shared-substructure*)))
+
+(test* "objects" #t
+       (topological-equal? *object-instances*
+                           (b-roundtrip *object-instances*)))
+
+(define-record-type point (make-point x y) point?
+  (x point-x)
+  (y point-y set-point-y!))
+
+(test* "records" '(#t 1 (2 3) #t)
+       (let* ([p (make-point 1 (list 2 3))]
+              [_ (set-point-y! p (list 2 3 p))]
+              [r (b-roundtrip p)])
+         (list (point? r) (point-x r)
+               (take (point-y r) 2)
+               (eq? r (caddr (point-y r))))))
+
+(test* "hash tables" '(eq? ((a . 1) (b . "two")) string=? (("x" . #(1 2))))
+       (let ([h1 (make-hash-table 'eq?)]
+             [h2 (make-hash-table 'string=?)])
+         (hash-table-put! h1 'a 1)
+         (hash-table-put! h1 'b "two")
+         (hash-table-put! h2 "x" #(1 2))
+         (let1 r (b-roundtrip (list h1 h2))
+           (list (hash-table-type (car r))
+                 (sort (hash-table->alist (car r))
+                       (^[a b] (symbol<? (car a) (car b))))
+                 (hash-table-type (cadr r))
+                 (hash-table->alist (cadr r))))))
+
+(test* "circular hash table" #t
+       (let1 h (make-hash-table 'equal?)
+         (hash-table-put! h '(self) h)
+         (let1 r (b-roundtrip h)
+           (eq? r (hash-table-get r '(self))))))
+
+(test* "uninterned symbol" '(#t #f)
+       (let* ([s (gensym)]
+              [r (b-roundtrip (list s s))])
+         (list (eq? (car r) (cadr r))
+               (symbol-interned? (car r)))))
+
+(test* "large data" '(#t #t)
+       (let* ([v (make-u8vector 200000 0)]
+              [lis (iota 100000)])
+         (dotimes [i 200000] (u8vector-set! v i (modulo i 251)))
+         (let1 r (b-roundtrip (list v lis))
+           (list (equal? (car r) v) (equal? (cadr r) lis)))))
+
+(test* "stream" '((1 2) #(a "b") "trailer" #t)
+       (let1 s (call-with-output-string
+                 (^[out]
+                   (let1 ser (make <bserializer> :port out)
+                     (write-to-serializer ser '(1 2))
+                     (write-to-serializer ser #(a "b"))
+                     (display "trailer" out))))
+         (call-with-input-string s
+           (^[in]
+             (let* ([ser (make <bserializer> :port in)]
+                    [a (read-from-serializer ser)]
+                    [b (read-from-serializer ser)]
+                    [c (read-line in)])
+               (list a b c
+                     (eof-object? (read-from-serializer ser))))))))
+
+(test* "without sharing" '(#f #t #t ((a) (a) "s" "s" k k))
+       (let* ([x (list 'a)]
+              [s "s"]
+              [g (gensym)]
+              [r (read-from-string-with-serializer
+                  <bserializer>
+                  (write-to-string-with-serializer
+                   <bserializer> (list x x s s 'k 'k g g) :shared #f))])
+         (list (eq? (car r) (cadr r))
+               (eq? (list-ref r 4) (list-ref r 5))
+               (eq? (list-ref r 6) (list-ref r 7))
+               (take r 6))))
+
+(test* "unserializable" (test-error)
+       (write-to-string-with-serializer <bserializer> (list 1 car)))
+
+(test* "broken data" (test-error)
+       (read-from-string-with-serializer
+        <bserializer>
+        (u8vector->string
+         (u8vector-copy (string->u8vector
+                         (write-to-string-with-serializer <bserializer>
+                                                          '(1 2 3)))
+                        0 5))))
+
+(test* "broken data (huge length)" (test-error)
+       ;; The data of #(1 2 3) is <chunk-length> <format> <tag> <immutable>
+       ;; <size> <element> ....  Replace the size with 2^40, adjusting
+       ;; the chunk length; it must be rejected before allocation.
+       (let1 v (string->u8vector
+                (write-to-string-with-serializer <bserializer> '#(1 2 3)))
+         (read-from-string-with-serializer
+          <bserializer>
+          (u8vector->string
+           (u8vector-append (u8vector (+ (u8vector-ref v 0) 5))
+                            (u8vector-copy v 1 4)
+                            #u8(#x80 #x80 #x80 #x80 #x80 #x20)
+                            (u8vector-copy v 5))))))
+
+(test* "file i/o" #t
+       (unwind-protect
+           (let1 data (list *primitive-types*
+                            *shared-substructure*
+                            *object-instances*)
+             (write-to-file-with-serializer <bserializer> data "test.s")
+             (topological-equal? data
+                                 (read-from-file-with-serializer <bserializer>
+                                                                 "test.s")))
+         (sys-remove "test.s")))
+
 ;(test "dserializer"
 ;      (lambda ()
 ;        (let* ((data *primitive-types*)
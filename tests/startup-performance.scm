@@ -0,0 +1,53 @@
+;;
+;; Measure startup time of gosh, with and without a heap image.
+;;
+;;   gosh startup-performance.scm [gosh-command [iterations]]
+;;
+;; Runs GOSH-COMMAND (default "gosh"; may include options) with several
+;; -u options ITERATIONS times, as is, with the compile cache, and with
+;; a heap image made by --dump-image (see libeval.scm), and shows the
+;; average wall-clock time of each.
+;;
+
+(use gauche.process)
+(use gauche.time)
+(use file.util)
+
+(define modules
+  '("gauche.interactive" "gauche.parseopt" "gauche.sequence"
+    "srfi.13" "text.tr" "util.match" "rfc.json"))
+
+(define (gosh-args command opts)
+  `(,@(string-split command #\space)
+    ,@opts
+    ,@(map (cut string-append "-u" <>) modules)))
+
+(define (run name command opts iterations)
+  (let1 t (make <real-time-counter>)
+    (with-time-counter t
+      (dotimes [_ iterations]
+        (unless (do-process (gosh-args command `(,@opts "-e" "(exit 0)")))
+          (error "gosh failed:" name))))
+    (format #t "~16a ~8,2f ms\n" name
+            (/ (* (time-counter-value t) 1000) iterations))))
+
+(define (main args)
+  (let* ([command (if (> (length args) 1) (cadr args) "gosh")]
+         [iterations (if (> (length args) 2) (x->integer (caddr args)) 20)]
+         [tmp (build-path (temporary-directory)
+                          #"gosh-startup-~(sys-getpid)")]
+         [image (build-path tmp "startup.img")])
+    (make-directory* tmp)
+    (unwind-protect
+        (begin
+          (format #t "~d iterations\n" iterations)
+          (run "plain" command '() iterations)
+          (sys-setenv "GAUCHE_COMPILE_CACHE" (build-path tmp "cache") #t)
+          (run "compile cache" command '() iterations)
+          (sys-unsetenv "GAUCHE_COMPILE_CACHE")
+          (unless (do-process (gosh-args command
+                                         `(,#"--dump-image=~image")))
+            (error "dumping image failed"))
+          (run "heap image" command `(,#"--image=~image") iterations))
+      (remove-directory* tmp))
+    0))
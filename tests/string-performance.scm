@@ -0,0 +1,59 @@
+;;
+;; Measure performance of string search, scan and validation.
+;;
+;;   gosh string-performance.scm [size-in-kilobytes]
+;;
+;; Runs each benchmark with every vector kernel level the cpu supports
+;; (0: scalar, 1: SSE2, 2: AVX2; see src/strsimd.c).  The texts are
+;; about SIZE kilobytes, either ASCII or Japanese (3 octets per
+;; character).
+;;
+
+(use gauche.time)
+(use srfi.13)
+
+(define simd-level (with-module gauche.internal %string-simd-level))
+
+(define (make-text unit size)
+  (let1 n (quotient size (string-size unit))
+    (string-concatenate (make-list (max n 1) unit))))
+
+(define (benchmarks size)
+  (let* ([ascii (make-text "The quick brown fox jumps over the lazy dog. " size)]
+         [japanese (make-text "いろはにほへとちりぬるをわかよたれそつねならむ" size)]
+         [ascii-in (string-complete->incomplete ascii)]
+         [japanese-in (string-complete->incomplete japanese)])
+    `(("string-scan (ascii)"
+       . ,(^[] (string-scan ascii "lazy cat")))
+      ("string-scan (japanese)"
+       . ,(^[] (string-scan japanese "ならむい")))
+      ("string-scan index (japanese)"
+       . ,(let1 s (string-append japanese "ん")
+            (^[] (string-scan s "ん"))))
+      ("string-scan-right char (ascii)"
+       . ,(let1 s (string-append "$" ascii)
+            (^[] (string-scan-right s #\$))))
+      ("string-index char (japanese)"
+       . ,(^[] (string-index japanese #\ん)))
+      ("string-contains (ascii)"
+       . ,(^[] (string-contains ascii "jumps over the lazy cat")))
+      ("incomplete->complete (ascii)"
+       . ,(^[] (string-incomplete->complete ascii-in)))
+      ("incomplete->complete (japanese)"
+       . ,(^[] (string-incomplete->complete japanese-in)))
+      ("string-cursor->index (japanese)"
+       . ,(let1 c (string-cursor-end japanese)
+            (^[] (string-cursor->index japanese c))))
+      )))
+
+(define (main args)
+  (let* ([size (* 1024 (if (> (length args) 1) (x->integer (cadr args)) 1024))]
+         [max-level (simd-level 2)])
+    (dolist [b (benchmarks size)]
+      (print (car b))
+      ($ time-these/report '(cpu 2)
+         (map (^[level] (cons (string->symbol #"level~level")
+                              (^[] (simd-level level) ((cdr b)))))
+              (iota (+ max-level 1)))))
+    (simd-level max-level)
+    0))
@@ -1049,4 +1049,66 @@
   ]
  [else]) ; gauche.os.windows
 
+;;-------------------------------------------------------------------
+(test-section "garbage collection")
+
+(test* "gc-configuration" '(:markers :incremental :time-limit
+                            :free-space-divisor :full-freq :max-heap-size)
+       (map car (gc-configuration)))
+
+(let1 orig (cadr (assq :free-space-divisor (gc-configuration)))
+  (test* "gc-configure! :free-space-divisor" 5
+         (begin (gc-configure! :free-space-divisor 5)
+                (cadr (assq :free-space-divisor (gc-configuration)))))
+  (gc-configure! :free-space-divisor orig))
+
+(test* "gc-configure! :markers (too late)" (test-error)
+       (gc-configure! :markers 2))
+(test* "gc-configure! unknown parameter" (test-error)
+       (gc-configure! :no-such-parameter 1))
+(test* "gc-configure! bad value" (test-error)
+       (gc-configure! :free-space-divisor 0))
+(test* "gc-configure! bad value" (test-error)
+       (gc-configure! :full-freq -1))
+
+(test* "gc-telemetry" '(#t #t #t #t)
+       (begin
+         (gc-telemetry-reset!)
+         (gc)
+         (gc)
+         (let ([tm (map (^p (cons (car p) (cadr p))) (gc-telemetry))])
+           (list (>= (assq-ref tm :collections) 2)
+                 (>= (assq-ref tm :pauses) 2)
+                 (= (assq-ref tm :pauses)
+                    (fold + 0 (vector->list (assq-ref tm :pause-histogram))))
+                 (>= (assq-ref tm :total-pause) (assq-ref tm :max-pause))))))
+
+(test* "gc-telemetry-reset!" 0
+       (begin
+         (gc-telemetry-reset!)
+         (cadr (assq :collections (gc-telemetry)))))
+
+(define (make-garbage n)
+  (let loop ([i 0] [r '()])
+    (if (< i n) (loop (+ i 1) (cons i r)) r)))
+
+(test* "vm-cache-allocated-bytes" #t
+       (let1 before (vm-cache-allocated-bytes)
+         (make-garbage 1000)
+         (> (vm-cache-allocated-bytes) before)))
+
+(test* "vm-cache-allocated-bytes (flonums)" #t
+       (let* ([before (vm-cache-allocated-bytes)]
+              [v (list-tabulate 100 (^i (+ i 0.5)))])
+         (and (= (length v) 100)
+              (> (vm-cache-allocated-bytes) before))))
+
+(cond-expand
+ [gauche.sys.threads
+  (test* "vm-cache-allocated-bytes (other thread)" #t
+         (let1 t (make-thread (^[] (make-garbage 1000)))
+           (thread-join! (thread-start! t))
+           (>= (vm-cache-allocated-bytes t) 1000)))]
+ [else])
+
 (test-end)
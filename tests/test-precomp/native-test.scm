@@ -0,0 +1,29 @@
+;;
+;; Procedures compiled into C by the C backend (--native option).
+;;
+
+(define-module native-test
+  (export fib sum-list make-adder vm-fib))
+(select-module native-test)
+
+(define (fib n)
+  (if (< n 2)
+    n
+    (+ (fib (- n 1)) (fib (- n 2)))))
+
+(define (sum-list xs)
+  (let loop ([xs xs] [s 0])
+    (if (null? xs)
+      s
+      (loop (cdr xs) (+ s (car xs))))))
+
+;; The C backend can't create a closure that closes over variables yet,
+;; so this one falls back to VM code.
+(define (make-adder n)
+  (^x (+ x n)))
+
+;; Not listed in --native.
+(define (vm-fib n)
+  (if (< n 2)
+    n
+    (+ (vm-fib (- n 1)) (vm-fib (- n 2)))))
@@ -892,6 +892,72 @@ fuga
 
 ;; WRITEME
 
+;;-------------------------------------------------------------------
+(test-section "rope")
+(use text.rope)
+(use text.tree)
+(test-module 'text.rope)
+
+(let ()
+  (define (build strs) (rope-concatenate strs))
+  (define words (map (^i (format "~d:あいう~a " i (make-string (modulo i 7) #\x)))
+                     (iota 500)))
+  (define str (string-concatenate words))
+  (define r (fold (^[w r] (rope-append r w)) (string->rope "") words))
+
+  (test* "rope-length" (string-length str) (rope-length r))
+  (test* "rope-size" (string-size str) (rope-size r))
+  (test* "rope->string" str (rope->string r))
+  (test* "rope->string (cached)" #t (eq? (rope->string r) (rope->string r)))
+  (test* "rope-depth balanced" #t
+         (<= (rope-depth r) (* 2 (integer-length (length (rope-pieces r))))))
+  (test* "rope-pieces" str (string-concatenate (rope-pieces r)))
+  (test* "rope-ref" #t
+         (every (^i (eqv? (string-ref str i) (rope-ref r i)))
+                (iota (string-length str))))
+  (test* "rope-ref out of range" (test-error) (rope-ref r (rope-length r)))
+  (test* "rope-ref fallback" 'none (rope-ref r -1 'none))
+  (test* "rope-substring" #t
+         (every (^[s e] (equal? (substring str s e)
+                                (rope->string (rope-substring r s e))))
+                '(0 3 100 1000 2345 0)
+                (list 0 10 1500 1001 (string-length str) (string-length str))))
+  (test* "rope-substring shares" #t
+         (<= (rope-depth (rope-substring r 10 3000)) (+ (rope-depth r) 2)))
+  (test* "rope-substring out of range" (test-error)
+         (rope-substring r 0 (+ (rope-length r) 1)))
+  (test* "rope-concatenate" str (rope->string (build words)))
+  (test* "rope-append mixed" "abcdef"
+         (rope->string (rope-append "a" (string->rope "bc") "" (rope-append "de" "f"))))
+  (test* "rope-empty?" '(#t #f)
+         (list (rope-empty? (rope-append "" "")) (rope-empty? r)))
+  (test* "mutable string is copied" "abc"
+         (let* ([s (string-copy "abc")]
+                [r (string->rope s)])
+           (string-set! s 0 #\z)
+           (rope->string r)))
+  (test* "equal?" #t (equal? r (build words)))
+  (test* "equal?" #f (equal? r (rope-append r "x")))
+  (test* "x->string" "abc" (x->string (rope-append "a" "bc")))
+  (test* "write" "#<rope 3 chars>" (write-to-string (rope-append "a" "bc")))
+  (test* "tree->string" str (tree->string (list r)))
+  (test* "open-input-rope" str (port->string (open-input-rope r)))
+  (test* "open-input-rope read-line" '("ab" "cdえ" "f")
+         (port->string-list (open-input-rope (rope-append "a" "b\ncd" "え\nf"))))
+  (test* "open-input-rope (empty)" (eof-object)
+         (read-char (open-input-rope (string->rope ""))))
+  (test* "rxmatch" "499:あいう"
+         (rxmatch-substring (rope-rxmatch #/499:[^ x]+/ r)))
+  (test* "object-apply" "1:あいうx"
+         (rxmatch-substring (#/\d+:\S+/ (rope-substring r 5))))
+  (test* "sequence" '(#\0 #\: #\あ)
+         (take (coerce-to <list> r) 3))
+  (test* "size-of" (string-length str) (size-of r))
+  (test* "ref" (string-ref str 123) (ref r 123))
+  (test* "subseq" "いう" (rope->string (subseq r 3 5)))
+  (test* "fold" (string-length str) (fold (^[c n] (+ n 1)) 0 r))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "sh")
 (use text.sh)
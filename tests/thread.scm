@@ -1054,4 +1054,98 @@
   ;;((with-module gauche.internal memo-table-dump) string-hash-tab)
   )
 
+;;---------------------------------------------------------------------
+(test-section "concurrent hash tables")
+
+(let ([h (make-concurrent-hash-table 'eqv?)]
+      [nthreads 8]
+      [nkeys 2000])
+  ;; Each thread inserts its own range of keys and concurrently
+  ;; increments shared counters.
+  (define (worker k)
+    (^[]
+      (dotimes [i nkeys]
+        (concurrent-hash-table-put! h (+ (* k nkeys) i) k)
+        (concurrent-hash-table-update! h (- (modulo i 10) 10) (cut + <> 1) 0)
+        (concurrent-hash-table-get h (* (modulo (+ k 1) nthreads) nkeys) #f))))
+
+  ($ for-each thread-join!
+     $ map (^k (thread-start! (make-thread (worker k))))
+     $ iota nthreads)
+
+  (test* "concurrent insertion" (+ (* nthreads nkeys) 10)
+         (concurrent-hash-table-num-entries h))
+  (test* "concurrent insertion (values)" #t
+         (every (^k (every (^i (eqv? (concurrent-hash-table-get
+                                      h (+ (* k nkeys) i) #f)
+                                     k))
+                           (iota nkeys)))
+                (iota nthreads)))
+  (test* "concurrent update" (make-list 10 (/ (* nthreads nkeys) 10))
+         (map (^i (concurrent-hash-table-get h i)) (iota 10 -10))))
+
+;;---------------------------------------------------------------------
+(test-section "work-stealing deques")
+
+(let ([dq (make-work-deque 'test)])
+  (test* "work-deque?" '(#t #f) (list (work-deque? dq) (work-deque? 'dq)))
+  (test* "work-deque-name" 'test (work-deque-name dq))
+  (test* "empty" '(#t 0 none none)
+         (list (work-deque-empty? dq) (work-deque-length dq)
+               (work-deque-pop! dq 'none) (work-deque-steal! dq 'none)))
+  (test* "pop from empty deque" (test-error) (work-deque-pop! dq))
+  (test* "push and pop (LIFO)" '(4 3 2 1 0)
+         (begin
+           (dotimes [i 5] (work-deque-push! dq i))
+           (list-tabulate 5 (^_ (work-deque-pop! dq)))))
+  (test* "push and steal (FIFO)" '(0 1 2 3 4)
+         (begin
+           (dotimes [i 5] (work-deque-push! dq i))
+           (list-tabulate 5 (^_ (work-deque-steal! dq)))))
+  (test* "growing" '(1000 999 0)
+         (begin
+           (dotimes [i 1000] (work-deque-push! dq i))
+           (list (work-deque-length dq)
+                 (work-deque-pop! dq)
+                 (work-deque-steal! dq))))
+  (test* "push by non-owner" 'error
+         (thread-join! (thread-start!
+                        (make-thread
+                         (^[] (guard (e [(<error> e) 'error])
+                                (work-deque-push! dq 'x)))))))
+  (test* "steal by non-owner" 1
+         (thread-join! (thread-start!
+                        (make-thread (^[] (work-deque-steal! dq)))))))
+
+;; The owner pops while other threads steal.  Every item must be taken
+;; exactly once.
+(let ([dq (make-work-deque)]
+      [nitems 20000]
+      [nthieves 4]
+      [done #f])
+  (define (thief)
+    (^[] (let loop ([r '()])
+           (let1 x (work-deque-steal! dq #f)
+             (cond [x (loop (cons x r))]
+                   [done r]
+                   [else (thread-yield!) (loop r)])))))
+  (let* ([ts (map (^_ (thread-start! (make-thread (thief))))
+                  (iota nthieves))]
+         [mine (let loop ([i 0] [r '()])
+                 (cond [(< i nitems)
+                        (work-deque-push! dq i)
+                        (if (even? i)
+                          (loop (+ i 1) r)
+                          (let1 x (work-deque-pop! dq #f)
+                            (loop (+ i 1) (if x (cons x r) r))))]
+                       [else
+                        (let drain ([r r])
+                          (if-let1 x (work-deque-pop! dq #f)
+                            (drain (cons x r))
+                            r))]))]
+         [_ (set! done #t)]
+         [stolen (append-map thread-join! ts)])
+    (test* "concurrent steal" (iota nitems)
+           (sort (append mine stolen)))))
+
 (test-end)
@@ -208,6 +208,36 @@
   (test-string-index 65537)
   (test-string-index 131072)
   (test-string-index 131073)
+
+  ;; Index is built automatically for long strings accessed often
+  (let1 s (make-str 1000)
+    (test* "auto index: not yet" #f
+           (begin (string-ref s 10) ; short scans aren't counted
+                  (string-ref s 300) (string-ref s 400) (string-ref s 200)
+                  (string-fast-indexable? s)))
+    (test* "auto index: indexed" #t
+           (begin (string-ref s 100)
+                  (string-fast-indexable? s)))
+    (test* "auto index: prefix shares index" #t
+           (string-fast-indexable? (substring s 0 300)))
+    (test* "auto index: derived string" '(#f #t #t)
+           (let ([t (substring s 10 300)]
+                 [u (string-append s "x")])
+             (list (string-fast-indexable? t)
+                   (begin (string-ref t 100) (string-fast-indexable? t))
+                   (begin (string-ref u 100) (string-fast-indexable? u))))))
+  (let1 s (make-str 20000)
+    (test* "auto index: large string" #t
+           (begin (string-ref s 1000) (string-fast-indexable? s)))
+    (test* "auto index: string-ref" #f
+           (any (^p (and (not (eqv? (car p) (string-ref s (cdr p))))
+                         (cdr p)))
+                (map cons (string->list s) (liota))))
+    (test* "auto index: substring" #t
+           (every (^[i] (equal? (substring s i (+ i 40))
+                                (list->string
+                                 (take (drop (string->list s) i) 40))))
+                  '(0 1 31 32 33 1000 4095 4097 9000))))
   )
 
 ;;-------------------------------------------------------------------
@@ -328,6 +358,110 @@
 (test "string-pad-right" "パッド■■" (lambda () (string-pad-right "パッド" 5 #\■)))
 (test "string-pad" "パディング" (lambda () (string-pad-right "パディングス" 5 #\■)))
 
+;;-------------------------------------------------------------------
+(test-section "vectorized string primitives")
+
+;; Searching, validation and counting use vector kernels chosen by
+;; the cpu (see strsimd.c).  We run the same tests on every level the
+;; cpu supports, comparing the results with naive implementations.
+(let ()
+  (define simd-level (with-module gauche.internal %string-simd-level))
+  (define max-level (simd-level 2))
+  (define alphabet (string #\a #\b #\あ #\x00e9 #\い #\c #\x1f600))
+
+  (define seed 1)
+  (define (rand n)
+    (set! seed (modulo (+ (* seed 1103515245) 12345) 2147483648))
+    (modulo (quotient seed 65536) n))
+  ;; A string of LEN characters, chosen from the first K of alphabet.
+  (define (random-string len k)
+    (with-output-to-string
+      (^[] (dotimes [_ len] (write-char (string-ref alphabet (rand k)))))))
+
+  (define (naive-scan s1 s2)
+    (let ([n (string-length s1)] [m (string-length s2)])
+      (let loop ([i 0])
+        (cond [(> (+ i m) n) #f]
+              [(string=? (substring s1 i (+ i m)) s2) i]
+              [else (loop (+ i 1))]))))
+  (define (naive-scan-right s1 c)
+    (let loop ([i (- (string-length s1) 1)])
+      (cond [(< i 0) #f]
+            [(char=? (string-ref s1 i) c) i]
+            [else (loop (- i 1))])))
+
+  ;; Runs THUNK N times, and returns the results that are not #t.
+  (define (failures n thunk)
+    (filter (^r (not (eq? r #t))) (list-tabulate n (^_ (thunk)))))
+
+  (define (run level)
+    (simd-level level)
+    (test* #"string-scan (level ~level)" '()
+           (failures 300
+                     (^[] (let* ([k (+ 1 (rand 7))]
+                                 [s1 (random-string (rand 200) k)]
+                                 [s2 (random-string (+ 1 (rand 4)) k)])
+                            (or (eqv? (naive-scan s1 s2) (string-scan s1 s2))
+                                (list s1 s2))))))
+    (test* #"string-scan-right (level ~level)" '()
+           (failures 300
+                     (^[] (let* ([k (+ 1 (rand 7))]
+                                 [s1 (random-string (rand 200) k)]
+                                 [c (string-ref alphabet (rand k))])
+                            (or (eqv? (naive-scan-right s1 c)
+                                      (string-scan-right s1 c))
+                                (list s1 c))))))
+    (test* #"string-index (level ~level)" '()
+           (failures 300
+                     (^[] (let* ([k (+ 1 (rand 7))]
+                                 [s1 (random-string (rand 200) k)]
+                                 [len (string-length s1)]
+                                 [start (rand (+ len 1))]
+                                 [c (string-ref alphabet (rand k))])
+                            (or (equal? (string-index s1 c start)
+                                        (let1 i (naive-scan (substring s1 start len)
+                                                            (string c))
+                                          (and i (+ i start))))
+                                (list s1 c start))))))
+    (test* #"string-contains (level ~level)" 215
+           (string-contains (string-append (make-string 200 #\あ)
+                                           "abc"
+                                           (make-string 13 #\い)
+                                           "あいabc")
+                            "いあいab"))
+    (test* #"string-scan, periodic needle (level ~level)" '(#f 4900)
+           (let ([s1 (make-string 5000 #\a)]
+                 [s2 (string-append (make-string 100 #\a) "b")])
+             (list (string-scan s1 s2)
+                   (string-scan (string-append s1 "b") s2))))
+    (test* #"string-cursor->index (level ~level)" '()
+           (let1 s (random-string 1000 7)
+             (filter (^i (not (= i (string-cursor->index
+                                    s (string-index->cursor s i)))))
+                     (iota 1001))))
+    (test* #"string-incomplete->complete (level ~level)" '()
+           (failures 100
+                     (^[] (let* ([s (random-string (rand 300) 7)]
+                                 [bs (string-complete->incomplete s)]
+                                 [pos (rand (+ (string-size bs) 1))]
+                                 [junk (list-ref '(#*"\xff" #*"\xc0\xaf"
+                                                   #*"\xe0\x80\xaf" #*"\x80"
+                                                   #*"\xe3\x81")
+                                                 (rand 5))]
+                                 [bad (string-append
+                                       (byte-substring bs 0 pos)
+                                       junk
+                                       (byte-substring bs pos
+                                                       (string-size bs)))])
+                            ;; BAD is always invalid, even if JUNK
+                            ;; is inserted in the middle of a character.
+                            (or (and (equal? (string-incomplete->complete bs) s)
+                                     (not (string-incomplete->complete bad)))
+                                (list s pos junk)))))))
+
+  (for-each run (iota (+ max-level 1)))
+  (simd-level max-level))
+
 ;;-------------------------------------------------------------------
 (test-section "char set")
 